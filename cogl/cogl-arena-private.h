@@ -0,0 +1,84 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_ARENA_PRIVATE_H
+#define __COGL_ARENA_PRIVATE_H
+
+#include <glib.h>
+
+#include "cogl-debug.h"
+
+/*
+ * A CoglArena is used for transient data that all has the same
+ * lifetime. Allocating just bumps a pointer within the current chunk
+ * of memory and nothing is freed individually. Instead the whole
+ * arena is reset at once. The memory is kept after a reset so that
+ * once the arena has grown big enough for a frame's worth of data no
+ * further calls to the system allocator are needed.
+ */
+
+typedef struct _CoglArenaChunk CoglArenaChunk;
+
+typedef struct _CoglArena
+{
+  /* The chunk that is being allocated from is at the head of the
+     list. Each chunk is twice the size of the previous one */
+  CoglArenaChunk *chunks;
+  size_t chunk_offset;
+
+  /* The number of allocations since the last reset */
+  unsigned long n_allocations;
+
+  /* Optional counters to update for each allocation. These can be
+     shared between arenas */
+  CoglDebugTypeStats *stats;
+} CoglArena;
+
+void
+_cogl_arena_init (CoglArena *arena,
+                  CoglDebugTypeStats *stats);
+
+void *
+_cogl_arena_alloc (CoglArena *arena,
+                   size_t size);
+
+#define _cogl_arena_new(arena, type) \
+  ((type *) _cogl_arena_alloc ((arena), sizeof (type)))
+
+/* Frees everything allocated from the arena. Only the largest chunk
+   of memory is kept */
+void
+_cogl_arena_reset (CoglArena *arena);
+
+/* Resets the arena and also frees the memory that would be kept if it
+   is bigger than max_size bytes. This is useful for arenas that are
+   occasionally used for very big allocations */
+void
+_cogl_arena_trim (CoglArena *arena,
+                  size_t max_size);
+
+void
+_cogl_arena_destroy (CoglArena *arena);
+
+#endif /* __COGL_ARENA_PRIVATE_H */
@@ -0,0 +1,151 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cogl-arena-private.h"
+
+#define COGL_ARENA_MIN_CHUNK_SIZE 4096
+
+/* Every allocation is aligned to this so that any structure can be
+   stored in it */
+#define COGL_ARENA_ALIGNMENT MAX (sizeof (void *), sizeof (double))
+
+#define COGL_ARENA_ALIGN(size) \
+  (((size) + COGL_ARENA_ALIGNMENT - 1) & ~(COGL_ARENA_ALIGNMENT - 1))
+
+struct _CoglArenaChunk
+{
+  CoglArenaChunk *next;
+  size_t size;
+};
+
+#define COGL_ARENA_CHUNK_DATA(chunk) \
+  ((guint8 *) (chunk) + COGL_ARENA_ALIGN (sizeof (CoglArenaChunk)))
+
+void
+_cogl_arena_init (CoglArena *arena,
+                  CoglDebugTypeStats *stats)
+{
+  arena->chunks = NULL;
+  arena->chunk_offset = 0;
+  arena->n_allocations = 0;
+  arena->stats = stats;
+}
+
+static void
+add_chunk (CoglArena *arena,
+           size_t min_size)
+{
+  CoglArenaChunk *chunk;
+  size_t size = COGL_ARENA_MIN_CHUNK_SIZE;
+
+  if (arena->chunks)
+    size = arena->chunks->size * 2;
+  while (size < min_size)
+    size *= 2;
+
+  chunk = g_malloc (COGL_ARENA_ALIGN (sizeof (CoglArenaChunk)) + size);
+  chunk->size = size;
+  chunk->next = arena->chunks;
+
+  arena->chunks = chunk;
+  arena->chunk_offset = 0;
+}
+
+void *
+_cogl_arena_alloc (CoglArena *arena,
+                   size_t size)
+{
+  void *ret;
+
+  size = COGL_ARENA_ALIGN (size);
+
+  if (G_UNLIKELY (arena->chunks == NULL ||
+                  arena->chunk_offset + size > arena->chunks->size))
+    add_chunk (arena, size);
+
+  ret = COGL_ARENA_CHUNK_DATA (arena->chunks) + arena->chunk_offset;
+  arena->chunk_offset += size;
+  arena->n_allocations++;
+
+  if (arena->stats)
+    {
+      arena->stats->instance_count++;
+      arena->stats->n_allocations++;
+    }
+
+  return ret;
+}
+
+static void
+free_chunks (CoglArenaChunk *chunk)
+{
+  while (chunk)
+    {
+      CoglArenaChunk *next = chunk->next;
+      g_free (chunk);
+      chunk = next;
+    }
+}
+
+void
+_cogl_arena_reset (CoglArena *arena)
+{
+  if (arena->chunks == NULL)
+    return;
+
+  /* The head of the list is always the biggest chunk */
+  free_chunks (arena->chunks->next);
+  arena->chunks->next = NULL;
+  arena->chunk_offset = 0;
+
+  if (arena->stats)
+    arena->stats->instance_count -= arena->n_allocations;
+  arena->n_allocations = 0;
+}
+
+void
+_cogl_arena_trim (CoglArena *arena,
+                  size_t max_size)
+{
+  _cogl_arena_reset (arena);
+
+  if (arena->chunks && arena->chunks->size > max_size)
+    {
+      free_chunks (arena->chunks);
+      arena->chunks = NULL;
+    }
+}
+
+void
+_cogl_arena_destroy (CoglArena *arena)
+{
+  _cogl_arena_reset (arena);
+  free_chunks (arena->chunks);
+  arena->chunks = NULL;
+  arena->chunk_offset = 0;
+}
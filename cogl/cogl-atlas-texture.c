@@ -190,7 +190,7 @@ _cogl_atlas_texture_atlas_destroyed_cb (void *user_data)
 }
 
 static CoglAtlas *
-_cogl_atlas_texture_create_atlas (void)
+_cogl_atlas_texture_create_atlas (CoglPixelFormat format)
 {
   static CoglUserDataKey atlas_private_key;
 
@@ -198,7 +198,7 @@ _cogl_atlas_texture_create_atlas (void)
 
   _COGL_GET_CONTEXT (ctx, COGL_INVALID_HANDLE);
 
-  atlas = _cogl_atlas_new (COGL_PIXEL_FORMAT_RGBA_8888,
+  atlas = _cogl_atlas_new (format,
                            0,
                            _cogl_atlas_texture_update_position_cb);
 
@@ -508,7 +508,7 @@ _cogl_atlas_texture_prepare_for_upload (CoglAtlasTexture *atlas_tex,
      images are all stored in the original premult format of the
      orignal format so we do need to trigger the conversion */
 
-  internal_format = (COGL_PIXEL_FORMAT_RGBA_8888 |
+  internal_format = (atlas_tex->atlas->texture_format |
                      (atlas_tex->format & COGL_PREMULT_BIT));
 
   converted_bmp = _cogl_texture_prepare_for_upload (bmp,
@@ -617,18 +617,37 @@ _cogl_atlas_texture_get_height (CoglTexture *tex)
   return cogl_texture_get_height (atlas_tex->sub_texture);
 }
 
-static gboolean
-_cogl_atlas_texture_can_use_format (CoglPixelFormat format)
-{
-  /* We don't care about the ordering or the premult status and we can
-     accept RGBA or RGB textures. Although we could also accept
-     luminance and alpha only textures or 16-bit formats it seems that
-     if the application is explicitly using these formats then they've
-     got a reason to want the lower memory requirements so putting
-     them in the atlas might not be a good idea */
-  format &= ~(COGL_PREMULT_BIT | COGL_BGR_BIT | COGL_AFIRST_BIT);
-  return (format == COGL_PIXEL_FORMAT_RGB_888 ||
-          format == COGL_PIXEL_FORMAT_RGBA_8888);
+/* Returns the format of the atlas that a texture with the given
+   internal format should be stored in or COGL_PIXEL_FORMAT_ANY if it
+   can't be put in an atlas */
+static CoglPixelFormat
+_cogl_atlas_texture_get_atlas_format (CoglPixelFormat format)
+{
+  /* Compressed data can never be copied in to the atlas */
+  if (_cogl_pixel_format_is_compressed (format))
+    return COGL_PIXEL_FORMAT_ANY;
+
+  /* We don't care about the ordering or the premult status. Each of
+     the remaining formats gets its own set of atlases so that alpha
+     only textures such as glyph masks and RGB textures don't have to
+     be expanded to RGBA. Although we could also accept luminance or
+     16-bit formats it seems that if the application is explicitly
+     using these formats then they've got a reason to want them so
+     putting them in the atlas might not be a good idea */
+  switch (format & ~(COGL_PREMULT_BIT | COGL_BGR_BIT | COGL_AFIRST_BIT))
+    {
+    case COGL_PIXEL_FORMAT_A_8:
+      return COGL_PIXEL_FORMAT_A_8;
+
+    case COGL_PIXEL_FORMAT_RGB_888:
+      return COGL_PIXEL_FORMAT_RGB_888;
+
+    case COGL_PIXEL_FORMAT_RGBA_8888:
+      return COGL_PIXEL_FORMAT_RGBA_8888;
+
+    default:
+      return COGL_PIXEL_FORMAT_ANY;
+    }
 }
 
 CoglHandle
@@ -639,6 +658,7 @@ _cogl_atlas_texture_new_with_size (unsigned int width,
 {
   CoglAtlasTexture *atlas_tex;
   CoglAtlas        *atlas;
+  CoglPixelFormat   atlas_format;
   GSList           *l;
 
   _COGL_GET_CONTEXT (ctx, COGL_INVALID_HANDLE);
@@ -667,7 +687,8 @@ _cogl_atlas_texture_new_with_size (unsigned int width,
   COGL_NOTE (ATLAS, "Adding texture of size %ix%i", width, height);
 
   /* If the texture is in a strange format then we won't use it */
-  if (!_cogl_atlas_texture_can_use_format (internal_format))
+  atlas_format = _cogl_atlas_texture_get_atlas_format (internal_format);
+  if (atlas_format == COGL_PIXEL_FORMAT_ANY)
     {
       COGL_NOTE (ATLAS, "Texture can not be added because the "
                  "format is unsupported");
@@ -687,23 +708,32 @@ _cogl_atlas_texture_new_with_size (unsigned int width,
 
   atlas_tex->sub_texture = COGL_INVALID_HANDLE;
 
-  /* Look for an existing atlas that can hold the texture */
+  /* Look for an existing atlas that can hold the texture. Only the
+     atlases with a matching format are considered */
   for (l = ctx->atlases; l; l = l->next)
-    /* Try to make some space in the atlas for the texture */
-    if (_cogl_atlas_reserve_space (atlas = l->data,
-                                   /* Add two pixels for the border */
-                                   width + 2, height + 2,
-                                   atlas_tex))
-      {
-        cogl_object_ref (atlas);
-        break;
-      }
+    {
+      atlas = l->data;
+
+      if (atlas->texture_format != atlas_format)
+        continue;
+
+      /* Try to make some space in the atlas for the texture */
+      if (_cogl_atlas_reserve_space (atlas,
+                                     /* Add two pixels for the border */
+                                     width + 2, height + 2,
+                                     atlas_tex))
+        {
+          cogl_object_ref (atlas);
+          break;
+        }
+    }
 
   /* If we couldn't find a suitable atlas then start another */
   if (l == NULL)
     {
-      atlas = _cogl_atlas_texture_create_atlas ();
-      COGL_NOTE (ATLAS, "Created new atlas for textures: %p", atlas);
+      atlas = _cogl_atlas_texture_create_atlas (atlas_format);
+      COGL_NOTE (ATLAS, "Created new atlas for textures of format 0x%x: %p",
+                 atlas_format, atlas);
       if (!_cogl_atlas_reserve_space (atlas,
                                       /* Add two pixels for the border */
                                       width + 2, height + 2,
@@ -32,6 +32,7 @@
 #include "cogl-object-private.h"
 #include "cogl-attribute-buffer.h"
 #include "cogl-attribute-buffer-private.h"
+#include "cogl-attribute-private.h"
 #include "cogl-context-private.h"
 
 static void _cogl_attribute_buffer_free (CoglAttributeBuffer *array);
@@ -73,6 +74,8 @@ cogl_attribute_buffer_new (CoglContext *context,
 static void
 _cogl_attribute_buffer_free (CoglAttributeBuffer *array)
 {
+  _cogl_attribute_forget_buffer_vertex_arrays (array);
+
   /* parent's destructor */
   _cogl_buffer_fini (COGL_BUFFER (array));
 
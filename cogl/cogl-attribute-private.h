@@ -98,12 +98,28 @@ _cogl_attribute_immutable_unref (CoglAttribute *attribute);
 void
 _cogl_attribute_disable_cached_arrays (void);
 
+/* Deletes any cached vertex array objects that refer to the given
+ * buffer. This must be called before the GL buffer is deleted because
+ * otherwise its name could be recycled for a new buffer */
+void
+_cogl_attribute_forget_buffer_vertex_arrays (CoglAttributeBuffer *buffer);
+
+void
+_cogl_attribute_free_vertex_array_cache (CoglContext *ctx);
+
+/* Flushes the pipeline and the attribute state for a draw. If
+ * @base_vertex_out isn't NULL then the attribute pointers may be
+ * stored relative to a vertex further into the buffers so that a
+ * cached vertex array object can be reused. The number of vertices
+ * that the caller needs to add to the first vertex of the draw is
+ * returned there */
 void
 _cogl_flush_attributes_state (CoglFramebuffer *framebuffer,
                               CoglPipeline *pipeline,
                               CoglDrawFlags flags,
                               CoglAttribute **attributes,
-                              int n_attributes);
+                              int n_attributes,
+                              int *base_vertex_out);
 
 #endif /* __COGL_ATTRIBUTE_PRIVATE_H */
 
@@ -41,6 +41,8 @@
 #include "cogl-texture-private.h"
 #include "cogl-framebuffer-private.h"
 #include "cogl-indices-private.h"
+#include "cogl-profile.h"
+#include "cogl-slab-private.h"
 #ifdef COGL_PIPELINE_PROGEND_GLSL
 #include "cogl-pipeline-progend-glsl-private.h"
 #endif
@@ -59,6 +61,11 @@ static void _cogl_attribute_free (CoglAttribute *attribute);
 
 COGL_OBJECT_DEFINE (Attribute, attribute);
 
+/* The journal creates new attributes for every batch so they are
+   allocated from a slab */
+static CoglSlabAllocator attribute_slab =
+  COGL_SLAB_ALLOCATOR_INIT (NULL, sizeof (CoglAttribute), 64);
+
 static gboolean
 validate_cogl_attribute_name (const char *name,
                               CoglAttributeNameID *name_id,
@@ -157,7 +164,7 @@ cogl_attribute_new (CoglAttributeBuffer *attribute_buffer,
                     int n_components,
                     CoglAttributeType type)
 {
-  CoglAttribute *attribute = g_slice_new (CoglAttribute);
+  CoglAttribute *attribute = _cogl_slab_alloc (&attribute_slab);
 
   /* FIXME: retrieve the context from the buffer */
   _COGL_GET_CONTEXT (ctx, NULL);
@@ -307,7 +314,7 @@ _cogl_attribute_free (CoglAttribute *attribute)
 {
   cogl_object_unref (attribute->attribute_buffer);
 
-  g_slice_free (CoglAttribute, attribute);
+  _cogl_slab_free (&attribute_slab, attribute);
 }
 
 typedef struct
@@ -481,31 +488,158 @@ foreach_changed_bit_and_save (CoglContext *context,
   _cogl_bitmask_set_bits (current_bits, new_bits);
 }
 
+/* Each attribute is assigned a slot which says where its array is
+ * plumbed into GL. Generic attributes use their attribute location
+ * and the fixed function arrays are given negative numbers so that
+ * both can be stored in the vertex array cache keys */
+#define ATTRIBUTE_SLOT_NONE G_MININT
+#define ATTRIBUTE_SLOT_COLOR -1
+#define ATTRIBUTE_SLOT_NORMAL -2
+#define ATTRIBUTE_SLOT_POSITION -3
+#define ATTRIBUTE_SLOT_TEXCOORD(unit) (-4 - (unit))
+#define ATTRIBUTE_SLOT_TEXCOORD_UNIT(slot) (-4 - (slot))
+
+static int
+get_attribute_slot (CoglContext *context,
+                    CoglPipeline *pipeline,
+                    CoglAttribute *attribute)
+{
+  CoglAttributeNameID name_id = attribute->name_state->name_id;
+
+  if (name_id == COGL_ATTRIBUTE_NAME_ID_CUSTOM_ARRAY ||
+      context->driver == COGL_DRIVER_GLES2)
+    {
 #ifdef COGL_PIPELINE_PROGEND_GLSL
+      if (context->driver != COGL_DRIVER_GLES1)
+        {
+          int name_index = attribute->name_state->name_index;
+          int attrib_location =
+            _cogl_pipeline_progend_glsl_get_attrib_location (pipeline,
+                                                             name_index);
+          if (attrib_location != -1)
+            return attrib_location;
+        }
+#endif
+      return ATTRIBUTE_SLOT_NONE;
+    }
+
+  switch (name_id)
+    {
+    case COGL_ATTRIBUTE_NAME_ID_COLOR_ARRAY:
+      return ATTRIBUTE_SLOT_COLOR;
+    case COGL_ATTRIBUTE_NAME_ID_NORMAL_ARRAY:
+      return ATTRIBUTE_SLOT_NORMAL;
+    case COGL_ATTRIBUTE_NAME_ID_TEXTURE_COORD_ARRAY:
+      return ATTRIBUTE_SLOT_TEXCOORD (attribute->name_state->texture_unit);
+    case COGL_ATTRIBUTE_NAME_ID_POSITION_ARRAY:
+      return ATTRIBUTE_SLOT_POSITION;
+    default:
+      g_warning ("Unrecognised attribute type 0x%08x", attribute->type);
+      return ATTRIBUTE_SLOT_NONE;
+    }
+}
 
+/* Sets the array pointer for the attribute and marks the slot as
+ * needing to be enabled in the context's tmp bitmasks. The buffer of
+ * the attribute must already be bound */
 static void
-setup_generic_attribute (CoglContext *context,
-                         CoglPipeline *pipeline,
-                         CoglAttribute *attribute,
-                         guint8 *base)
-{
-  int name_index = attribute->name_state->name_index;
-  int attrib_location =
-    _cogl_pipeline_progend_glsl_get_attrib_location (pipeline, name_index);
-  if (attrib_location != -1)
+setup_attribute (CoglContext *context,
+                 int slot,
+                 CoglAttribute *attribute,
+                 guint8 *pointer)
+{
+  if (slot >= 0)
     {
-      GE( context, glVertexAttribPointer (attrib_location,
+      GE( context, glVertexAttribPointer (slot,
                                           attribute->n_components,
                                           attribute->type,
                                           attribute->normalized,
                                           attribute->stride,
-                                          base + attribute->offset) );
+                                          pointer) );
       _cogl_bitmask_set (&context->enable_custom_attributes_tmp,
-                         attrib_location, TRUE);
+                         slot, TRUE);
+      return;
     }
+
+#if defined (HAVE_COGL_GL) || defined (HAVE_COGL_GLES)
+  switch (slot)
+    {
+    case ATTRIBUTE_SLOT_COLOR:
+      _cogl_bitmask_set (&context->enable_builtin_attributes_tmp,
+                         COGL_ATTRIBUTE_NAME_ID_COLOR_ARRAY, TRUE);
+      GE (context, glColorPointer (attribute->n_components,
+                                   attribute->type,
+                                   attribute->stride,
+                                   pointer));
+      break;
+    case ATTRIBUTE_SLOT_NORMAL:
+      _cogl_bitmask_set (&context->enable_builtin_attributes_tmp,
+                         COGL_ATTRIBUTE_NAME_ID_NORMAL_ARRAY, TRUE);
+      GE (context, glNormalPointer (attribute->type,
+                                    attribute->stride,
+                                    pointer));
+      break;
+    case ATTRIBUTE_SLOT_POSITION:
+      _cogl_bitmask_set (&context->enable_builtin_attributes_tmp,
+                         COGL_ATTRIBUTE_NAME_ID_POSITION_ARRAY, TRUE);
+      GE (context, glVertexPointer (attribute->n_components,
+                                    attribute->type,
+                                    attribute->stride,
+                                    pointer));
+      break;
+    default:
+      {
+        int unit = ATTRIBUTE_SLOT_TEXCOORD_UNIT (slot);
+
+        _cogl_bitmask_set (&context->enable_texcoord_attributes_tmp,
+                           unit, TRUE);
+        GE (context, glClientActiveTexture (GL_TEXTURE0 + unit));
+        GE (context, glTexCoordPointer (attribute->n_components,
+                                        attribute->type,
+                                        attribute->stride,
+                                        pointer));
+      }
+      break;
+    }
+#endif
 }
 
-#endif /* COGL_PIPELINE_PROGEND_GLSL */
+/* Sets up the array pointers for all of the attributes. The pointers
+ * are moved back by @base_vertex vertices so the caller must add that
+ * to the first vertex of the draw */
+static void
+setup_attributes (CoglContext *context,
+                  CoglAttribute **attributes,
+                  const int *slots,
+                  int n_attributes,
+                  int base_vertex)
+{
+  int i;
+
+  _cogl_bitmask_clear_all (&context->enable_builtin_attributes_tmp);
+  _cogl_bitmask_clear_all (&context->enable_texcoord_attributes_tmp);
+  _cogl_bitmask_clear_all (&context->enable_custom_attributes_tmp);
+
+  for (i = 0; i < n_attributes; i++)
+    {
+      CoglAttribute *attribute = attributes[i];
+      CoglBuffer *buffer;
+      guint8 *base;
+
+      if (slots[i] == ATTRIBUTE_SLOT_NONE)
+        continue;
+
+      buffer = COGL_BUFFER (cogl_attribute_get_buffer (attribute));
+      base = _cogl_buffer_bind (buffer,
+                                COGL_BUFFER_BIND_TARGET_ATTRIBUTE_BUFFER);
+
+      setup_attribute (context, slots[i], attribute,
+                       base + attribute->offset -
+                       (gsize) base_vertex * attribute->stride);
+
+      _cogl_buffer_unbind (buffer);
+    }
+}
 
 static void
 apply_attribute_enable_updates (CoglContext *context,
@@ -538,12 +672,306 @@ apply_attribute_enable_updates (CoglContext *context,
                                 &changed_bits_state);
 }
 
+/* The cache is simply cleared when it gets this big. Applications
+ * would normally only use a handful of vertex layouts so this should
+ * only happen if the attribute buffers are constantly recreated */
+#define VERTEX_ARRAY_CACHE_SIZE 256
+
+typedef struct
+{
+  GLuint gl_buffer;
+  int slot;
+  int n_components;
+  CoglAttributeType type;
+  gboolean normalized;
+  gsize stride;
+  /* The offset of the attribute relative to the first vertex of the
+   * draw. The absolute offset isn't part of the key so that drawing
+   * from a different part of the same buffer with the same layout,
+   * as the journal does for each batch, reuses the vertex array */
+  gsize vertex_offset;
+} CoglVertexArrayAttribute;
+
+/* A vertex array object along with the attribute state that was
+ * recorded into it. The entry itself is used as the hash table key
+ * and it is allocated with enough space for all of the attributes */
+typedef struct
+{
+  GLuint gl_vertex_array;
+  int n_attributes;
+  CoglVertexArrayAttribute attributes[1];
+} CoglVertexArrayEntry;
+
+#define VERTEX_ARRAY_ENTRY_SIZE(n_attributes)            \
+  (G_STRUCT_OFFSET (CoglVertexArrayEntry, attributes) +  \
+   sizeof (CoglVertexArrayAttribute) * (n_attributes))
+
+static unsigned int
+vertex_array_entry_hash (const void *data)
+{
+  const CoglVertexArrayEntry *entry = data;
+  unsigned int hash;
+
+  hash = _cogl_util_one_at_a_time_hash (0,
+                                        &entry->n_attributes,
+                                        sizeof (entry->n_attributes));
+  hash = _cogl_util_one_at_a_time_hash (hash,
+                                        entry->attributes,
+                                        sizeof (CoglVertexArrayAttribute) *
+                                        entry->n_attributes);
+
+  return _cogl_util_one_at_a_time_mix (hash);
+}
+
+static gboolean
+vertex_array_entry_equal (const void *a, const void *b)
+{
+  const CoglVertexArrayEntry *entry_a = a;
+  const CoglVertexArrayEntry *entry_b = b;
+
+  return (entry_a->n_attributes == entry_b->n_attributes &&
+          !memcmp (entry_a->attributes,
+                   entry_b->attributes,
+                   sizeof (CoglVertexArrayAttribute) *
+                   entry_a->n_attributes));
+}
+
+static void
+vertex_array_entry_free (void *data)
+{
+  CoglVertexArrayEntry *entry = data;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  _cogl_gl_state_delete_vertex_array (ctx, entry->gl_vertex_array);
+
+  g_free (entry);
+}
+
+static gboolean
+vertex_array_entry_uses_buffer_cb (void *key,
+                                   void *value,
+                                   void *user_data)
+{
+  CoglVertexArrayEntry *entry = value;
+  GLuint gl_buffer = GPOINTER_TO_UINT (user_data);
+  int i;
+
+  for (i = 0; i < entry->n_attributes; i++)
+    if (entry->attributes[i].gl_buffer == gl_buffer)
+      return TRUE;
+
+  return FALSE;
+}
+
+void
+_cogl_attribute_forget_buffer_vertex_arrays (CoglAttributeBuffer *buffer)
+{
+  CoglContext *ctx = COGL_BUFFER (buffer)->context;
+  GLuint gl_buffer = COGL_BUFFER (buffer)->gl_handle;
+
+  if (ctx->vertex_array_cache == NULL ||
+      g_hash_table_size (ctx->vertex_array_cache) == 0 ||
+      !(COGL_BUFFER (buffer)->flags & COGL_BUFFER_FLAG_BUFFER_OBJECT))
+    return;
+
+  g_hash_table_foreach_remove (ctx->vertex_array_cache,
+                               vertex_array_entry_uses_buffer_cb,
+                               GUINT_TO_POINTER (gl_buffer));
+}
+
+void
+_cogl_attribute_free_vertex_array_cache (CoglContext *ctx)
+{
+  if (ctx->vertex_array_cache)
+    {
+      g_hash_table_destroy (ctx->vertex_array_cache);
+      ctx->vertex_array_cache = NULL;
+    }
+}
+
+/* Enables all of the arrays marked in the tmp bitmasks on a newly
+ * created vertex array object where everything starts disabled. This
+ * doesn't touch the context's enabled bitmasks because those track
+ * the state of the default vertex array */
+static void
+enable_new_vertex_array_attributes (CoglContext *context)
+{
+  ForeachChangedBitState changed_bits_state;
+  CoglBitmask disabled_bits;
+
+  _cogl_bitmask_init (&disabled_bits);
+
+  changed_bits_state.context = context;
+  changed_bits_state.pipeline = NULL;
+
+  foreach_changed_bit_and_save (context,
+                                &disabled_bits,
+                                &context->enable_builtin_attributes_tmp,
+                                toggle_builtin_attribute_enabled_cb,
+                                &changed_bits_state);
+
+  _cogl_bitmask_clear_all (&disabled_bits);
+  foreach_changed_bit_and_save (context,
+                                &disabled_bits,
+                                &context->enable_texcoord_attributes_tmp,
+                                toggle_texcood_attribute_enabled_cb,
+                                &changed_bits_state);
+
+  _cogl_bitmask_clear_all (&disabled_bits);
+  foreach_changed_bit_and_save (context,
+                                &disabled_bits,
+                                &context->enable_custom_attributes_tmp,
+                                toggle_custom_attribute_enabled_cb,
+                                &changed_bits_state);
+
+  _cogl_bitmask_destroy (&disabled_bits);
+}
+
+/* Works out how many whole vertices the attribute pointers can be
+ * moved back by so that the offsets left over only describe the
+ * layout of the vertices. This is only possible if the caller can
+ * pass the difference on to the draw and all of the attributes have
+ * an explicit stride */
+static int
+get_base_vertex (CoglAttribute **attributes,
+                 const int *slots,
+                 int n_attributes)
+{
+  int base_vertex = G_MAXINT;
+  int i;
+
+  for (i = 0; i < n_attributes; i++)
+    {
+      CoglAttribute *attribute = attributes[i];
+
+      if (slots[i] == ATTRIBUTE_SLOT_NONE)
+        continue;
+
+      if (attribute->stride == 0)
+        return 0;
+
+      base_vertex = MIN (base_vertex, attribute->offset / attribute->stride);
+    }
+
+  return base_vertex == G_MAXINT ? 0 : base_vertex;
+}
+
+/* Binds a vertex array object containing the given attribute state,
+ * creating it if there isn't one in the cache yet. The key is built
+ * from the GL buffer names and layout of the attributes at draw time
+ * so changing an attribute or reallocating its buffer just results in
+ * a different key. If @base_vertex_out isn't NULL then the pointers
+ * are stored relative to a base vertex which the caller must add to
+ * the first vertex of the draw. This returns FALSE if the attributes
+ * can't be stored in a vertex array object, which happens when a
+ * buffer has fallen back to malloc'd memory */
+static gboolean
+flush_vertex_array (CoglContext *context,
+                    CoglAttribute **attributes,
+                    const int *slots,
+                    int n_attributes,
+                    int *base_vertex_out)
+{
+  CoglVertexArrayEntry *key;
+  CoglVertexArrayEntry *entry;
+  int n_key_attributes = 0;
+  int base_vertex = 0;
+  gsize entry_size;
+  int i;
+
+  COGL_STATIC_COUNTER (vertex_array_hit_counter,
+                       "Vertex array cache hit counter",
+                       "Increments each time the attribute state is "
+                       "flushed with a cached vertex array object",
+                       0 /* no application private data */);
+  COGL_STATIC_COUNTER (vertex_array_create_counter,
+                       "Vertex array create counter",
+                       "Increments each time a GL vertex array object "
+                       "is created",
+                       0 /* no application private data */);
+
+  key = g_alloca (VERTEX_ARRAY_ENTRY_SIZE (n_attributes));
+  /* Clear the whole key so that any padding won't affect the hash or
+     the comparison */
+  memset (key, 0, VERTEX_ARRAY_ENTRY_SIZE (n_attributes));
+
+  if (base_vertex_out)
+    base_vertex = get_base_vertex (attributes, slots, n_attributes);
+
+  for (i = 0; i < n_attributes; i++)
+    {
+      CoglAttribute *attribute = attributes[i];
+      CoglBuffer *buffer;
+      CoglVertexArrayAttribute *key_attribute;
+
+      if (slots[i] == ATTRIBUTE_SLOT_NONE)
+        continue;
+
+      buffer = COGL_BUFFER (cogl_attribute_get_buffer (attribute));
+      if (!(buffer->flags & COGL_BUFFER_FLAG_BUFFER_OBJECT))
+        return FALSE;
+
+      key_attribute = key->attributes + n_key_attributes++;
+      key_attribute->gl_buffer = buffer->gl_handle;
+      key_attribute->slot = slots[i];
+      key_attribute->n_components = attribute->n_components;
+      key_attribute->type = attribute->type;
+      key_attribute->normalized = attribute->normalized;
+      key_attribute->stride = attribute->stride;
+      key_attribute->vertex_offset =
+        attribute->offset - (gsize) base_vertex * attribute->stride;
+    }
+
+  key->n_attributes = n_key_attributes;
+
+  if (base_vertex_out)
+    *base_vertex_out = base_vertex;
+
+  if (context->vertex_array_cache == NULL)
+    context->vertex_array_cache =
+      g_hash_table_new_full (vertex_array_entry_hash,
+                             vertex_array_entry_equal,
+                             NULL, /* key destroy */
+                             vertex_array_entry_free);
+
+  entry = g_hash_table_lookup (context->vertex_array_cache, key);
+
+  if (entry)
+    {
+      COGL_COUNTER_INC (_cogl_uprof_context, vertex_array_hit_counter);
+      _cogl_gl_state_bind_vertex_array (context, entry->gl_vertex_array);
+      return TRUE;
+    }
+
+  COGL_COUNTER_INC (_cogl_uprof_context, vertex_array_create_counter);
+
+  if (g_hash_table_size (context->vertex_array_cache) >=
+      VERTEX_ARRAY_CACHE_SIZE)
+    g_hash_table_remove_all (context->vertex_array_cache);
+
+  entry_size = VERTEX_ARRAY_ENTRY_SIZE (n_key_attributes);
+  entry = g_malloc (entry_size);
+  memcpy (entry, key, entry_size);
+
+  GE (context, glGenVertexArrays (1, &entry->gl_vertex_array));
+  _cogl_gl_state_bind_vertex_array (context, entry->gl_vertex_array);
+
+  setup_attributes (context, attributes, slots, n_attributes, base_vertex);
+  enable_new_vertex_array_attributes (context);
+
+  g_hash_table_insert (context->vertex_array_cache, entry, entry);
+
+  return TRUE;
+}
+
 void
 _cogl_flush_attributes_state (CoglFramebuffer *framebuffer,
                               CoglPipeline *pipeline,
                               CoglDrawFlags flags,
                               CoglAttribute **attributes,
-                              int n_attributes)
+                              int n_attributes,
+                              int *base_vertex_out)
 {
   int i;
   gboolean skip_gl_color = FALSE;
@@ -551,6 +979,10 @@ _cogl_flush_attributes_state (CoglFramebuffer *framebuffer,
   int n_tex_coord_attribs = 0;
   ValidateLayerState layers_state;
   CoglContext *ctx = framebuffer->context;
+  int *slots;
+
+  if (base_vertex_out)
+    *base_vertex_out = 0;
 
   if (!(flags & COGL_DRAW_SKIP_JOURNAL_FLUSH))
     _cogl_journal_flush (framebuffer->journal, framebuffer);
@@ -667,104 +1099,41 @@ _cogl_flush_attributes_state (CoglFramebuffer *framebuffer,
 
   _cogl_pipeline_flush_gl_state (pipeline, skip_gl_color, n_tex_coord_attribs);
 
-  _cogl_bitmask_clear_all (&ctx->enable_builtin_attributes_tmp);
-  _cogl_bitmask_clear_all (&ctx->enable_texcoord_attributes_tmp);
-  _cogl_bitmask_clear_all (&ctx->enable_custom_attributes_tmp);
+  /* If the pipeline's program is still being linked then the draw
+   * will be skipped so there's no point in setting up the attributes */
+  if (G_UNLIKELY (ctx->current_pipeline_skip_draws))
+    {
+      if (copy)
+        cogl_object_unref (copy);
+      return;
+    }
 
   /* Bind the attribute pointers. We need to do this after the
    * pipeline is flushed because when using GLSL that is the only
    * point when we can determine the attribute locations */
 
+  slots = g_alloca (sizeof (int) * n_attributes);
   for (i = 0; i < n_attributes; i++)
-    {
-      CoglAttribute *attribute = attributes[i];
-      CoglAttributeBuffer *attribute_buffer;
-      CoglBuffer *buffer;
-      guint8 *base;
-
-      attribute_buffer = cogl_attribute_get_buffer (attribute);
-      buffer = COGL_BUFFER (attribute_buffer);
-      base = _cogl_buffer_bind (buffer, COGL_BUFFER_BIND_TARGET_ATTRIBUTE_BUFFER);
-
-      switch (attribute->name_state->name_id)
-        {
-        case COGL_ATTRIBUTE_NAME_ID_COLOR_ARRAY:
-#ifdef HAVE_COGL_GLES2
-          if (ctx->driver == COGL_DRIVER_GLES2)
-            setup_generic_attribute (ctx, pipeline, attribute, base);
-          else
-#endif
-            {
-              _cogl_bitmask_set (&ctx->enable_builtin_attributes_tmp,
-                                 COGL_ATTRIBUTE_NAME_ID_COLOR_ARRAY, TRUE);
-              GE (ctx, glColorPointer (attribute->n_components,
-                                       attribute->type,
-                                       attribute->stride,
-                                       base + attribute->offset));
-            }
-          break;
-        case COGL_ATTRIBUTE_NAME_ID_NORMAL_ARRAY:
-#ifdef HAVE_COGL_GLES2
-          if (ctx->driver == COGL_DRIVER_GLES2)
-            setup_generic_attribute (ctx, pipeline, attribute, base);
-          else
-#endif
-            {
-              _cogl_bitmask_set (&ctx->enable_builtin_attributes_tmp,
-                                 COGL_ATTRIBUTE_NAME_ID_NORMAL_ARRAY, TRUE);
-              GE (ctx, glNormalPointer (attribute->type,
-                                        attribute->stride,
-                                        base + attribute->offset));
-            }
-          break;
-        case COGL_ATTRIBUTE_NAME_ID_TEXTURE_COORD_ARRAY:
-#ifdef HAVE_COGL_GLES2
-          if (ctx->driver == COGL_DRIVER_GLES2)
-            setup_generic_attribute (ctx, pipeline, attribute, base);
-          else
-#endif
-            {
-              _cogl_bitmask_set (&ctx->enable_texcoord_attributes_tmp,
-                                 attribute->name_state->texture_unit, TRUE);
-              GE (ctx,
-                  glClientActiveTexture (GL_TEXTURE0 +
-                                         attribute->name_state->texture_unit));
-              GE (ctx, glTexCoordPointer (attribute->n_components,
-                                          attribute->type,
-                                          attribute->stride,
-                                          base + attribute->offset));
-            }
-          break;
-        case COGL_ATTRIBUTE_NAME_ID_POSITION_ARRAY:
-#ifdef HAVE_COGL_GLES2
-          if (ctx->driver == COGL_DRIVER_GLES2)
-            setup_generic_attribute (ctx, pipeline, attribute, base);
-          else
-#endif
-            {
-              _cogl_bitmask_set (&ctx->enable_builtin_attributes_tmp,
-                                 COGL_ATTRIBUTE_NAME_ID_POSITION_ARRAY, TRUE);
-              GE (ctx, glVertexPointer (attribute->n_components,
-                                        attribute->type,
-                                        attribute->stride,
-                                        base + attribute->offset));
-            }
-          break;
-        case COGL_ATTRIBUTE_NAME_ID_CUSTOM_ARRAY:
-#ifdef COGL_PIPELINE_PROGEND_GLSL
-          if (ctx->driver != COGL_DRIVER_GLES1)
-            setup_generic_attribute (ctx, pipeline, attribute, base);
-#endif
-          break;
-        default:
-          g_warning ("Unrecognised attribute type 0x%08x", attribute->type);
-        }
+    slots[i] = get_attribute_slot (ctx, pipeline, attributes[i]);
 
-      _cogl_buffer_unbind (buffer);
+  if (ctx->private_feature_flags & COGL_PRIVATE_FEATURE_VERTEX_ARRAY_OBJECTS)
+    {
+      if (!COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_VAOS) &&
+          flush_vertex_array (ctx, attributes, slots, n_attributes,
+                              base_vertex_out))
+        goto done;
+
+      /* The enabled attribute bitmasks in the context track the
+       * state of the default vertex array */
+      _cogl_gl_state_bind_vertex_array (ctx, 0);
     }
 
+  setup_attributes (ctx, attributes, slots, n_attributes, 0);
+
   apply_attribute_enable_updates (ctx, pipeline);
 
+done:
+
   if (copy)
     cogl_object_unref (copy);
 }
@@ -774,6 +1143,11 @@ _cogl_attribute_disable_cached_arrays (void)
 {
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
+  /* The enabled attribute bitmasks only describe the default vertex
+   * array */
+  if (ctx->private_feature_flags & COGL_PRIVATE_FEATURE_VERTEX_ARRAY_OBJECTS)
+    _cogl_gl_state_bind_vertex_array (ctx, 0);
+
   _cogl_bitmask_clear_all (&ctx->enable_builtin_attributes_tmp);
   _cogl_bitmask_clear_all (&ctx->enable_texcoord_attributes_tmp);
   _cogl_bitmask_clear_all (&ctx->enable_custom_attributes_tmp);
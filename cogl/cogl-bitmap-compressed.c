@@ -0,0 +1,307 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cogl-internal.h"
+#include "cogl-bitmap-private.h"
+
+/* Loads the base level of images stored in the KTX and DDS
+   containers. These are used to store compressed texture data that
+   can be passed straight to GL so the image libraries can't load
+   them */
+
+static const guint8 ktx_identifier[] =
+  { 0xab, 0x4b, 0x54, 0x58, 0x20, 0x31, 0x31, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a };
+
+#define KTX_HEADER_SIZE 64
+#define KTX_ENDIANNESS 0x04030201
+
+#define DDS_HEADER_SIZE 128
+#define DDS_PIXEL_FORMAT_FOURCC 0x4
+
+/* The GL enums used for glInternalFormat in KTX files. These are
+   defined here so that the loader doesn't depend on the GL headers */
+#define KTX_ETC1_RGB8 0x8d64
+#define KTX_RGB8_ETC2 0x9274
+#define KTX_RGBA8_ETC2_EAC 0x9278
+#define KTX_RGB_S3TC_DXT1 0x83f0
+#define KTX_RGBA_S3TC_DXT3 0x83f2
+#define KTX_RGBA_S3TC_DXT5 0x83f3
+
+#define MAKE_FOURCC(a, b, c, d) \
+  ((guint32) (a) | ((guint32) (b) << 8) | \
+   ((guint32) (c) << 16) | ((guint32) (d) << 24))
+
+typedef enum
+{
+  CONTAINER_UNKNOWN,
+  CONTAINER_KTX,
+  CONTAINER_DDS
+} ContainerType;
+
+static guint32
+read_uint32 (const guint8 *p, gboolean swap)
+{
+  guint32 value = ((guint32) p[0] |
+                   ((guint32) p[1] << 8) |
+                   ((guint32) p[2] << 16) |
+                   ((guint32) p[3] << 24));
+
+  return swap ? GUINT32_SWAP_LE_BE (value) : value;
+}
+
+/* Only reads the magic numbers so that other files don't have to be
+   read twice */
+static ContainerType
+get_container_type (const char *filename)
+{
+  ContainerType type = CONTAINER_UNKNOWN;
+  guint8 magic[sizeof (ktx_identifier)];
+  size_t got;
+  FILE *file;
+
+  if ((file = fopen (filename, "rb")) == NULL)
+    return CONTAINER_UNKNOWN;
+
+  got = fread (magic, 1, sizeof (magic), file);
+
+  if (got >= sizeof (ktx_identifier) &&
+      !memcmp (magic, ktx_identifier, sizeof (ktx_identifier)))
+    type = CONTAINER_KTX;
+  else if (got >= 4 && !memcmp (magic, "DDS ", 4))
+    type = CONTAINER_DDS;
+
+  fclose (file);
+
+  return type;
+}
+
+static void
+free_file_contents (guint8 *data, void *contents)
+{
+  g_free (contents);
+}
+
+static gsize
+get_image_size (CoglPixelFormat format, int width, int height)
+{
+  return ((gsize) _cogl_get_format_block_size (format) *
+          ((width + 3) / 4) * ((height + 3) / 4));
+}
+
+static gboolean
+set_corrupt_error (const char *filename, GError **error)
+{
+  g_set_error (error, COGL_BITMAP_ERROR, COGL_BITMAP_ERROR_CORRUPT_IMAGE,
+               "The compressed image '%s' is invalid", filename);
+  return FALSE;
+}
+
+static gboolean
+set_unknown_type_error (const char *filename, GError **error)
+{
+  g_set_error (error, COGL_BITMAP_ERROR, COGL_BITMAP_ERROR_UNKNOWN_TYPE,
+               "The compressed image '%s' uses an unsupported format",
+               filename);
+  return FALSE;
+}
+
+static CoglPixelFormat
+format_from_ktx (guint32 gl_internal_format)
+{
+  switch (gl_internal_format)
+    {
+    case KTX_ETC1_RGB8:
+      return COGL_PIXEL_FORMAT_ETC1_RGB_8;
+    case KTX_RGB8_ETC2:
+      return COGL_PIXEL_FORMAT_ETC2_RGB_8;
+    case KTX_RGBA8_ETC2_EAC:
+      return COGL_PIXEL_FORMAT_ETC2_RGBA_8;
+    case KTX_RGB_S3TC_DXT1:
+      return COGL_PIXEL_FORMAT_S3TC_DXT1_RGB;
+    case KTX_RGBA_S3TC_DXT3:
+      return COGL_PIXEL_FORMAT_S3TC_DXT3_RGBA;
+    case KTX_RGBA_S3TC_DXT5:
+      return COGL_PIXEL_FORMAT_S3TC_DXT5_RGBA;
+    default:
+      return COGL_PIXEL_FORMAT_ANY;
+    }
+}
+
+static CoglPixelFormat
+format_from_dds (guint32 fourcc)
+{
+  if (fourcc == MAKE_FOURCC ('D', 'X', 'T', '1'))
+    return COGL_PIXEL_FORMAT_S3TC_DXT1_RGB;
+  else if (fourcc == MAKE_FOURCC ('D', 'X', 'T', '3'))
+    return COGL_PIXEL_FORMAT_S3TC_DXT3_RGBA;
+  else if (fourcc == MAKE_FOURCC ('D', 'X', 'T', '5'))
+    return COGL_PIXEL_FORMAT_S3TC_DXT5_RGBA;
+  else
+    return COGL_PIXEL_FORMAT_ANY;
+}
+
+/* Finds the image data of the base level within a KTX file */
+static gboolean
+parse_ktx (const char *filename,
+           const guint8 *contents,
+           gsize length,
+           CoglPixelFormat *format,
+           int *width,
+           int *height,
+           gsize *offset,
+           GError **error)
+{
+  gboolean swap;
+  guint32 gl_type, gl_internal_format;
+  guint32 depth, n_array_elements, n_faces;
+  guint32 key_value_size, image_size;
+
+  if (length < KTX_HEADER_SIZE)
+    return set_corrupt_error (filename, error);
+
+  /* The endianness field is written in the byte order of the
+     machine that created the file */
+  if (read_uint32 (contents + 12, FALSE) == KTX_ENDIANNESS)
+    swap = FALSE;
+  else if (read_uint32 (contents + 12, TRUE) == KTX_ENDIANNESS)
+    swap = TRUE;
+  else
+    return set_corrupt_error (filename, error);
+
+  gl_type = read_uint32 (contents + 16, swap);
+  gl_internal_format = read_uint32 (contents + 28, swap);
+  *width = read_uint32 (contents + 36, swap);
+  *height = read_uint32 (contents + 40, swap);
+  depth = read_uint32 (contents + 44, swap);
+  n_array_elements = read_uint32 (contents + 48, swap);
+  n_faces = read_uint32 (contents + 52, swap);
+  key_value_size = read_uint32 (contents + 60, swap);
+
+  /* Only plain compressed 2D textures are supported */
+  *format = format_from_ktx (gl_internal_format);
+  if (gl_type != 0 ||
+      *format == COGL_PIXEL_FORMAT_ANY ||
+      depth > 1 ||
+      n_array_elements > 0 ||
+      n_faces != 1)
+    return set_unknown_type_error (filename, error);
+
+  *offset = KTX_HEADER_SIZE + key_value_size;
+
+  if (*offset + 4 > length || *offset + 4 < *offset)
+    return set_corrupt_error (filename, error);
+
+  image_size = read_uint32 (contents + *offset, swap);
+  *offset += 4;
+
+  if (*width < 1 || *height < 1 ||
+      image_size != get_image_size (*format, *width, *height) ||
+      image_size > length - *offset)
+    return set_corrupt_error (filename, error);
+
+  return TRUE;
+}
+
+/* Finds the image data of the base level within a DDS file */
+static gboolean
+parse_dds (const char *filename,
+           const guint8 *contents,
+           gsize length,
+           CoglPixelFormat *format,
+           int *width,
+           int *height,
+           gsize *offset,
+           GError **error)
+{
+  if (length < DDS_HEADER_SIZE ||
+      read_uint32 (contents + 4, FALSE) != DDS_HEADER_SIZE - 4)
+    return set_corrupt_error (filename, error);
+
+  *height = read_uint32 (contents + 12, FALSE);
+  *width = read_uint32 (contents + 16, FALSE);
+
+  if (!(read_uint32 (contents + 80, FALSE) & DDS_PIXEL_FORMAT_FOURCC) ||
+      (*format = format_from_dds (read_uint32 (contents + 84, FALSE))) ==
+      COGL_PIXEL_FORMAT_ANY)
+    return set_unknown_type_error (filename, error);
+
+  *offset = DDS_HEADER_SIZE;
+
+  if (*width < 1 || *height < 1 ||
+      get_image_size (*format, *width, *height) > length - *offset)
+    return set_corrupt_error (filename, error);
+
+  return TRUE;
+}
+
+CoglBitmap *
+_cogl_bitmap_compressed_from_file (const char *filename,
+                                   GError **error)
+{
+  ContainerType type;
+  CoglPixelFormat format;
+  int width, height;
+  gsize offset;
+  gchar *contents;
+  gsize length;
+  gboolean ret;
+
+  _COGL_RETURN_VAL_IF_FAIL (error == NULL || *error == NULL, NULL);
+
+  if ((type = get_container_type (filename)) == CONTAINER_UNKNOWN)
+    return NULL;
+
+  if (!g_file_get_contents (filename, &contents, &length, error))
+    return NULL;
+
+  if (type == CONTAINER_KTX)
+    ret = parse_ktx (filename, (const guint8 *) contents, length,
+                     &format, &width, &height, &offset, error);
+  else
+    ret = parse_dds (filename, (const guint8 *) contents, length,
+                     &format, &width, &height, &offset, error);
+
+  if (!ret)
+    {
+      g_free (contents);
+      return NULL;
+    }
+
+  /* The bitmap points directly at the base level within the file
+     contents so the data doesn't need to be copied */
+  return _cogl_bitmap_new_from_data ((guint8 *) contents + offset,
+                                     format,
+                                     width, height,
+                                     _cogl_get_format_block_size (format) *
+                                     ((width + 3) / 4),
+                                     free_file_contents,
+                                     contents);
+}
@@ -127,6 +127,13 @@ _cogl_bitmap_from_file (const char *filename,
 CoglBitmap *
 _cogl_bitmap_fallback_from_file (const char *filename);
 
+/* Loads the base level of a KTX or DDS file containing compressed
+ * data. This returns NULL without setting @error if the file isn't
+ * in one of these containers */
+CoglBitmap *
+_cogl_bitmap_compressed_from_file (const char *filename,
+                                   GError **error);
+
 gboolean
 _cogl_bitmap_convert_premult_status (CoglBitmap      *bmp,
                                      CoglPixelFormat  dst_format);
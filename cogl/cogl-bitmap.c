@@ -92,12 +92,45 @@ _cogl_get_format_bpp (CoglPixelFormat format)
     2, /* 4444     */
     2, /* 5551     */
     2, /* YUV      */
-    1  /* G_8      */
+    1, /* G_8      */
+    0, /* ETC1     */
+    0, /* ETC2 RGB */
+    0, /* ETC2 RGBA */
+    0, /* DXT1     */
+    0, /* DXT3     */
+    0, /* DXT5     */
+    0  /* invalid  */
   };
 
   return bpp_lut [format & COGL_UNORDERED_MASK];
 }
 
+gboolean
+_cogl_pixel_format_is_compressed (CoglPixelFormat format)
+{
+  return _cogl_get_format_block_size (format) != 0;
+}
+
+int
+_cogl_get_format_block_size (CoglPixelFormat format)
+{
+  switch (format & COGL_UNPREMULT_MASK)
+    {
+    case COGL_PIXEL_FORMAT_ETC1_RGB_8:
+    case COGL_PIXEL_FORMAT_ETC2_RGB_8:
+    case COGL_PIXEL_FORMAT_S3TC_DXT1_RGB:
+      return 8;
+
+    case COGL_PIXEL_FORMAT_ETC2_RGBA_8:
+    case COGL_PIXEL_FORMAT_S3TC_DXT3_RGBA:
+    case COGL_PIXEL_FORMAT_S3TC_DXT5_RGBA:
+      return 16;
+
+    default:
+      return 0;
+    }
+}
+
 gboolean
 _cogl_bitmap_convert_premult_status (CoglBitmap      *bmp,
                                      CoglPixelFormat  dst_format)
@@ -310,9 +343,21 @@ cogl_bitmap_new_from_file (const char  *filename,
                            GError     **error)
 {
   CoglBitmap *bmp;
+  GError *compressed_error = NULL;
 
   _COGL_RETURN_VAL_IF_FAIL (error == NULL || *error == NULL, COGL_INVALID_HANDLE);
 
+  /* Compressed texture containers are checked first because the
+     image libraries can't load them */
+  if ((bmp = _cogl_bitmap_compressed_from_file (filename,
+                                                &compressed_error)))
+    return bmp;
+  if (compressed_error)
+    {
+      g_propagate_error (error, compressed_error);
+      return NULL;
+    }
+
   if ((bmp = _cogl_bitmap_from_file (filename, error)) == NULL)
     {
       /* Try fallback */
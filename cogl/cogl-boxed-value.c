@@ -334,3 +334,77 @@ _cogl_boxed_value_set_uniform (CoglContext *ctx,
       break;
     }
 }
+
+void
+_cogl_boxed_value_write_to_block (const CoglBoxedValue *value,
+                                  guint8 *data,
+                                  int array_size,
+                                  int array_stride,
+                                  int matrix_stride,
+                                  gboolean row_major)
+{
+  int count = MIN (value->count, array_size);
+  int i;
+
+  switch (value->type)
+    {
+    case COGL_BOXED_NONE:
+      break;
+
+    case COGL_BOXED_INT:
+    case COGL_BOXED_FLOAT:
+      {
+        const guint8 *ptr;
+
+        /* Ints and floats are both 4 bytes so they can be copied in
+           the same way */
+        if (value->count == 1)
+          ptr = (const guint8 *) value->v.float_value;
+        else
+          ptr = value->v.array;
+
+        for (i = 0; i < count; i++)
+          memcpy (data + i * array_stride,
+                  ptr + i * value->size * sizeof (float),
+                  value->size * sizeof (float));
+      }
+      break;
+
+    case COGL_BOXED_MATRIX:
+      {
+        const float *ptr;
+        int size = value->size;
+
+        if (value->count == 1)
+          ptr = value->v.matrix;
+        else
+          ptr = value->v.float_array;
+
+        for (i = 0; i < count; i++)
+          {
+            const float *src = ptr + i * size * size;
+            guint8 *dst = data + i * array_stride;
+            int column, row;
+
+            /* The boxed value is column-major unless transpose is
+               set. Each column (or row for a row-major block member)
+               is padded out to the matrix stride */
+            for (column = 0; column < size; column++)
+              for (row = 0; row < size; row++)
+                {
+                  float v = (value->transpose ?
+                             src[row * size + column] :
+                             src[column * size + row]);
+
+                  if (row_major)
+                    memcpy (dst + row * matrix_stride + column * sizeof (float),
+                            &v, sizeof (float));
+                  else
+                    memcpy (dst + column * matrix_stride + row * sizeof (float),
+                            &v, sizeof (float));
+                }
+          }
+      }
+      break;
+    }
+}
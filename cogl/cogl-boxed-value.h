@@ -108,4 +108,26 @@ _cogl_boxed_value_set_uniform (CoglContext *ctx,
                                int location,
                                const CoglBoxedValue *value);
 
+/*
+ * _cogl_boxed_value_write_to_block:
+ * @value: The value to write
+ * @data: The location of the uniform within a copy of a uniform block
+ * @array_size: The number of array elements the uniform has
+ * @array_stride: The number of bytes between each array element
+ * @matrix_stride: The number of bytes between each column of a
+ *   matrix, or each row if @row_major is %TRUE
+ * @row_major: Whether the matrix is stored row-major in the block
+ *
+ * Writes @value into client-side storage for a uniform block using
+ * the layout queried from GL. Any elements beyond @array_size are
+ * ignored, as glUniform* would do.
+ */
+void
+_cogl_boxed_value_write_to_block (const CoglBoxedValue *value,
+                                  guint8 *data,
+                                  int array_size,
+                                  int array_stride,
+                                  int matrix_stride,
+                                  gboolean row_major);
+
 #endif /* __COGL_BOXED_VALUE_H */
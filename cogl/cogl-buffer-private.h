@@ -36,6 +36,14 @@
 
 G_BEGIN_DECLS
 
+/* Attribute and index buffer objects up to this size keep a copy of
+ * their contents in client memory as long as they are only modified
+ * with cogl_buffer_set_data(). This lets the journal read back the
+ * data of small primitives so that they can be batched with
+ * rectangles (see _cogl_journal_log_primitive()) without mapping the
+ * buffer object */
+#define COGL_BUFFER_SHADOW_THRESHOLD 4096
+
 typedef struct _CoglBufferVtable CoglBufferVtable;
 
 struct _CoglBufferVtable
@@ -97,9 +105,16 @@ struct _CoglBuffer
                                       * points to allocated memory in the
                                       * fallback paths */
 
+  /* A copy of the contents of a small buffer object or NULL. See
+   * COGL_BUFFER_SHADOW_THRESHOLD */
+  guint8                 *shadow;
+
   int                     immutable_ref;
 
   guint                   store_created:1;
+  /* Set once the buffer has been mapped for writing. The shadow copy
+   * can't be kept up to date after that */
+  guint                   shadow_disabled:1;
 };
 
 /* This is used to register a type to the list of handle types that
@@ -137,6 +152,11 @@ _cogl_buffer_get_usage_hint (CoglBuffer *buffer);
 GLenum
 _cogl_buffer_access_to_gl_enum (CoglBufferAccess access);
 
+/* Returns the contents of the buffer if they can be read from client
+ * memory without involving GL, otherwise NULL */
+const guint8 *
+_cogl_buffer_get_client_data (CoglBuffer *buffer);
+
 CoglBuffer *
 _cogl_buffer_immutable_ref (CoglBuffer *buffer);
 
@@ -44,6 +44,7 @@
 #include "cogl-context-private.h"
 #include "cogl-handle.h"
 #include "cogl-pixel-buffer-private.h"
+#include "cogl-memory-private.h"
 
 /*
  * GL/GLES compatibility defines for the buffer API:
@@ -154,6 +155,15 @@ bo_map (CoglBuffer       *buffer,
       !cogl_has_feature (ctx, COGL_FEATURE_ID_MAP_BUFFER_FOR_WRITE))
     return NULL;
 
+  /* We can't see what is written through the mapping so the shadow
+     copy would become stale */
+  if (access & COGL_BUFFER_ACCESS_WRITE)
+    {
+      g_free (buffer->shadow);
+      buffer->shadow = NULL;
+      buffer->shadow_disabled = TRUE;
+    }
+
   target = buffer->last_target;
   _cogl_buffer_bind (buffer, target);
 
@@ -234,6 +244,15 @@ bo_set_data (CoglBuffer   *buffer,
 
   _cogl_buffer_unbind (buffer);
 
+  if (!buffer->shadow_disabled &&
+      buffer->usage_hint != COGL_BUFFER_USAGE_HINT_TEXTURE &&
+      buffer->size <= COGL_BUFFER_SHADOW_THRESHOLD)
+    {
+      if (buffer->shadow == NULL)
+        buffer->shadow = g_malloc0 (buffer->size);
+      memcpy (buffer->shadow + offset, data, size);
+    }
+
   return TRUE;
 }
 
@@ -283,6 +302,8 @@ _cogl_buffer_initialize (CoglBuffer           *buffer,
   buffer->usage_hint    = usage_hint;
   buffer->update_hint   = update_hint;
   buffer->data          = NULL;
+  buffer->shadow        = NULL;
+  buffer->shadow_disabled = FALSE;
   buffer->immutable_ref = 0;
 
   if (use_malloc)
@@ -301,6 +322,10 @@ _cogl_buffer_initialize (CoglBuffer           *buffer,
 
       GE( context, glGenBuffers (1, &buffer->gl_handle) );
       buffer->flags |= COGL_BUFFER_FLAG_BUFFER_OBJECT;
+
+      /* The GL store is created lazily but it will always have this
+         size so we account for it straight away */
+      _cogl_memory_add (context, COGL_MEMORY_TYPE_BUFFER, size);
     }
 }
 
@@ -311,7 +336,12 @@ _cogl_buffer_fini (CoglBuffer *buffer)
   _COGL_RETURN_IF_FAIL (buffer->immutable_ref == 0);
 
   if (buffer->flags & COGL_BUFFER_FLAG_BUFFER_OBJECT)
-    GE( buffer->context, glDeleteBuffers (1, &buffer->gl_handle) );
+    {
+      _cogl_gl_state_delete_buffer (buffer->context, buffer->gl_handle);
+      _cogl_memory_remove (buffer->context, COGL_MEMORY_TYPE_BUFFER,
+                           buffer->size);
+      g_free (buffer->shadow);
+    }
   else
     g_free (buffer->data);
 
@@ -349,7 +379,7 @@ _cogl_buffer_bind (CoglBuffer *buffer, CoglBufferBindTarget target)
   if (buffer->flags & COGL_BUFFER_FLAG_BUFFER_OBJECT)
     {
       GLenum gl_target = convert_bind_target_to_gl_target (buffer->last_target);
-      GE( ctx, glBindBuffer (gl_target, buffer->gl_handle) );
+      _cogl_gl_state_bind_buffer (ctx, gl_target, buffer->gl_handle);
       return NULL;
     }
   else
@@ -369,7 +399,7 @@ _cogl_buffer_unbind (CoglBuffer *buffer)
   if (buffer->flags & COGL_BUFFER_FLAG_BUFFER_OBJECT)
     {
       GLenum gl_target = convert_bind_target_to_gl_target (buffer->last_target);
-      GE( ctx, glBindBuffer (gl_target, 0) );
+      _cogl_gl_state_bind_buffer (ctx, gl_target, 0);
     }
 
   ctx->current_buffer[buffer->last_target] = NULL;
@@ -425,7 +455,9 @@ cogl_buffer_map (CoglBuffer        *buffer,
 {
   _COGL_RETURN_VAL_IF_FAIL (cogl_is_buffer (buffer), NULL);
 
-  if (G_UNLIKELY (buffer->immutable_ref))
+  /* Reading the data back can't modify it */
+  if (G_UNLIKELY (buffer->immutable_ref) &&
+      (access & COGL_BUFFER_ACCESS_WRITE))
     warn_about_midscene_changes ();
 
   if (buffer->flags & COGL_BUFFER_FLAG_MAPPED)
@@ -447,6 +479,20 @@ cogl_buffer_unmap (CoglBuffer *buffer)
   buffer->vtable.unmap (buffer);
 }
 
+const guint8 *
+_cogl_buffer_get_client_data (CoglBuffer *buffer)
+{
+  /* The application may be modifying the data */
+  if (buffer->flags & (COGL_BUFFER_FLAG_MAPPED |
+                       COGL_BUFFER_FLAG_MAPPED_FALLBACK))
+    return NULL;
+
+  if (buffer->flags & COGL_BUFFER_FLAG_BUFFER_OBJECT)
+    return buffer->shadow;
+  else
+    return buffer->data;
+}
+
 void *
 _cogl_buffer_map_for_fill_or_fallback (CoglBuffer *buffer)
 {
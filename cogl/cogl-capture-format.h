@@ -0,0 +1,119 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_CAPTURE_FORMAT_H
+#define __COGL_CAPTURE_FORMAT_H
+
+/* This describes the file format written when the "capture" debug
+ * option is enabled. It is kept free of any Cogl internals so that
+ * it can also be included by the replay tool in examples/.
+ *
+ * All values are written in host byte order. The file starts with
+ * the 8 byte magic followed by a 32-bit version number. After that
+ * the file is a sequence of records. Each record starts with a
+ * 32-bit record type and a 32-bit size which gives the number of
+ * bytes of payload that follow so that a reader can skip records
+ * it doesn't understand.
+ *
+ * A few blocks are shared between the record types:
+ *
+ * Framebuffer state:
+ *   uint32 width, uint32 height
+ *   float viewport[4]
+ *   float projection[16]
+ *
+ * Pipeline state:
+ *   uint8 color[4] (premultiplied)
+ *   uint32 flags (CoglCapturePipelineFlags)
+ *   uint32 n_layers
+ *   uint64 texture_hash[n_layers] (0 if the texture wasn't captured)
+ *
+ * Clip state:
+ *   uint32 has_clip
+ *   int32 scissor bounds[4] (x0, y0, x1, y1 in window coordinates)
+ *
+ * The payloads of the records are:
+ *
+ * COGL_CAPTURE_RECORD_FRAME:
+ *   empty. Written whenever an onscreen framebuffer is swapped.
+ *
+ * COGL_CAPTURE_RECORD_TEXTURE:
+ *   uint64 hash, uint32 width, uint32 height
+ *   uint8 data[width * height * 4] (COGL_PIXEL_FORMAT_RGBA_8888_PRE)
+ *   Each texture hash is only written once, before the first record
+ *   that references it.
+ *
+ * COGL_CAPTURE_RECORD_JOURNAL:
+ *   framebuffer state
+ *   uint32 n_entries
+ *   for each entry:
+ *     pipeline state, clip state, float modelview[16]
+ *     uint32 n_vertices
+ *     if n_vertices is 0 (a rectangle):
+ *       float vertices[(n_layers * 2 + 2) * 2 + 1]
+ *     otherwise (a primitive):
+ *       float vertices[(n_layers * 2 + 4) * n_vertices]
+ *   The vertices are copied verbatim from the journal. For rectangles
+ *   the first float is really the packed color followed by the
+ *   top-left and bottom-right vertices, each with a position and a
+ *   texture coordinate for every layer. Primitives are a list of
+ *   triangles and each vertex has a packed color, an x, y and z
+ *   position and a texture coordinate for every layer.
+ *
+ * COGL_CAPTURE_RECORD_DRAW:
+ *   framebuffer state, pipeline state, clip state,
+ *   float modelview[16]
+ *   uint32 mode, int32 first_vertex, int32 n_vertices
+ *   uint32 n_buffers
+ *   for each buffer: uint32 size, uint8 data[size]
+ *   uint32 n_attributes
+ *   for each attribute:
+ *     uint32 name_len, char name[name_len]
+ *     uint32 buffer_index, uint32 stride, uint32 offset,
+ *     uint32 n_components, uint32 type, uint32 normalized
+ *   uint32 has_indices
+ *   if has_indices: uint32 type, uint32 size, uint8 data[size]
+ */
+
+#define COGL_CAPTURE_MAGIC "COGLCAP"
+#define COGL_CAPTURE_MAGIC_SIZE 8
+#define COGL_CAPTURE_VERSION 2
+
+#define COGL_CAPTURE_DEFAULT_FILENAME "cogl-capture.bin"
+
+typedef enum
+{
+  COGL_CAPTURE_RECORD_FRAME = 1,
+  COGL_CAPTURE_RECORD_TEXTURE,
+  COGL_CAPTURE_RECORD_JOURNAL,
+  COGL_CAPTURE_RECORD_DRAW
+} CoglCaptureRecordType;
+
+typedef enum
+{
+  COGL_CAPTURE_PIPELINE_FLAG_BLEND = 1L<<0,
+  COGL_CAPTURE_PIPELINE_FLAG_DEPTH_TEST = 1L<<1,
+  COGL_CAPTURE_PIPELINE_FLAG_DEPTH_WRITE = 1L<<2
+} CoglCapturePipelineFlags;
+
+#endif /* __COGL_CAPTURE_FORMAT_H */
@@ -0,0 +1,53 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_CAPTURE_PRIVATE_H
+#define __COGL_CAPTURE_PRIVATE_H
+
+#include "cogl-journal-private.h"
+#include "cogl-framebuffer.h"
+#include "cogl-attribute.h"
+#include "cogl-indices.h"
+#include "cogl-debug.h"
+
+#define _COGL_CAPTURE_ENABLED() \
+  (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_CAPTURE)))
+
+void
+_cogl_capture_journal (CoglJournal *journal,
+                       CoglFramebuffer *framebuffer);
+
+void
+_cogl_capture_draw (CoglFramebuffer *framebuffer,
+                    CoglPipeline *pipeline,
+                    CoglVerticesMode mode,
+                    int first_vertex,
+                    int n_vertices,
+                    CoglIndices *indices,
+                    CoglAttribute **attributes,
+                    int n_attributes);
+
+void
+_cogl_capture_frame (CoglFramebuffer *framebuffer);
+
+#endif /* __COGL_CAPTURE_PRIVATE_H */
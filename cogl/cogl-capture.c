@@ -0,0 +1,572 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cogl.h"
+#include "cogl-debug.h"
+#include "cogl-internal.h"
+#include "cogl-context-private.h"
+#include "cogl-capture-private.h"
+#include "cogl-capture-format.h"
+#include "cogl-config-private.h"
+#include "cogl-journal-private.h"
+#include "cogl-framebuffer-private.h"
+#include "cogl-pipeline-private.h"
+#include "cogl-pipeline-layer-private.h"
+#include "cogl-texture-private.h"
+#include "cogl-attribute-private.h"
+#include "cogl-clip-stack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The capture stream is global rather than per context because it is
+ * enabled through COGL_DEBUG and is only intended for debugging a
+ * single application at a time */
+static FILE *capture_file = NULL;
+static gboolean capture_failed = FALSE;
+
+/* Maps from a CoglTexture pointer to the hash of its contents. The
+ * contents of each texture are only captured the first time it is
+ * used. The entry is removed when the texture is destroyed so that a
+ * new texture at the same address will be captured again. */
+static GHashTable *texture_hashes = NULL;
+/* The set of hashes that have already been written to the file */
+static GHashTable *written_hashes = NULL;
+
+static CoglUserDataKey texture_hash_key;
+
+static void
+close_capture_file (void)
+{
+  if (capture_file)
+    {
+      fclose (capture_file);
+      capture_file = NULL;
+    }
+}
+
+static FILE *
+get_capture_file (void)
+{
+  const char *filename;
+
+  if (capture_file || capture_failed)
+    return capture_file;
+
+  filename = g_getenv ("COGL_CAPTURE_FILE");
+  if (filename == NULL)
+    filename = _cogl_config_capture_file;
+  if (filename == NULL)
+    filename = COGL_CAPTURE_DEFAULT_FILENAME;
+
+  capture_file = fopen (filename, "wb");
+
+  if (capture_file == NULL)
+    {
+      g_warning ("Failed to open Cogl capture file \"%s\"", filename);
+      capture_failed = TRUE;
+      return NULL;
+    }
+  else
+    {
+      char magic[COGL_CAPTURE_MAGIC_SIZE] = COGL_CAPTURE_MAGIC;
+      guint32 version = COGL_CAPTURE_VERSION;
+
+      fwrite (magic, sizeof (magic), 1, capture_file);
+      fwrite (&version, sizeof (version), 1, capture_file);
+
+      texture_hashes = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                              NULL, g_free);
+      written_hashes = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                              g_free, NULL);
+
+      atexit (close_capture_file);
+
+      COGL_NOTE (CAPTURE, "Capturing to \"%s\"", filename);
+    }
+
+  return capture_file;
+}
+
+static void
+append_uint32 (GByteArray *record, guint32 value)
+{
+  g_byte_array_append (record, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+append_int32 (GByteArray *record, gint32 value)
+{
+  g_byte_array_append (record, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+append_uint64 (GByteArray *record, guint64 value)
+{
+  g_byte_array_append (record, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+append_floats (GByteArray *record, const float *values, int n_values)
+{
+  g_byte_array_append (record,
+                       (const guint8 *) values,
+                       sizeof (float) * n_values);
+}
+
+static void
+write_record (FILE *file, CoglCaptureRecordType type, GByteArray *record)
+{
+  guint32 header[2];
+
+  header[0] = type;
+  header[1] = record->len;
+
+  fwrite (header, sizeof (header), 1, file);
+  if (record->len)
+    fwrite (record->data, record->len, 1, file);
+}
+
+static guint64
+hash_data (guint64 hash, const guint8 *data, size_t len)
+{
+  size_t i;
+
+  /* 64-bit FNV-1a */
+  for (i = 0; i < len; i++)
+    {
+      hash ^= data[i];
+      hash *= G_GUINT64_CONSTANT (1099511628211);
+    }
+
+  return hash;
+}
+
+static void
+texture_destroyed_cb (void *user_data)
+{
+  if (texture_hashes)
+    g_hash_table_remove (texture_hashes, user_data);
+}
+
+/* Returns the hash of the texture's contents, writing a texture
+ * record the first time a given set of contents is seen. Returns 0 if
+ * the contents can't be captured */
+static guint64
+capture_texture (FILE *file, CoglTexture *texture)
+{
+  guint64 *hash_ptr;
+  guint64 hash;
+  int width, height;
+  guint8 *data;
+  guint32 size[2];
+  GByteArray *record;
+
+  _COGL_GET_CONTEXT (ctx, 0);
+
+  if (texture == NULL)
+    return 0;
+
+  hash_ptr = g_hash_table_lookup (texture_hashes, texture);
+  if (hash_ptr)
+    return *hash_ptr;
+
+  /* Reading back the texture must not cause any rendering because we
+   * are called in the middle of flushing a journal. Textures that are
+   * rendered to might need their journals flushed and without
+   * glGetTexImage the data is read back by drawing the texture so in
+   * those cases we just don't capture the contents. */
+  if (ctx->driver != COGL_DRIVER_GL ||
+      _cogl_texture_get_associated_framebuffers (texture))
+    return 0;
+
+  width = cogl_texture_get_width (texture);
+  height = cogl_texture_get_height (texture);
+  data = g_malloc (width * height * 4);
+
+  if (!cogl_texture_get_data (texture,
+                              COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                              width * 4,
+                              data))
+    {
+      g_free (data);
+      return 0;
+    }
+
+  size[0] = width;
+  size[1] = height;
+  hash = hash_data (G_GUINT64_CONSTANT (14695981039346656037),
+                    (const guint8 *) size, sizeof (size));
+  hash = hash_data (hash, data, width * height * 4);
+  /* 0 is reserved to mean that the texture wasn't captured */
+  if (hash == 0)
+    hash = 1;
+
+  if (!g_hash_table_lookup (written_hashes, &hash))
+    {
+      record = g_byte_array_sized_new (16 + width * height * 4);
+      append_uint64 (record, hash);
+      append_uint32 (record, width);
+      append_uint32 (record, height);
+      g_byte_array_append (record, data, width * height * 4);
+      write_record (file, COGL_CAPTURE_RECORD_TEXTURE, record);
+      g_byte_array_free (record, TRUE);
+
+      g_hash_table_insert (written_hashes,
+                           g_memdup (&hash, sizeof (hash)),
+                           GINT_TO_POINTER (TRUE));
+    }
+
+  g_free (data);
+
+  hash_ptr = g_memdup (&hash, sizeof (hash));
+  g_hash_table_insert (texture_hashes, texture, hash_ptr);
+  cogl_object_set_user_data (COGL_OBJECT (texture),
+                             &texture_hash_key,
+                             texture,
+                             texture_destroyed_cb);
+
+  return hash;
+}
+
+typedef struct
+{
+  FILE *file;
+  GArray *hashes;
+} CaptureLayersState;
+
+static gboolean
+capture_layer_cb (CoglPipelineLayer *layer, void *user_data)
+{
+  CaptureLayersState *state = user_data;
+  CoglTexture *texture = _cogl_pipeline_layer_get_texture (layer);
+  guint64 hash = capture_texture (state->file, texture);
+
+  g_array_append_val (state->hashes, hash);
+
+  return TRUE;
+}
+
+/* Capturing textures may write texture records so this needs to be
+ * done before starting to build the record that references them */
+static GArray *
+capture_pipeline_textures (FILE *file, CoglPipeline *pipeline)
+{
+  CaptureLayersState state;
+
+  state.file = file;
+  state.hashes = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+  _cogl_pipeline_foreach_layer_internal (pipeline,
+                                         capture_layer_cb,
+                                         &state);
+
+  return state.hashes;
+}
+
+static void
+append_pipeline (GByteArray *record,
+                 CoglPipeline *pipeline,
+                 GArray *texture_hashes)
+{
+  guint8 color[4];
+  CoglDepthState depth_state;
+  guint32 flags = 0;
+  int i;
+
+  _cogl_pipeline_get_colorubv (pipeline, color);
+  g_byte_array_append (record, color, sizeof (color));
+
+  if (_cogl_pipeline_get_real_blend_enabled (pipeline))
+    flags |= COGL_CAPTURE_PIPELINE_FLAG_BLEND;
+
+  cogl_pipeline_get_depth_state (pipeline, &depth_state);
+  if (cogl_depth_state_get_test_enabled (&depth_state))
+    flags |= COGL_CAPTURE_PIPELINE_FLAG_DEPTH_TEST;
+  if (cogl_depth_state_get_write_enabled (&depth_state))
+    flags |= COGL_CAPTURE_PIPELINE_FLAG_DEPTH_WRITE;
+
+  append_uint32 (record, flags);
+
+  append_uint32 (record, texture_hashes->len);
+  for (i = 0; i < texture_hashes->len; i++)
+    append_uint64 (record, g_array_index (texture_hashes, guint64, i));
+}
+
+static void
+append_clip_stack (GByteArray *record, CoglClipStack *clip_stack)
+{
+  int x0, y0, x1, y1;
+
+  if (clip_stack == NULL)
+    {
+      append_uint32 (record, FALSE);
+      x0 = y0 = x1 = y1 = 0;
+    }
+  else
+    {
+      append_uint32 (record, TRUE);
+      _cogl_clip_stack_get_bounds (clip_stack, &x0, &y0, &x1, &y1);
+    }
+
+  append_int32 (record, x0);
+  append_int32 (record, y0);
+  append_int32 (record, x1);
+  append_int32 (record, y1);
+}
+
+static void
+append_matrix (GByteArray *record, const CoglMatrix *matrix)
+{
+  append_floats (record, cogl_matrix_get_array (matrix), 16);
+}
+
+static void
+append_framebuffer (GByteArray *record, CoglFramebuffer *framebuffer)
+{
+  float viewport[4];
+  CoglMatrix projection;
+
+  append_uint32 (record, cogl_framebuffer_get_width (framebuffer));
+  append_uint32 (record, cogl_framebuffer_get_height (framebuffer));
+
+  cogl_framebuffer_get_viewport4fv (framebuffer, viewport);
+  append_floats (record, viewport, 4);
+
+  _cogl_matrix_stack_get (_cogl_framebuffer_get_projection_stack (framebuffer),
+                          &projection);
+  append_matrix (record, &projection);
+}
+
+void
+_cogl_capture_journal (CoglJournal *journal,
+                       CoglFramebuffer *framebuffer)
+{
+  FILE *file = get_capture_file ();
+  GPtrArray *entry_hashes;
+  GByteArray *record;
+  int i;
+
+  if (file == NULL)
+    return;
+
+  /* Capture the textures first so that their records come before the
+   * journal record */
+  entry_hashes = g_ptr_array_new ();
+  for (i = 0; i < journal->entries->len; i++)
+    {
+      CoglJournalEntry *entry =
+        &g_array_index (journal->entries, CoglJournalEntry, i);
+      CoglPipeline *pipeline =
+        _cogl_journal_get_entry_pipeline (journal, entry);
+      g_ptr_array_add (entry_hashes,
+                       capture_pipeline_textures (file, pipeline));
+    }
+
+  record = g_byte_array_new ();
+
+  append_framebuffer (record, framebuffer);
+  append_uint32 (record, journal->entries->len);
+
+  for (i = 0; i < journal->entries->len; i++)
+    {
+      CoglJournalEntry *entry =
+        &g_array_index (journal->entries, CoglJournalEntry, i);
+      GArray *hashes = g_ptr_array_index (entry_hashes, i);
+      int n_floats;
+
+      /* Rectangles have a single color followed by two vertices
+       * whereas primitives have a color in each of their vertices */
+      if (entry->n_vertices)
+        n_floats = (entry->n_layers * 2 + 4) * entry->n_vertices;
+      else
+        n_floats = (entry->n_layers * 2 + 2) * 2 + 1;
+
+      append_pipeline (record,
+                       _cogl_journal_get_entry_pipeline (journal, entry),
+                       hashes);
+      append_clip_stack (record, entry->clip_stack);
+      append_matrix (record, &entry->model_view);
+      append_uint32 (record, entry->n_vertices);
+      append_floats (record,
+                     &g_array_index (journal->vertices, float,
+                                     entry->array_offset),
+                     n_floats);
+
+      g_array_free (hashes, TRUE);
+    }
+
+  write_record (file, COGL_CAPTURE_RECORD_JOURNAL, record);
+
+  g_byte_array_free (record, TRUE);
+  g_ptr_array_free (entry_hashes, TRUE);
+}
+
+static void
+append_buffer (GByteArray *record, CoglBuffer *buffer)
+{
+  size_t size = cogl_buffer_get_size (buffer);
+  guint8 *data = cogl_buffer_map (buffer, COGL_BUFFER_ACCESS_READ, 0);
+
+  /* If the buffer can't be read back then it is recorded as empty and
+   * the replay tool will skip drawing it */
+  if (data == NULL)
+    {
+      append_uint32 (record, 0);
+      return;
+    }
+
+  append_uint32 (record, size);
+  g_byte_array_append (record, data, size);
+
+  cogl_buffer_unmap (buffer);
+}
+
+void
+_cogl_capture_draw (CoglFramebuffer *framebuffer,
+                    CoglPipeline *pipeline,
+                    CoglVerticesMode mode,
+                    int first_vertex,
+                    int n_vertices,
+                    CoglIndices *indices,
+                    CoglAttribute **attributes,
+                    int n_attributes)
+{
+  FILE *file = get_capture_file ();
+  GPtrArray *buffers;
+  GArray *hashes;
+  GByteArray *record;
+  CoglMatrix modelview;
+  int i;
+
+  if (file == NULL)
+    return;
+
+  hashes = capture_pipeline_textures (file, pipeline);
+
+  record = g_byte_array_new ();
+
+  append_framebuffer (record, framebuffer);
+  append_pipeline (record, pipeline, hashes);
+  append_clip_stack (record, _cogl_framebuffer_get_clip_stack (framebuffer));
+
+  _cogl_matrix_stack_get (_cogl_framebuffer_get_modelview_stack (framebuffer),
+                          &modelview);
+  append_matrix (record, &modelview);
+
+  append_uint32 (record, mode);
+  append_int32 (record, first_vertex);
+  append_int32 (record, n_vertices);
+
+  /* Attributes commonly share a buffer so each buffer is only written
+   * once */
+  buffers = g_ptr_array_new ();
+  for (i = 0; i < n_attributes; i++)
+    {
+      CoglAttributeBuffer *buffer = attributes[i]->attribute_buffer;
+      int j;
+
+      for (j = 0; j < buffers->len; j++)
+        if (g_ptr_array_index (buffers, j) == buffer)
+          break;
+      if (j == buffers->len)
+        g_ptr_array_add (buffers, buffer);
+    }
+
+  append_uint32 (record, buffers->len);
+  for (i = 0; i < buffers->len; i++)
+    append_buffer (record, g_ptr_array_index (buffers, i));
+
+  append_uint32 (record, n_attributes);
+  for (i = 0; i < n_attributes; i++)
+    {
+      CoglAttribute *attribute = attributes[i];
+      const char *name = attribute->name_state->name;
+      int j;
+
+      for (j = 0; j < buffers->len; j++)
+        if (g_ptr_array_index (buffers, j) == attribute->attribute_buffer)
+          break;
+
+      append_uint32 (record, strlen (name));
+      g_byte_array_append (record, (const guint8 *) name, strlen (name));
+      append_uint32 (record, j);
+      append_uint32 (record, attribute->stride);
+      append_uint32 (record, attribute->offset);
+      append_uint32 (record, attribute->n_components);
+      append_uint32 (record, attribute->type);
+      append_uint32 (record, attribute->normalized);
+    }
+
+  if (indices)
+    {
+      CoglIndicesType type = cogl_indices_get_type (indices);
+      CoglBuffer *buffer = COGL_BUFFER (cogl_indices_get_buffer (indices));
+      size_t offset = cogl_indices_get_offset (indices);
+      size_t size = cogl_buffer_get_size (buffer);
+      guint8 *data = cogl_buffer_map (buffer, COGL_BUFFER_ACCESS_READ, 0);
+
+      append_uint32 (record, TRUE);
+      append_uint32 (record, type);
+
+      if (data && offset <= size)
+        {
+          append_uint32 (record, size - offset);
+          g_byte_array_append (record, data + offset, size - offset);
+        }
+      else
+        append_uint32 (record, 0);
+
+      if (data)
+        cogl_buffer_unmap (buffer);
+    }
+  else
+    append_uint32 (record, FALSE);
+
+  write_record (file, COGL_CAPTURE_RECORD_DRAW, record);
+
+  g_ptr_array_free (buffers, TRUE);
+  g_byte_array_free (record, TRUE);
+  g_array_free (hashes, TRUE);
+}
+
+void
+_cogl_capture_frame (CoglFramebuffer *framebuffer)
+{
+  FILE *file = get_capture_file ();
+  GByteArray *record;
+
+  if (file == NULL)
+    return;
+
+  record = g_byte_array_new ();
+  write_record (file, COGL_CAPTURE_RECORD_FRAME, record);
+  g_byte_array_free (record, TRUE);
+
+  fflush (file);
+}
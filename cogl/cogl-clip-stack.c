@@ -45,6 +45,7 @@
 #include "cogl-pipeline-opengl-private.h"
 #include "cogl-attribute-private.h"
 #include "cogl-primitive-private.h"
+#include "cogl-slab-private.h"
 
 #ifndef GL_CLIP_PLANE0
 #define GL_CLIP_PLANE0 0x3000
@@ -223,18 +224,21 @@ add_stencil_clip_rectangle (CoglFramebuffer *framebuffer,
      flushed now */
   _cogl_context_set_current_projection (ctx, projection_stack);
   _cogl_context_set_current_modelview (ctx, modelview_stack);
+  /* The modelview is changed without going through the framebuffer
+     state tracking so make sure it gets flushed again next time */
+  ctx->current_draw_buffer_changes |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 
   if (first)
     {
-      GE( ctx, glEnable (GL_STENCIL_TEST) );
+      _cogl_gl_state_set_enabled (ctx, COGL_GL_STATE_CAP_STENCIL_TEST, TRUE);
 
       /* Initially disallow everything */
       GE( ctx, glClearStencil (0) );
       GE( ctx, glClear (GL_STENCIL_BUFFER_BIT) );
 
       /* Punch out a hole to allow the rectangle */
-      GE( ctx, glStencilFunc (GL_NEVER, 0x1, 0x1) );
-      GE( ctx, glStencilOp (GL_REPLACE, GL_REPLACE, GL_REPLACE) );
+      _cogl_gl_state_stencil_func (ctx, GL_NEVER, 0x1, 0x1);
+      _cogl_gl_state_stencil_op (ctx, GL_REPLACE, GL_REPLACE, GL_REPLACE);
 
       _cogl_rectangle_immediate (framebuffer,
                                  ctx->stencil_pipeline,
@@ -244,8 +248,8 @@ add_stencil_clip_rectangle (CoglFramebuffer *framebuffer,
     {
       /* Add one to every pixel of the stencil buffer in the
 	 rectangle */
-      GE( ctx, glStencilFunc (GL_NEVER, 0x1, 0x3) );
-      GE( ctx, glStencilOp (GL_INCR, GL_INCR, GL_INCR) );
+      _cogl_gl_state_stencil_func (ctx, GL_NEVER, 0x1, 0x3);
+      _cogl_gl_state_stencil_op (ctx, GL_INCR, GL_INCR, GL_INCR);
       _cogl_rectangle_immediate (framebuffer,
                                  ctx->stencil_pipeline,
                                  x_1, y_1, x_2, y_2);
@@ -253,7 +257,7 @@ add_stencil_clip_rectangle (CoglFramebuffer *framebuffer,
       /* Subtract one from all pixels in the stencil buffer so that
 	 only pixels where both the original stencil buffer and the
 	 rectangle are set will be valid */
-      GE( ctx, glStencilOp (GL_DECR, GL_DECR, GL_DECR) );
+      _cogl_gl_state_stencil_op (ctx, GL_DECR, GL_DECR, GL_DECR);
 
       _cogl_matrix_stack_push (projection_stack);
       _cogl_matrix_stack_load_identity (projection_stack);
@@ -263,6 +267,7 @@ add_stencil_clip_rectangle (CoglFramebuffer *framebuffer,
 
       _cogl_context_set_current_projection (ctx, projection_stack);
       _cogl_context_set_current_modelview (ctx, modelview_stack);
+      ctx->current_draw_buffer_changes |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 
       _cogl_rectangle_immediate (framebuffer,
                                  ctx->stencil_pipeline,
@@ -273,8 +278,8 @@ add_stencil_clip_rectangle (CoglFramebuffer *framebuffer,
     }
 
   /* Restore the stencil mode */
-  GE( ctx, glStencilFunc (GL_EQUAL, 0x1, 0x1) );
-  GE( ctx, glStencilOp (GL_KEEP, GL_KEEP, GL_KEEP) );
+  _cogl_gl_state_stencil_func (ctx, GL_EQUAL, 0x1, 0x1);
+  _cogl_gl_state_stencil_op (ctx, GL_KEEP, GL_KEEP, GL_KEEP);
 }
 
 typedef void (*SilhouettePaintCallback) (void *user_data);
@@ -301,18 +306,21 @@ add_stencil_clip_silhouette (CoglFramebuffer *framebuffer,
      flushed now */
   _cogl_context_set_current_projection (ctx, projection_stack);
   _cogl_context_set_current_modelview (ctx, modelview_stack);
+  /* The modelview is changed without going through the framebuffer
+     state tracking so make sure it gets flushed again next time */
+  ctx->current_draw_buffer_changes |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 
   _cogl_pipeline_flush_gl_state (ctx->stencil_pipeline, FALSE, 0);
 
-  GE( ctx, glEnable (GL_STENCIL_TEST) );
+  _cogl_gl_state_set_enabled (ctx, COGL_GL_STATE_CAP_STENCIL_TEST, TRUE);
 
   GE( ctx, glColorMask (FALSE, FALSE, FALSE, FALSE) );
-  GE( ctx, glDepthMask (FALSE) );
+  _cogl_gl_state_depth_mask (ctx, FALSE);
 
   if (merge)
     {
-      GE (ctx, glStencilMask (2));
-      GE (ctx, glStencilFunc (GL_LEQUAL, 0x2, 0x6));
+      _cogl_gl_state_stencil_mask (ctx, 2);
+      _cogl_gl_state_stencil_func (ctx, GL_LEQUAL, 0x2, 0x6);
     }
   else
     {
@@ -332,18 +340,18 @@ add_stencil_clip_silhouette (CoglFramebuffer *framebuffer,
       else
         {
           /* Just clear the bounding box */
-          GE( ctx, glStencilMask (~(GLuint) 0) );
-          GE( ctx, glStencilOp (GL_ZERO, GL_ZERO, GL_ZERO) );
+          _cogl_gl_state_stencil_mask (ctx, ~(GLuint) 0);
+          _cogl_gl_state_stencil_op (ctx, GL_ZERO, GL_ZERO, GL_ZERO);
           _cogl_rectangle_immediate (framebuffer,
                                      ctx->stencil_pipeline,
                                      bounds_x1, bounds_y1,
                                      bounds_x2, bounds_y2);
         }
-      GE (ctx, glStencilMask (1));
-      GE (ctx, glStencilFunc (GL_LEQUAL, 0x1, 0x3));
+      _cogl_gl_state_stencil_mask (ctx, 1);
+      _cogl_gl_state_stencil_func (ctx, GL_LEQUAL, 0x1, 0x3);
     }
 
-  GE (ctx, glStencilOp (GL_INVERT, GL_INVERT, GL_INVERT));
+  _cogl_gl_state_stencil_op (ctx, GL_INVERT, GL_INVERT, GL_INVERT);
 
   silhouette_callback (user_data);
 
@@ -351,9 +359,9 @@ add_stencil_clip_silhouette (CoglFramebuffer *framebuffer,
     {
       /* Now we have the new stencil buffer in bit 1 and the old
          stencil buffer in bit 0 so we need to intersect them */
-      GE (ctx, glStencilMask (3));
-      GE (ctx, glStencilFunc (GL_NEVER, 0x2, 0x3));
-      GE (ctx, glStencilOp (GL_DECR, GL_DECR, GL_DECR));
+      _cogl_gl_state_stencil_mask (ctx, 3);
+      _cogl_gl_state_stencil_func (ctx, GL_NEVER, 0x2, 0x3);
+      _cogl_gl_state_stencil_op (ctx, GL_DECR, GL_DECR, GL_DECR);
       /* Decrement all of the bits twice so that only pixels where the
          value is 3 will remain */
 
@@ -372,12 +380,12 @@ add_stencil_clip_silhouette (CoglFramebuffer *framebuffer,
       _cogl_matrix_stack_pop (projection_stack);
     }
 
-  GE (ctx, glStencilMask (~(GLuint) 0));
-  GE (ctx, glDepthMask (TRUE));
+  _cogl_gl_state_stencil_mask (ctx, ~(GLuint) 0);
+  _cogl_gl_state_depth_mask (ctx, TRUE);
   GE (ctx, glColorMask (TRUE, TRUE, TRUE, TRUE));
 
-  GE (ctx, glStencilFunc (GL_EQUAL, 0x1, 0x1));
-  GE (ctx, glStencilOp (GL_KEEP, GL_KEEP, GL_KEEP));
+  _cogl_gl_state_stencil_func (ctx, GL_EQUAL, 0x1, 0x1);
+  _cogl_gl_state_stencil_op (ctx, GL_KEEP, GL_KEEP, GL_KEEP);
 }
 
 static void
@@ -447,7 +455,7 @@ disable_stencil_buffer (void)
 {
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
-  GE( ctx, glDisable (GL_STENCIL_TEST) );
+  _cogl_gl_state_set_enabled (ctx, COGL_GL_STATE_CAP_STENCIL_TEST, FALSE);
 }
 
 static void
@@ -472,12 +480,45 @@ disable_clip_planes (void)
   GE( ctx, glDisable (GL_CLIP_PLANE0) );
 }
 
+/* Clip entries are pushed and popped every frame so they are
+   allocated from a slab for each type of entry */
+static CoglSlabAllocator clip_stack_rect_slab =
+  COGL_SLAB_ALLOCATOR_INIT ("CoglClipStackRect",
+                            sizeof (CoglClipStackRect), 64);
+static CoglSlabAllocator clip_stack_window_rect_slab =
+  COGL_SLAB_ALLOCATOR_INIT ("CoglClipStackWindowRect",
+                            sizeof (CoglClipStackWindowRect), 16);
+static CoglSlabAllocator clip_stack_path_slab =
+  COGL_SLAB_ALLOCATOR_INIT ("CoglClipStackPath",
+                            sizeof (CoglClipStackPath), 16);
+static CoglSlabAllocator clip_stack_primitive_slab =
+  COGL_SLAB_ALLOCATOR_INIT ("CoglClipStackPrimitive",
+                            sizeof (CoglClipStackPrimitive), 16);
+
+static CoglSlabAllocator *
+get_entry_slab (CoglClipStackType type)
+{
+  switch (type)
+    {
+    case COGL_CLIP_STACK_RECT:
+      return &clip_stack_rect_slab;
+    case COGL_CLIP_STACK_WINDOW_RECT:
+      return &clip_stack_window_rect_slab;
+    case COGL_CLIP_STACK_PATH:
+      return &clip_stack_path_slab;
+    case COGL_CLIP_STACK_PRIMITIVE:
+      return &clip_stack_primitive_slab;
+    }
+
+  g_assert_not_reached ();
+  return NULL;
+}
+
 static gpointer
 _cogl_clip_stack_push_entry (CoglClipStack *clip_stack,
-                             size_t size,
                              CoglClipStackType type)
 {
-  CoglClipStack *entry = g_slice_alloc (size);
+  CoglClipStack *entry = _cogl_slab_alloc (get_entry_slab (type));
 
   /* The new entry starts with a ref count of 1 because the stack
      holds a reference to it as it is the top entry */
@@ -543,9 +584,7 @@ _cogl_clip_stack_push_window_rectangle (CoglClipStack *stack,
 {
   CoglClipStack *entry;
 
-  entry = _cogl_clip_stack_push_entry (stack,
-                                       sizeof (CoglClipStackWindowRect),
-                                       COGL_CLIP_STACK_WINDOW_RECT);
+  entry = _cogl_clip_stack_push_entry (stack, COGL_CLIP_STACK_WINDOW_RECT);
 
   entry->bounds_x0 = x_offset;
   entry->bounds_x1 = x_offset + width;
@@ -568,9 +607,7 @@ _cogl_clip_stack_push_rectangle (CoglClipStack *stack,
   float v[4];
 
   /* Make a new entry */
-  entry = _cogl_clip_stack_push_entry (stack,
-                                       sizeof (CoglClipStackRect),
-                                       COGL_CLIP_STACK_RECT);
+  entry = _cogl_clip_stack_push_entry (stack, COGL_CLIP_STACK_RECT);
 
   entry->x0 = x_1;
   entry->y0 = y_1;
@@ -646,9 +683,7 @@ _cogl_clip_stack_push_from_path (CoglClipStack *stack,
     {
       CoglClipStackPath *entry;
 
-      entry = _cogl_clip_stack_push_entry (stack,
-                                           sizeof (CoglClipStackPath),
-                                           COGL_CLIP_STACK_PATH);
+      entry = _cogl_clip_stack_push_entry (stack, COGL_CLIP_STACK_PATH);
 
       entry->path = cogl_path_copy (path);
 
@@ -672,9 +707,7 @@ _cogl_clip_stack_push_primitive (CoglClipStack *stack,
 {
   CoglClipStackPrimitive *entry;
 
-  entry = _cogl_clip_stack_push_entry (stack,
-                                       sizeof (CoglClipStackPrimitive),
-                                       COGL_CLIP_STACK_PRIMITIVE);
+  entry = _cogl_clip_stack_push_entry (stack, COGL_CLIP_STACK_PRIMITIVE);
 
   entry->primitive = cogl_object_ref (primitive);
 
@@ -717,27 +750,23 @@ _cogl_clip_stack_unref (CoglClipStack *entry)
       switch (entry->type)
         {
         case COGL_CLIP_STACK_RECT:
-          g_slice_free1 (sizeof (CoglClipStackRect), entry);
-          break;
-
         case COGL_CLIP_STACK_WINDOW_RECT:
-          g_slice_free1 (sizeof (CoglClipStackWindowRect), entry);
           break;
 
         case COGL_CLIP_STACK_PATH:
           cogl_object_unref (((CoglClipStackPath *) entry)->path);
-          g_slice_free1 (sizeof (CoglClipStackPath), entry);
           break;
 
         case COGL_CLIP_STACK_PRIMITIVE:
           cogl_object_unref (((CoglClipStackPrimitive *) entry)->primitive);
-          g_slice_free1 (sizeof (CoglClipStackPrimitive), entry);
           break;
 
         default:
           g_assert_not_reached ();
         }
 
+      _cogl_slab_free (get_entry_slab (entry->type), entry);
+
       entry = parent;
     }
 }
@@ -837,7 +866,7 @@ _cogl_clip_stack_flush (CoglClipStack *stack,
       COGL_NOTE (CLIPPING, "Flushed empty clip stack");
 
       ctx->current_clip_stack_uses_stencil = FALSE;
-      GE (ctx, glDisable (GL_SCISSOR_TEST));
+      _cogl_gl_state_set_enabled (ctx, COGL_GL_STATE_CAP_SCISSOR_TEST, FALSE);
       return;
     }
 
@@ -877,10 +906,11 @@ _cogl_clip_stack_flush (CoglClipStack *stack,
              scissor_x0, scissor_y0,
              scissor_x1, scissor_y1);
 
-  GE (ctx, glEnable (GL_SCISSOR_TEST));
-  GE (ctx, glScissor (scissor_x0, scissor_y_start,
-                      scissor_x1 - scissor_x0,
-                      scissor_y1 - scissor_y0));
+  _cogl_gl_state_set_enabled (ctx, COGL_GL_STATE_CAP_SCISSOR_TEST, TRUE);
+  _cogl_gl_state_scissor (ctx,
+                          scissor_x0, scissor_y_start,
+                          scissor_x1 - scissor_x0,
+                          scissor_y1 - scissor_y0);
 
   /* Add all of the entries. This will end up adding them in the
      reverse order that they were specified but as all of the clips
@@ -33,5 +33,8 @@ _cogl_config_read (void);
 
 extern char *_cogl_config_driver;
 extern char *_cogl_config_renderer;
+extern char *_cogl_config_capture_file;
+extern char *_cogl_config_journal_threads;
+extern char *_cogl_config_async_shaders;
 
 #endif /* __COGL_CONFIG_PRIVATE_H */
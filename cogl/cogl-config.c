@@ -34,6 +34,9 @@
 
 char *_cogl_config_driver;
 char *_cogl_config_renderer;
+char *_cogl_config_capture_file;
+char *_cogl_config_journal_threads;
+char *_cogl_config_async_shaders;
 
 static void
 _cogl_config_process (GKeyFile *key_file)
@@ -75,6 +78,35 @@ _cogl_config_process (GKeyFile *key_file)
 
       _cogl_config_renderer = value;
     }
+
+  value = g_key_file_get_string (key_file, "global", "COGL_CAPTURE_FILE", NULL);
+  if (value)
+    {
+      if (_cogl_config_capture_file)
+        g_free (_cogl_config_capture_file);
+
+      _cogl_config_capture_file = value;
+    }
+
+  value = g_key_file_get_string (key_file, "global", "COGL_JOURNAL_THREADS",
+                                 NULL);
+  if (value)
+    {
+      if (_cogl_config_journal_threads)
+        g_free (_cogl_config_journal_threads);
+
+      _cogl_config_journal_threads = value;
+    }
+
+  value = g_key_file_get_string (key_file, "global", "COGL_ASYNC_SHADERS",
+                                 NULL);
+  if (value)
+    {
+      if (_cogl_config_async_shaders)
+        g_free (_cogl_config_async_shaders);
+
+      _cogl_config_async_shaders = value;
+    }
 }
 
 void
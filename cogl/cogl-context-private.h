@@ -43,6 +43,23 @@
 #include "cogl-atlas.h"
 #include "cogl-texture-driver.h"
 #include "cogl-pipeline-cache.h"
+#include "cogl-framebuffer-private.h"
+#include "cogl-gl-state-private.h"
+#include "cogl-arena-private.h"
+#include "cogl-upload-ring-private.h"
+
+/* What to do when drawing with a pipeline whose GLSL program is
+ * still being linked asynchronously */
+typedef enum
+{
+  /* Programs are linked synchronously */
+  COGL_ASYNC_SHADERS_DISABLED,
+  /* Draw with the program of the closest ancestor pipeline that has
+   * finished linking. If there isn't one then wait for the link */
+  COGL_ASYNC_SHADERS_ANCESTOR,
+  /* Skip the draw */
+  COGL_ASYNC_SHADERS_SKIP
+} CoglAsyncShadersPolicy;
 
 typedef struct
 {
@@ -107,8 +124,60 @@ struct _CoglContext
   CoglMatrixStackCache builtin_flushed_projection;
   CoglMatrixStackCache builtin_flushed_modelview;
 
+  /* The uniform buffer for the block of builtin matrices that is
+     shared by every GLSL program when uniform buffer objects are
+     available, and the last matrix stacks that were written to it.
+     This is owned by the GLSL progend */
+  GLuint            builtin_uniform_buffer;
+  CoglMatrixStackCache builtin_projection_cache;
+  CoglMatrixStackCache builtin_modelview_cache;
+
   GArray           *texture_units;
-  int               active_texture_unit;
+  /* GL sampler objects keyed by their filter and wrap modes. This is
+   * owned by cogl-pipeline-opengl.c */
+  GHashTable       *sampler_cache;
+  /* GL vertex array objects keyed by the attribute layout. This is
+   * owned by cogl-attribute.c */
+  GHashTable       *vertex_array_cache;
+
+  /* Temporary memory used by the GLES texture driver when a bitmap
+     has to be repacked before it can be uploaded */
+  CoglArena         texture_upload_arena;
+
+  /* Staging buffers for cogl_texture_set_region_async(). This is
+   * owned by cogl-upload-ring.c */
+  CoglUploadRing    upload_ring;
+
+  /* Asynchronous readbacks in the order they were started. This is
+   * owned by cogl-readback.c. The thread pool converts the pixels
+   * and is created lazily */
+  GQueue            pending_readbacks;
+  GThreadPool      *readback_thread_pool;
+  GAsyncQueue      *readback_done_queue;
+  gboolean          readback_threads_failed;
+
+  /* Tiles of CoglTiledTextures that are being loaded. This is owned
+   * by cogl-tiled-texture.c. The pending loads are only used when
+   * threads aren't available, otherwise the loads are pushed
+   * straight to the thread pool which is created lazily */
+  GQueue            pending_tile_loads;
+  GThreadPool      *tile_thread_pool;
+  GAsyncQueue      *tile_done_queue;
+  int               n_running_tile_loads;
+  gboolean          tile_threads_failed;
+
+  /* Bytes allocated in the GPU for each CoglMemoryType and the
+   * callbacks to notify when the budget is exceeded. This is owned by
+   * cogl-memory.c */
+  gsize             memory_usage[COGL_N_MEMORY_TYPES];
+  gsize             memory_total;
+  gsize             memory_budget;
+  GHookList         low_memory_callbacks;
+  /* Whether the callbacks are waiting for cogl_poll_dispatch() */
+  gboolean          low_memory_pending;
+  /* Whether the callbacks have already been queued since the usage
+   * last exceeded the budget */
+  gboolean          low_memory_notified;
 
   CoglPipelineFogState legacy_fog_state;
 
@@ -118,12 +187,26 @@ struct _CoglContext
   CoglPipeline     *texture_pipeline; /* used for set_source_texture */
   GString          *codegen_header_buffer;
   GString          *codegen_source_buffer;
+  GString          *codegen_uniform_block_buffer;
+  /* Generated GLSL for the layer combine functions, keyed by the
+   * state that affects it. This is owned by the GLSL fragend */
+  GHashTable       *codegen_layer_cache;
   GList            *source_stack;
 
   int               legacy_state_set;
 
   CoglPipelineCache *pipeline_cache;
 
+  /* Pipelines queued with COGL_PIPELINE_PRECOMPILE_FLAG_IDLE. These
+   * are compiled one at a time from cogl_poll_dispatch() */
+  GQueue            precompile_queue;
+
+  /* This is incremented whenever a pipeline that has descendants is
+   * reparented because that changes the authorities of all of the
+   * descendants. The per-pipeline authorities caches are only valid
+   * while this hasn't changed */
+  unsigned long     pipeline_graph_age;
+
   /* Textures */
   CoglHandle        default_gl_texture_2d_tex;
   CoglHandle        default_gl_texture_rect_tex;
@@ -134,7 +217,14 @@ struct _CoglContext
 
   /* Global journal buffers */
   GArray           *journal_flush_attributes_array;
-  GArray           *journal_clip_bounds;
+  /* Per-entry flags used when preparing a journal flush on multiple
+   * threads */
+  GArray           *journal_entry_flags;
+  /* The thread pool used to prepare big journals. It is created
+   * lazily and only if n_journal_threads is greater than zero */
+  int               n_journal_threads;
+  GThreadPool      *journal_thread_pool;
+  GAsyncQueue      *journal_thread_done_queue;
 
   GArray           *polygon_vertices;
 
@@ -143,14 +233,22 @@ struct _CoglContext
   unsigned long     current_pipeline_changes_since_flush;
   gboolean          current_pipeline_skip_gl_color;
   unsigned long     current_pipeline_age;
-
-  gboolean          gl_blend_enable_cache;
-
-  gboolean              depth_test_enabled_cache;
-  CoglDepthTestFunction depth_test_function_cache;
-  gboolean              depth_writing_enabled_cache;
-  float                 depth_range_near_cache;
-  float                 depth_range_far_cache;
+  /* These are set by the GLSL progend if the program for the current
+   * pipeline hasn't finished linking. The pipeline is always
+   * reflushed while the link is pending so that it can be polled. If
+   * no program could be used instead then draws are skipped */
+  gboolean          current_pipeline_link_pending;
+  gboolean          current_pipeline_skip_draws;
+
+  CoglAsyncShadersPolicy async_shaders_policy;
+  /* Incremented whenever an onscreen framebuffer is swapped. This is
+   * used to defer checking the link status of programs when
+   * GL_KHR_parallel_shader_compile isn't available */
+  unsigned int      frame_counter;
+
+  /* Shadow copy of the GL state used to skip redundant calls. See
+   * cogl-gl-state-private.h */
+  CoglGLState       gl_state;
 
   gboolean              legacy_depth_test_enabled;
 
@@ -161,7 +259,11 @@ struct _CoglContext
   /* Framebuffers */
   GSList           *framebuffer_stack;
   CoglHandle        window_buffer;
-  unsigned long     current_draw_buffer_state_flushed;
+  /* The framebuffer whose value of each group of state was last
+   * flushed to GL or NULL if the GL state is unknown */
+  CoglFramebuffer  *framebuffer_state_owners[COGL_FRAMEBUFFER_STATE_INDEX_MAX];
+  /* State that has been modified in GL behind the back of the
+   * current framebuffer so it needs to be flushed again */
   unsigned long     current_draw_buffer_changes;
   CoglFramebuffer  *current_draw_buffer;
   CoglFramebuffer  *current_read_buffer;
@@ -184,6 +286,9 @@ struct _CoglContext
 
   CoglPipeline     *texture_download_pipeline;
   CoglPipeline     *blit_texture_pipeline;
+  /* A pair of framebuffers used to update regions of the mipmaps of a
+     2D texture. These are created lazily */
+  GLuint            mipmap_fbos[2];
 
   GSList           *atlases;
   GHookList         atlas_reorganize_callbacks;
@@ -205,7 +310,6 @@ struct _CoglContext
 
   CoglPipelineProgramType current_fragment_program_type;
   CoglPipelineProgramType current_vertex_program_type;
-  GLuint                  current_gl_program;
 
   gboolean current_gl_dither_enabled;
   CoglColorMask current_gl_color_mask;
@@ -44,8 +44,13 @@
 #include "cogl-onscreen-private.h"
 #include "cogl2-path.h"
 #include "cogl-attribute-private.h"
+#include "cogl-config-private.h"
+#include "cogl-readback-private.h"
+#include "cogl-tiled-texture-private.h"
+#include "cogl-memory-private.h"
 
 #include <string.h>
+#include <stdlib.h>
 
 #ifdef HAVE_COGL_GL
 #include "cogl-pipeline-fragend-arbfp-private.h"
@@ -81,6 +86,9 @@ _cogl_init_feature_overrides (CoglContext *ctx)
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_PBOS)))
     ctx->private_feature_flags &= ~COGL_PRIVATE_FEATURE_PBOS;
 
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_UBOS)))
+    ctx->private_feature_flags &= ~COGL_PRIVATE_FEATURE_UBOS;
+
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_ARBFP)))
     {
       ctx->feature_flags &= ~COGL_FEATURE_SHADERS_ARBFP;
@@ -131,6 +139,8 @@ cogl_context_new (CoglDisplay *display,
   CoglContext *context;
   GLubyte default_texture_data[] = { 0xff, 0xff, 0xff, 0x0 };
   const CoglWinsysVtable *winsys;
+  const char *journal_threads;
+  const char *async_shaders;
   int i;
 
   _cogl_init ();
@@ -239,6 +249,8 @@ cogl_context_new (CoglDisplay *display,
   /* Initialise the driver specific state */
   _cogl_init_feature_overrides (context);
 
+  context->pipeline_graph_age = 0;
+
   _cogl_pipeline_init_default_pipeline ();
   _cogl_pipeline_init_default_layers ();
   _cogl_pipeline_init_state_hash_functions ();
@@ -258,10 +270,29 @@ cogl_context_new (CoglDisplay *display,
   context->texture_units =
     g_array_new (FALSE, FALSE, sizeof (CoglTextureUnit));
 
+  _cogl_gl_state_init (&context->gl_state);
+
   /* See cogl-pipeline.c for more details about why we leave texture unit 1
    * active by default... */
-  context->active_texture_unit = 1;
-  GE (context, glActiveTexture (GL_TEXTURE1));
+  _cogl_gl_state_active_texture (context, 1);
+
+  context->sampler_cache = NULL;
+  context->vertex_array_cache = NULL;
+  _cogl_arena_init (&context->texture_upload_arena, NULL);
+  _cogl_upload_ring_init (&context->upload_ring);
+
+  g_queue_init (&context->pending_readbacks);
+  context->readback_thread_pool = NULL;
+  context->readback_done_queue = NULL;
+  context->readback_threads_failed = FALSE;
+
+  g_queue_init (&context->pending_tile_loads);
+  context->tile_thread_pool = NULL;
+  context->tile_done_queue = NULL;
+  context->n_running_tile_loads = 0;
+  context->tile_threads_failed = FALSE;
+
+  _cogl_memory_init (context);
 
   context->legacy_fog_state.enabled = FALSE;
 
@@ -270,6 +301,8 @@ cogl_context_new (CoglDisplay *display,
   context->texture_pipeline = cogl_pipeline_new ();
   context->codegen_header_buffer = g_string_new ("");
   context->codegen_source_buffer = g_string_new ("");
+  context->codegen_uniform_block_buffer = g_string_new ("");
+  context->codegen_layer_cache = NULL;
   context->source_stack = NULL;
 
   context->legacy_state_set = 0;
@@ -280,18 +313,38 @@ cogl_context_new (CoglDisplay *display,
   context->framebuffers = NULL;
   context->current_draw_buffer = NULL;
   context->current_read_buffer = NULL;
-  context->current_draw_buffer_state_flushed = 0;
+  for (i = 0; i < COGL_FRAMEBUFFER_STATE_INDEX_MAX; i++)
+    context->framebuffer_state_owners[i] = NULL;
   context->current_draw_buffer_changes = COGL_FRAMEBUFFER_STATE_ALL;
 
   context->journal_flush_attributes_array =
     g_array_new (TRUE, FALSE, sizeof (CoglAttribute *));
-  context->journal_clip_bounds = NULL;
+  context->journal_entry_flags = NULL;
+
+  /* Preparing journal flushes on other threads is disabled by
+   * default. The environment variable overrides the config file */
+  journal_threads = g_getenv ("COGL_JOURNAL_THREADS");
+  if (journal_threads == NULL)
+    journal_threads = _cogl_config_journal_threads;
+  if (journal_threads)
+    context->n_journal_threads = CLAMP (atoi (journal_threads), 0, 64);
+  else
+    context->n_journal_threads = 0;
+  context->journal_thread_pool = NULL;
+  context->journal_thread_done_queue = NULL;
 
   context->polygon_vertices = g_array_new (FALSE, FALSE, sizeof (float));
 
   context->current_pipeline = NULL;
   context->current_pipeline_changes_since_flush = 0;
   context->current_pipeline_skip_gl_color = FALSE;
+  context->current_pipeline_link_pending = FALSE;
+  context->current_pipeline_skip_draws = FALSE;
+
+  /* Programs needed while creating the context are always linked
+   * synchronously. The policy is set further down */
+  context->async_shaders_policy = COGL_ASYNC_SHADERS_DISABLED;
+  context->frame_counter = 0;
 
   _cogl_bitmask_init (&context->enabled_builtin_attributes);
   _cogl_bitmask_init (&context->enable_builtin_attributes_tmp);
@@ -308,24 +361,16 @@ cogl_context_new (CoglDisplay *display,
 
   context->current_fragment_program_type = COGL_PIPELINE_PROGRAM_TYPE_FIXED;
   context->current_vertex_program_type = COGL_PIPELINE_PROGRAM_TYPE_FIXED;
-  context->current_gl_program = 0;
 
   context->current_gl_dither_enabled = TRUE;
   context->current_gl_color_mask = COGL_COLOR_MASK_ALL;
 
-  context->gl_blend_enable_cache = FALSE;
-
-  context->depth_test_enabled_cache = FALSE;
-  context->depth_test_function_cache = COGL_DEPTH_TEST_FUNCTION_LESS;
-  context->depth_writing_enabled_cache = TRUE;
-  context->depth_range_near_cache = 0;
-  context->depth_range_far_cache = 1;
-
   context->point_size_cache = 1.0f;
 
   context->legacy_depth_test_enabled = FALSE;
 
   context->pipeline_cache = cogl_pipeline_cache_new ();
+  g_queue_init (&context->precompile_queue);
 
   for (i = 0; i < COGL_BUFFER_BIND_TARGET_COUNT; i++)
     context->current_buffer[i] = NULL;
@@ -359,6 +404,8 @@ cogl_context_new (CoglDisplay *display,
 
   context->texture_download_pipeline = COGL_INVALID_HANDLE;
   context->blit_texture_pipeline = COGL_INVALID_HANDLE;
+  context->mipmap_fbos[0] = 0;
+  context->mipmap_fbos[1] = 0;
 
 #if defined (HAVE_COGL_GL) || defined (HAVE_COGL_GLES)
   if (context->driver != COGL_DRIVER_GLES2)
@@ -375,6 +422,9 @@ cogl_context_new (CoglDisplay *display,
   _context->current_projection_stack = NULL;
   _cogl_matrix_stack_init_cache (&_context->builtin_flushed_projection);
   _cogl_matrix_stack_init_cache (&_context->builtin_flushed_modelview);
+  _context->builtin_uniform_buffer = 0;
+  _cogl_matrix_stack_init_cache (&_context->builtin_projection_cache);
+  _cogl_matrix_stack_init_cache (&_context->builtin_modelview_cache);
 
   /* Create default textures used for fall backs */
   context->default_gl_texture_2d_tex =
@@ -399,6 +449,22 @@ cogl_context_new (CoglDisplay *display,
   cogl_push_source (context->opaque_color_pipeline);
   _cogl_pipeline_flush_gl_state (context->opaque_color_pipeline, FALSE, 0);
 
+  /* Linking GLSL programs asynchronously is disabled by default. The
+   * environment variable overrides the config file */
+  async_shaders = g_getenv ("COGL_ASYNC_SHADERS");
+  if (async_shaders == NULL)
+    async_shaders = _cogl_config_async_shaders;
+  if (async_shaders && !g_ascii_strcasecmp (async_shaders, "ancestor"))
+    context->async_shaders_policy = COGL_ASYNC_SHADERS_ANCESTOR;
+  else if (async_shaders && !g_ascii_strcasecmp (async_shaders, "skip"))
+    context->async_shaders_policy = COGL_ASYNC_SHADERS_SKIP;
+
+  /* Let the driver pick how many threads to use for compiling */
+  if (context->async_shaders_policy != COGL_ASYNC_SHADERS_DISABLED &&
+      (context->private_feature_flags &
+       COGL_PRIVATE_FEATURE_PARALLEL_SHADER_COMPILE))
+    GE (context, glMaxShaderCompilerThreads (0xffffffff));
+
   context->atlases = NULL;
   g_hook_list_init (&context->atlas_reorganize_callbacks, sizeof (GHook));
 
@@ -445,11 +511,19 @@ _cogl_context_free (CoglContext *context)
 
   if (context->blit_texture_pipeline)
     cogl_handle_unref (context->blit_texture_pipeline);
+  if (context->mipmap_fbos[0])
+    GE (context, glDeleteFramebuffers (2, context->mipmap_fbos));
 
   if (context->journal_flush_attributes_array)
     g_array_free (context->journal_flush_attributes_array, TRUE);
-  if (context->journal_clip_bounds)
-    g_array_free (context->journal_clip_bounds, TRUE);
+  if (context->journal_entry_flags)
+    g_array_free (context->journal_entry_flags, TRUE);
+
+  /* Wait for any running jobs to finish */
+  if (context->journal_thread_pool)
+    g_thread_pool_free (context->journal_thread_pool, FALSE, TRUE);
+  if (context->journal_thread_done_queue)
+    g_async_queue_unref (context->journal_thread_done_queue);
 
   if (context->polygon_vertices)
     g_array_free (context->polygon_vertices, TRUE);
@@ -497,11 +571,29 @@ _cogl_context_free (CoglContext *context)
     cogl_object_unref (_context->current_projection_stack);
   _cogl_matrix_stack_destroy_cache (&context->builtin_flushed_projection);
   _cogl_matrix_stack_destroy_cache (&context->builtin_flushed_modelview);
-
+  _cogl_matrix_stack_destroy_cache (&context->builtin_projection_cache);
+  _cogl_matrix_stack_destroy_cache (&context->builtin_modelview_cache);
+  if (context->builtin_uniform_buffer)
+    _cogl_gl_state_delete_buffer (context, context->builtin_uniform_buffer);
+
+  _cogl_pipeline_clear_pending_precompiles (context);
+  _cogl_readback_clear_pending (context);
+  _cogl_tiled_texture_clear_pending (context);
+  _cogl_memory_destroy (context);
   cogl_pipeline_cache_free (context->pipeline_cache);
 
+  if (context->codegen_layer_cache)
+    g_hash_table_destroy (context->codegen_layer_cache);
+  g_string_free (context->codegen_header_buffer, TRUE);
+  g_string_free (context->codegen_source_buffer, TRUE);
+  g_string_free (context->codegen_uniform_block_buffer, TRUE);
+
 
   _cogl_destroy_texture_units ();
+  _cogl_destroy_samplers ();
+  _cogl_attribute_free_vertex_array_cache (context);
+  _cogl_arena_destroy (&context->texture_upload_arena);
+  _cogl_upload_ring_destroy (context, &context->upload_ring);
 
   g_ptr_array_free (context->uniform_names, TRUE);
   g_hash_table_destroy (context->uniform_name_hash);
@@ -62,8 +62,6 @@ G_BEGIN_DECLS
  * what state other components have left you with.
  */
 
-typedef struct _CoglContext	      CoglContext;
-
 #define COGL_CONTEXT(OBJECT) ((CoglContext *)OBJECT)
 
 /**
@@ -150,6 +148,171 @@ cogl_android_set_native_window (ANativeWindow *window);
 gboolean
 cogl_is_context (void *object);
 
+/**
+ * CoglMemoryType:
+ * @COGL_MEMORY_TYPE_TEXTURE_2D: Storage for #CoglTexture2D<!-- -->s,
+ *   including the textures backing the texture atlases.
+ * @COGL_MEMORY_TYPE_TEXTURE_2D_SLICED: Storage for the slices of
+ *   #CoglTexture2DSliced<!-- -->s that is covered by the texture.
+ * @COGL_MEMORY_TYPE_TEXTURE_2D_SLICED_WASTE: The padding of the
+ *   slices of #CoglTexture2DSliced<!-- -->s that is never sampled.
+ * @COGL_MEMORY_TYPE_TEXTURE_3D: Storage for #CoglTexture3D<!-- -->s.
+ * @COGL_MEMORY_TYPE_TEXTURE_RECTANGLE: Storage for
+ *   #CoglTextureRectangle<!-- -->s.
+ * @COGL_MEMORY_TYPE_RENDERBUFFER: The depth and stencil buffers
+ *   allocated for #CoglOffscreen framebuffers.
+ * @COGL_MEMORY_TYPE_BUFFER: Storage for #CoglBuffer<!-- -->s such as
+ *   attribute, index and pixel buffers.
+ * @COGL_N_MEMORY_TYPES: The number of memory types.
+ *
+ * The categories that Cogl uses to account for the memory that it
+ * allocates in the GPU. See cogl_context_get_memory_usage().
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+typedef enum
+{
+  COGL_MEMORY_TYPE_TEXTURE_2D,
+  COGL_MEMORY_TYPE_TEXTURE_2D_SLICED,
+  COGL_MEMORY_TYPE_TEXTURE_2D_SLICED_WASTE,
+  COGL_MEMORY_TYPE_TEXTURE_3D,
+  COGL_MEMORY_TYPE_TEXTURE_RECTANGLE,
+  COGL_MEMORY_TYPE_RENDERBUFFER,
+  COGL_MEMORY_TYPE_BUFFER,
+
+  COGL_N_MEMORY_TYPES
+} CoglMemoryType;
+
+/**
+ * cogl_context_get_memory_usage:
+ * @context: A #CoglContext pointer
+ * @type: The #CoglMemoryType to query
+ *
+ * Queries the number of bytes that Cogl has allocated in the GPU for
+ * objects of the given @type. The size of a texture is calculated
+ * from its internal format and size including any mipmap levels that
+ * have been generated. The driver may pad the storage further so
+ * this should be treated as an estimate. Textures created from
+ * foreign GL textures, EGLImages or X pixmaps aren't included
+ * because their storage isn't owned by Cogl.
+ *
+ * Return value: The number of bytes allocated for @type
+ * Since: 1.10
+ * Stability: unstable
+ */
+gsize
+cogl_context_get_memory_usage (CoglContext *context,
+                               CoglMemoryType type);
+
+/**
+ * cogl_context_get_total_memory_usage:
+ * @context: A #CoglContext pointer
+ *
+ * Queries the sum of the memory usage for all of the
+ * #CoglMemoryType<!-- -->s. This is the value that is compared with
+ * the budget set with cogl_context_set_memory_budget().
+ *
+ * Return value: The total number of bytes allocated in the GPU
+ * Since: 1.10
+ * Stability: unstable
+ */
+gsize
+cogl_context_get_total_memory_usage (CoglContext *context);
+
+/**
+ * cogl_context_set_memory_budget:
+ * @context: A #CoglContext pointer
+ * @budget: The number of bytes, or 0 to remove the budget
+ *
+ * Sets the number of bytes that the application would like Cogl to
+ * keep its GPU allocations within. Cogl never refuses an allocation
+ * because of the budget. Instead, whenever the total memory usage
+ * grows beyond it, the callbacks added with
+ * cogl_context_add_low_memory_callback() are invoked so that the
+ * application can release resources such as glyph caches before the
+ * driver runs out of memory.
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+void
+cogl_context_set_memory_budget (CoglContext *context,
+                                gsize budget);
+
+/**
+ * cogl_context_get_memory_budget:
+ * @context: A #CoglContext pointer
+ *
+ * Queries the budget set with cogl_context_set_memory_budget().
+ *
+ * Return value: The budget in bytes or 0 if there isn't one
+ * Since: 1.10
+ * Stability: unstable
+ */
+gsize
+cogl_context_get_memory_budget (CoglContext *context);
+
+/**
+ * CoglLowMemoryCallback:
+ * @context: The #CoglContext that has exceeded its budget
+ * @usage: The total memory usage when the callback is invoked
+ * @budget: The budget that was exceeded
+ * @user_data: The private data passed to
+ *   cogl_context_add_low_memory_callback()
+ *
+ * The type of the callbacks that are notified when the memory usage
+ * of a #CoglContext exceeds its budget.
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+typedef void (*CoglLowMemoryCallback) (CoglContext *context,
+                                       gsize usage,
+                                       gsize budget,
+                                       void *user_data);
+
+/**
+ * cogl_context_add_low_memory_callback:
+ * @context: A #CoglContext pointer
+ * @callback: A #CoglLowMemoryCallback to invoke
+ * @user_data: A private pointer to pass to @callback
+ *
+ * Adds a callback that will be invoked when the total memory usage
+ * of @context grows beyond the budget set with
+ * cogl_context_set_memory_budget(). The callbacks are never invoked
+ * from inside the function that made the allocation. Instead they
+ * are invoked from cogl_poll_dispatch() so it is safe to destroy
+ * Cogl objects from the callback. The callbacks are invoked once each
+ * time the usage crosses the budget. They won't be invoked again
+ * until the usage has dropped back within the budget.
+ *
+ * Return value: An identifier that can be passed to
+ *   cogl_context_remove_low_memory_callback()
+ * Since: 1.10
+ * Stability: unstable
+ */
+unsigned int
+cogl_context_add_low_memory_callback (CoglContext *context,
+                                      CoglLowMemoryCallback callback,
+                                      void *user_data);
+
+/**
+ * cogl_context_remove_low_memory_callback:
+ * @context: A #CoglContext pointer
+ * @id: An identifier returned by
+ *   cogl_context_add_low_memory_callback()
+ *
+ * Removes a callback that was added with
+ * cogl_context_add_low_memory_callback().
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+void
+cogl_context_remove_low_memory_callback (CoglContext *context,
+                                         unsigned int id);
+
 G_END_DECLS
 
 #endif /* __COGL_CONTEXT_H__ */
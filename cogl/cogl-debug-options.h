@@ -97,6 +97,16 @@ OPT (DISABLE_PBOS,
      "disable-pbos",
      N_("Disable GL Pixel Buffers"),
      N_("Disable use of OpenGL pixel buffer objects"))
+OPT (DISABLE_UBOS,
+     N_("Root Cause"),
+     "disable-ubos",
+     N_("Disable GL Uniform Buffers"),
+     N_("Disable use of OpenGL uniform buffer objects"))
+OPT (DISABLE_VAOS,
+     N_("Root Cause"),
+     "disable-vaos",
+     N_("Disable GL Vertex Array Objects"),
+     N_("Disable caching attribute state in vertex array objects"))
 OPT (DISABLE_SOFTWARE_TRANSFORM,
      N_("Root Cause"),
      "disable-software-transform",
@@ -185,3 +195,15 @@ OPT (CLIPPING,
      "clipping",
      N_("Trace clipping"),
      N_("Logs information about how Cogl is implementing clipping"))
+OPT (GL_STATE,
+     N_("Cogl Tracing"),
+     "gl-state",
+     N_("Trace GL state changes"),
+     N_("Logs how many GL state changes were made and how many were "
+        "skipped as redundant for every frame"))
+OPT (CAPTURE,
+     N_("Cogl Tracing"),
+     "capture",
+     N_("Capture rendering to a file"),
+     N_("Serializes all journal flushes and primitive draws to the file "
+        "named by COGL_CAPTURE_FILE so they can be replayed offline"))
@@ -56,7 +56,8 @@ static const GDebugKey cogl_log_debug_keys[] = {
   { "texture-pixmap", COGL_DEBUG_TEXTURE_PIXMAP },
   { "bitmap", COGL_DEBUG_BITMAP },
   { "clipping", COGL_DEBUG_CLIPPING },
-  { "winsys", COGL_DEBUG_WINSYS }
+  { "winsys", COGL_DEBUG_WINSYS },
+  { "gl-state", COGL_DEBUG_GL_STATE }
 };
 static const int n_cogl_log_debug_keys =
   G_N_ELEMENTS (cogl_log_debug_keys);
@@ -66,6 +67,8 @@ static const GDebugKey cogl_behavioural_debug_keys[] = {
   { "disable-batching", COGL_DEBUG_DISABLE_BATCHING },
   { "disable-vbos", COGL_DEBUG_DISABLE_VBOS },
   { "disable-pbos", COGL_DEBUG_DISABLE_PBOS },
+  { "disable-ubos", COGL_DEBUG_DISABLE_UBOS },
+  { "disable-vaos", COGL_DEBUG_DISABLE_VAOS },
   { "disable-software-transform", COGL_DEBUG_DISABLE_SOFTWARE_TRANSFORM },
   { "dump-atlas-image", COGL_DEBUG_DUMP_ATLAS_IMAGE },
   { "disable-atlas", COGL_DEBUG_DISABLE_ATLAS },
@@ -79,7 +82,8 @@ static const GDebugKey cogl_behavioural_debug_keys[] = {
   { "wireframe", COGL_DEBUG_WIREFRAME},
   { "disable-software-clip", COGL_DEBUG_DISABLE_SOFTWARE_CLIP},
   { "disable-program-caches", COGL_DEBUG_DISABLE_PROGRAM_CACHES},
-  { "disable-fast-read-pixel", COGL_DEBUG_DISABLE_FAST_READ_PIXEL}
+  { "disable-fast-read-pixel", COGL_DEBUG_DISABLE_FAST_READ_PIXEL},
+  { "capture", COGL_DEBUG_CAPTURE}
 };
 static const int n_cogl_behavioural_debug_keys =
   G_N_ELEMENTS (cogl_behavioural_debug_keys);
@@ -67,6 +67,10 @@ typedef enum {
   COGL_DEBUG_DISABLE_FAST_READ_PIXEL,
   COGL_DEBUG_CLIPPING,
   COGL_DEBUG_WINSYS,
+  COGL_DEBUG_CAPTURE,
+  COGL_DEBUG_DISABLE_UBOS,
+  COGL_DEBUG_GL_STATE,
+  COGL_DEBUG_DISABLE_VAOS,
 
   COGL_DEBUG_N_FLAGS
 } CoglDebugFlags;
@@ -80,8 +84,29 @@ typedef enum {
    get this to work when building with MSVC */
 COGL_EXPORT extern unsigned long _cogl_debug_flags[COGL_DEBUG_N_LONGS];
 
+/* Maps the name of a type to its CoglDebugTypeStats. These are
+   reported by cogl_debug_object_foreach_type() */
 extern GHashTable *_cogl_debug_instances;
 
+typedef struct
+{
+  unsigned long instance_count;
+  /* The number of allocations made during the current frame */
+  unsigned long n_allocations;
+  /* The number of allocations made during the last complete frame */
+  unsigned long n_frame_allocations;
+} CoglDebugTypeStats;
+
+void
+_cogl_debug_register_type_stats (const char *name,
+                                 CoglDebugTypeStats *stats);
+
+/* Moves the allocation counts of the current frame to the last frame
+   for all of the types. This is called whenever an onscreen
+   framebuffer is swapped */
+void
+_cogl_debug_end_frame (void);
+
 #define COGL_DEBUG_ENABLED(flag) \
   COGL_FLAGS_GET (_cogl_debug_flags, flag)
 
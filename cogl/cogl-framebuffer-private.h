@@ -117,6 +117,10 @@ struct _CoglFramebuffer
 
   CoglClipState       clip_state;
 
+  /* The groups of state (CoglFramebufferState) that have changed
+   * since this framebuffer last flushed them to GL */
+  unsigned long       dirty_state;
+
   gboolean            dirty_bitmasks;
   int                 red_bits;
   int                 blue_bits;
@@ -159,6 +163,8 @@ typedef struct _CoglOffscreen
   CoglFramebuffer  _parent;
   GLuint          fbo_handle;
   GSList          *renderbuffers;
+  /* The number of bytes accounted for the renderbuffers */
+  gsize           renderbuffer_memory;
 
   CoglTexture    *texture;
   int             texture_level;
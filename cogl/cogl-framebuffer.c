@@ -42,6 +42,10 @@
 #include "cogl-pipeline-state-private.h"
 #include "cogl-matrix-private.h"
 #include "cogl-primitive-private.h"
+#include "cogl-capture-private.h"
+#include "cogl-readback-private.h"
+#include "cogl-memory-private.h"
+#include "cogl-private.h"
 
 #ifndef GL_FRAMEBUFFER
 #define GL_FRAMEBUFFER		0x8D40
@@ -174,6 +178,7 @@ _cogl_framebuffer_init (CoglFramebuffer *framebuffer,
 
   /* Initialise the clip stack */
   _cogl_clip_state_init (&framebuffer->clip_state);
+  framebuffer->dirty_state = COGL_FRAMEBUFFER_STATE_ALL;
 
   framebuffer->journal = _cogl_journal_new ();
 
@@ -217,6 +222,7 @@ void
 _cogl_framebuffer_free (CoglFramebuffer *framebuffer)
 {
   CoglContext *ctx = framebuffer->context;
+  int i;
 
   _cogl_clip_state_destroy (&framebuffer->clip_state);
 
@@ -233,6 +239,9 @@ _cogl_framebuffer_free (CoglFramebuffer *framebuffer)
 
   if (ctx->current_draw_buffer == framebuffer)
     ctx->current_draw_buffer = NULL;
+  for (i = 0; i < COGL_FRAMEBUFFER_STATE_INDEX_MAX; i++)
+    if (ctx->framebuffer_state_owners[i] == framebuffer)
+      ctx->framebuffer_state_owners[i] = NULL;
   if (ctx->current_read_buffer == framebuffer)
     ctx->current_read_buffer = NULL;
 }
@@ -535,9 +544,7 @@ cogl_framebuffer_set_viewport (CoglFramebuffer *framebuffer,
   framebuffer->viewport_width = width;
   framebuffer->viewport_height = height;
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_VIEWPORT;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_VIEWPORT;
 }
 
 float
@@ -794,6 +801,9 @@ _cogl_offscreen_free (CoglOffscreen *offscreen)
     }
   g_slist_free (offscreen->renderbuffers);
 
+  _cogl_memory_remove (ctx, COGL_MEMORY_TYPE_RENDERBUFFER,
+                       offscreen->renderbuffer_memory);
+
   GE (ctx, glDeleteFramebuffers (1, &offscreen->fbo_handle));
 
   if (offscreen->texture != COGL_INVALID_HANDLE)
@@ -818,6 +828,8 @@ try_creating_fbo (CoglOffscreen *offscreen,
   int n_samples;
   int height;
   int width;
+  /* Bytes per pixel used by all of the renderbuffers */
+  int renderbuffer_bpp = 0;
 
   if (!cogl_texture_get_gl_texture (offscreen->texture,
                                     &tex_gl_handle, &tex_gl_target))
@@ -890,6 +902,7 @@ try_creating_fbo (CoglOffscreen *offscreen,
       offscreen->renderbuffers =
         g_slist_prepend (offscreen->renderbuffers,
                          GUINT_TO_POINTER (gl_depth_stencil_handle));
+      renderbuffer_bpp += 4;
     }
 
   if (flags & _TRY_DEPTH)
@@ -913,6 +926,7 @@ try_creating_fbo (CoglOffscreen *offscreen,
       offscreen->renderbuffers =
         g_slist_prepend (offscreen->renderbuffers,
                          GUINT_TO_POINTER (gl_depth_handle));
+      renderbuffer_bpp += 2;
     }
 
   if (flags & _TRY_STENCIL)
@@ -934,6 +948,7 @@ try_creating_fbo (CoglOffscreen *offscreen,
       offscreen->renderbuffers =
         g_slist_prepend (offscreen->renderbuffers,
                          GUINT_TO_POINTER (gl_stencil_handle));
+      renderbuffer_bpp += 1;
     }
 
   /* Make sure it's complete */
@@ -957,6 +972,11 @@ try_creating_fbo (CoglOffscreen *offscreen,
       return FALSE;
     }
 
+  offscreen->renderbuffer_memory =
+    (gsize) renderbuffer_bpp * width * height * MAX (n_samples, 1);
+  _cogl_memory_add (ctx, COGL_MEMORY_TYPE_RENDERBUFFER,
+                    offscreen->renderbuffer_memory);
+
   /* Update the real number of samples_per_pixel now that we have a
    * complete framebuffer */
   if (n_samples)
@@ -1483,11 +1503,11 @@ _cogl_framebuffer_flush_viewport_state (CoglFramebuffer *framebuffer)
              framebuffer->viewport_width,
              framebuffer->viewport_height);
 
-  GE (framebuffer->context,
-      glViewport (framebuffer->viewport_x,
-                  gl_viewport_y,
-                  framebuffer->viewport_width,
-                  framebuffer->viewport_height));
+  _cogl_gl_state_viewport (framebuffer->context,
+                           framebuffer->viewport_x,
+                           gl_viewport_y,
+                           framebuffer->viewport_width,
+                           framebuffer->viewport_height);
 }
 
 static void
@@ -1579,43 +1599,53 @@ _cogl_framebuffer_flush_state (CoglFramebuffer *draw_buffer,
 {
   CoglContext *ctx = draw_buffer->context;
   unsigned long differences;
+  unsigned long unchanged;
+  unsigned long requested;
   int bit;
 
-  /* We can assume that any state that has changed for the current
-   * framebuffer is different to the currently flushed value. */
-  differences = ctx->current_draw_buffer_changes;
-
-  /* Any state of the current framebuffer that hasn't already been
-   * flushed is assumed to be unknown so we will always flush that
-   * state if asked. */
-  differences |= ~ctx->current_draw_buffer_state_flushed;
-
-  /* We only need to consider the state we've been asked to flush */
-  differences &= state;
+  /* Any state that has changed for this framebuffer since it was last
+   * flushed or that has been modified behind its back needs to be
+   * flushed. */
+  differences = ((draw_buffer->dirty_state | ctx->current_draw_buffer_changes) &
+                 state);
 
   if (ctx->current_draw_buffer != draw_buffer)
     {
-      /* If the previous draw buffer is NULL then we'll assume
-         everything has changed. This can happen if a framebuffer is
-         destroyed while it is the last flushed draw buffer. In that
-         case the framebuffer destructor will set
-         ctx->current_draw_buffer to NULL */
-      if (ctx->current_draw_buffer == NULL)
-        differences |= state;
-      else
-        /* NB: we only need to compare the state we're being asked to flush
-         * and we don't need to compare the state we've already decided
-         * we will definitely flush... */
-        differences |= _cogl_framebuffer_compare (ctx->current_draw_buffer,
-                                                  draw_buffer,
-                                                  state & ~differences);
+      /* Binding isn't tracked per state group, we just need to
+       * rebind whenever the framebuffer changes */
+      differences |= state & COGL_FRAMEBUFFER_STATE_BIND;
 
       /* NB: we don't take a reference here, to avoid a circular
        * reference. */
       ctx->current_draw_buffer = draw_buffer;
-      ctx->current_draw_buffer_state_flushed = 0;
     }
 
+  /* For the rest of the state we only need to look at the groups
+   * that were last flushed by a different framebuffer. If the other
+   * framebuffer has the same value then we can avoid flushing it
+   * again. NB: we don't need to compare the state we've already
+   * decided we will definitely flush... */
+  unchanged = state & ~differences & ~COGL_FRAMEBUFFER_STATE_BIND;
+
+  COGL_FLAGS_FOREACH_START (&unchanged, 1, bit)
+    {
+      CoglFramebuffer *owner = ctx->framebuffer_state_owners[bit];
+
+      if (owner == draw_buffer)
+        continue;
+
+      /* If the owner is NULL then the state is unknown. This can
+         happen if a framebuffer is destroyed while it owns some of
+         the flushed state. In that case the framebuffer destructor
+         will clear its entries in ctx->framebuffer_state_owners */
+      if (owner == NULL)
+        differences |= 1 << bit;
+      else
+        differences |= _cogl_framebuffer_compare (owner, draw_buffer,
+                                                  1 << bit);
+    }
+  COGL_FLAGS_FOREACH_END;
+
   if (ctx->current_read_buffer != read_buffer &&
       state & COGL_FRAMEBUFFER_STATE_BIND)
     {
@@ -1625,6 +1655,18 @@ _cogl_framebuffer_flush_state (CoglFramebuffer *draw_buffer,
       ctx->current_read_buffer = read_buffer;
     }
 
+  /* All of the requested state will match this framebuffer after
+   * this function whether it needed to be flushed or not */
+  requested = state & ~COGL_FRAMEBUFFER_STATE_BIND;
+  COGL_FLAGS_FOREACH_START (&requested, 1, bit)
+    {
+      ctx->framebuffer_state_owners[bit] = draw_buffer;
+    }
+  COGL_FLAGS_FOREACH_END;
+
+  draw_buffer->dirty_state &= ~state;
+  ctx->current_draw_buffer_changes &= ~state;
+
   if (!differences)
     return;
 
@@ -1692,9 +1734,6 @@ _cogl_framebuffer_flush_state (CoglFramebuffer *draw_buffer,
         }
     }
   COGL_FLAGS_FOREACH_END;
-
-  ctx->current_draw_buffer_state_flushed |= state;
-  ctx->current_draw_buffer_changes &= ~state;
 }
 
 int
@@ -1744,9 +1783,7 @@ cogl_framebuffer_set_color_mask (CoglFramebuffer *framebuffer,
 
   framebuffer->color_mask = color_mask;
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_COLOR_MASK;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_COLOR_MASK;
 }
 
 gboolean
@@ -1765,9 +1802,7 @@ cogl_framebuffer_set_dither_enabled (CoglFramebuffer *framebuffer,
   cogl_flush (); /* Currently dithering changes aren't tracked in the journal */
   framebuffer->dither_enabled = dither_enabled;
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_DITHER;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_DITHER;
 }
 
 CoglPixelFormat
@@ -2019,6 +2054,121 @@ cogl_framebuffer_finish (CoglFramebuffer *framebuffer)
   GE (framebuffer->context, glFinish ());
 }
 
+void
+cogl_framebuffer_read_pixels_async (CoglFramebuffer *framebuffer,
+                                    int x,
+                                    int y,
+                                    int width,
+                                    int height,
+                                    CoglPixelFormat format,
+                                    int rowstride,
+                                    guint8 *pixels,
+                                    CoglReadbackCallback callback,
+                                    void *user_data)
+{
+  CoglContext *ctx = framebuffer->context;
+  CoglReadback *readback;
+  CoglPixelFormat read_format;
+  GLenum gl_format;
+  GLenum gl_type;
+  guint8 *ptr;
+
+  _COGL_RETURN_IF_FAIL (format != COGL_PIXEL_FORMAT_ANY);
+  _COGL_RETURN_IF_FAIL (pixels != NULL);
+  _COGL_RETURN_IF_FAIL (callback != NULL);
+
+  if (rowstride == 0)
+    rowstride = _cogl_get_format_bpp (format) * width;
+
+  if (!_cogl_readback_is_supported (ctx))
+    {
+      cogl_push_framebuffer (framebuffer);
+      _cogl_read_pixels_with_rowstride (x, y, width, height,
+                                        COGL_READ_PIXELS_COLOR_BUFFER,
+                                        format,
+                                        pixels,
+                                        rowstride);
+      cogl_pop_framebuffer ();
+
+      _cogl_readback_queue_completed (ctx, TRUE, callback, user_data);
+      return;
+    }
+
+  /* We match the premultiplied state of the read to the framebuffer
+   * so that it will get converted to the right format when the
+   * readback completes */
+  read_format = format;
+  if ((format & COGL_A_BIT))
+    {
+      if ((framebuffer->format & COGL_PREMULT_BIT))
+        read_format |= COGL_PREMULT_BIT;
+      else
+        read_format &= ~COGL_PREMULT_BIT;
+    }
+
+  /* XXX: As with cogl_read_pixels(), all of the journals are flushed
+   * because we don't track the dependencies between framebuffers */
+  cogl_flush ();
+
+  _cogl_framebuffer_flush_state (cogl_get_draw_framebuffer (),
+                                 framebuffer,
+                                 COGL_FRAMEBUFFER_STATE_BIND);
+
+  /* The y co-ordinate should be given in OpenGL's coordinate system
+   * so 0 is the bottom row. Offscreen rendering is done upside down
+   * so onscreen framebuffers are the only ones that need flipping */
+  if (!cogl_is_offscreen (framebuffer))
+    y = framebuffer->height - y - height;
+
+  readback = _cogl_readback_new (ctx,
+                                 width, height,
+                                 read_format,
+                                 format,
+                                 rowstride,
+                                 pixels,
+                                 !cogl_is_offscreen (framebuffer),
+                                 callback,
+                                 user_data);
+
+  ctx->texture_driver->pixel_format_to_gl (format,
+                                           NULL, /* internal format */
+                                           &gl_format,
+                                           &gl_type);
+
+  ptr = _cogl_readback_bind (readback);
+
+  ctx->texture_driver->prep_gl_for_pixels_download (readback->buffer_rowstride,
+                                                    readback->bpp);
+
+  /* With a pixel pack buffer bound this only queues the read so it
+     doesn't wait for the rendering to finish */
+  GE( ctx, glReadPixels (x, y, width, height, gl_format, gl_type, ptr) );
+
+  _cogl_readback_unbind (readback);
+
+  _cogl_readback_queue (ctx, readback);
+}
+
+void
+cogl_framebuffer_get_journal_stats (CoglFramebuffer *framebuffer,
+                                    CoglJournalStats *stats)
+{
+  *stats = framebuffer->journal->stats;
+}
+
+void
+cogl_framebuffer_get_last_journal_flush_stats (CoglFramebuffer *framebuffer,
+                                               CoglJournalStats *stats)
+{
+  *stats = framebuffer->journal->last_flush_stats;
+}
+
+void
+cogl_framebuffer_reset_journal_stats (CoglFramebuffer *framebuffer)
+{
+  _cogl_journal_reset_stats (framebuffer->journal);
+}
+
 void
 cogl_framebuffer_push_matrix (CoglFramebuffer *framebuffer)
 {
@@ -2026,9 +2176,7 @@ cogl_framebuffer_push_matrix (CoglFramebuffer *framebuffer)
     _cogl_framebuffer_get_modelview_stack (framebuffer);
   _cogl_matrix_stack_push (modelview_stack);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_MODELVIEW;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 }
 
 void
@@ -2038,9 +2186,7 @@ cogl_framebuffer_pop_matrix (CoglFramebuffer *framebuffer)
     _cogl_framebuffer_get_modelview_stack (framebuffer);
   _cogl_matrix_stack_pop (modelview_stack);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_MODELVIEW;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 }
 
 void
@@ -2050,9 +2196,7 @@ cogl_framebuffer_identity_matrix (CoglFramebuffer *framebuffer)
     _cogl_framebuffer_get_modelview_stack (framebuffer);
   _cogl_matrix_stack_load_identity (modelview_stack);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_MODELVIEW;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 }
 
 void
@@ -2065,9 +2209,7 @@ cogl_framebuffer_scale (CoglFramebuffer *framebuffer,
     _cogl_framebuffer_get_modelview_stack (framebuffer);
   _cogl_matrix_stack_scale (modelview_stack, x, y, z);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_MODELVIEW;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 }
 
 void
@@ -2080,9 +2222,7 @@ cogl_framebuffer_translate (CoglFramebuffer *framebuffer,
     _cogl_framebuffer_get_modelview_stack (framebuffer);
   _cogl_matrix_stack_translate (modelview_stack, x, y, z);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_MODELVIEW;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 }
 
 void
@@ -2096,9 +2236,7 @@ cogl_framebuffer_rotate (CoglFramebuffer *framebuffer,
     _cogl_framebuffer_get_modelview_stack (framebuffer);
   _cogl_matrix_stack_rotate (modelview_stack, angle, x, y, z);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_MODELVIEW;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 }
 
 void
@@ -2109,9 +2247,7 @@ cogl_framebuffer_transform (CoglFramebuffer *framebuffer,
     _cogl_framebuffer_get_modelview_stack (framebuffer);
   _cogl_matrix_stack_multiply (modelview_stack, matrix);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_MODELVIEW;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 }
 
 void
@@ -2131,9 +2267,7 @@ cogl_framebuffer_perspective (CoglFramebuffer *framebuffer,
                             z_near,
                             z_far);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_PROJECTION;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_PROJECTION;
 }
 
 void
@@ -2162,9 +2296,7 @@ cogl_framebuffer_frustum (CoglFramebuffer *framebuffer,
                               z_near,
                               z_far);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_PROJECTION;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_PROJECTION;
 }
 
 void
@@ -2188,9 +2320,7 @@ cogl_framebuffer_orthographic (CoglFramebuffer *framebuffer,
   cogl_matrix_orthographic (&ortho, x_1, y_1, x_2, y_2, near, far);
   _cogl_matrix_stack_set (projection_stack, &ortho);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_PROJECTION;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_PROJECTION;
 }
 
 void
@@ -2200,9 +2330,7 @@ _cogl_framebuffer_push_projection (CoglFramebuffer *framebuffer)
     _cogl_framebuffer_get_projection_stack (framebuffer);
   _cogl_matrix_stack_push (projection_stack);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_PROJECTION;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_PROJECTION;
 }
 
 void
@@ -2212,9 +2340,7 @@ _cogl_framebuffer_pop_projection (CoglFramebuffer *framebuffer)
     _cogl_framebuffer_get_projection_stack (framebuffer);
   _cogl_matrix_stack_pop (projection_stack);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_PROJECTION;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_PROJECTION;
 }
 
 void
@@ -2235,9 +2361,7 @@ cogl_framebuffer_set_modelview_matrix (CoglFramebuffer *framebuffer,
     _cogl_framebuffer_get_modelview_stack (framebuffer);
   _cogl_matrix_stack_set (modelview_stack, matrix);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_MODELVIEW;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
 
   _COGL_MATRIX_DEBUG_PRINT (matrix);
 }
@@ -2265,9 +2389,7 @@ cogl_framebuffer_set_projection_matrix (CoglFramebuffer *framebuffer,
 
   _cogl_matrix_stack_set (projection_stack, matrix);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_PROJECTION;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_PROJECTION;
 
   _COGL_MATRIX_DEBUG_PRINT (matrix);
 }
@@ -2285,9 +2407,7 @@ cogl_framebuffer_push_scissor_clip (CoglFramebuffer *framebuffer,
     _cogl_clip_stack_push_window_rectangle (clip_state->stacks->data,
                                             x, y, width, height);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_CLIP;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_CLIP;
 }
 
 void
@@ -2307,9 +2427,7 @@ cogl_framebuffer_push_rectangle_clip (CoglFramebuffer *framebuffer,
                                      x_1, y_1, x_2, y_2,
                                      &modelview_matrix);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_CLIP;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_CLIP;
 }
 
 void
@@ -2326,9 +2444,7 @@ cogl_framebuffer_push_path_clip (CoglFramebuffer *framebuffer,
                                      path,
                                      &modelview_matrix);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_CLIP;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_CLIP;
 }
 
 void
@@ -2351,9 +2467,7 @@ cogl_framebuffer_push_primitive_clip (CoglFramebuffer *framebuffer,
                                      bounds_x2, bounds_y2,
                                      &modelview_matrix);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_CLIP;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_CLIP;
 }
 
 void
@@ -2363,9 +2477,7 @@ cogl_framebuffer_pop_clip (CoglFramebuffer *framebuffer)
 
   clip_state->stacks->data = _cogl_clip_stack_pop (clip_state->stacks->data);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_CLIP;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_CLIP;
 }
 
 void
@@ -2374,9 +2486,7 @@ _cogl_framebuffer_save_clip_stack (CoglFramebuffer *framebuffer)
   CoglClipState *clip_state = _cogl_framebuffer_get_clip_state (framebuffer);
   _cogl_clip_state_save_clip_stack (clip_state);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_CLIP;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_CLIP;
 }
 
 void
@@ -2385,9 +2495,7 @@ _cogl_framebuffer_restore_clip_stack (CoglFramebuffer *framebuffer)
   CoglClipState *clip_state = _cogl_framebuffer_get_clip_state (framebuffer);
   _cogl_clip_state_restore_clip_stack (clip_state);
 
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_CLIP;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_CLIP;
 }
 
 void
@@ -2667,6 +2775,43 @@ draw_wireframe (CoglFramebuffer *framebuffer,
 }
 #endif
 
+/* Small primitives are logged into the journal so that they can be
+ * batched together with the surrounding rectangles. Returns TRUE if
+ * the primitive was logged and so shouldn't be drawn directly */
+static gboolean
+try_journal_primitive (CoglFramebuffer *framebuffer,
+                       CoglPipeline *pipeline,
+                       CoglVerticesMode mode,
+                       int first_vertex,
+                       int n_vertices,
+                       CoglIndices *indices,
+                       CoglAttribute **attributes,
+                       int n_attributes,
+                       CoglDrawFlags flags)
+{
+  /* Draws that skip the journal flush are made by Cogl internally,
+   * for example by the journal itself */
+  if (flags & COGL_DRAW_SKIP_JOURNAL_FLUSH)
+    return FALSE;
+
+  if (n_vertices > COGL_JOURNAL_PRIMITIVE_MAX_VERTICES)
+    return FALSE;
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_WIREFRAME)))
+    return FALSE;
+
+  return _cogl_journal_log_primitive (framebuffer->journal,
+                                      framebuffer,
+                                      pipeline,
+                                      mode,
+                                      first_vertex,
+                                      n_vertices,
+                                      indices,
+                                      attributes,
+                                      n_attributes,
+                                      flags);
+}
+
 /* This can be called directly by the CoglJournal to draw attributes
  * skipping the implicit journal flush, the framebuffer flush and
  * pipeline validation. */
@@ -2680,7 +2825,24 @@ _cogl_framebuffer_draw_attributes (CoglFramebuffer *framebuffer,
                                    int n_attributes,
                                    CoglDrawFlags flags)
 {
+  if (try_journal_primitive (framebuffer, pipeline,
+                             mode, first_vertex, n_vertices,
+                             NULL, attributes, n_attributes, flags))
+    return;
+
 #ifdef COGL_ENABLE_DEBUG
+  /* Draws that skip the journal flush are made internally by Cogl,
+   * for example by the journal itself, so they don't need capturing */
+  if (_COGL_CAPTURE_ENABLED () && !(flags & COGL_DRAW_SKIP_JOURNAL_FLUSH))
+    {
+      /* Flush the journal first so that the records are written in
+       * the order that they are drawn */
+      _cogl_framebuffer_flush_journal (framebuffer);
+      _cogl_capture_draw (framebuffer, pipeline,
+                          mode, first_vertex, n_vertices,
+                          NULL, attributes, n_attributes);
+    }
+
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_WIREFRAME)))
     draw_wireframe (framebuffer, pipeline,
                     mode, first_vertex, n_vertices,
@@ -2688,11 +2850,18 @@ _cogl_framebuffer_draw_attributes (CoglFramebuffer *framebuffer,
   else
 #endif
     {
-      _cogl_flush_attributes_state (framebuffer, pipeline, flags,
-                                    attributes, n_attributes);
+      int base_vertex;
 
-      GE (framebuffer->context,
-          glDrawArrays ((GLenum)mode, first_vertex, n_vertices));
+      _cogl_flush_attributes_state (framebuffer, pipeline, flags,
+                                    attributes, n_attributes,
+                                    &base_vertex);
+
+      /* Skip the draw if the program is still being linked */
+      if (G_LIKELY (!framebuffer->context->current_pipeline_skip_draws))
+        GE (framebuffer->context,
+            glDrawArrays ((GLenum)mode,
+                          first_vertex + base_vertex,
+                          n_vertices));
     }
 }
 
@@ -2773,7 +2942,20 @@ _cogl_framebuffer_draw_indexed_attributes (CoglFramebuffer *framebuffer,
                                            int n_attributes,
                                            CoglDrawFlags flags)
 {
+  if (try_journal_primitive (framebuffer, pipeline,
+                             mode, first_vertex, n_vertices,
+                             indices, attributes, n_attributes, flags))
+    return;
+
 #ifdef COGL_ENABLE_DEBUG
+  if (_COGL_CAPTURE_ENABLED () && !(flags & COGL_DRAW_SKIP_JOURNAL_FLUSH))
+    {
+      _cogl_framebuffer_flush_journal (framebuffer);
+      _cogl_capture_draw (framebuffer, pipeline,
+                          mode, first_vertex, n_vertices,
+                          indices, attributes, n_attributes);
+    }
+
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_WIREFRAME)))
     draw_wireframe (framebuffer, pipeline,
                     mode, first_vertex, n_vertices,
@@ -2781,14 +2963,24 @@ _cogl_framebuffer_draw_indexed_attributes (CoglFramebuffer *framebuffer,
   else
 #endif
     {
+      CoglContext *ctx = framebuffer->context;
       CoglBuffer *buffer;
       guint8 *base;
       size_t buffer_offset;
       size_t index_size;
       GLenum indices_gl_type = 0;
+      int base_vertex = 0;
 
+      /* The attribute pointers can only be rebased if the indices
+       * can be offset by the same number of vertices */
       _cogl_flush_attributes_state (framebuffer, pipeline, flags,
-                                    attributes, n_attributes);
+                                    attributes, n_attributes,
+                                    ctx->glDrawElementsBaseVertex ?
+                                    &base_vertex : NULL);
+
+      /* Skip the draw if the program is still being linked */
+      if (G_UNLIKELY (framebuffer->context->current_pipeline_skip_draws))
+        return;
 
       buffer = COGL_BUFFER (cogl_indices_get_buffer (indices));
       base = _cogl_buffer_bind (buffer, COGL_BUFFER_BIND_TARGET_INDEX_BUFFER);
@@ -2808,11 +3000,19 @@ _cogl_framebuffer_draw_indexed_attributes (CoglFramebuffer *framebuffer,
           break;
         }
 
-      GE (framebuffer->context,
-          glDrawElements ((GLenum)mode,
-                          n_vertices,
-                          indices_gl_type,
-                          base + buffer_offset + index_size * first_vertex));
+      if (base_vertex)
+        GE (ctx, glDrawElementsBaseVertex ((GLenum)mode,
+                                           n_vertices,
+                                           indices_gl_type,
+                                           base + buffer_offset +
+                                           index_size * first_vertex,
+                                           base_vertex));
+      else
+        GE (ctx, glDrawElements ((GLenum)mode,
+                                 n_vertices,
+                                 indices_gl_type,
+                                 base + buffer_offset +
+                                 index_size * first_vertex));
 
       _cogl_buffer_unbind (buffer);
     }
@@ -1236,6 +1236,152 @@ cogl_framebuffer_discard_buffers (CoglFramebuffer *framebuffer,
 void
 cogl_framebuffer_finish (CoglFramebuffer *framebuffer);
 
+/**
+ * cogl_framebuffer_read_pixels_async:
+ * @framebuffer: A #CoglFramebuffer pointer
+ * @x: The x position to read from
+ * @y: The y position to read from
+ * @width: The width of the region of rectangles to read
+ * @height: The height of the region of rectangles to read
+ * @format: The pixel format to store the data in
+ * @rowstride: The rowstride of @pixels in bytes or 0 to calculate it
+ *   from the bytes-per-pixel of @format multiplied by @width
+ * @pixels: The memory to write the pixels to
+ * @callback: A #CoglReadbackCallback to invoke when the pixels are
+ *   ready
+ * @user_data: Private data to pass to @callback
+ *
+ * Starts reading a rectangle of pixels from @framebuffer where
+ * position (0, 0) is the top left. Unlike cogl_read_pixels() this
+ * doesn't wait for the GPU to finish rendering. Instead the pixels
+ * are read into a pixel buffer and @callback is invoked from
+ * cogl_poll_dispatch() once they have been copied into @pixels.
+ * @pixels must remain valid until then. Copying the pixels out of
+ * the pixel buffer and any premultiplication conversion are done on
+ * a separate thread if possible.
+ *
+ * If the driver doesn't support pixel buffers and fences then the
+ * pixels are read synchronously before this function returns but
+ * @callback is still invoked from cogl_poll_dispatch().
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+void
+cogl_framebuffer_read_pixels_async (CoglFramebuffer *framebuffer,
+                                    int x,
+                                    int y,
+                                    int width,
+                                    int height,
+                                    CoglPixelFormat format,
+                                    int rowstride,
+                                    guint8 *pixels,
+                                    CoglReadbackCallback callback,
+                                    void *user_data);
+
+/**
+ * CoglJournalStats:
+ * @n_flushes: The number of times the journal was flushed
+ * @n_entries: The number of rectangles that were logged in the
+ *   journal and later flushed
+ * @n_batches: The number of draw calls issued to submit the logged
+ *   rectangles
+ * @n_clip_breaks: The number of times a batch had to be split
+ *   because consecutive rectangles had different clip state
+ * @n_stride_breaks: The number of times a batch had to be split
+ *   because the vertex stride changed
+ * @n_layer_breaks: The number of times a batch had to be split
+ *   because the number of pipeline layers changed
+ * @n_pipeline_breaks: The number of times a batch had to be split
+ *   because consecutive rectangles used incompatible pipelines
+ * @n_modelview_breaks: The number of times a batch had to be split
+ *   because the modelview matrix changed. This only happens when
+ *   software transformation of rectangles is disabled.
+ * @n_bytes_uploaded: The total number of bytes of vertex data
+ *   uploaded to the GPU
+ * @upload_time: The time spent software clipping, expanding and
+ *   uploading vertex data in microseconds
+ * @state_flush_time: The time spent flushing framebuffer and clip
+ *   state in microseconds
+ * @draw_time: The time spent flushing pipeline state and issuing
+ *   draw calls in microseconds
+ *
+ * A structure used to report statistics about how efficiently the
+ * rectangles drawn to a framebuffer could be batched together. These
+ * are intended to help tune the order in which an application issues
+ * its drawing.
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+typedef struct {
+  unsigned int n_flushes;
+  unsigned int n_entries;
+  unsigned int n_batches;
+
+  unsigned int n_clip_breaks;
+  unsigned int n_stride_breaks;
+  unsigned int n_layer_breaks;
+  unsigned int n_pipeline_breaks;
+  unsigned int n_modelview_breaks;
+
+  gsize n_bytes_uploaded;
+
+  gint64 upload_time;
+  gint64 state_flush_time;
+  gint64 draw_time;
+
+  /*< private >*/
+  void *padding[4];
+} CoglJournalStats;
+
+/**
+ * cogl_framebuffer_get_journal_stats:
+ * @framebuffer: A #CoglFramebuffer pointer
+ * @stats: (out): A #CoglJournalStats to fill in
+ *
+ * Retrieves statistics accumulated over all of the journal flushes
+ * for @framebuffer since it was created or since the last call to
+ * cogl_framebuffer_reset_journal_stats(). Any rectangles that are
+ * still pending in the journal are not included.
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+void
+cogl_framebuffer_get_journal_stats (CoglFramebuffer *framebuffer,
+                                    CoglJournalStats *stats);
+
+/**
+ * cogl_framebuffer_get_last_journal_flush_stats:
+ * @framebuffer: A #CoglFramebuffer pointer
+ * @stats: (out): A #CoglJournalStats to fill in
+ *
+ * Retrieves the statistics for only the most recent journal flush of
+ * @framebuffer. The @n_flushes member will be 0 if the journal has
+ * not been flushed yet.
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+void
+cogl_framebuffer_get_last_journal_flush_stats (CoglFramebuffer *framebuffer,
+                                               CoglJournalStats *stats);
+
+/**
+ * cogl_framebuffer_reset_journal_stats:
+ * @framebuffer: A #CoglFramebuffer pointer
+ *
+ * Resets the accumulated journal statistics for @framebuffer back to
+ * zero. This can be used for example at the start of each frame to
+ * get per-frame numbers from cogl_framebuffer_get_journal_stats().
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+void
+cogl_framebuffer_reset_journal_stats (CoglFramebuffer *framebuffer);
+
 /**
  * cogl_get_draw_framebuffer:
  *
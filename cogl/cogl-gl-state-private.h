@@ -0,0 +1,266 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_GL_STATE_PRIVATE_H
+#define __COGL_GL_STATE_PRIVATE_H
+
+#include <glib.h>
+
+#include "cogl.h"
+#include "cogl-context.h"
+
+/*
+ * CoglGLState keeps a shadow copy of the GL state that Cogl changes
+ * most often. All of the calls to change this state should go through
+ * the functions below instead of calling GL directly. Each function
+ * compares the new value with the shadow copy and only calls GL if it
+ * differs. The number of calls that were issued and elided are
+ * counted for every frame and they are logged when the frame is
+ * swapped if COGL_DEBUG=gl-state is set.
+ *
+ * A shadow value is only trusted once it has been set through the
+ * tracker so the first call after initialisation or
+ * _cogl_gl_state_invalidate() is always issued.
+ */
+
+typedef enum
+{
+  COGL_GL_STATE_CALL_ENABLE,
+  COGL_GL_STATE_CALL_BLEND_FUNC,
+  COGL_GL_STATE_CALL_BLEND_EQUATION,
+  COGL_GL_STATE_CALL_BLEND_COLOR,
+  COGL_GL_STATE_CALL_DEPTH_FUNC,
+  COGL_GL_STATE_CALL_DEPTH_MASK,
+  COGL_GL_STATE_CALL_DEPTH_RANGE,
+  COGL_GL_STATE_CALL_STENCIL_FUNC,
+  COGL_GL_STATE_CALL_STENCIL_OP,
+  COGL_GL_STATE_CALL_STENCIL_MASK,
+  COGL_GL_STATE_CALL_SCISSOR,
+  COGL_GL_STATE_CALL_VIEWPORT,
+  COGL_GL_STATE_CALL_ACTIVE_TEXTURE,
+  COGL_GL_STATE_CALL_USE_PROGRAM,
+  COGL_GL_STATE_CALL_BIND_VERTEX_ARRAY,
+  COGL_GL_STATE_CALL_BIND_BUFFER,
+  COGL_GL_STATE_CALL_BIND_BUFFER_BASE,
+
+  COGL_GL_STATE_N_CALLS
+} CoglGLStateCall;
+
+/* The capabilities that can be toggled with
+ * _cogl_gl_state_set_enabled() */
+typedef enum
+{
+  COGL_GL_STATE_CAP_BLEND,
+  COGL_GL_STATE_CAP_DEPTH_TEST,
+  COGL_GL_STATE_CAP_STENCIL_TEST,
+  COGL_GL_STATE_CAP_SCISSOR_TEST,
+  COGL_GL_STATE_CAP_CULL_FACE,
+
+  COGL_GL_STATE_N_CAPS
+} CoglGLStateCap;
+
+/* The buffer targets whose bindings are shadowed. Other targets are
+ * always passed straight through */
+typedef enum
+{
+  COGL_GL_STATE_BUFFER_ARRAY,
+  COGL_GL_STATE_BUFFER_ELEMENT_ARRAY,
+  COGL_GL_STATE_BUFFER_PIXEL_PACK,
+  COGL_GL_STATE_BUFFER_PIXEL_UNPACK,
+  COGL_GL_STATE_BUFFER_UNIFORM,
+
+  COGL_GL_STATE_N_BUFFERS
+} CoglGLStateBuffer;
+
+/* The number of indexed uniform buffer binding points that are
+ * shadowed. GL guarantees at least 24. Binding points above this are
+ * always passed straight through */
+#define COGL_GL_STATE_N_UNIFORM_BUFFER_BINDINGS 32
+
+typedef struct _CoglGLState
+{
+  /* A bit for each CoglGLStateCall whose shadow value is known */
+  unsigned int valid;
+
+  /* A bit for each CoglGLStateCap */
+  unsigned int caps_valid;
+  unsigned int caps_enabled;
+
+  GLenum blend_src_rgb, blend_dst_rgb;
+  GLenum blend_src_alpha, blend_dst_alpha;
+  GLenum blend_equation_rgb, blend_equation_alpha;
+  float blend_color[4];
+
+  GLenum depth_func;
+  gboolean depth_mask;
+  float depth_range_near, depth_range_far;
+
+  GLenum stencil_func;
+  GLint stencil_ref;
+  GLuint stencil_value_mask;
+  GLenum stencil_fail, stencil_depth_fail, stencil_depth_pass;
+  GLuint stencil_write_mask;
+
+  GLint scissor[4];
+  GLint viewport[4];
+
+  int active_texture_unit;
+  GLuint program;
+  GLuint vertex_array;
+
+  /* A bit for each CoglGLStateBuffer */
+  unsigned int buffers_valid;
+  GLuint buffers[COGL_GL_STATE_N_BUFFERS];
+
+  /* A bit for each uniform buffer binding point */
+  guint32 uniform_buffer_bindings_valid;
+  GLuint uniform_buffer_bindings[COGL_GL_STATE_N_UNIFORM_BUFFER_BINDINGS];
+
+  /* Statistics for the current frame */
+  unsigned int n_issued[COGL_GL_STATE_N_CALLS];
+  unsigned int n_elided[COGL_GL_STATE_N_CALLS];
+} CoglGLState;
+
+void
+_cogl_gl_state_init (CoglGLState *state);
+
+/* Forgets all of the shadow values. This should be used whenever
+ * something outside of Cogl may have changed the GL state */
+void
+_cogl_gl_state_invalidate (CoglGLState *state);
+
+void
+_cogl_gl_state_set_enabled (CoglContext *ctx,
+                            CoglGLStateCap cap,
+                            gboolean enabled);
+
+void
+_cogl_gl_state_blend_func (CoglContext *ctx,
+                           GLenum src_rgb,
+                           GLenum dst_rgb,
+                           GLenum src_alpha,
+                           GLenum dst_alpha);
+
+void
+_cogl_gl_state_blend_equation (CoglContext *ctx,
+                               GLenum mode_rgb,
+                               GLenum mode_alpha);
+
+void
+_cogl_gl_state_blend_color (CoglContext *ctx,
+                            float red,
+                            float green,
+                            float blue,
+                            float alpha);
+
+void
+_cogl_gl_state_depth_func (CoglContext *ctx,
+                           GLenum func);
+
+void
+_cogl_gl_state_depth_mask (CoglContext *ctx,
+                           gboolean write_enabled);
+
+void
+_cogl_gl_state_depth_range (CoglContext *ctx,
+                            float near_val,
+                            float far_val);
+
+void
+_cogl_gl_state_stencil_func (CoglContext *ctx,
+                             GLenum func,
+                             GLint ref,
+                             GLuint mask);
+
+void
+_cogl_gl_state_stencil_op (CoglContext *ctx,
+                           GLenum fail,
+                           GLenum depth_fail,
+                           GLenum depth_pass);
+
+void
+_cogl_gl_state_stencil_mask (CoglContext *ctx,
+                             GLuint mask);
+
+void
+_cogl_gl_state_scissor (CoglContext *ctx,
+                        GLint x,
+                        GLint y,
+                        GLsizei width,
+                        GLsizei height);
+
+void
+_cogl_gl_state_viewport (CoglContext *ctx,
+                         GLint x,
+                         GLint y,
+                         GLsizei width,
+                         GLsizei height);
+
+void
+_cogl_gl_state_active_texture (CoglContext *ctx,
+                               int unit_index);
+
+/* Returns FALSE if GL rejected the program in which case no program
+ * will be in use */
+gboolean
+_cogl_gl_state_use_program (CoglContext *ctx,
+                            GLuint program);
+
+void
+_cogl_gl_state_bind_vertex_array (CoglContext *ctx,
+                                  GLuint vertex_array);
+
+/* Deletes a vertex array object. This must be used instead of
+ * calling glDeleteVertexArrays directly so that a recycled name won't
+ * be mistaken for a redundant bind */
+void
+_cogl_gl_state_delete_vertex_array (CoglContext *ctx,
+                                    GLuint vertex_array);
+
+void
+_cogl_gl_state_bind_buffer (CoglContext *ctx,
+                            GLenum target,
+                            GLuint buffer);
+
+/* Binds a buffer to an indexed GL_UNIFORM_BUFFER binding point. Like
+ * glBindBufferBase this also binds the buffer to the generic
+ * GL_UNIFORM_BUFFER target */
+void
+_cogl_gl_state_bind_uniform_buffer (CoglContext *ctx,
+                                    GLuint binding,
+                                    GLuint buffer);
+
+/* Deletes a buffer object and forgets any bindings of it. Deleting a
+ * bound buffer implicitly binds 0 to the target */
+void
+_cogl_gl_state_delete_buffer (CoglContext *ctx,
+                              GLuint buffer);
+
+/* Logs the statistics for the frame if COGL_DEBUG=gl-state is set
+ * and then resets them. This is called whenever an onscreen
+ * framebuffer is swapped */
+void
+_cogl_gl_state_end_frame (CoglContext *ctx);
+
+#endif /* __COGL_GL_STATE_PRIVATE_H */
@@ -0,0 +1,626 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "cogl-gl-state-private.h"
+#include "cogl-context-private.h"
+#include "cogl-debug.h"
+#include "cogl-internal.h"
+#include "cogl-profile.h"
+#include "cogl-util.h"
+
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER 0x8A11
+#endif
+
+#define CALL_BIT(call) (1U << (call))
+
+static const char * const
+call_names[COGL_GL_STATE_N_CALLS] =
+  {
+    "glEnable/glDisable",
+    "glBlendFunc",
+    "glBlendEquation",
+    "glBlendColor",
+    "glDepthFunc",
+    "glDepthMask",
+    "glDepthRange",
+    "glStencilFunc",
+    "glStencilOp",
+    "glStencilMask",
+    "glScissor",
+    "glViewport",
+    "glActiveTexture",
+    "glUseProgram",
+    "glBindVertexArray",
+    "glBindBuffer",
+    "glBindBufferBase"
+  };
+
+static const GLenum
+cap_enums[COGL_GL_STATE_N_CAPS] =
+  {
+    GL_BLEND,
+    GL_DEPTH_TEST,
+    GL_STENCIL_TEST,
+    GL_SCISSOR_TEST,
+    GL_CULL_FACE
+  };
+
+static void
+count_call (CoglGLState *state,
+            CoglGLStateCall call,
+            gboolean issued)
+{
+  COGL_STATIC_COUNTER (gl_state_issued_counter,
+                       "GL state calls issued",
+                       "Increments each time the GL state tracker "
+                       "calls GL to change some state",
+                       0 /* no application private data */);
+  COGL_STATIC_COUNTER (gl_state_elided_counter,
+                       "GL state calls elided",
+                       "Increments each time the GL state tracker "
+                       "skips a call because the state is already set",
+                       0 /* no application private data */);
+
+  if (issued)
+    {
+      state->n_issued[call]++;
+      COGL_COUNTER_INC (_cogl_uprof_context, gl_state_issued_counter);
+    }
+  else
+    {
+      state->n_elided[call]++;
+      COGL_COUNTER_INC (_cogl_uprof_context, gl_state_elided_counter);
+    }
+}
+
+/* Returns TRUE and counts an elided call if the shadow value for the
+ * given call is known and matched. Otherwise marks the shadow value
+ * as known and counts an issued call. The caller should then update
+ * the shadow value and call GL */
+static gboolean
+check_redundant (CoglGLState *state,
+                 CoglGLStateCall call,
+                 gboolean matches)
+{
+  if ((state->valid & CALL_BIT (call)) && matches)
+    {
+      count_call (state, call, FALSE);
+      return TRUE;
+    }
+
+  state->valid |= CALL_BIT (call);
+  count_call (state, call, TRUE);
+
+  return FALSE;
+}
+
+void
+_cogl_gl_state_init (CoglGLState *state)
+{
+  memset (state, 0, sizeof (CoglGLState));
+  _cogl_gl_state_invalidate (state);
+}
+
+void
+_cogl_gl_state_invalidate (CoglGLState *state)
+{
+  state->valid = 0;
+  state->caps_valid = 0;
+  state->buffers_valid = 0;
+  state->uniform_buffer_bindings_valid = 0;
+}
+
+void
+_cogl_gl_state_set_enabled (CoglContext *ctx,
+                            CoglGLStateCap cap,
+                            gboolean enabled)
+{
+  CoglGLState *state = &ctx->gl_state;
+  unsigned int cap_bit = 1U << cap;
+
+  if ((state->caps_valid & cap_bit) &&
+      !!(state->caps_enabled & cap_bit) == !!enabled)
+    {
+      count_call (state, COGL_GL_STATE_CALL_ENABLE, FALSE);
+      return;
+    }
+
+  count_call (state, COGL_GL_STATE_CALL_ENABLE, TRUE);
+
+  if (enabled)
+    {
+      GE (ctx, glEnable (cap_enums[cap]));
+      state->caps_enabled |= cap_bit;
+    }
+  else
+    {
+      GE (ctx, glDisable (cap_enums[cap]));
+      state->caps_enabled &= ~cap_bit;
+    }
+
+  state->caps_valid |= cap_bit;
+}
+
+void
+_cogl_gl_state_blend_func (CoglContext *ctx,
+                           GLenum src_rgb,
+                           GLenum dst_rgb,
+                           GLenum src_alpha,
+                           GLenum dst_alpha)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_BLEND_FUNC,
+                       state->blend_src_rgb == src_rgb &&
+                       state->blend_dst_rgb == dst_rgb &&
+                       state->blend_src_alpha == src_alpha &&
+                       state->blend_dst_alpha == dst_alpha))
+    return;
+
+#if defined(HAVE_COGL_GLES2) || defined(HAVE_COGL_GL)
+  /* GLES 1 only has glBlendFunc */
+  if (ctx->driver != COGL_DRIVER_GLES1 &&
+      ctx->glBlendFuncSeparate &&
+      (src_rgb != src_alpha || dst_rgb != dst_alpha))
+    GE (ctx, glBlendFuncSeparate (src_rgb, dst_rgb, src_alpha, dst_alpha));
+  else
+#endif
+    {
+      GE (ctx, glBlendFunc (src_rgb, dst_rgb));
+      src_alpha = src_rgb;
+      dst_alpha = dst_rgb;
+    }
+
+  state->blend_src_rgb = src_rgb;
+  state->blend_dst_rgb = dst_rgb;
+  state->blend_src_alpha = src_alpha;
+  state->blend_dst_alpha = dst_alpha;
+}
+
+void
+_cogl_gl_state_blend_equation (CoglContext *ctx,
+                               GLenum mode_rgb,
+                               GLenum mode_alpha)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_BLEND_EQUATION,
+                       state->blend_equation_rgb == mode_rgb &&
+                       state->blend_equation_alpha == mode_alpha))
+    return;
+
+  if (ctx->glBlendEquationSeparate && mode_rgb != mode_alpha)
+    GE (ctx, glBlendEquationSeparate (mode_rgb, mode_alpha));
+  else
+    {
+      GE (ctx, glBlendEquation (mode_rgb));
+      mode_alpha = mode_rgb;
+    }
+
+  state->blend_equation_rgb = mode_rgb;
+  state->blend_equation_alpha = mode_alpha;
+}
+
+void
+_cogl_gl_state_blend_color (CoglContext *ctx,
+                            float red,
+                            float green,
+                            float blue,
+                            float alpha)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_BLEND_COLOR,
+                       state->blend_color[0] == red &&
+                       state->blend_color[1] == green &&
+                       state->blend_color[2] == blue &&
+                       state->blend_color[3] == alpha))
+    return;
+
+  GE (ctx, glBlendColor (red, green, blue, alpha));
+
+  state->blend_color[0] = red;
+  state->blend_color[1] = green;
+  state->blend_color[2] = blue;
+  state->blend_color[3] = alpha;
+}
+
+void
+_cogl_gl_state_depth_func (CoglContext *ctx,
+                           GLenum func)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_DEPTH_FUNC,
+                       state->depth_func == func))
+    return;
+
+  GE (ctx, glDepthFunc (func));
+  state->depth_func = func;
+}
+
+void
+_cogl_gl_state_depth_mask (CoglContext *ctx,
+                           gboolean write_enabled)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  write_enabled = !!write_enabled;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_DEPTH_MASK,
+                       state->depth_mask == write_enabled))
+    return;
+
+  GE (ctx, glDepthMask (write_enabled ? GL_TRUE : GL_FALSE));
+  state->depth_mask = write_enabled;
+}
+
+void
+_cogl_gl_state_depth_range (CoglContext *ctx,
+                            float near_val,
+                            float far_val)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  /* GLES 1 doesn't have glDepthRange */
+  _COGL_RETURN_IF_FAIL (ctx->driver != COGL_DRIVER_GLES1);
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_DEPTH_RANGE,
+                       state->depth_range_near == near_val &&
+                       state->depth_range_far == far_val))
+    return;
+
+  if (ctx->driver == COGL_DRIVER_GLES2)
+    GE (ctx, glDepthRangef (near_val, far_val));
+  else
+    GE (ctx, glDepthRange (near_val, far_val));
+
+  state->depth_range_near = near_val;
+  state->depth_range_far = far_val;
+}
+
+void
+_cogl_gl_state_stencil_func (CoglContext *ctx,
+                             GLenum func,
+                             GLint ref,
+                             GLuint mask)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_STENCIL_FUNC,
+                       state->stencil_func == func &&
+                       state->stencil_ref == ref &&
+                       state->stencil_value_mask == mask))
+    return;
+
+  GE (ctx, glStencilFunc (func, ref, mask));
+
+  state->stencil_func = func;
+  state->stencil_ref = ref;
+  state->stencil_value_mask = mask;
+}
+
+void
+_cogl_gl_state_stencil_op (CoglContext *ctx,
+                           GLenum fail,
+                           GLenum depth_fail,
+                           GLenum depth_pass)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_STENCIL_OP,
+                       state->stencil_fail == fail &&
+                       state->stencil_depth_fail == depth_fail &&
+                       state->stencil_depth_pass == depth_pass))
+    return;
+
+  GE (ctx, glStencilOp (fail, depth_fail, depth_pass));
+
+  state->stencil_fail = fail;
+  state->stencil_depth_fail = depth_fail;
+  state->stencil_depth_pass = depth_pass;
+}
+
+void
+_cogl_gl_state_stencil_mask (CoglContext *ctx,
+                             GLuint mask)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_STENCIL_MASK,
+                       state->stencil_write_mask == mask))
+    return;
+
+  GE (ctx, glStencilMask (mask));
+  state->stencil_write_mask = mask;
+}
+
+void
+_cogl_gl_state_scissor (CoglContext *ctx,
+                        GLint x,
+                        GLint y,
+                        GLsizei width,
+                        GLsizei height)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_SCISSOR,
+                       state->scissor[0] == x &&
+                       state->scissor[1] == y &&
+                       state->scissor[2] == width &&
+                       state->scissor[3] == height))
+    return;
+
+  GE (ctx, glScissor (x, y, width, height));
+
+  state->scissor[0] = x;
+  state->scissor[1] = y;
+  state->scissor[2] = width;
+  state->scissor[3] = height;
+}
+
+void
+_cogl_gl_state_viewport (CoglContext *ctx,
+                         GLint x,
+                         GLint y,
+                         GLsizei width,
+                         GLsizei height)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_VIEWPORT,
+                       state->viewport[0] == x &&
+                       state->viewport[1] == y &&
+                       state->viewport[2] == width &&
+                       state->viewport[3] == height))
+    return;
+
+  GE (ctx, glViewport (x, y, width, height));
+
+  state->viewport[0] = x;
+  state->viewport[1] = y;
+  state->viewport[2] = width;
+  state->viewport[3] = height;
+}
+
+void
+_cogl_gl_state_active_texture (CoglContext *ctx,
+                               int unit_index)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_ACTIVE_TEXTURE,
+                       state->active_texture_unit == unit_index))
+    return;
+
+  GE (ctx, glActiveTexture (GL_TEXTURE0 + unit_index));
+  state->active_texture_unit = unit_index;
+}
+
+gboolean
+_cogl_gl_state_use_program (CoglContext *ctx,
+                            GLuint program)
+{
+  CoglGLState *state = &ctx->gl_state;
+  GLenum gl_error;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_USE_PROGRAM,
+                       state->program == program))
+    return TRUE;
+
+  /* glUseProgram will fail if the program didn't link so we need to
+     check for errors. Any errors from earlier calls are cleared
+     first */
+  while ((gl_error = ctx->glGetError ()) != GL_NO_ERROR)
+    ;
+  ctx->glUseProgram (program);
+  if (ctx->glGetError () == GL_NO_ERROR)
+    {
+      state->program = program;
+      return TRUE;
+    }
+  else
+    {
+      GE( ctx, glUseProgram (0) );
+      state->program = 0;
+      return FALSE;
+    }
+}
+
+void
+_cogl_gl_state_bind_vertex_array (CoglContext *ctx,
+                                  GLuint vertex_array)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (check_redundant (state, COGL_GL_STATE_CALL_BIND_VERTEX_ARRAY,
+                       state->vertex_array == vertex_array))
+    return;
+
+  GE (ctx, glBindVertexArray (vertex_array));
+  state->vertex_array = vertex_array;
+
+  /* The element array binding is part of the vertex array state */
+  state->buffers_valid &= ~(1U << COGL_GL_STATE_BUFFER_ELEMENT_ARRAY);
+}
+
+void
+_cogl_gl_state_delete_vertex_array (CoglContext *ctx,
+                                    GLuint vertex_array)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  /* Deleting the bound vertex array reverts to the default one */
+  if (state->vertex_array == vertex_array)
+    {
+      state->vertex_array = 0;
+      state->buffers_valid &= ~(1U << COGL_GL_STATE_BUFFER_ELEMENT_ARRAY);
+    }
+
+  GE (ctx, glDeleteVertexArrays (1, &vertex_array));
+}
+
+static int
+get_buffer_index (GLenum target)
+{
+  switch (target)
+    {
+    case GL_ARRAY_BUFFER:
+      return COGL_GL_STATE_BUFFER_ARRAY;
+    case GL_ELEMENT_ARRAY_BUFFER:
+      return COGL_GL_STATE_BUFFER_ELEMENT_ARRAY;
+    case GL_PIXEL_PACK_BUFFER:
+      return COGL_GL_STATE_BUFFER_PIXEL_PACK;
+    case GL_PIXEL_UNPACK_BUFFER:
+      return COGL_GL_STATE_BUFFER_PIXEL_UNPACK;
+    case GL_UNIFORM_BUFFER:
+      return COGL_GL_STATE_BUFFER_UNIFORM;
+    }
+
+  return -1;
+}
+
+void
+_cogl_gl_state_bind_buffer (CoglContext *ctx,
+                            GLenum target,
+                            GLuint buffer)
+{
+  CoglGLState *state = &ctx->gl_state;
+  int index = get_buffer_index (target);
+
+  if (index == -1)
+    {
+      count_call (state, COGL_GL_STATE_CALL_BIND_BUFFER, TRUE);
+      GE (ctx, glBindBuffer (target, buffer));
+      return;
+    }
+
+  if ((state->buffers_valid & (1U << index)) &&
+      state->buffers[index] == buffer)
+    {
+      count_call (state, COGL_GL_STATE_CALL_BIND_BUFFER, FALSE);
+      return;
+    }
+
+  count_call (state, COGL_GL_STATE_CALL_BIND_BUFFER, TRUE);
+
+  GE (ctx, glBindBuffer (target, buffer));
+
+  state->buffers[index] = buffer;
+  state->buffers_valid |= 1U << index;
+}
+
+void
+_cogl_gl_state_bind_uniform_buffer (CoglContext *ctx,
+                                    GLuint binding,
+                                    GLuint buffer)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (binding >= COGL_GL_STATE_N_UNIFORM_BUFFER_BINDINGS)
+    count_call (state, COGL_GL_STATE_CALL_BIND_BUFFER_BASE, TRUE);
+  else if ((state->uniform_buffer_bindings_valid & (1U << binding)) &&
+           state->uniform_buffer_bindings[binding] == buffer)
+    {
+      count_call (state, COGL_GL_STATE_CALL_BIND_BUFFER_BASE, FALSE);
+      return;
+    }
+  else
+    {
+      count_call (state, COGL_GL_STATE_CALL_BIND_BUFFER_BASE, TRUE);
+      state->uniform_buffer_bindings[binding] = buffer;
+      state->uniform_buffer_bindings_valid |= 1U << binding;
+    }
+
+  GE (ctx, glBindBufferBase (GL_UNIFORM_BUFFER, binding, buffer));
+
+  state->buffers[COGL_GL_STATE_BUFFER_UNIFORM] = buffer;
+  state->buffers_valid |= 1U << COGL_GL_STATE_BUFFER_UNIFORM;
+}
+
+void
+_cogl_gl_state_delete_buffer (CoglContext *ctx,
+                              GLuint buffer)
+{
+  CoglGLState *state = &ctx->gl_state;
+  int i;
+
+  /* Deleting a bound buffer reverts the binding to 0. The element
+     array binding may also refer to the buffer from a vertex array
+     object that isn't bound but that won't be seen until the vertex
+     array is bound again which already invalidates it */
+  for (i = 0; i < COGL_GL_STATE_N_BUFFERS; i++)
+    if (state->buffers[i] == buffer)
+      state->buffers[i] = 0;
+  for (i = 0; i < COGL_GL_STATE_N_UNIFORM_BUFFER_BINDINGS; i++)
+    if (state->uniform_buffer_bindings[i] == buffer)
+      state->uniform_buffer_bindings[i] = 0;
+
+  GE (ctx, glDeleteBuffers (1, &buffer));
+}
+
+void
+_cogl_gl_state_end_frame (CoglContext *ctx)
+{
+  CoglGLState *state = &ctx->gl_state;
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_GL_STATE)))
+    {
+      unsigned int total_issued = 0, total_elided = 0;
+      int i;
+
+      for (i = 0; i < COGL_GL_STATE_N_CALLS; i++)
+        {
+          if (state->n_issued[i] == 0 && state->n_elided[i] == 0)
+            continue;
+
+          COGL_NOTE (GL_STATE, "%-20s issued %6u, elided %6u",
+                     call_names[i],
+                     state->n_issued[i],
+                     state->n_elided[i]);
+
+          total_issued += state->n_issued[i];
+          total_elided += state->n_elided[i];
+        }
+
+      COGL_NOTE (GL_STATE, "%-20s issued %6u, elided %6u",
+                 "Total for frame", total_issued, total_elided);
+    }
+
+  memset (state->n_issued, 0, sizeof (state->n_issued));
+  memset (state->n_elided, 0, sizeof (state->n_elided));
+}
@@ -73,6 +73,15 @@ cogl_gl_error_to_string (GLenum error_code);
 int
 _cogl_get_format_bpp (CoglPixelFormat format);
 
+/* Compressed formats are stored in blocks of 4x4 pixels so
+ * _cogl_get_format_bpp() returns 0 for them */
+gboolean
+_cogl_pixel_format_is_compressed (CoglPixelFormat format);
+
+/* Returns the number of bytes in a 4x4 block of a compressed format */
+int
+_cogl_get_format_block_size (CoglPixelFormat format);
+
 void
 _cogl_enable (unsigned long flags);
 
@@ -110,7 +119,16 @@ typedef enum
   COGL_PRIVATE_FEATURE_OFFSCREEN_BLIT = 1L<<3,
   COGL_PRIVATE_FEATURE_FOUR_CLIP_PLANES = 1L<<4,
   COGL_PRIVATE_FEATURE_PBOS = 1L<<5,
-  COGL_PRIVATE_FEATURE_VBOS = 1L<<6
+  COGL_PRIVATE_FEATURE_VBOS = 1L<<6,
+  COGL_PRIVATE_FEATURE_UBOS = 1L<<7,
+  COGL_PRIVATE_FEATURE_PARALLEL_SHADER_COMPILE = 1L<<8,
+  COGL_PRIVATE_FEATURE_SAMPLER_OBJECTS = 1L<<9,
+  COGL_PRIVATE_FEATURE_MULTI_BIND = 1L<<10,
+  COGL_PRIVATE_FEATURE_VERTEX_ARRAY_OBJECTS = 1L<<11,
+  /* GLES can upload a sub-region of a bitmap using
+     GL_UNPACK_ROW_LENGTH. This is always available on big GL */
+  COGL_PRIVATE_FEATURE_UNPACK_SUBIMAGE = 1L<<12,
+  COGL_PRIVATE_FEATURE_FENCES = 1L<<13
 } CoglPrivateFeatureFlags;
 
 /* Sometimes when evaluating pipelines, either during comparisons or
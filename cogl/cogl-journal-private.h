@@ -27,9 +27,15 @@
 #include "cogl.h"
 #include "cogl-handle.h"
 #include "cogl-clip-stack.h"
+#include "cogl-attribute-private.h"
+#include "cogl-arena-private.h"
 
 #define COGL_JOURNAL_VBO_POOL_SIZE 8
 
+/* Primitives with more vertices than this are drawn directly instead
+ * of being logged in the journal */
+#define COGL_JOURNAL_PRIMITIVE_MAX_VERTICES 64
+
 typedef struct _CoglJournal
 {
   CoglObject _parent;
@@ -46,6 +52,11 @@ typedef struct _CoglJournal
   GArray *vertices;
   size_t needed_vbo_len;
 
+  /* The number of entries that were logged for primitives rather than
+     rectangles. The primitives are drawn as lists of triangles in
+     between the runs of rectangles */
+  int n_primitive_entries;
+
   /* A pool of attribute buffers is used so that we can avoid repeatedly
      reallocating buffers. Only one of these buffers at a time will be
      used by Cogl but we keep more than one alive anyway in case the
@@ -58,6 +69,21 @@ typedef struct _CoglJournal
 
   int fast_read_pixel_count;
 
+  /* Pipelines with the overrides of quad entries applied. These are
+     created on demand when the journal is flushed and are keyed by
+     the entry's pipeline and overrides so that each combination is
+     only copied once per flush. See
+     _cogl_journal_get_entry_pipeline() */
+  GHashTable *override_pipelines;
+
+  /* Transient data that only lives until the journal is discarded */
+  CoglArena arena;
+
+  /* Statistics accumulated across all flushes and for the most
+     recent flush. See cogl_framebuffer_get_journal_stats() */
+  CoglJournalStats stats;
+  CoglJournalStats last_flush_stats;
+
 } CoglJournal;
 
 /* To improve batching of geometry when submitting vertices to OpenGL we
@@ -71,6 +97,17 @@ typedef struct _CoglJournalEntry
   CoglClipStack           *clip_stack;
   /* Offset into ctx->logged_vertices */
   size_t                   array_offset;
+  /* 0 for rectangles or the number of triangle list vertices logged
+   * for a primitive */
+  int                      n_vertices;
+  /* Overrides to apply to the pipeline when the entry is drawn. These
+   * are stored separately so that logging a quad doesn't need to copy
+   * the pipeline. disable_layers is 0 if no layers are disabled */
+  guint32                  disable_layers;
+  CoglTexture             *layer0_override_texture;
+  /* TRUE if blending should be forced on, for example because a
+   * primitive has a color attribute with translucent colors */
+  gboolean                 enable_blend;
   /* XXX: These entries are pretty big now considering the padding in
    * CoglPipelineFlushOptions and CoglMatrix, so we might need to optimize this
    * later. */
@@ -79,6 +116,13 @@ typedef struct _CoglJournalEntry
 CoglJournal *
 _cogl_journal_new (void);
 
+/* Returns the pipeline to draw the entry with. If the entry has any
+ * overrides then this is a derived pipeline which is owned by the
+ * journal and is only valid until the journal is discarded */
+CoglPipeline *
+_cogl_journal_get_entry_pipeline (CoglJournal *journal,
+                                  const CoglJournalEntry *entry);
+
 void
 _cogl_journal_log_quad (CoglJournal  *journal,
                         const float  *position,
@@ -88,6 +132,18 @@ _cogl_journal_log_quad (CoglJournal  *journal,
                         const float  *tex_coords,
                         unsigned int  tex_coords_len);
 
+gboolean
+_cogl_journal_log_primitive (CoglJournal *journal,
+                             CoglFramebuffer *framebuffer,
+                             CoglPipeline *pipeline,
+                             CoglVerticesMode mode,
+                             int first_vertex,
+                             int n_vertices,
+                             CoglIndices *indices,
+                             CoglAttribute **attributes,
+                             int n_attributes,
+                             CoglDrawFlags flags);
+
 void
 _cogl_journal_flush (CoglJournal *journal,
                      CoglFramebuffer *framebuffer);
@@ -102,6 +158,9 @@ _cogl_journal_all_entries_within_bounds (CoglJournal *journal,
                                          float clip_x1,
                                          float clip_y1);
 
+void
+_cogl_journal_reset_stats (CoglJournal *journal);
+
 gboolean
 _cogl_journal_try_read_pixel (CoglJournal *journal,
                               int x,
@@ -39,6 +39,10 @@
 #include "cogl-attribute-private.h"
 #include "cogl-point-in-poly-private.h"
 #include "cogl-private.h"
+#include "cogl-capture-private.h"
+#include "cogl-buffer-private.h"
+#include "cogl-indices-private.h"
+#include "cogl-util.h"
 
 #include <string.h>
 #include <gmodule.h>
@@ -57,6 +61,23 @@
 #define GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS(N_LAYERS) \
   (N_LAYERS * 2 + 2)
 
+/* XXX NB:
+ * Entries logged for a primitive are already broken down into a list
+ * of triangles and each vertex is logged as follows:
+ *   4 RGBA GLubytes for the color
+ *   3 floats for the untransformed position
+ *   2 * n_layers floats for the texture coordinates
+ */
+#define GET_JOURNAL_PRIMITIVE_ARRAY_STRIDE_FOR_N_LAYERS(N_LAYERS) \
+  (N_LAYERS * 2 + 4)
+
+/* In the vertex array the triangles of a primitive are padded with
+ * degenerate triangles to a multiple of this number of vertices. That
+ * way the rectangles always start on a multiple of 4 vertices so they
+ * can still be drawn as quads with the shared rectangle indices. This
+ * needs to be a multiple of both 3 and 4 */
+#define COGL_JOURNAL_PRIMITIVE_VB_ALIGNMENT 12
+
 /* XXX NB:
  * Once in the vertex array, the journal's vertex data is arranged as follows:
  * 4 vertices per quad:
@@ -87,11 +108,43 @@
   (POS_STRIDE + COLOR_STRIDE + \
    TEX_STRIDE * (N_LAYERS < MIN_LAYER_PADING ? MIN_LAYER_PADING : N_LAYERS))
 
+/* The vertices of each entry start at a whole number of vertices into
+ * the vertex buffer. The vertex buffer is padded wherever the stride
+ * changes to ensure this. That way the attributes for all of the
+ * batches with the same stride have the same offsets relative to the
+ * first vertex so they can share a vertex array object and each
+ * batch just passes its start as the first vertex of the draw. The
+ * offset and the result are in floats */
+static size_t
+align_vb_offset (size_t offset, int n_layers)
+{
+  size_t vb_stride = GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (n_layers);
+
+  return (offset + vb_stride - 1) / vb_stride * vb_stride;
+}
+
 /* If a batch is longer than this threshold then we'll assume it's not
    worth doing software clipping and it's cheaper to program the GPU
    to do the clip */
 #define COGL_JOURNAL_HARDWARE_CLIP_THRESHOLD 8
 
+/* Journals with fewer entries than this are always prepared on the
+   calling thread because handing the work over to the thread pool
+   would cost more than it saves */
+#define COGL_JOURNAL_THREADED_PREPARE_THRESHOLD 512
+
+/* Flags stored in ctx->journal_entry_flags while preparing a journal
+   on multiple threads */
+typedef enum
+{
+  /* Set before the threads are started if the entry has a clip stack
+     and its pipeline allows modifying the texture coordinates */
+  COGL_JOURNAL_ENTRY_FLAG_PIPELINE_CLIPPABLE = 1 << 0,
+  /* Set by the threads if the entry was clipped in software so that
+     its clip stack can be dropped once all of the threads are done */
+  COGL_JOURNAL_ENTRY_FLAG_SOFTWARE_CLIPPED = 1 << 1
+} CoglJournalEntryFlag;
+
 typedef struct _CoglJournalFlushState
 {
   CoglJournal         *journal;
@@ -113,8 +166,23 @@ typedef struct _CoglJournalFlushState
   CoglMatrixStack     *projection_stack;
 
   CoglPipeline        *pipeline;
+
+  /* Statistics for the current flush */
+  CoglJournalStats    *stats;
 } CoglJournalFlushState;
 
+/* The reasons why a run of journal entries had to be split into
+ * separate batches. These are recorded in the journal statistics */
+typedef enum
+{
+  COGL_JOURNAL_BATCH_BREAK_NONE,
+  COGL_JOURNAL_BATCH_BREAK_CLIP,
+  COGL_JOURNAL_BATCH_BREAK_STRIDE,
+  COGL_JOURNAL_BATCH_BREAK_N_LAYERS,
+  COGL_JOURNAL_BATCH_BREAK_PIPELINE,
+  COGL_JOURNAL_BATCH_BREAK_MODELVIEW
+} CoglJournalBatchBreak;
+
 typedef void (*CoglJournalBatchCallback) (CoglJournalEntry *start,
                                           int n_entries,
                                           void *data);
@@ -139,9 +207,121 @@ _cogl_journal_free (CoglJournal *journal)
     if (journal->vbo_pool[i])
       cogl_object_unref (journal->vbo_pool[i]);
 
+  if (journal->override_pipelines)
+    g_hash_table_destroy (journal->override_pipelines);
+
+  _cogl_arena_destroy (&journal->arena);
+
   g_slice_free (CoglJournal, journal);
 }
 
+/* Allocation counts for the arenas of all of the journals */
+static CoglDebugTypeStats journal_arena_stats;
+
+typedef struct
+{
+  CoglPipeline *pipeline;
+  CoglTexture *layer0_override_texture;
+  guint32 disable_layers;
+  gboolean enable_blend;
+} CoglJournalOverrideKey;
+
+typedef struct
+{
+  CoglJournalOverrideKey key;
+  CoglPipeline *pipeline;
+} CoglJournalOverrideEntry;
+
+static unsigned int
+override_key_hash (const void *data)
+{
+  unsigned int hash =
+    _cogl_util_one_at_a_time_hash (0, data, sizeof (CoglJournalOverrideKey));
+
+  return _cogl_util_one_at_a_time_mix (hash);
+}
+
+static gboolean
+override_key_equal (const void *a, const void *b)
+{
+  return !memcmp (a, b, sizeof (CoglJournalOverrideKey));
+}
+
+static void
+override_entry_free (void *data)
+{
+  CoglJournalOverrideEntry *entry = data;
+
+  /* The entry itself is in the journal's arena */
+  cogl_object_unref (entry->pipeline);
+}
+
+CoglPipeline *
+_cogl_journal_get_entry_pipeline (CoglJournal *journal,
+                                  const CoglJournalEntry *entry)
+{
+  CoglJournalOverrideKey key;
+  CoglJournalOverrideEntry *override_entry;
+  CoglPipelineFlushOptions flush_options;
+  COGL_STATIC_COUNTER (journal_override_pipeline_counter,
+                       "Journal override pipelines",
+                       "The number of pipelines copied to apply the "
+                       "overrides of journal entries",
+                       0 /* no application private data */);
+
+  if (G_LIKELY (entry->disable_layers == 0 &&
+                entry->layer0_override_texture == NULL &&
+                !entry->enable_blend))
+    return entry->pipeline;
+
+  if (journal->override_pipelines == NULL)
+    journal->override_pipelines =
+      g_hash_table_new_full (override_key_hash,
+                             override_key_equal,
+                             NULL, /* key destroy */
+                             override_entry_free);
+
+  /* Clear the whole struct so that any padding won't affect the hash
+     or the comparison */
+  memset (&key, 0, sizeof (key));
+  key.pipeline = entry->pipeline;
+  key.layer0_override_texture = entry->layer0_override_texture;
+  key.disable_layers = entry->disable_layers;
+  key.enable_blend = entry->enable_blend;
+
+  override_entry = g_hash_table_lookup (journal->override_pipelines, &key);
+  if (override_entry)
+    return override_entry->pipeline;
+
+  COGL_COUNTER_INC (_cogl_uprof_context, journal_override_pipeline_counter);
+
+  flush_options.flags = 0;
+  if (entry->disable_layers)
+    {
+      flush_options.disable_layers = entry->disable_layers;
+      flush_options.flags |= COGL_PIPELINE_FLUSH_DISABLE_MASK;
+    }
+  if (entry->layer0_override_texture)
+    {
+      flush_options.flags |= COGL_PIPELINE_FLUSH_LAYER0_OVERRIDE;
+      flush_options.layer0_override_texture = entry->layer0_override_texture;
+    }
+
+  override_entry = _cogl_arena_new (&journal->arena, CoglJournalOverrideEntry);
+  override_entry->key = key;
+  override_entry->pipeline = cogl_pipeline_copy (entry->pipeline);
+  _cogl_pipeline_apply_overrides (override_entry->pipeline, &flush_options);
+  if (entry->enable_blend)
+    _cogl_pipeline_set_blend_enabled (override_entry->pipeline,
+                                      COGL_PIPELINE_BLEND_ENABLE_ENABLED);
+
+  g_hash_table_insert (journal->override_pipelines,
+                       &override_entry->key,
+                       override_entry);
+
+  return override_entry->pipeline;
+}
+
 CoglJournal *
 _cogl_journal_new (void)
 {
@@ -150,6 +330,9 @@ _cogl_journal_new (void)
   journal->entries = g_array_new (FALSE, FALSE, sizeof (CoglJournalEntry));
   journal->vertices = g_array_new (FALSE, FALSE, sizeof (float));
 
+  _cogl_debug_register_type_stats ("CoglJournalArena", &journal_arena_stats);
+  _cogl_arena_init (&journal->arena, &journal_arena_stats);
+
   return _cogl_journal_object_new (journal);
 }
 
@@ -229,12 +412,92 @@ _cogl_journal_dump_quad_batch (guint8 *data, int n_layers, int n_quads)
     _cogl_journal_dump_quad_vertices (data + byte_stride * 2 * i, n_layers);
 }
 
+/* Returns the number of vertices that the entry will take up in the
+ * vbo */
+static int
+get_entry_n_vb_vertices (const CoglJournalEntry *entry)
+{
+  if (entry->n_vertices)
+    return ((entry->n_vertices + COGL_JOURNAL_PRIMITIVE_VB_ALIGNMENT - 1) /
+            COGL_JOURNAL_PRIMITIVE_VB_ALIGNMENT *
+            COGL_JOURNAL_PRIMITIVE_VB_ALIGNMENT);
+  else
+    return 4;
+}
+
+static int
+get_batch_n_vb_vertices (const CoglJournalEntry *batch_start,
+                         int batch_len)
+{
+  int n_vertices = 0;
+  int i;
+
+  for (i = 0; i < batch_len; i++)
+    n_vertices += get_entry_n_vb_vertices (batch_start + i);
+
+  return n_vertices;
+}
+
+static void
+record_batch_break (CoglJournalStats *stats,
+                    CoglJournalBatchBreak reason)
+{
+  COGL_STATIC_COUNTER (journal_clip_break_counter,
+                       "Journal clip breaks",
+                       "The number of batches split by a clip change",
+                       0 /* no application private data */);
+  COGL_STATIC_COUNTER (journal_stride_break_counter,
+                       "Journal stride breaks",
+                       "The number of batches split by a stride change",
+                       0 /* no application private data */);
+  COGL_STATIC_COUNTER (journal_n_layers_break_counter,
+                       "Journal layer count breaks",
+                       "The number of batches split by a change in the "
+                       "number of layers",
+                       0 /* no application private data */);
+  COGL_STATIC_COUNTER (journal_pipeline_break_counter,
+                       "Journal pipeline breaks",
+                       "The number of batches split by a pipeline change",
+                       0 /* no application private data */);
+  COGL_STATIC_COUNTER (journal_modelview_break_counter,
+                       "Journal modelview breaks",
+                       "The number of batches split by a modelview change",
+                       0 /* no application private data */);
+
+  switch (reason)
+    {
+    case COGL_JOURNAL_BATCH_BREAK_NONE:
+      break;
+    case COGL_JOURNAL_BATCH_BREAK_CLIP:
+      stats->n_clip_breaks++;
+      COGL_COUNTER_INC (_cogl_uprof_context, journal_clip_break_counter);
+      break;
+    case COGL_JOURNAL_BATCH_BREAK_STRIDE:
+      stats->n_stride_breaks++;
+      COGL_COUNTER_INC (_cogl_uprof_context, journal_stride_break_counter);
+      break;
+    case COGL_JOURNAL_BATCH_BREAK_N_LAYERS:
+      stats->n_layer_breaks++;
+      COGL_COUNTER_INC (_cogl_uprof_context, journal_n_layers_break_counter);
+      break;
+    case COGL_JOURNAL_BATCH_BREAK_PIPELINE:
+      stats->n_pipeline_breaks++;
+      COGL_COUNTER_INC (_cogl_uprof_context, journal_pipeline_break_counter);
+      break;
+    case COGL_JOURNAL_BATCH_BREAK_MODELVIEW:
+      stats->n_modelview_breaks++;
+      COGL_COUNTER_INC (_cogl_uprof_context, journal_modelview_break_counter);
+      break;
+    }
+}
+
 static void
 batch_and_call (CoglJournalEntry *entries,
                 int n_entries,
                 CoglJournalBatchTest can_batch_callback,
                 CoglJournalBatchCallback batch_callback,
-                void *data)
+                CoglJournalBatchBreak break_reason,
+                CoglJournalFlushState *state)
 {
   int i;
   int batch_len = 1;
@@ -254,14 +517,69 @@ batch_and_call (CoglJournalEntry *entries,
           continue;
         }
 
-      batch_callback (batch_start, batch_len, data);
+      record_batch_break (state->stats, break_reason);
+
+      batch_callback (batch_start, batch_len, state);
 
       batch_start = entry1;
       batch_len = 1;
     }
 
   /* The last batch... */
-  batch_callback (batch_start, batch_len, data);
+  batch_callback (batch_start, batch_len, state);
+}
+
+/* Draws a run of rectangles whose vertices start at first_vertex */
+static void
+draw_rectangles (CoglJournalFlushState *state,
+                 CoglAttribute **attributes,
+                 int first_vertex,
+                 int n_rectangles,
+                 CoglDrawFlags draw_flags)
+{
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+#ifdef HAVE_COGL_GL
+  if (ctx->driver == COGL_DRIVER_GL)
+    {
+      /* XXX: it's rather evil that we sneak in the GL_QUADS enum here... */
+      _cogl_framebuffer_draw_attributes (state->framebuffer,
+                                         state->pipeline,
+                                         GL_QUADS,
+                                         first_vertex, n_rectangles * 4,
+                                         attributes,
+                                         state->attributes->len,
+                                         draw_flags);
+    }
+  else
+#endif /* HAVE_COGL_GL */
+    {
+      if (n_rectangles > 1)
+        {
+          CoglVerticesMode mode = COGL_VERTICES_MODE_TRIANGLES;
+          /* The rectangles always start on a multiple of 4 vertices */
+          int first_index = first_vertex * 6 / 4;
+          _cogl_framebuffer_draw_indexed_attributes (state->framebuffer,
+                                                     state->pipeline,
+                                                     mode,
+                                                     first_index,
+                                                     n_rectangles * 6,
+                                                     state->indices,
+                                                     attributes,
+                                                     state->attributes->len,
+                                                     draw_flags);
+        }
+      else
+        {
+          _cogl_framebuffer_draw_attributes (state->framebuffer,
+                                             state->pipeline,
+                                             COGL_VERTICES_MODE_TRIANGLE_FAN,
+                                             first_vertex, 4,
+                                             attributes,
+                                             state->attributes->len,
+                                             draw_flags);
+        }
+    }
 }
 
 static void
@@ -271,6 +589,9 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
 {
   CoglJournalFlushState *state = data;
   CoglAttribute **attributes;
+  int n_vertices;
+  int first_vertex;
+  int i;
   CoglDrawFlags draw_flags = (COGL_DRAW_SKIP_JOURNAL_FLUSH |
                               COGL_DRAW_SKIP_PIPELINE_VALIDATION |
                               COGL_DRAW_SKIP_FRAMEBUFFER_FLUSH |
@@ -281,6 +602,10 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
                      "flush: modelview+entries",
                      "The time spent flushing modelview + entries",
                      0 /* no application private data */);
+  COGL_STATIC_COUNTER (journal_batch_counter,
+                       "Journal batches",
+                       "The number of draw calls emitted by the journal",
+                       0 /* no application private data */);
 
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
@@ -289,11 +614,17 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
     g_print ("BATCHING:     modelview batch len = %d\n", batch_len);
 
+  state->stats->n_batches++;
+  COGL_COUNTER_INC (_cogl_uprof_context, journal_batch_counter);
+
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SOFTWARE_TRANSFORM)))
     {
       _cogl_matrix_stack_set (state->modelview_stack,
                               &batch_start->model_view);
       _cogl_context_set_current_modelview (ctx, state->modelview_stack);
+      /* The modelview is set behind the back of the framebuffer
+       * state tracking so it needs to be flushed again next time */
+      ctx->current_draw_buffer_changes |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
     }
 
   attributes = (CoglAttribute **)state->attributes->data;
@@ -301,45 +632,43 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
   if (!_cogl_pipeline_get_real_blend_enabled (state->pipeline))
     draw_flags |= COGL_DRAW_COLOR_ATTRIBUTE_IS_OPAQUE;
 
-#ifdef HAVE_COGL_GL
-  if (ctx->driver == COGL_DRIVER_GL)
-    {
-      /* XXX: it's rather evil that we sneak in the GL_QUADS enum here... */
-      _cogl_framebuffer_draw_attributes (state->framebuffer,
-                                         state->pipeline,
-                                         GL_QUADS,
-                                         state->current_vertex, batch_len * 4,
-                                         attributes,
-                                         state->attributes->len,
-                                         draw_flags);
-    }
-  else
-#endif /* HAVE_COGL_GL */
+  n_vertices = get_batch_n_vb_vertices (batch_start, batch_len);
+
+  /* Runs of rectangles and runs of primitives are drawn separately
+     so that the rectangles can still be drawn as quads */
+  first_vertex = state->current_vertex;
+  i = 0;
+  while (i < batch_len)
     {
-      if (batch_len > 1)
+      gboolean is_primitive = batch_start[i].n_vertices != 0;
+      int run_n_vertices = 0;
+      int run_len = 0;
+
+      while (i < batch_len &&
+             (batch_start[i].n_vertices != 0) == is_primitive)
         {
-          CoglVerticesMode mode = COGL_VERTICES_MODE_TRIANGLES;
-          int first_vertex = state->current_vertex * 6 / 4;
-          _cogl_framebuffer_draw_indexed_attributes (state->framebuffer,
-                                                     state->pipeline,
-                                                     mode,
-                                                     first_vertex,
-                                                     batch_len * 6,
-                                                     state->indices,
-                                                     attributes,
-                                                     state->attributes->len,
-                                                     draw_flags);
+          run_n_vertices += get_entry_n_vb_vertices (batch_start + i);
+          run_len++;
+          i++;
         }
-      else
+
+      if (is_primitive)
         {
+          /* The padding between the primitives only adds degenerate
+             triangles so the whole run can be drawn at once */
           _cogl_framebuffer_draw_attributes (state->framebuffer,
                                              state->pipeline,
-                                             COGL_VERTICES_MODE_TRIANGLE_FAN,
-                                             state->current_vertex, 4,
+                                             COGL_VERTICES_MODE_TRIANGLES,
+                                             first_vertex, run_n_vertices,
                                              attributes,
                                              state->attributes->len,
                                              draw_flags);
         }
+      else
+        draw_rectangles (state, attributes, first_vertex, run_len,
+                         draw_flags);
+
+      first_vertex += run_n_vertices;
     }
 
   /* DEBUGGING CODE XXX: This path will cause all rectangles to be
@@ -352,7 +681,6 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
     {
       static CoglPipeline *outline = NULL;
       guint8 color_intensity;
-      int i;
       CoglAttribute *loop_attributes[1];
 
       _COGL_GET_CONTEXT (ctxt, NO_RETVAL);
@@ -378,14 +706,23 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
                                   0xff);
 
       loop_attributes[0] = attributes[0]; /* we just want the position */
+      first_vertex = state->current_vertex;
       for (i = 0; i < batch_len; i++)
-        _cogl_framebuffer_draw_attributes (state->framebuffer,
-                                           outline,
-                                           COGL_VERTICES_MODE_LINE_LOOP,
-                                           4 * i + state->current_vertex, 4,
-                                           loop_attributes,
-                                           1,
-                                           draw_flags);
+        {
+          const CoglJournalEntry *entry = batch_start + i;
+
+          /* The padding of primitives isn't outlined */
+          _cogl_framebuffer_draw_attributes (state->framebuffer,
+                                             outline,
+                                             COGL_VERTICES_MODE_LINE_LOOP,
+                                             first_vertex,
+                                             entry->n_vertices ?
+                                             entry->n_vertices : 4,
+                                             loop_attributes,
+                                             1,
+                                             draw_flags);
+          first_vertex += get_entry_n_vb_vertices (entry);
+        }
 
       /* Go to the next color */
       do
@@ -396,7 +733,7 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
              || (ctxt->journal_rectangles_color & 0x07) == 0x07);
     }
 
-  state->current_vertex += (4 * batch_len);
+  state->current_vertex += n_vertices;
 
   COGL_TIMER_STOP (_cogl_uprof_context, time_flush_modelview_and_entries);
 }
@@ -444,7 +781,8 @@ _cogl_journal_flush_pipeline_and_entries (CoglJournalEntry *batch_start,
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
     g_print ("BATCHING:    pipeline batch len = %d\n", batch_len);
 
-  state->pipeline = batch_start->pipeline;
+  state->pipeline = _cogl_journal_get_entry_pipeline (state->journal,
+                                                      batch_start);
 
   /* If we haven't transformed the quads in software then we need to also break
    * up batches according to changes in the modelview matrix... */
@@ -454,7 +792,8 @@ _cogl_journal_flush_pipeline_and_entries (CoglJournalEntry *batch_start,
                       batch_len,
                       compare_entry_modelviews,
                       _cogl_journal_flush_modelview_and_entries,
-                      data);
+                      COGL_JOURNAL_BATCH_BREAK_MODELVIEW,
+                      state);
     }
   else
     _cogl_journal_flush_modelview_and_entries (batch_start, batch_len, data);
@@ -467,6 +806,21 @@ compare_entry_pipelines (CoglJournalEntry *entry0, CoglJournalEntry *entry1)
 {
   /* batch rectangles using compatible pipelines */
 
+  if (entry0->disable_layers != entry1->disable_layers ||
+      entry0->layer0_override_texture != entry1->layer0_override_texture ||
+      entry0->enable_blend != entry1->enable_blend)
+    return FALSE;
+
+  if (entry0->pipeline == entry1->pipeline)
+    return TRUE;
+
+  /* The batch hashes are memoized with each pipeline so this lets us
+   * quickly rule out most pipelines that are different without doing
+   * a full comparison */
+  if (_cogl_pipeline_get_batch_hash (entry0->pipeline) !=
+      _cogl_pipeline_get_batch_hash (entry1->pipeline))
+    return FALSE;
+
   if (_cogl_pipeline_equal (entry0->pipeline,
                             entry1->pipeline,
                             (COGL_PIPELINE_STATE_ALL &
@@ -555,7 +909,8 @@ _cogl_journal_flush_texcoord_vbo_offsets_and_entries (
                   batch_len,
                   compare_entry_pipelines,
                   _cogl_journal_flush_pipeline_and_entries,
-                  data);
+                  COGL_JOURNAL_BATCH_BREAK_PIPELINE,
+                  state);
   COGL_TIMER_STOP (_cogl_uprof_context, time_flush_texcoord_pipeline_entries);
 }
 
@@ -606,6 +961,16 @@ _cogl_journal_flush_vbo_offsets_and_entries (CoglJournalEntry *batch_start,
   stride *= sizeof (float);
   state->stride = stride;
 
+  /* Skip the padding that was added when the vertices were uploaded
+     so that the offsets below are a whole number of vertices into the
+     buffer. The attributes then only differ from those of the other
+     batches with this stride by a number of vertices so the same
+     vertex array object is used and the start of the batch is passed
+     on as the first vertex of the draw */
+  state->array_offset =
+    align_vb_offset (state->array_offset / sizeof (float),
+                     batch_start->n_layers) * sizeof (float);
+
   for (i = 0; i < state->attributes->len; i++)
     cogl_object_unref (g_array_index (state->attributes, CoglAttribute *, i));
 
@@ -628,8 +993,14 @@ _cogl_journal_flush_vbo_offsets_and_entries (CoglJournalEntry *batch_start,
                         4,
                         COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE);
 
+  /* The primitives also take up space in the vertex array so the
+     indices are sized by the number of vertices rather than the
+     number of entries */
   if (ctx->driver != COGL_DRIVER_GL)
-    state->indices = cogl_get_rectangle_indices (ctx, batch_len);
+    state->indices =
+      cogl_get_rectangle_indices (ctx,
+                                  get_batch_n_vb_vertices (batch_start,
+                                                           batch_len) / 4);
 
   /* We only create new Attributes when the stride within the
    * AttributeBuffer changes. (due to a change in the number of pipeline
@@ -639,7 +1010,9 @@ _cogl_journal_flush_vbo_offsets_and_entries (CoglJournalEntry *batch_start,
    */
   state->current_vertex = 0;
 
-  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_JOURNAL)))
+  /* XXX: the dump code only understands batches of quads */
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_JOURNAL)) &&
+      state->journal->n_primitive_entries == 0)
     {
       guint8 *verts;
 
@@ -661,10 +1034,12 @@ _cogl_journal_flush_vbo_offsets_and_entries (CoglJournalEntry *batch_start,
                   batch_len,
                   compare_entry_n_layers,
                   _cogl_journal_flush_texcoord_vbo_offsets_and_entries,
-                  data);
+                  COGL_JOURNAL_BATCH_BREAK_N_LAYERS,
+                  state);
 
   /* progress forward through the VBO containing all our vertices */
-  state->array_offset += (stride * 4 * batch_len);
+  state->array_offset += (stride *
+                          get_batch_n_vb_vertices (batch_start, batch_len));
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_JOURNAL)))
     g_print ("new vbo offset = %lu\n", (unsigned long)state->array_offset);
 
@@ -695,6 +1070,7 @@ _cogl_journal_flush_clip_stacks_and_entries (CoglJournalEntry *batch_start,
                                              void             *data)
 {
   CoglJournalFlushState *state = data;
+  gint64 start_time;
 
   COGL_STATIC_TIMER (time_flush_clip_stack_pipeline_entries,
                      "Journal Flush", /* parent */
@@ -711,6 +1087,8 @@ _cogl_journal_flush_clip_stacks_and_entries (CoglJournalEntry *batch_start,
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
     g_print ("BATCHING:  clip stack batch len = %d\n", batch_len);
 
+  start_time = g_get_monotonic_time ();
+
   _cogl_clip_stack_flush (batch_start->clip_stack, state->framebuffer);
 
   /* XXX: Because we are manually flushing clip state here we need to
@@ -729,6 +1107,11 @@ _cogl_journal_flush_clip_stacks_and_entries (CoglJournalEntry *batch_start,
     {
       _cogl_matrix_stack_load_identity (state->modelview_stack);
       _cogl_context_set_current_modelview (ctx, state->modelview_stack);
+      /* XXX: As with the clip state, the modelview is set manually so
+       * we need to make sure it gets flushed again next time. The
+       * framebuffer that last flushed the modelview state might not
+       * be this one */
+      ctx->current_draw_buffer_changes |= COGL_FRAMEBUFFER_STATE_MODELVIEW;
     }
 
   /* Setting up the clip state can sometimes also flush the projection
@@ -736,11 +1119,18 @@ _cogl_journal_flush_clip_stacks_and_entries (CoglJournalEntry *batch_start,
      clip code didn't modify the projection */
   _cogl_context_set_current_projection (ctx, state->projection_stack);
 
+  state->stats->state_flush_time += g_get_monotonic_time () - start_time;
+
+  start_time = g_get_monotonic_time ();
+
   batch_and_call (batch_start,
                   batch_len,
                   compare_entry_strides,
                   _cogl_journal_flush_vbo_offsets_and_entries, /* callback */
-                  data);
+                  COGL_JOURNAL_BATCH_BREAK_STRIDE,
+                  state);
+
+  state->stats->draw_time += g_get_monotonic_time () - start_time;
 
   _cogl_matrix_stack_pop (state->modelview_stack);
 
@@ -839,15 +1229,40 @@ typedef struct
   float x_2, y_2;
 } ClipBounds;
 
+static gboolean
+can_software_clip_pipeline (CoglPipeline *pipeline)
+{
+  int layer_num;
+
+  /* If the pipeline has a user program then we can't reliably modify
+     the texture coordinates */
+  if (cogl_pipeline_get_user_program (pipeline))
+    return FALSE;
+
+  /* If any of the pipeline layers have a texture matrix then we can't
+     reliably modify the texture coordinates */
+  for (layer_num = cogl_pipeline_get_n_layers (pipeline) - 1;
+       layer_num >= 0;
+       layer_num--)
+    if (_cogl_pipeline_layer_has_user_matrix (pipeline, layer_num))
+      return FALSE;
+
+  return TRUE;
+}
+
+/* If entry_flags is not NULL then the result of
+ * can_software_clip_pipeline() is taken from the flags instead of
+ * being calculated. The pipeline functions may update caches in the
+ * pipeline so this is needed when running on multiple threads. */
 static gboolean
 can_software_clip_entry (CoglJournalEntry *journal_entry,
                          CoglJournalEntry *prev_journal_entry,
                          CoglClipStack *clip_stack,
+                         const guint8 *entry_flags,
                          ClipBounds *clip_bounds_out)
 {
   CoglPipeline *pipeline = journal_entry->pipeline;
   CoglClipStack *clip_entry;
-  int layer_num;
 
   clip_bounds_out->x_1 = -G_MAXFLOAT;
   clip_bounds_out->y_1 = -G_MAXFLOAT;
@@ -856,20 +1271,16 @@ can_software_clip_entry (CoglJournalEntry *journal_entry,
 
   /* Check the pipeline is usable. We can short-cut here for
      entries using the same pipeline as the previous entry */
-  if (prev_journal_entry == NULL || pipeline != prev_journal_entry->pipeline)
+  if (entry_flags)
     {
-      /* If the pipeline has a user program then we can't reliably modify
-         the texture coordinates */
-      if (cogl_pipeline_get_user_program (pipeline))
+      if (!(*entry_flags & COGL_JOURNAL_ENTRY_FLAG_PIPELINE_CLIPPABLE))
+        return FALSE;
+    }
+  else if (prev_journal_entry == NULL ||
+           pipeline != prev_journal_entry->pipeline)
+    {
+      if (!can_software_clip_pipeline (pipeline))
         return FALSE;
-
-      /* If any of the pipeline layers have a texture matrix then we can't
-         reliably modify the texture coordinates */
-      for (layer_num = cogl_pipeline_get_n_layers (pipeline) - 1;
-           layer_num >= 0;
-           layer_num--)
-        if (_cogl_pipeline_layer_has_user_matrix (pipeline, layer_num))
-          return FALSE;
     }
 
   /* Now we need to verify that each clip entry's matrix is just a
@@ -934,10 +1345,6 @@ software_clip_entry (CoglJournalEntry *journal_entry,
   float vx1, vy1, vx2, vy2;
   int layer_num;
 
-  /* Remove the clip on the entry */
-  _cogl_clip_stack_unref (journal_entry->clip_stack);
-  journal_entry->clip_stack = NULL;
-
   vx1 = verts[0];
   vy1 = verts[1];
   vx2 = verts[stride];
@@ -1015,17 +1422,20 @@ software_clip_entry (CoglJournalEntry *journal_entry,
     }
 }
 
-static void
-maybe_software_clip_entries (CoglJournalEntry      *batch_start,
-                             int                    batch_len,
-                             CoglJournalFlushState *state)
+/* Checks whether all of the entries in a batch sharing the same clip
+ * stack can be clipped in software. If so the bounds of the clip for
+ * each entry are written to clip_bounds which must have room for
+ * COGL_JOURNAL_HARDWARE_CLIP_THRESHOLD entries. entry_flags can be
+ * NULL or the flags for the first entry in the batch. */
+static gboolean
+can_software_clip_batch (CoglJournalEntry *batch_start,
+                         int batch_len,
+                         const guint8 *entry_flags,
+                         ClipBounds *clip_bounds)
 {
-  CoglJournal *journal = state->journal;
   CoglClipStack *clip_stack, *clip_entry;
   int entry_num;
 
-  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
-
   /* This tries to find cases where the entry is logged with a clip
      but it would be faster to modify the vertex and texture
      coordinates rather than flush the clip so that it can batch
@@ -1034,42 +1444,56 @@ maybe_software_clip_entries (CoglJournalEntry      *batch_start,
   /* If the batch is reasonably long then it's worthwhile programming
      the GPU to do the clip */
   if (batch_len >= COGL_JOURNAL_HARDWARE_CLIP_THRESHOLD)
-    return;
+    return FALSE;
 
   clip_stack = batch_start->clip_stack;
 
   if (clip_stack == NULL)
-    return;
+    return FALSE;
 
   /* Verify that all of the clip stack entries are a simple rectangle
      clip */
   for (clip_entry = clip_stack; clip_entry; clip_entry = clip_entry->parent)
     if (clip_entry->type != COGL_CLIP_STACK_RECT)
-      return;
+      return FALSE;
 
-  /* This scratch buffer is used to store the translation for each
-     entry in the journal. We store it in a separate buffer because
-     it's expensive to calculate but at this point we still don't know
+  /* The bounds are stored in a separate buffer because they are
+     expensive to calculate but at this point we still don't know
      whether we can clip all of the entries so we don't want to do the
      rest of the dependant calculations until we're sure we can. */
-  if (ctx->journal_clip_bounds == NULL)
-    ctx->journal_clip_bounds = g_array_new (FALSE, FALSE, sizeof (ClipBounds));
-  g_array_set_size (ctx->journal_clip_bounds, batch_len);
-
   for (entry_num = 0; entry_num < batch_len; entry_num++)
     {
       CoglJournalEntry *journal_entry = batch_start + entry_num;
       CoglJournalEntry *prev_journal_entry =
         entry_num ? batch_start + (entry_num - 1) : NULL;
-      ClipBounds *clip_bounds = &g_array_index (ctx->journal_clip_bounds,
-                                                ClipBounds, entry_num);
+
+      /* Only rectangles can be clipped in software */
+      if (journal_entry->n_vertices)
+        return FALSE;
 
       if (!can_software_clip_entry (journal_entry, prev_journal_entry,
                                     clip_stack,
-                                    clip_bounds))
-        return;
+                                    entry_flags ?
+                                    entry_flags + entry_num : NULL,
+                                    clip_bounds + entry_num))
+        return FALSE;
     }
 
+  return TRUE;
+}
+
+static void
+maybe_software_clip_entries (CoglJournalEntry      *batch_start,
+                             int                    batch_len,
+                             CoglJournalFlushState *state)
+{
+  CoglJournal *journal = state->journal;
+  ClipBounds clip_bounds[COGL_JOURNAL_HARDWARE_CLIP_THRESHOLD];
+  int entry_num;
+
+  if (!can_software_clip_batch (batch_start, batch_len, NULL, clip_bounds))
+    return;
+
   /* If we make it here then we know we can software clip the entire batch */
 
   COGL_NOTE (CLIPPING, "Software clipping a batch of length %i", batch_len);
@@ -1079,10 +1503,12 @@ maybe_software_clip_entries (CoglJournalEntry      *batch_start,
       CoglJournalEntry *journal_entry = batch_start + entry_num;
       float *verts = &g_array_index (journal->vertices, float,
                                      journal_entry->array_offset + 1);
-      ClipBounds *clip_bounds = &g_array_index (ctx->journal_clip_bounds,
-                                                ClipBounds, entry_num);
 
-      software_clip_entry (journal_entry, verts, clip_bounds);
+      software_clip_entry (journal_entry, verts, clip_bounds + entry_num);
+
+      /* Remove the clip on the entry */
+      _cogl_clip_stack_unref (journal_entry->clip_stack);
+      journal_entry->clip_stack = NULL;
     }
 
   return;
@@ -1155,104 +1581,439 @@ create_attribute_buffer (CoglJournal *journal,
   return cogl_object_ref (vbo);
 }
 
-static CoglAttributeBuffer *
-upload_vertices (CoglJournal            *journal,
-                 const CoglJournalEntry *entries,
-                 int                     n_entries,
-                 size_t                  needed_vbo_len,
-                 GArray                 *vertices)
+static float *
+upload_primitive_vertices (const CoglJournalEntry *entry,
+                           const float *vin,
+                           float *vout)
 {
-  CoglAttributeBuffer *attribute_buffer;
-  CoglBuffer *buffer;
-  const float *vin;
-  float *vout;
-  int entry_num;
+  size_t vb_stride = GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (entry->n_layers);
+  size_t array_stride =
+    GET_JOURNAL_PRIMITIVE_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+  int n_vb_vertices = get_entry_n_vb_vertices (entry);
   int i;
 
-  g_assert (needed_vbo_len);
-
-  attribute_buffer = create_attribute_buffer (journal, needed_vbo_len * 4);
-  buffer = COGL_BUFFER (attribute_buffer);
-  cogl_buffer_set_update_hint (buffer, COGL_BUFFER_UPDATE_HINT_STATIC);
+  /* Primitives are only logged when transforming in software so the
+     position always has 3 components */
+  cogl_matrix_transform_points (&entry->model_view,
+                                3, /* n_components */
+                                array_stride * sizeof (float), /* stride_in */
+                                vin + 1, /* points_in */
+                                vb_stride * sizeof (float), /* stride_out */
+                                vout, /* points_out */
+                                entry->n_vertices /* n_points */);
+
+  for (i = 0; i < entry->n_vertices; i++)
+    {
+      memcpy (vout + POS_STRIDE, vin, 4);
+      memcpy (vout + POS_STRIDE + COLOR_STRIDE,
+              vin + 4,
+              sizeof (float) * 2 * entry->n_layers);
 
-  vout = _cogl_buffer_map_for_fill_or_fallback (buffer);
-  vin = &g_array_index (vertices, float, 0);
+      vin += array_stride;
+      vout += vb_stride;
+    }
 
-  /* Expand the number of vertices from 2 to 4 while uploading */
-  for (entry_num = 0; entry_num < n_entries; entry_num++)
+  /* Pad with copies of the last vertex so that the padding only adds
+     degenerate triangles */
+  for (; i < n_vb_vertices; i++)
     {
-      const CoglJournalEntry *entry = entries + entry_num;
-      size_t vb_stride = GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (entry->n_layers);
-      size_t array_stride =
-        GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+      memcpy (vout, vout - vb_stride, vb_stride * sizeof (float));
+      vout += vb_stride;
+    }
 
-      /* Copy the color to all four of the vertices */
-      for (i = 0; i < 4; i++)
-        memcpy (vout + vb_stride * i + POS_STRIDE, vin, 4);
-      vin++;
+  return vout;
+}
 
-      if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SOFTWARE_TRANSFORM)))
-        {
-          vout[vb_stride * 0] = vin[0];
-          vout[vb_stride * 0 + 1] = vin[1];
-          vout[vb_stride * 1] = vin[0];
-          vout[vb_stride * 1 + 1] = vin[array_stride + 1];
-          vout[vb_stride * 2] = vin[array_stride];
-          vout[vb_stride * 2 + 1] = vin[array_stride + 1];
-          vout[vb_stride * 3] = vin[array_stride];
-          vout[vb_stride * 3 + 1] = vin[1];
-        }
-      else
-        {
-          float v[8];
-
-          v[0] = vin[0];
-          v[1] = vin[1];
-          v[2] = vin[0];
-          v[3] = vin[array_stride + 1];
-          v[4] = vin[array_stride];
-          v[5] = vin[array_stride + 1];
-          v[6] = vin[array_stride];
-          v[7] = vin[1];
-
-          cogl_matrix_transform_points (&entry->model_view,
-                                        2, /* n_components */
-                                        sizeof (float) * 2, /* stride_in */
-                                        v, /* points_in */
-                                        /* strideout */
-                                        vb_stride * sizeof (float),
-                                        vout, /* points_out */
-                                        4 /* n_points */);
-        }
+/* Expands the vertices of a single entry into the vertex buffer and
+ * returns a pointer to where the vertices of the next entry should be
+ * written */
+static float *
+upload_entry_vertices (const CoglJournalEntry *entry,
+                       GArray *vertices,
+                       float *vout)
+{
+  size_t vb_stride = GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (entry->n_layers);
+  size_t array_stride =
+    GET_JOURNAL_ARRAY_STRIDE_FOR_N_LAYERS (entry->n_layers);
+  const float *vin = &g_array_index (vertices, float, entry->array_offset);
+  int i;
 
-      for (i = 0; i < entry->n_layers; i++)
-        {
-          const float *tin = vin + 2;
-          float *tout = vout + POS_STRIDE + COLOR_STRIDE;
-
-          tout[vb_stride * 0 + i * 2] = tin[i * 2];
-          tout[vb_stride * 0 + 1 + i * 2] = tin[i * 2 + 1];
-          tout[vb_stride * 1 + i * 2] = tin[i * 2];
-          tout[vb_stride * 1 + 1 + i * 2] = tin[array_stride + i * 2 + 1];
-          tout[vb_stride * 2 + i * 2] = tin[array_stride + i * 2];
-          tout[vb_stride * 2 + 1 + i * 2] = tin[array_stride + i * 2 + 1];
-          tout[vb_stride * 3 + i * 2] = tin[array_stride + i * 2];
-          tout[vb_stride * 3 + 1 + i * 2] = tin[i * 2 + 1];
-        }
+  if (entry->n_vertices)
+    return upload_primitive_vertices (entry, vin, vout);
+
+  /* Expand the number of vertices from 2 to 4 while uploading */
 
-      vin += array_stride * 2;
-      vout += vb_stride * 4;
+  /* Copy the color to all four of the vertices */
+  for (i = 0; i < 4; i++)
+    memcpy (vout + vb_stride * i + POS_STRIDE, vin, 4);
+  vin++;
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SOFTWARE_TRANSFORM)))
+    {
+      vout[vb_stride * 0] = vin[0];
+      vout[vb_stride * 0 + 1] = vin[1];
+      vout[vb_stride * 1] = vin[0];
+      vout[vb_stride * 1 + 1] = vin[array_stride + 1];
+      vout[vb_stride * 2] = vin[array_stride];
+      vout[vb_stride * 2 + 1] = vin[array_stride + 1];
+      vout[vb_stride * 3] = vin[array_stride];
+      vout[vb_stride * 3 + 1] = vin[1];
+    }
+  else
+    {
+      float v[8];
+
+      v[0] = vin[0];
+      v[1] = vin[1];
+      v[2] = vin[0];
+      v[3] = vin[array_stride + 1];
+      v[4] = vin[array_stride];
+      v[5] = vin[array_stride + 1];
+      v[6] = vin[array_stride];
+      v[7] = vin[1];
+
+      cogl_matrix_transform_points (&entry->model_view,
+                                    2, /* n_components */
+                                    sizeof (float) * 2, /* stride_in */
+                                    v, /* points_in */
+                                    /* strideout */
+                                    vb_stride * sizeof (float),
+                                    vout, /* points_out */
+                                    4 /* n_points */);
     }
 
-  _cogl_buffer_unmap_for_fill_or_fallback (buffer);
+  for (i = 0; i < entry->n_layers; i++)
+    {
+      const float *tin = vin + 2;
+      float *tout = vout + POS_STRIDE + COLOR_STRIDE;
+
+      tout[vb_stride * 0 + i * 2] = tin[i * 2];
+      tout[vb_stride * 0 + 1 + i * 2] = tin[i * 2 + 1];
+      tout[vb_stride * 1 + i * 2] = tin[i * 2];
+      tout[vb_stride * 1 + 1 + i * 2] = tin[array_stride + i * 2 + 1];
+      tout[vb_stride * 2 + i * 2] = tin[array_stride + i * 2];
+      tout[vb_stride * 2 + 1 + i * 2] = tin[array_stride + i * 2 + 1];
+      tout[vb_stride * 3 + i * 2] = tin[array_stride + i * 2];
+      tout[vb_stride * 3 + 1 + i * 2] = tin[i * 2 + 1];
+    }
 
-  return attribute_buffer;
+  return vout + vb_stride * 4;
 }
 
-void
-_cogl_journal_discard (CoglJournal *journal)
+static CoglAttributeBuffer *
+map_vertex_buffer (CoglJournal *journal,
+                   size_t needed_vbo_len,
+                   float **vout)
 {
-  int i;
+  CoglAttributeBuffer *attribute_buffer;
+  CoglBuffer *buffer;
+
+  g_assert (needed_vbo_len);
+
+  attribute_buffer = create_attribute_buffer (journal, needed_vbo_len * 4);
+  buffer = COGL_BUFFER (attribute_buffer);
+  cogl_buffer_set_update_hint (buffer, COGL_BUFFER_UPDATE_HINT_STATIC);
+
+  *vout = _cogl_buffer_map_for_fill_or_fallback (buffer);
+
+  return attribute_buffer;
+}
+
+static CoglAttributeBuffer *
+upload_vertices (CoglJournal            *journal,
+                 const CoglJournalEntry *entries,
+                 int                     n_entries,
+                 size_t                  needed_vbo_len,
+                 GArray                 *vertices)
+{
+  CoglAttributeBuffer *attribute_buffer;
+  float *vbo_start, *vout;
+  int entry_num;
+
+  attribute_buffer = map_vertex_buffer (journal, needed_vbo_len, &vbo_start);
+
+  for (entry_num = 0, vout = vbo_start; entry_num < n_entries; entry_num++)
+    {
+      vout = vbo_start + align_vb_offset (vout - vbo_start,
+                                          entries[entry_num].n_layers);
+      vout = upload_entry_vertices (entries + entry_num, vertices, vout);
+    }
+
+  _cogl_buffer_unmap_for_fill_or_fallback (COGL_BUFFER (attribute_buffer));
+
+  return attribute_buffer;
+}
+
+/* A range of journal entries prepared by one thread */
+typedef struct
+{
+  CoglJournalEntry *entries;
+  int n_entries;
+  int first_entry;
+  int last_entry;
+
+  guint8 *entry_flags;
+  GArray *vertices;
+  gboolean software_clip;
+
+  /* The start of the mapped vertex buffer and where the vertices of
+     first_entry are written before they are aligned */
+  float *vbo_start;
+  float *vout;
+
+  GAsyncQueue *done_queue;
+} CoglJournalPrepareChunk;
+
+static void
+software_clip_chunk (CoglJournalPrepareChunk *chunk)
+{
+  CoglJournalEntry *entries = chunk->entries;
+  ClipBounds clip_bounds[COGL_JOURNAL_HARDWARE_CLIP_THRESHOLD];
+  int entry_num = chunk->first_entry;
+  int i;
+
+  while (entry_num < chunk->last_entry)
+    {
+      CoglClipStack *clip_stack = entries[entry_num].clip_stack;
+      int batch_first = entry_num;
+      int batch_last = entry_num + 1;
+
+      /* The decision whether to clip in software is made for a whole
+         batch of entries sharing a clip stack so a batch that
+         straddles the edges of the chunk is examined in full. Only
+         the first batch can start before the chunk. Batches that
+         reach the threshold are never clipped so there is no point
+         in looking any further than that. The clip stacks aren't
+         modified until all of the threads are done so this is the
+         same decision that the other threads make. */
+      if (entry_num == chunk->first_entry)
+        while (batch_first > 0 &&
+               batch_last - batch_first < COGL_JOURNAL_HARDWARE_CLIP_THRESHOLD &&
+               entries[batch_first - 1].clip_stack == clip_stack)
+          batch_first--;
+      while (batch_last < chunk->n_entries &&
+             batch_last - batch_first < COGL_JOURNAL_HARDWARE_CLIP_THRESHOLD &&
+             entries[batch_last].clip_stack == clip_stack)
+        batch_last++;
+
+      if (!can_software_clip_batch (entries + batch_first,
+                                    batch_last - batch_first,
+                                    chunk->entry_flags + batch_first,
+                                    clip_bounds))
+        {
+          /* Skip the rest of the batch */
+          while (entry_num < chunk->last_entry &&
+                 entries[entry_num].clip_stack == clip_stack)
+            entry_num++;
+          continue;
+        }
+
+      for (i = MAX (batch_first, chunk->first_entry);
+           i < MIN (batch_last, chunk->last_entry);
+           i++)
+        {
+          float *verts = &g_array_index (chunk->vertices, float,
+                                         entries[i].array_offset + 1);
+
+          software_clip_entry (entries + i, verts,
+                               clip_bounds + (i - batch_first));
+          chunk->entry_flags[i] |= COGL_JOURNAL_ENTRY_FLAG_SOFTWARE_CLIPPED;
+        }
+
+      entry_num = MIN (batch_last, chunk->last_entry);
+    }
+}
+
+static void
+prepare_chunk (CoglJournalPrepareChunk *chunk)
+{
+  float *vout = chunk->vout;
+  int entry_num;
+
+  if (chunk->software_clip)
+    software_clip_chunk (chunk);
+
+  for (entry_num = chunk->first_entry;
+       entry_num < chunk->last_entry;
+       entry_num++)
+    {
+      vout = (chunk->vbo_start +
+              align_vb_offset (vout - chunk->vbo_start,
+                               chunk->entries[entry_num].n_layers));
+      vout = upload_entry_vertices (chunk->entries + entry_num,
+                                    chunk->vertices,
+                                    vout);
+    }
+}
+
+static void
+prepare_chunk_thread_cb (void *data, void *user_data)
+{
+  CoglJournalPrepareChunk *chunk = data;
+
+  prepare_chunk (chunk);
+
+  g_async_queue_push (chunk->done_queue, chunk);
+}
+
+static gboolean
+ensure_journal_thread_pool (CoglContext *ctx)
+{
+  GError *error = NULL;
+
+  if (ctx->journal_thread_pool)
+    return TRUE;
+
+#if !GLIB_CHECK_VERSION (2, 31, 0)
+  /* Older versions of GLib need the application to initialize the
+     thread system */
+  if (!g_thread_supported ())
+    {
+      ctx->n_journal_threads = 0;
+      return FALSE;
+    }
+#endif
+
+  ctx->journal_thread_pool = g_thread_pool_new (prepare_chunk_thread_cb,
+                                                NULL, /* user_data */
+                                                ctx->n_journal_threads,
+                                                FALSE, /* not exclusive */
+                                                &error);
+  if (ctx->journal_thread_pool == NULL)
+    {
+      g_warning ("Failed to create the journal thread pool: %s",
+                 error->message);
+      g_error_free (error);
+      ctx->n_journal_threads = 0;
+      return FALSE;
+    }
+
+  ctx->journal_thread_done_queue = g_async_queue_new ();
+
+  return TRUE;
+}
+
+/* This does the same work as the software clipping pass followed by
+ * upload_vertices() except that the journal is split into chunks
+ * which are prepared in parallel by the thread pool and the calling
+ * thread. Each chunk writes its vertices directly into the mapped
+ * vertex buffer at an offset that is calculated up front. Everything
+ * that touches GL or reference counts stays on the calling thread. */
+static CoglAttributeBuffer *
+prepare_journal_threaded (CoglJournal *journal,
+                          size_t needed_vbo_len,
+                          gboolean software_clip)
+{
+  CoglAttributeBuffer *attribute_buffer;
+  CoglJournalEntry *entries =
+    &g_array_index (journal->entries, CoglJournalEntry, 0);
+  int n_entries = journal->entries->len;
+  CoglJournalPrepareChunk *chunks;
+  int n_chunks, chunk_size;
+  guint8 *entry_flags;
+  float *vbo_start, *vout;
+  int i, chunk_num;
+
+  _COGL_GET_CONTEXT (ctx, NULL);
+
+  if (ctx->journal_entry_flags == NULL)
+    ctx->journal_entry_flags = g_array_new (FALSE, FALSE, sizeof (guint8));
+  g_array_set_size (ctx->journal_entry_flags, n_entries);
+  entry_flags = (guint8 *) ctx->journal_entry_flags->data;
+
+  /* Checking the pipelines may update caches within the pipeline so
+     it is done here before the threads are started */
+  if (software_clip)
+    {
+      CoglPipeline *prev_pipeline = NULL;
+      gboolean clippable = FALSE;
+
+      for (i = 0; i < n_entries; i++)
+        {
+          entry_flags[i] = 0;
+
+          if (entries[i].clip_stack == NULL)
+            continue;
+
+          if (entries[i].pipeline != prev_pipeline)
+            {
+              prev_pipeline = entries[i].pipeline;
+              clippable = can_software_clip_pipeline (prev_pipeline);
+            }
+
+          if (clippable)
+            entry_flags[i] = COGL_JOURNAL_ENTRY_FLAG_PIPELINE_CLIPPABLE;
+        }
+    }
+  else
+    memset (entry_flags, 0, n_entries);
+
+  attribute_buffer = map_vertex_buffer (journal, needed_vbo_len, &vbo_start);
+  vout = vbo_start;
+
+  /* The calling thread prepares a chunk too */
+  n_chunks = ctx->n_journal_threads + 1;
+  chunk_size = (n_entries + n_chunks - 1) / n_chunks;
+  chunks = g_alloca (sizeof (CoglJournalPrepareChunk) * n_chunks);
+
+  for (chunk_num = 0, i = 0; chunk_num < n_chunks; chunk_num++)
+    {
+      CoglJournalPrepareChunk *chunk = chunks + chunk_num;
+
+      chunk->entries = entries;
+      chunk->n_entries = n_entries;
+      chunk->first_entry = i;
+      chunk->last_entry = MIN (i + chunk_size, n_entries);
+      chunk->entry_flags = entry_flags;
+      chunk->vertices = journal->vertices;
+      chunk->software_clip = software_clip;
+      chunk->vbo_start = vbo_start;
+      chunk->vout = vout;
+      chunk->done_queue = ctx->journal_thread_done_queue;
+
+      /* Work out where the next chunk starts writing */
+      for (; i < chunk->last_entry; i++)
+        vout = (vbo_start +
+                align_vb_offset (vout - vbo_start, entries[i].n_layers) +
+                GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (entries[i].n_layers) *
+                get_entry_n_vb_vertices (entries + i));
+    }
+
+  for (chunk_num = 1; chunk_num < n_chunks; chunk_num++)
+    g_thread_pool_push (ctx->journal_thread_pool, chunks + chunk_num, NULL);
+
+  prepare_chunk (chunks);
+
+  /* Wait for all of the other threads to finish */
+  for (chunk_num = 1; chunk_num < n_chunks; chunk_num++)
+    g_async_queue_pop (ctx->journal_thread_done_queue);
+
+  _cogl_buffer_unmap_for_fill_or_fallback (COGL_BUFFER (attribute_buffer));
+
+  if (software_clip)
+    {
+      int n_clipped = 0;
+
+      for (i = 0; i < n_entries; i++)
+        if (entry_flags[i] & COGL_JOURNAL_ENTRY_FLAG_SOFTWARE_CLIPPED)
+          {
+            /* Remove the clip on the entry */
+            _cogl_clip_stack_unref (entries[i].clip_stack);
+            entries[i].clip_stack = NULL;
+            n_clipped++;
+          }
+
+      COGL_NOTE (CLIPPING, "Software clipped %i entries on %i threads",
+                 n_clipped, n_chunks);
+    }
+
+  return attribute_buffer;
+}
+
+void
+_cogl_journal_discard (CoglJournal *journal)
+{
+  int i;
 
   for (i = 0; i < journal->entries->len; i++)
     {
@@ -1260,11 +2021,18 @@ _cogl_journal_discard (CoglJournal *journal)
         &g_array_index (journal->entries, CoglJournalEntry, i);
       _cogl_pipeline_journal_unref (entry->pipeline);
       _cogl_clip_stack_unref (entry->clip_stack);
+      if (entry->layer0_override_texture)
+        cogl_object_unref (entry->layer0_override_texture);
     }
 
+  if (journal->override_pipelines)
+    g_hash_table_remove_all (journal->override_pipelines);
+  _cogl_arena_reset (&journal->arena);
+
   g_array_set_size (journal->entries, 0);
   g_array_set_size (journal->vertices, 0);
   journal->needed_vbo_len = 0;
+  journal->n_primitive_entries = 0;
   journal->fast_read_pixel_count = 0;
 
   /* The journal only holds a reference to the framebuffer while the
@@ -1344,6 +2112,30 @@ _cogl_journal_all_entries_within_bounds (CoglJournal *journal,
   return TRUE;
 }
 
+static void
+accumulate_stats (CoglJournalStats *total,
+                  const CoglJournalStats *stats)
+{
+  total->n_flushes += stats->n_flushes;
+  total->n_entries += stats->n_entries;
+  total->n_batches += stats->n_batches;
+  total->n_clip_breaks += stats->n_clip_breaks;
+  total->n_stride_breaks += stats->n_stride_breaks;
+  total->n_layer_breaks += stats->n_layer_breaks;
+  total->n_pipeline_breaks += stats->n_pipeline_breaks;
+  total->n_modelview_breaks += stats->n_modelview_breaks;
+  total->n_bytes_uploaded += stats->n_bytes_uploaded;
+  total->upload_time += stats->upload_time;
+  total->state_flush_time += stats->state_flush_time;
+  total->draw_time += stats->draw_time;
+}
+
+void
+_cogl_journal_reset_stats (CoglJournal *journal)
+{
+  memset (&journal->stats, 0, sizeof (CoglJournalStats));
+}
+
 /* XXX NB: When _cogl_journal_flush() returns all state relating
  * to pipelines, all glEnable flags and current matrix state
  * is undefined.
@@ -1355,11 +2147,21 @@ _cogl_journal_flush (CoglJournal *journal,
   CoglJournalFlushState state;
   int                   i;
   CoglMatrixStack      *modelview_stack;
+  CoglJournalStats     *stats;
+  gint64                start_time;
+  size_t                needed_vbo_len;
+  gboolean              software_clip;
   COGL_STATIC_TIMER (flush_timer,
                      "Mainloop", /* parent */
                      "Journal Flush",
                      "The time spent flushing the Cogl journal",
                      0 /* no application private data */);
+  COGL_STATIC_TIMER (time_upload_vertices,
+                     "Journal Flush", /* parent */
+                     "flush: upload vertices",
+                     "The time spent expanding and uploading the "
+                     "journal's vertices",
+                     0 /* no application private data */);
 
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
@@ -1377,16 +2179,29 @@ _cogl_journal_flush (CoglJournal *journal,
    * this journal... */
   _cogl_framebuffer_flush_dependency_journals (framebuffer);
 
+  /* This is done before starting the timer so that the time spent
+   * writing the capture isn't included */
+  if (_COGL_CAPTURE_ENABLED ())
+    _cogl_capture_journal (journal, framebuffer);
+
   /* Note: we start the timer after flushing dependency journals so
    * that the timer isn't started recursively. */
   COGL_TIMER_START (_cogl_uprof_context, flush_timer);
 
+  stats = &journal->last_flush_stats;
+  memset (stats, 0, sizeof (CoglJournalStats));
+  stats->n_flushes = 1;
+  stats->n_entries = journal->entries->len;
+  state.stats = stats;
+
   state.framebuffer = framebuffer;
   cogl_push_framebuffer (framebuffer);
 
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
     g_print ("BATCHING: journal len = %d\n", journal->entries->len);
 
+  start_time = g_get_monotonic_time ();
+
   /* NB: the journal deals with flushing the modelview stack and clip
      state manually */
   _cogl_framebuffer_flush_state (framebuffer,
@@ -1395,38 +2210,67 @@ _cogl_journal_flush (CoglJournal *journal,
                                  ~(COGL_FRAMEBUFFER_STATE_MODELVIEW |
                                    COGL_FRAMEBUFFER_STATE_CLIP));
 
+  stats->state_flush_time += g_get_monotonic_time () - start_time;
+
   state.journal = journal;
 
   state.attributes = ctx->journal_flush_attributes_array;
 
+  needed_vbo_len = journal->needed_vbo_len;
+
   modelview_stack = _cogl_framebuffer_get_modelview_stack (framebuffer);
   state.modelview_stack = modelview_stack;
   state.projection_stack = _cogl_framebuffer_get_projection_stack (framebuffer);
 
-  if (G_UNLIKELY ((COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SOFTWARE_CLIP)) == 0))
+  software_clip =
+    G_UNLIKELY ((COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SOFTWARE_CLIP)) == 0);
+
+  COGL_TIMER_START (_cogl_uprof_context, time_upload_vertices);
+  start_time = g_get_monotonic_time ();
+
+  if (ctx->n_journal_threads > 0 &&
+      journal->entries->len >= COGL_JOURNAL_THREADED_PREPARE_THRESHOLD &&
+      ensure_journal_thread_pool (ctx))
     {
-      /* We do an initial walk of the journal to analyse the clip stack
-         batches to see if we can do software clipping. We do this as a
-         separate walk of the journal because we can modify entries and
-         this may end up joining together clip stack batches in the next
-         iteration. */
-      batch_and_call ((CoglJournalEntry *)journal->entries->data, /* first entry */
-                      journal->entries->len, /* max number of entries to consider */
-                      compare_entry_clip_stacks,
-                      _cogl_journal_maybe_software_clip_entries, /* callback */
-                      &state); /* data */
+      /* Big journals are software clipped and uploaded on multiple
+         threads */
+      state.attribute_buffer =
+        prepare_journal_threaded (journal,
+                                  needed_vbo_len,
+                                  software_clip);
     }
+  else
+    {
+      if (software_clip)
+        {
+          /* We do an initial walk of the journal to analyse the clip
+             stack batches to see if we can do software clipping. We do
+             this as a separate walk of the journal because we can
+             modify entries and this may end up joining together clip
+             stack batches in the next iteration. */
+          batch_and_call ((CoglJournalEntry *)journal->entries->data, /* first entry */
+                          journal->entries->len, /* max number of entries to consider */
+                          compare_entry_clip_stacks,
+                          _cogl_journal_maybe_software_clip_entries, /* callback */
+                          COGL_JOURNAL_BATCH_BREAK_NONE,
+                          &state); /* data */
+        }
 
-  /* We upload the vertices after the clip stack pass in case it
-     modifies the entries */
-  state.attribute_buffer =
-    upload_vertices (journal,
-                     &g_array_index (journal->entries, CoglJournalEntry, 0),
-                     journal->entries->len,
-                     journal->needed_vbo_len,
-                     journal->vertices);
+      /* We upload the vertices after the clip stack pass in case it
+         modifies the entries */
+      state.attribute_buffer =
+        upload_vertices (journal,
+                         &g_array_index (journal->entries, CoglJournalEntry, 0),
+                         journal->entries->len,
+                         needed_vbo_len,
+                         journal->vertices);
+    }
   state.array_offset = 0;
 
+  stats->upload_time = g_get_monotonic_time () - start_time;
+  stats->n_bytes_uploaded = needed_vbo_len * 4;
+  COGL_TIMER_STOP (_cogl_uprof_context, time_upload_vertices);
+
   /* batch_and_call() batches a list of journal entries according to some
    * given criteria and calls a callback once for each determined batch.
    *
@@ -1454,6 +2298,7 @@ _cogl_journal_flush (CoglJournal *journal,
                   journal->entries->len, /* max number of entries to consider */
                   compare_entry_clip_stacks,
                   _cogl_journal_flush_clip_stacks_and_entries, /* callback */
+                  COGL_JOURNAL_BATCH_BREAK_CLIP,
                   &state); /* data */
 
   for (i = 0; i < state.attributes->len; i++)
@@ -1462,6 +2307,21 @@ _cogl_journal_flush (CoglJournal *journal,
 
   cogl_object_unref (state.attribute_buffer);
 
+  accumulate_stats (&journal->stats, stats);
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
+    g_print ("BATCHING: flush stats: entries = %u, batches = %u, "
+             "breaks (clip = %u, stride = %u, layers = %u, pipeline = %u, "
+             "modelview = %u), uploaded = %lu bytes, upload = %" G_GINT64_FORMAT
+             "us, state = %" G_GINT64_FORMAT "us, draw = %" G_GINT64_FORMAT
+             "us\n",
+             stats->n_entries, stats->n_batches,
+             stats->n_clip_breaks, stats->n_stride_breaks,
+             stats->n_layer_breaks, stats->n_pipeline_breaks,
+             stats->n_modelview_breaks,
+             (unsigned long) stats->n_bytes_uploaded,
+             stats->upload_time, stats->state_flush_time, stats->draw_time);
+
   _cogl_journal_discard (journal);
 
   cogl_pop_framebuffer ();
@@ -1499,20 +2359,22 @@ _cogl_journal_log_quad (CoglJournal  *journal,
   float            *v;
   int               i;
   int               next_entry;
-  guint32           disable_layers;
   CoglJournalEntry *entry;
-  CoglPipeline     *final_pipeline;
   CoglClipStack    *clip_stack;
-  CoglPipelineFlushOptions flush_options;
   COGL_STATIC_TIMER (log_timer,
                      "Mainloop", /* parent */
                      "Journal Log",
                      "The time spent logging in the Cogl journal",
                      0 /* no application private data */);
+  COGL_STATIC_COUNTER (journal_entry_counter,
+                       "Journal entries",
+                       "The number of rectangles logged in the journal",
+                       0 /* no application private data */);
 
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
   COGL_TIMER_START (_cogl_uprof_context, log_timer);
+  COGL_COUNTER_INC (_cogl_uprof_context, journal_entry_counter);
 
   /* If the framebuffer was previously empty then we'll take a
      reference to the current framebuffer. This reference will be
@@ -1538,7 +2400,9 @@ _cogl_journal_log_quad (CoglJournal  *journal,
   /* We calculate the needed size of the vbo as we go because it
      depends on the number of layers in each entry and it's not easy
      calculate based on the length of the logged vertices array */
-  journal->needed_vbo_len += GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (n_layers) * 4;
+  journal->needed_vbo_len =
+    align_vb_offset (journal->needed_vbo_len, n_layers) +
+    GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (n_layers) * 4;
 
   /* XXX: All the jumping around to fill in this strided buffer doesn't
    * seem ideal. */
@@ -1574,37 +2438,29 @@ _cogl_journal_log_quad (CoglJournal  *journal,
 
   entry->n_layers = n_layers;
   entry->array_offset = next_vert;
+  entry->n_vertices = 0;
 
-  final_pipeline = pipeline;
-
-  flush_options.flags = 0;
+  /* The overrides are only recorded here. The derived pipeline is
+   * created when the journal is flushed so that it can be shared by
+   * all of the entries with the same overrides */
   if (G_UNLIKELY (cogl_pipeline_get_n_layers (pipeline) != n_layers))
-    {
-      disable_layers = (1 << n_layers) - 1;
-      disable_layers = ~disable_layers;
-      flush_options.disable_layers = disable_layers;
-      flush_options.flags |= COGL_PIPELINE_FLUSH_DISABLE_MASK;
-    }
+    entry->disable_layers = ~((1 << n_layers) - 1);
+  else
+    entry->disable_layers = 0;
+
   if (G_UNLIKELY (layer0_override_texture))
-    {
-      flush_options.flags |= COGL_PIPELINE_FLUSH_LAYER0_OVERRIDE;
-      flush_options.layer0_override_texture = layer0_override_texture;
-    }
+    entry->layer0_override_texture =
+      cogl_object_ref (layer0_override_texture);
+  else
+    entry->layer0_override_texture = NULL;
 
-  if (G_UNLIKELY (flush_options.flags))
-    {
-      final_pipeline = cogl_pipeline_copy (pipeline);
-      _cogl_pipeline_apply_overrides (final_pipeline, &flush_options);
-    }
+  entry->enable_blend = FALSE;
 
-  entry->pipeline = _cogl_pipeline_journal_ref (final_pipeline);
+  entry->pipeline = _cogl_pipeline_journal_ref (pipeline);
 
   clip_stack = _cogl_framebuffer_get_clip_stack (journal->framebuffer);
   entry->clip_stack = _cogl_clip_stack_ref (clip_stack);
 
-  if (G_UNLIKELY (final_pipeline != pipeline))
-    cogl_handle_unref (final_pipeline);
-
   cogl_get_modelview_matrix (&entry->model_view);
 
   _cogl_pipeline_foreach_layer_internal (pipeline,
@@ -1622,6 +2478,423 @@ _cogl_journal_log_quad (CoglJournal  *journal,
   COGL_TIMER_STOP (_cogl_uprof_context, log_timer);
 }
 
+/* Primitives can only be logged if there is a builtin texture
+ * coordinate attribute name for each layer */
+#define COGL_JOURNAL_PRIMITIVE_MAX_LAYERS 8
+
+static gboolean
+validate_primitive_layer_cb (CoglPipeline *pipeline,
+                             int layer_index,
+                             void *user_data)
+{
+  CoglTexture *texture =
+    cogl_pipeline_get_layer_texture (pipeline, layer_index);
+  gboolean *valid = user_data;
+
+  if (texture == NULL)
+    return TRUE;
+
+  /* This mirrors validate_layer_cb() in cogl-attribute.c. If the
+     texture is in an atlas it will be migrated */
+  _cogl_texture_ensure_non_quad_rendering (texture);
+  _cogl_pipeline_pre_paint_for_layer (pipeline, layer_index);
+
+  /* Sliced textures need to fallback to a default texture when they
+     are used with primitives so we leave that to the normal drawing
+     code */
+  if (!_cogl_texture_can_hardware_repeat (texture))
+    {
+      *valid = FALSE;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static const guint8 *
+get_primitive_attribute_data (CoglAttribute *attribute,
+                              int max_index,
+                              size_t *stride_out)
+{
+  CoglBuffer *buffer = COGL_BUFFER (attribute->attribute_buffer);
+  const guint8 *data = _cogl_buffer_get_client_data (buffer);
+  size_t element_size;
+  size_t stride;
+
+  if (data == NULL)
+    return NULL;
+
+  /* Only float and unsigned byte attributes are accepted */
+  element_size = attribute->n_components *
+    (attribute->type == COGL_ATTRIBUTE_TYPE_FLOAT ? sizeof (float) : 1);
+  stride = attribute->stride ? attribute->stride : element_size;
+
+  if (attribute->offset + stride * max_index + element_size > buffer->size)
+    return NULL;
+
+  *stride_out = stride;
+
+  return data + attribute->offset;
+}
+
+/* Resolves the vertices of the primitive into a list of indices that
+ * form separate triangles. Returns the number of indices */
+static int
+get_primitive_triangles (CoglVerticesMode mode,
+                         int n_vertices,
+                         int *triangles)
+{
+  int n_triangles;
+  int i;
+
+  switch (mode)
+    {
+    case COGL_VERTICES_MODE_TRIANGLES:
+      n_triangles = n_vertices / 3;
+      for (i = 0; i < n_triangles * 3; i++)
+        triangles[i] = i;
+      break;
+
+    case COGL_VERTICES_MODE_TRIANGLE_STRIP:
+      n_triangles = n_vertices - 2;
+      for (i = 0; i < n_triangles; i++)
+        {
+          /* Every other triangle in a strip has its winding order
+             reversed so we need to swap the first two vertices to
+             preserve it */
+          triangles[i * 3] = (i & 1) ? i + 1 : i;
+          triangles[i * 3 + 1] = (i & 1) ? i : i + 1;
+          triangles[i * 3 + 2] = i + 2;
+        }
+      break;
+
+    case COGL_VERTICES_MODE_TRIANGLE_FAN:
+      n_triangles = n_vertices - 2;
+      for (i = 0; i < n_triangles; i++)
+        {
+          triangles[i * 3] = 0;
+          triangles[i * 3 + 1] = i + 1;
+          triangles[i * 3 + 2] = i + 2;
+        }
+      break;
+
+    default:
+      return 0;
+    }
+
+  return n_triangles * 3;
+}
+
+/* Tries to log a small primitive into the journal so that it can be
+ * batched together with rectangles. The primitive must use triangles
+ * and only the builtin position, color and texture coordinate
+ * attributes with the layouts used by the CoglVertexP* types. The
+ * vertex data is read back from client memory, either because the
+ * buffers aren't buffer objects or from their shadow copy. Buffer
+ * objects are never mapped because that would make GL wait for the
+ * GPU. If the primitive can't be logged then FALSE is returned and
+ * the caller should draw it directly instead. */
+gboolean
+_cogl_journal_log_primitive (CoglJournal *journal,
+                             CoglFramebuffer *framebuffer,
+                             CoglPipeline *pipeline,
+                             CoglVerticesMode mode,
+                             int first_vertex,
+                             int n_vertices,
+                             CoglIndices *indices,
+                             CoglAttribute **attributes,
+                             int n_attributes,
+                             CoglDrawFlags flags)
+{
+  CoglAttribute *position_attribute = NULL;
+  CoglAttribute *color_attribute = NULL;
+  CoglAttribute *tex_coord_attributes[COGL_JOURNAL_PRIMITIVE_MAX_LAYERS];
+  const guint8 *tex_coord_data[COGL_JOURNAL_PRIMITIVE_MAX_LAYERS];
+  size_t tex_coord_strides[COGL_JOURNAL_PRIMITIVE_MAX_LAYERS];
+  const guint8 *position_data, *color_data = NULL;
+  size_t position_stride, color_stride = 0;
+  int vertex_indices[COGL_JOURNAL_PRIMITIVE_MAX_VERTICES];
+  int triangles[(COGL_JOURNAL_PRIMITIVE_MAX_VERTICES - 2) * 3];
+  int n_triangle_vertices;
+  int max_index = 0;
+  int n_layers;
+  gboolean valid = TRUE;
+  gboolean needs_blending = FALSE;
+  CoglPipeline *final_pipeline;
+  guint8 pipeline_color[4];
+  size_t array_stride;
+  int next_vert, next_entry;
+  CoglJournalEntry *entry;
+  CoglClipStack *clip_stack;
+  float *v;
+  int i, j;
+  COGL_STATIC_COUNTER (journal_primitive_counter,
+                       "Journal primitives",
+                       "The number of primitives logged in the journal",
+                       0 /* no application private data */);
+
+  _COGL_GET_CONTEXT (ctx, FALSE);
+
+  if (n_vertices < 3 || n_vertices > COGL_JOURNAL_PRIMITIVE_MAX_VERTICES)
+    return FALSE;
+
+  /* The vertices get transformed along with the rectangles when
+     uploading so this can't work if the modelview matrix is flushed
+     to GL instead */
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SOFTWARE_TRANSFORM)))
+    return FALSE;
+
+  if (mode != COGL_VERTICES_MODE_TRIANGLES &&
+      mode != COGL_VERTICES_MODE_TRIANGLE_STRIP &&
+      mode != COGL_VERTICES_MODE_TRIANGLE_FAN)
+    return FALSE;
+
+  n_layers = cogl_pipeline_get_n_layers (pipeline);
+  if (n_layers > COGL_JOURNAL_PRIMITIVE_MAX_LAYERS)
+    return FALSE;
+
+  for (i = 0; i < n_layers; i++)
+    tex_coord_attributes[i] = NULL;
+
+  for (i = 0; i < n_attributes; i++)
+    {
+      CoglAttribute *attribute = attributes[i];
+      int unit;
+
+      switch (attribute->name_state->name_id)
+        {
+        case COGL_ATTRIBUTE_NAME_ID_POSITION_ARRAY:
+          if (attribute->type != COGL_ATTRIBUTE_TYPE_FLOAT ||
+              attribute->n_components < 2 ||
+              attribute->n_components > 3)
+            return FALSE;
+          position_attribute = attribute;
+          break;
+
+        case COGL_ATTRIBUTE_NAME_ID_COLOR_ARRAY:
+          if (attribute->type != COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE ||
+              attribute->n_components != 4 ||
+              !attribute->normalized)
+            return FALSE;
+          color_attribute = attribute;
+          break;
+
+        case COGL_ATTRIBUTE_NAME_ID_TEXTURE_COORD_ARRAY:
+          if (attribute->type != COGL_ATTRIBUTE_TYPE_FLOAT ||
+              attribute->n_components != 2)
+            return FALSE;
+          /* Texture coordinates for units without a layer are
+             unused anyway */
+          unit = attribute->name_state->texture_unit;
+          if (unit < n_layers)
+            tex_coord_attributes[unit] = attribute;
+          break;
+
+        default:
+          /* Normals and custom attributes can't be represented in
+             the journal */
+          return FALSE;
+        }
+    }
+
+  if (position_attribute == NULL)
+    return FALSE;
+
+  if (indices)
+    {
+      CoglBuffer *index_buffer = COGL_BUFFER (indices->buffer);
+      const guint8 *index_data = _cogl_buffer_get_client_data (index_buffer);
+      size_t index_size;
+
+      switch (indices->type)
+        {
+        case COGL_INDICES_TYPE_UNSIGNED_BYTE:
+          index_size = 1;
+          break;
+        case COGL_INDICES_TYPE_UNSIGNED_SHORT:
+          index_size = 2;
+          break;
+        default:
+          index_size = 4;
+          break;
+        }
+
+      if (index_data == NULL ||
+          (indices->offset + index_size * (first_vertex + n_vertices) >
+           index_buffer->size))
+        return FALSE;
+
+      index_data += indices->offset + index_size * first_vertex;
+
+      for (i = 0; i < n_vertices; i++)
+        {
+          switch (indices->type)
+            {
+            case COGL_INDICES_TYPE_UNSIGNED_BYTE:
+              vertex_indices[i] = index_data[i];
+              break;
+            case COGL_INDICES_TYPE_UNSIGNED_SHORT:
+              vertex_indices[i] = ((const guint16 *) index_data)[i];
+              break;
+            case COGL_INDICES_TYPE_UNSIGNED_INT:
+              vertex_indices[i] = ((const guint32 *) index_data)[i];
+              break;
+            }
+        }
+    }
+  else
+    for (i = 0; i < n_vertices; i++)
+      vertex_indices[i] = first_vertex + i;
+
+  for (i = 0; i < n_vertices; i++)
+    max_index = MAX (max_index, vertex_indices[i]);
+
+  position_data = get_primitive_attribute_data (position_attribute,
+                                                max_index,
+                                                &position_stride);
+  if (position_data == NULL)
+    return FALSE;
+
+  if (color_attribute)
+    {
+      color_data = get_primitive_attribute_data (color_attribute,
+                                                 max_index,
+                                                 &color_stride);
+      if (color_data == NULL)
+        return FALSE;
+
+      /* A color attribute normally forces blending on. That doesn't
+         make a difference if all of the colors are opaque but
+         otherwise the entry needs to override the blending */
+      if (!_cogl_pipeline_get_real_blend_enabled (pipeline))
+        for (i = 0; i < n_vertices; i++)
+          if (color_data[color_stride * vertex_indices[i] + 3] != 0xff)
+            {
+              needs_blending = TRUE;
+              break;
+            }
+    }
+
+  for (i = 0; i < n_layers; i++)
+    if (tex_coord_attributes[i])
+      {
+        tex_coord_data[i] =
+          get_primitive_attribute_data (tex_coord_attributes[i],
+                                        max_index,
+                                        &tex_coord_strides[i]);
+        if (tex_coord_data[i] == NULL)
+          return FALSE;
+      }
+
+  cogl_pipeline_foreach_layer (pipeline,
+                               validate_primitive_layer_cb,
+                               &valid);
+  if (!valid)
+    return FALSE;
+
+  n_triangle_vertices = get_primitive_triangles (mode, n_vertices, triangles);
+  if (n_triangle_vertices == 0)
+    return FALSE;
+
+  COGL_COUNTER_INC (_cogl_uprof_context, journal_primitive_counter);
+
+  final_pipeline = pipeline;
+
+  if (G_UNLIKELY (!(flags & COGL_DRAW_SKIP_LEGACY_STATE)) &&
+      G_UNLIKELY (ctx->legacy_state_set) &&
+      _cogl_get_enable_legacy_state ())
+    {
+      final_pipeline = cogl_pipeline_copy (pipeline);
+      _cogl_pipeline_apply_legacy_state (final_pipeline);
+    }
+
+  /* The journal takes a reference on the framebuffer while it isn't
+     empty. See _cogl_journal_log_quad() */
+  if (journal->vertices->len == 0)
+    journal->framebuffer = cogl_object_ref (framebuffer);
+
+  if (color_attribute == NULL)
+    _cogl_pipeline_get_colorubv (pipeline, pipeline_color);
+
+  array_stride = GET_JOURNAL_PRIMITIVE_ARRAY_STRIDE_FOR_N_LAYERS (n_layers);
+
+  next_vert = journal->vertices->len;
+  g_array_set_size (journal->vertices,
+                    next_vert + array_stride * n_triangle_vertices);
+  v = &g_array_index (journal->vertices, float, next_vert);
+
+  for (i = 0; i < n_triangle_vertices; i++)
+    {
+      int index = vertex_indices[triangles[i]];
+
+      if (color_data)
+        memcpy (v, color_data + color_stride * index, 4);
+      else
+        memcpy (v, pipeline_color, 4);
+
+      memcpy (v + 1, position_data + position_stride * index,
+              sizeof (float) * position_attribute->n_components);
+      if (position_attribute->n_components == 2)
+        v[3] = 0.0f;
+
+      for (j = 0; j < n_layers; j++)
+        {
+          float *t = v + 4 + j * 2;
+
+          if (tex_coord_attributes[j])
+            memcpy (t, tex_coord_data[j] + tex_coord_strides[j] * index,
+                    sizeof (float) * 2);
+          else
+            t[0] = t[1] = 0.0f;
+        }
+
+      v += array_stride;
+    }
+
+  /* The vertices are padded in the vbo so that the rectangles after
+     this entry stay aligned to quads */
+  journal->needed_vbo_len =
+    align_vb_offset (journal->needed_vbo_len, n_layers) +
+    GET_JOURNAL_VB_STRIDE_FOR_N_LAYERS (n_layers) *
+    ((n_triangle_vertices + COGL_JOURNAL_PRIMITIVE_VB_ALIGNMENT - 1) /
+     COGL_JOURNAL_PRIMITIVE_VB_ALIGNMENT *
+     COGL_JOURNAL_PRIMITIVE_VB_ALIGNMENT);
+  journal->n_primitive_entries++;
+
+  next_entry = journal->entries->len;
+  g_array_set_size (journal->entries, next_entry + 1);
+  entry = &g_array_index (journal->entries, CoglJournalEntry, next_entry);
+
+  entry->n_layers = n_layers;
+  entry->array_offset = next_vert;
+  entry->n_vertices = n_triangle_vertices;
+  entry->disable_layers = 0;
+  entry->layer0_override_texture = NULL;
+  /* Like the other overrides this is applied when the journal is
+     flushed so all of the entries share one derived pipeline */
+  entry->enable_blend = needs_blending;
+
+  entry->pipeline = _cogl_pipeline_journal_ref (final_pipeline);
+
+  clip_stack = _cogl_framebuffer_get_clip_stack (framebuffer);
+  entry->clip_stack = _cogl_clip_stack_ref (clip_stack);
+
+  if (G_UNLIKELY (final_pipeline != pipeline))
+    cogl_object_unref (final_pipeline);
+
+  _cogl_matrix_stack_get (_cogl_framebuffer_get_modelview_stack (framebuffer),
+                          &entry->model_view);
+
+  _cogl_pipeline_foreach_layer_internal (pipeline,
+                                         add_framebuffer_deps_cb,
+                                         framebuffer);
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_BATCHING)))
+    _cogl_framebuffer_flush_journal (framebuffer);
+
+  return TRUE;
+}
+
 static void
 entry_to_screen_polygon (CoglFramebuffer *framebuffer,
                          const CoglJournalEntry *entry,
@@ -1774,10 +3047,16 @@ try_checking_point_hits_entry_after_clipping (CoglFramebuffer *framebuffer,
         return FALSE;
 
       if (!can_software_clip_entry (entry, NULL,
-                                    entry->clip_stack, &clip_bounds))
+                                    entry->clip_stack,
+                                    NULL, /* entry_flags */
+                                    &clip_bounds))
         return FALSE;
 
       software_clip_entry (entry, vertices, &clip_bounds);
+
+      /* Remove the clip on the entry */
+      _cogl_clip_stack_unref (entry->clip_stack);
+      entry->clip_stack = NULL;
       entry_to_screen_polygon (framebuffer, entry, vertices, poly);
 
       *hit = _cogl_util_point_in_screen_poly (x, y, poly, sizeof (float) * 4, 4);
@@ -1814,6 +3093,10 @@ _cogl_journal_try_read_pixel (CoglJournal *journal,
       format != COGL_PIXEL_FORMAT_RGBA_8888)
     return FALSE;
 
+  /* The intersection tests below only understand rectangles */
+  if (journal->n_primitive_entries)
+    return FALSE;
+
   *found_intersection = FALSE;
 
   /* NB: The most recently added journal entry is the last entry, and
@@ -1857,7 +3140,9 @@ _cogl_journal_try_read_pixel (CoglJournal *journal,
       /* If we find that the rectangle the point of interest
        * intersects has any state more complex than a constant opaque
        * color then we bail out. */
-      if (!_cogl_pipeline_equal (ctx->opaque_color_pipeline, entry->pipeline,
+      if (entry->disable_layers || entry->layer0_override_texture ||
+          entry->enable_blend ||
+          !_cogl_pipeline_equal (ctx->opaque_color_pipeline, entry->pipeline,
                                  (COGL_PIPELINE_STATE_ALL &
                                   ~COGL_PIPELINE_STATE_COLOR),
                                  COGL_PIPELINE_LAYER_STATE_ALL,
@@ -0,0 +1,78 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+
+#ifndef __COGL_MEMORY_PRIVATE_H
+#define __COGL_MEMORY_PRIVATE_H
+
+#include <glib.h>
+
+#include "cogl-context.h"
+#include "cogl-types.h"
+
+/*
+ * Each context keeps a count of the bytes that Cogl has allocated in
+ * the GPU for each CoglMemoryType. The objects that own the storage
+ * add their size when it is allocated and remove it again when it is
+ * freed. When the total grows beyond the application's budget the
+ * low memory callbacks are queued to be invoked from
+ * cogl_poll_dispatch() so that they never run in the middle of an
+ * allocation.
+ */
+
+void
+_cogl_memory_init (CoglContext *ctx);
+
+void
+_cogl_memory_destroy (CoglContext *ctx);
+
+void
+_cogl_memory_add (CoglContext *ctx,
+                  CoglMemoryType type,
+                  gsize size);
+
+void
+_cogl_memory_remove (CoglContext *ctx,
+                     CoglMemoryType type,
+                     gsize size);
+
+/* Calculates the number of bytes needed to store an image of the
+ * given size in @format. If @mipmaps is TRUE then this includes all
+ * of the levels down to 1x1x1 */
+gsize
+_cogl_memory_calculate_texture_size (CoglPixelFormat format,
+                                     int width,
+                                     int height,
+                                     int depth,
+                                     gboolean mipmaps);
+
+/* Returns whether the low memory callbacks are waiting to be
+ * invoked */
+gboolean
+_cogl_memory_has_pending_callbacks (CoglContext *ctx);
+
+void
+_cogl_memory_dispatch (CoglContext *ctx);
+
+#endif /* __COGL_MEMORY_PRIVATE_H */
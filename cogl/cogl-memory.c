@@ -0,0 +1,224 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cogl-internal.h"
+#include "cogl-context-private.h"
+#include "cogl-memory-private.h"
+
+void
+_cogl_memory_init (CoglContext *ctx)
+{
+  int i;
+
+  for (i = 0; i < COGL_N_MEMORY_TYPES; i++)
+    ctx->memory_usage[i] = 0;
+
+  ctx->memory_total = 0;
+  ctx->memory_budget = 0;
+  ctx->low_memory_pending = FALSE;
+  ctx->low_memory_notified = FALSE;
+
+  g_hook_list_init (&ctx->low_memory_callbacks, sizeof (GHook));
+}
+
+void
+_cogl_memory_destroy (CoglContext *ctx)
+{
+  g_hook_list_clear (&ctx->low_memory_callbacks);
+}
+
+static void
+check_budget (CoglContext *ctx)
+{
+  if (ctx->memory_budget == 0 || ctx->memory_total <= ctx->memory_budget)
+    /* Rearm the callbacks for the next time the budget is exceeded */
+    ctx->low_memory_notified = FALSE;
+  else if (!ctx->low_memory_notified)
+    {
+      ctx->low_memory_notified = TRUE;
+      ctx->low_memory_pending = TRUE;
+    }
+}
+
+void
+_cogl_memory_add (CoglContext *ctx,
+                  CoglMemoryType type,
+                  gsize size)
+{
+  _COGL_RETURN_IF_FAIL (type < COGL_N_MEMORY_TYPES);
+
+  ctx->memory_usage[type] += size;
+  ctx->memory_total += size;
+
+  check_budget (ctx);
+}
+
+void
+_cogl_memory_remove (CoglContext *ctx,
+                     CoglMemoryType type,
+                     gsize size)
+{
+  _COGL_RETURN_IF_FAIL (type < COGL_N_MEMORY_TYPES);
+  _COGL_RETURN_IF_FAIL (ctx->memory_usage[type] >= size);
+
+  ctx->memory_usage[type] -= size;
+  ctx->memory_total -= size;
+
+  check_budget (ctx);
+}
+
+gsize
+_cogl_memory_calculate_texture_size (CoglPixelFormat format,
+                                     int width,
+                                     int height,
+                                     int depth,
+                                     gboolean mipmaps)
+{
+  gsize total = 0;
+
+  while (TRUE)
+    {
+      gsize level_size;
+
+      if (_cogl_pixel_format_is_compressed (format))
+        level_size = ((gsize) _cogl_get_format_block_size (format) *
+                      ((width + 3) / 4) * ((height + 3) / 4));
+      else
+        level_size = (gsize) _cogl_get_format_bpp (format) * width * height;
+
+      total += level_size * depth;
+
+      if (!mipmaps || (width == 1 && height == 1 && depth == 1))
+        break;
+
+      width = MAX (width >> 1, 1);
+      height = MAX (height >> 1, 1);
+      depth = MAX (depth >> 1, 1);
+    }
+
+  return total;
+}
+
+gboolean
+_cogl_memory_has_pending_callbacks (CoglContext *ctx)
+{
+  return ctx->low_memory_pending;
+}
+
+static void
+invoke_low_memory_callback (GHook *hook, void *data)
+{
+  CoglContext *ctx = data;
+  CoglLowMemoryCallback callback = hook->func;
+
+  callback (ctx, ctx->memory_total, ctx->memory_budget, hook->data);
+}
+
+void
+_cogl_memory_dispatch (CoglContext *ctx)
+{
+  if (!ctx->low_memory_pending)
+    return;
+
+  ctx->low_memory_pending = FALSE;
+
+  /* The application may have already freed enough memory since the
+     callbacks were queued */
+  if (ctx->memory_budget == 0 || ctx->memory_total <= ctx->memory_budget)
+    return;
+
+  g_hook_list_marshal (&ctx->low_memory_callbacks,
+                       FALSE,
+                       invoke_low_memory_callback,
+                       ctx);
+}
+
+gsize
+cogl_context_get_memory_usage (CoglContext *context,
+                               CoglMemoryType type)
+{
+  _COGL_RETURN_VAL_IF_FAIL (cogl_is_context (context), 0);
+  _COGL_RETURN_VAL_IF_FAIL (type < COGL_N_MEMORY_TYPES, 0);
+
+  return context->memory_usage[type];
+}
+
+gsize
+cogl_context_get_total_memory_usage (CoglContext *context)
+{
+  _COGL_RETURN_VAL_IF_FAIL (cogl_is_context (context), 0);
+
+  return context->memory_total;
+}
+
+void
+cogl_context_set_memory_budget (CoglContext *context,
+                                gsize budget)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_context (context));
+
+  context->memory_budget = budget;
+
+  check_budget (context);
+}
+
+gsize
+cogl_context_get_memory_budget (CoglContext *context)
+{
+  _COGL_RETURN_VAL_IF_FAIL (cogl_is_context (context), 0);
+
+  return context->memory_budget;
+}
+
+unsigned int
+cogl_context_add_low_memory_callback (CoglContext *context,
+                                      CoglLowMemoryCallback callback,
+                                      void *user_data)
+{
+  GHook *hook;
+
+  _COGL_RETURN_VAL_IF_FAIL (cogl_is_context (context), 0);
+  _COGL_RETURN_VAL_IF_FAIL (callback != NULL, 0);
+
+  hook = g_hook_alloc (&context->low_memory_callbacks);
+  hook->func = callback;
+  hook->data = user_data;
+  g_hook_append (&context->low_memory_callbacks, hook);
+
+  return hook->hook_id;
+}
+
+void
+cogl_context_remove_low_memory_callback (CoglContext *context,
+                                         unsigned int id)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_context (context));
+
+  g_hook_destroy (&context->low_memory_callbacks, id);
+}
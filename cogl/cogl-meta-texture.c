@@ -435,6 +435,45 @@ foreach_clamped_region (CoglMetaTexture *meta_texture,
   return FALSE;
 }
 
+/* Finds the range of normalized coordinates of the meta texture
+ * within [0,1] that the region between @start and @end actually
+ * touches. If the region crosses a repeat boundary then the whole
+ * range is used. Only iterating the sub-textures that are needed
+ * matters for meta textures such as #CoglTiledTexture which load their
+ * sub-textures when they are visited. */
+static void
+get_iteration_range (float start,
+                     float end,
+                     float size,
+                     CoglPipelineWrapMode wrap_mode,
+                     float *range)
+{
+  float low = MIN (start, end) / size;
+  float high = MAX (start, end) / size;
+  float origin = floorf (low);
+
+  range[0] = 0;
+  range[1] = 1;
+
+  if (low == high || high > origin + 1)
+    return;
+
+  low -= origin;
+  high -= origin;
+
+  if (wrap_mode == COGL_PIPELINE_WRAP_MODE_MIRRORED_REPEAT &&
+      ((int) origin & 1))
+    {
+      range[0] = 1 - high;
+      range[1] = 1 - low;
+    }
+  else
+    {
+      range[0] = low;
+      range[1] = high;
+    }
+}
+
 typedef struct _NormalizeData
 {
   CoglMetaTextureCallback callback;
@@ -556,6 +595,8 @@ cogl_meta_texture_foreach_in_region (CoglMetaTexture *meta_texture,
   if (texture->vtable->foreach_sub_texture_in_region)
     {
       ForeachData data;
+      float range_s[2];
+      float range_t[2];
 
       data.meta_region_coords[0] = tx_1;
       data.meta_region_coords[1] = ty_1;
@@ -573,7 +614,9 @@ cogl_meta_texture_foreach_in_region (CoglMetaTexture *meta_texture,
 
       /*
        * 1) We iterate all the slices of the meta-texture only within
-       *    the range [0,1].
+       *    the range [0,1]. If the region doesn't cross a repeat
+       *    boundary then only the part of that range that the region
+       *    maps to is iterated.
        *
        * 2) We define a "padded grid" for each slice of the
        *    meta-texture in the range [0,1].
@@ -595,8 +638,14 @@ cogl_meta_texture_foreach_in_region (CoglMetaTexture *meta_texture,
        * that we can batch geometry.
        */
 
+      get_iteration_range (tx_1, tx_2, width, wrap_s, range_s);
+      get_iteration_range (ty_1, ty_2, height, wrap_t, range_t);
+
       texture->vtable->foreach_sub_texture_in_region (texture,
-                                                      0, 0, 1, 1,
+                                                      range_s[0],
+                                                      range_t[0],
+                                                      range_s[1],
+                                                      range_t[1],
                                                       create_grid_and_repeat_cb,
                                                       &data);
     }
@@ -127,18 +127,19 @@ struct _CoglObject
 #define COGL_OBJECT_COMMON_DEFINE_WITH_CODE(TypeName, type_name, code)  \
                                                                         \
 CoglObjectClass _cogl_##type_name##_class;                              \
-static unsigned long _cogl_object_##type_name##_count;                  \
+static CoglDebugTypeStats _cogl_object_##type_name##_stats;             \
                                                                         \
 static inline void                                                      \
 _cogl_object_##type_name##_inc (void)                                   \
 {                                                                       \
-  _cogl_object_##type_name##_count++;                                   \
+  _cogl_object_##type_name##_stats.instance_count++;                    \
+  _cogl_object_##type_name##_stats.n_allocations++;                     \
 }                                                                       \
                                                                         \
 static inline void                                                      \
 _cogl_object_##type_name##_dec (void)                                   \
 {                                                                       \
-  _cogl_object_##type_name##_count--;                                   \
+  _cogl_object_##type_name##_stats.instance_count--;                    \
 }                                                                       \
                                                                         \
 static void                                                             \
@@ -160,11 +161,7 @@ _cogl_##type_name##_object_new (Cogl##TypeName *new_obj)                \
   obj->klass = &_cogl_##type_name##_class;                              \
   if (!obj->klass->virt_free)                                           \
     {                                                                   \
-      _cogl_object_##type_name##_count = 0;                             \
-                                                                        \
-      if (_cogl_debug_instances == NULL)                                \
-        _cogl_debug_instances =                                         \
-          g_hash_table_new (g_str_hash, g_str_equal);                   \
+      _cogl_object_##type_name##_stats.instance_count = 0;              \
                                                                         \
       obj->klass->virt_free =                                           \
         _cogl_object_##type_name##_indirect_free;                       \
@@ -172,9 +169,8 @@ _cogl_##type_name##_object_new (Cogl##TypeName *new_obj)                \
         _cogl_object_default_unref;                                     \
       obj->klass->name = "Cogl"#TypeName,                               \
                                                                         \
-      g_hash_table_insert (_cogl_debug_instances,                       \
-                           (void *) obj->klass->name,                   \
-                           &_cogl_object_##type_name##_count);          \
+      _cogl_debug_register_type_stats                                   \
+        (obj->klass->name, &_cogl_object_##type_name##_stats);          \
                                                                         \
       { code; }                                                         \
     }                                                                   \
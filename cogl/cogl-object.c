@@ -260,24 +260,56 @@ cogl_debug_object_foreach_type (CoglDebugObjectForeachTypeCallback func,
                                 void *user_data)
 {
   GHashTableIter iter;
-  unsigned long *instance_count;
+  CoglDebugTypeStats *stats;
   CoglDebugObjectTypeInfo info;
 
+  if (_cogl_debug_instances == NULL)
+    return;
+
   g_hash_table_iter_init (&iter, _cogl_debug_instances);
   while (g_hash_table_iter_next (&iter,
                                  (void *) &info.name,
-                                 (void *) &instance_count))
+                                 (void *) &stats))
     {
-      info.instance_count = *instance_count;
+      info.instance_count = stats->instance_count;
+      info.frame_allocations = stats->n_frame_allocations;
       func (&info, user_data);
     }
 }
 
+void
+_cogl_debug_register_type_stats (const char *name,
+                                 CoglDebugTypeStats *stats)
+{
+  if (_cogl_debug_instances == NULL)
+    _cogl_debug_instances = g_hash_table_new (g_str_hash, g_str_equal);
+
+  g_hash_table_insert (_cogl_debug_instances, (void *) name, stats);
+}
+
+void
+_cogl_debug_end_frame (void)
+{
+  GHashTableIter iter;
+  CoglDebugTypeStats *stats;
+
+  if (_cogl_debug_instances == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, _cogl_debug_instances);
+  while (g_hash_table_iter_next (&iter, NULL, (void *) &stats))
+    {
+      stats->n_frame_allocations = stats->n_allocations;
+      stats->n_allocations = 0;
+    }
+}
+
 static void
 print_instances_cb (const CoglDebugObjectTypeInfo *info,
                     void *user_data)
 {
-  g_print ("\t%s: %lu\n", info->name, info->instance_count);
+  g_print ("\t%s: %lu (%lu allocated in the last frame)\n",
+           info->name, info->instance_count, info->frame_allocations);
 }
 
 void
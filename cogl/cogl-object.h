@@ -86,6 +86,9 @@ typedef void (*CoglUserDataDestroyCallback) (void *user_data);
  * @name: A human readable name for the type.
  * @instance_count: The number of objects of this type that are
  *   currently in use
+ * @frame_allocations: The number of objects of this type that were
+ *   allocated during the last frame. A frame ends whenever an onscreen
+ *   framebuffer is swapped. Since 1.10
  *
  * This struct is used to pass information to the callback when
  * cogl_debug_object_foreach_type() is called.
@@ -97,6 +100,7 @@ typedef struct
 {
   const char *name;
   unsigned long instance_count;
+  unsigned long frame_allocations;
 } CoglDebugObjectTypeInfo;
 
 /**
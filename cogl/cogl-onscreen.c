@@ -31,6 +31,7 @@
 #include "cogl-onscreen-template-private.h"
 #include "cogl-context-private.h"
 #include "cogl-object-private.h"
+#include "cogl-capture-private.h"
 
 static void _cogl_onscreen_free (CoglOnscreen *onscreen);
 
@@ -134,8 +135,17 @@ cogl_framebuffer_swap_buffers (CoglFramebuffer *framebuffer)
 
   /* FIXME: we shouldn't need to flush *all* journals here! */
   cogl_flush ();
+
+#ifdef COGL_ENABLE_DEBUG
+  if (_COGL_CAPTURE_ENABLED ())
+    _cogl_capture_frame (framebuffer);
+#endif
+
   winsys = _cogl_framebuffer_get_winsys (framebuffer);
   winsys->onscreen_swap_buffers (COGL_ONSCREEN (framebuffer));
+  framebuffer->context->frame_counter++;
+  _cogl_gl_state_end_frame (framebuffer->context);
+  _cogl_debug_end_frame ();
   cogl_framebuffer_discard_buffers (framebuffer,
                                     COGL_BUFFER_BIT_COLOR |
                                     COGL_BUFFER_BIT_DEPTH |
@@ -154,6 +164,11 @@ cogl_framebuffer_swap_region (CoglFramebuffer *framebuffer,
   /* FIXME: we shouldn't need to flush *all* journals here! */
   cogl_flush ();
 
+#ifdef COGL_ENABLE_DEBUG
+  if (_COGL_CAPTURE_ENABLED ())
+    _cogl_capture_frame (framebuffer);
+#endif
+
   winsys = _cogl_framebuffer_get_winsys (framebuffer);
 
   /* This should only be called if the winsys advertises
@@ -163,6 +178,9 @@ cogl_framebuffer_swap_region (CoglFramebuffer *framebuffer,
   winsys->onscreen_swap_region (COGL_ONSCREEN (framebuffer),
                                 rectangles,
                                 n_rectangles);
+  framebuffer->context->frame_counter++;
+  _cogl_gl_state_end_frame (framebuffer->context);
+  _cogl_debug_end_frame ();
 
   cogl_framebuffer_discard_buffers (framebuffer,
                                     COGL_BUFFER_BIT_COLOR |
@@ -355,11 +373,8 @@ _cogl_framebuffer_winsys_update_size (CoglFramebuffer *framebuffer,
   framebuffer->width = width;
   framebuffer->height = height;
 
-  /* The framebuffer geometry can affect the GL viewport so if the
-   * framebuffer being updated is the current framebuffer we mark the
-   * viewport state as changed so it will be updated the next time
+  /* The framebuffer geometry can affect the GL viewport so we mark
+   * the viewport state as changed so it will be updated the next time
    * _cogl_framebuffer_flush_state() is called. */
-  if (framebuffer->context->current_draw_buffer == framebuffer)
-    framebuffer->context->current_draw_buffer_changes |=
-      COGL_FRAMEBUFFER_STATE_VIEWPORT;
+  framebuffer->dirty_state |= COGL_FRAMEBUFFER_STATE_VIEWPORT;
 }
@@ -156,22 +156,14 @@ dirty_shader_state (CoglPipeline *pipeline)
                              NULL);
 }
 
+/* Validates that we can handle the pipeline's state using ARBfp */
 static gboolean
-_cogl_pipeline_fragend_arbfp_start (CoglPipeline *pipeline,
-                                    int n_layers,
-                                    unsigned long pipelines_difference,
-                                    int n_tex_coord_attribs)
+can_handle_pipeline (CoglPipeline *pipeline)
 {
-  CoglPipelineShaderState *shader_state;
-  CoglPipeline *authority;
-  CoglPipeline *template_pipeline = NULL;
   CoglHandle user_program;
 
   _COGL_GET_CONTEXT (ctx, FALSE);
 
-  /* First validate that we can handle the current state using ARBfp
-   */
-
   if (!cogl_has_feature (ctx, COGL_FEATURE_ID_ARBFP))
     return FALSE;
 
@@ -183,20 +175,40 @@ _cogl_pipeline_fragend_arbfp_start (CoglPipeline *pipeline,
   if (_cogl_pipeline_has_fragment_snippets (pipeline))
     return FALSE;
 
+  /* If the user program does have a fragment shader then we can only
+     handle it if it's in ARBfp */
   user_program = cogl_pipeline_get_user_program (pipeline);
-  if (user_program != COGL_INVALID_HANDLE)
-    {
-      /* If the program doesn't have a fragment shader then some other
-         vertend will handle the vertex shader state and we still need
-         to generate a fragment program */
-      if (!_cogl_program_has_fragment_shader (user_program))
-        user_program = COGL_INVALID_HANDLE;
-      /* If the user program does have a fragment shader then we can
-         only handle it if it's in ARBfp */
-      else if (_cogl_program_get_language (user_program) !=
-               COGL_SHADER_LANGUAGE_ARBFP)
-        return FALSE;
-    }
+  if (user_program != COGL_INVALID_HANDLE &&
+      _cogl_program_has_fragment_shader (user_program) &&
+      _cogl_program_get_language (user_program) != COGL_SHADER_LANGUAGE_ARBFP)
+    return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+_cogl_pipeline_fragend_arbfp_start (CoglPipeline *pipeline,
+                                    int n_layers,
+                                    unsigned long pipelines_difference,
+                                    int n_tex_coord_attribs)
+{
+  CoglPipelineShaderState *shader_state;
+  CoglPipeline *authority;
+  CoglPipeline *template_pipeline = NULL;
+  CoglHandle user_program;
+
+  _COGL_GET_CONTEXT (ctx, FALSE);
+
+  if (!can_handle_pipeline (pipeline))
+    return FALSE;
+
+  /* If the program doesn't have a fragment shader then some other
+     vertend will handle the vertex shader state and we still need to
+     generate a fragment program */
+  user_program = cogl_pipeline_get_user_program (pipeline);
+  if (user_program != COGL_INVALID_HANDLE &&
+      !_cogl_program_has_fragment_shader (user_program))
+    user_program = COGL_INVALID_HANDLE;
 
   /* Now lookup our ARBfp backend private state */
   shader_state = get_shader_state (pipeline);
@@ -913,6 +925,17 @@ _cogl_pipeline_fragend_arbfp_end (CoglPipeline *pipeline,
   return TRUE;
 }
 
+static gboolean
+_cogl_pipeline_fragend_arbfp_precompile (CoglPipeline *pipeline,
+                                         int n_tex_coord_attribs)
+{
+  /* ARBfp programs are cheap to build and they have to be bound to be
+     compiled so they are left until the pipeline is flushed. We still
+     need to claim the pipeline so that the same fragend is picked as
+     for a real flush */
+  return can_handle_pipeline (pipeline);
+}
+
 static void
 _cogl_pipeline_fragend_arbfp_pipeline_pre_change_notify (
                                                    CoglPipeline *pipeline,
@@ -970,6 +993,7 @@ const CoglPipelineFragend _cogl_pipeline_arbfp_fragend =
   _cogl_pipeline_fragend_arbfp_add_layer,
   _cogl_pipeline_fragend_arbfp_passthrough,
   _cogl_pipeline_fragend_arbfp_end,
+  _cogl_pipeline_fragend_arbfp_precompile,
   _cogl_pipeline_fragend_arbfp_pipeline_pre_change_notify,
   NULL,
   _cogl_pipeline_fragend_arbfp_layer_pre_change_notify
@@ -87,10 +87,7 @@ get_max_texture_units (void)
 }
 
 static gboolean
-_cogl_pipeline_fragend_fixed_start (CoglPipeline *pipeline,
-                                    int n_layers,
-                                    unsigned long pipelines_difference,
-                                    int n_tex_coord_attribs)
+can_handle_pipeline (CoglPipeline *pipeline)
 {
   CoglHandle user_program;
 
@@ -115,6 +112,18 @@ _cogl_pipeline_fragend_fixed_start (CoglPipeline *pipeline,
       _cogl_program_has_fragment_shader (user_program))
     return FALSE;
 
+  return TRUE;
+}
+
+static gboolean
+_cogl_pipeline_fragend_fixed_start (CoglPipeline *pipeline,
+                                    int n_layers,
+                                    unsigned long pipelines_difference,
+                                    int n_tex_coord_attribs)
+{
+  if (!can_handle_pipeline (pipeline))
+    return FALSE;
+
   _cogl_use_fragment_program (0, COGL_PIPELINE_PROGRAM_TYPE_FIXED);
   return TRUE;
 }
@@ -360,12 +369,21 @@ _cogl_pipeline_fragend_fixed_end (CoglPipeline *pipeline,
   return TRUE;
 }
 
+static gboolean
+_cogl_pipeline_fragend_fixed_precompile (CoglPipeline *pipeline,
+                                         int n_tex_coord_attribs)
+{
+  /* There is no shader to generate for the fixed function pipeline */
+  return can_handle_pipeline (pipeline);
+}
+
 const CoglPipelineFragend _cogl_pipeline_fixed_fragend =
 {
   _cogl_pipeline_fragend_fixed_start,
   _cogl_pipeline_fragend_fixed_add_layer,
   NULL, /* passthrough */
   _cogl_pipeline_fragend_fixed_end,
+  _cogl_pipeline_fragend_fixed_precompile,
   NULL, /* pipeline_change_notify */
   NULL, /* pipeline_set_parent_notify */
   NULL, /* layer_change_notify */
@@ -48,6 +48,7 @@
 #include "cogl-shader-private.h"
 #include "cogl-program-private.h"
 #include "cogl-pipeline-cache.h"
+#include "cogl-util.h"
 
 #include <glib.h>
 
@@ -93,6 +94,10 @@ typedef struct
   GString *header, *source;
   UnitState *unit_state;
 
+  /* The members of the uniform block that the snippet uniforms are
+     packed into. This is NULL if uniform blocks aren't available */
+  GString *uniform_block;
+
   /* List of layers that we haven't generated code for yet. These are
      in reverse order. As soon as we're about to generate code for
      layer we'll remove it from the list so we don't generate it
@@ -345,6 +350,14 @@ _cogl_pipeline_fragend_glsl_start (CoglPipeline *pipeline,
   g_string_set_size (ctx->codegen_source_buffer, 0);
   shader_state->header = ctx->codegen_header_buffer;
   shader_state->source = ctx->codegen_source_buffer;
+
+  if ((ctx->private_feature_flags & COGL_PRIVATE_FEATURE_UBOS))
+    {
+      g_string_set_size (ctx->codegen_uniform_block_buffer, 0);
+      shader_state->uniform_block = ctx->codegen_uniform_block_buffer;
+    }
+  else
+    shader_state->uniform_block = NULL;
   COGL_LIST_INIT (&shader_state->layers);
 
   g_string_append (shader_state->source,
@@ -506,6 +519,9 @@ ensure_texture_lookup_generated (CoglPipelineShaderState *shader_state,
   snippet_data.arguments = "cogl_tex_coord";
   snippet_data.argument_declarations = "vec4 cogl_tex_coord";
   snippet_data.source_buf = shader_state->header;
+  snippet_data.uniform_block_buf = shader_state->uniform_block;
+  snippet_data.uniform_block_instance =
+    COGL_PIPELINE_SNIPPET_FRAGMENT_UNIFORM_INSTANCE;
 
   _cogl_pipeline_snippet_generate_code (&snippet_data);
 
@@ -787,6 +803,211 @@ append_masked_combine (CoglPipeline *pipeline,
   g_string_append_printf (shader_source, ";\n");
 }
 
+/* The function generated to combine a layer only depends on the
+   layer's combine state, its texture unit and the index of the
+   previous layer. The source is cached on the context so that a new
+   pipeline with a similar layer can reuse it */
+typedef struct
+{
+  int layer_index;
+  int previous_layer_index;
+  int unit_index;
+  int combine_separate;
+  CoglPipelineCombineFunc rgb_func;
+  CoglPipelineCombineSource rgb_src[3];
+  CoglPipelineCombineOp rgb_op[3];
+  CoglPipelineCombineFunc alpha_func;
+  CoglPipelineCombineSource alpha_src[3];
+  CoglPipelineCombineOp alpha_op[3];
+} LayerCombineKey;
+
+typedef struct
+{
+  LayerCombineKey key;
+  int source_len;
+  char *source;
+} LayerCombineEntry;
+
+/* The cache is cleared if it grows beyond this many entries */
+#define LAYER_COMBINE_CACHE_SIZE 512
+
+static unsigned int
+layer_combine_key_hash (const void *key)
+{
+  unsigned int hash;
+
+  hash = _cogl_util_one_at_a_time_hash (0, (void *) key,
+                                        sizeof (LayerCombineKey));
+
+  return _cogl_util_one_at_a_time_mix (hash);
+}
+
+static gboolean
+layer_combine_key_equal (const void *a,
+                         const void *b)
+{
+  return !memcmp (a, b, sizeof (LayerCombineKey));
+}
+
+static void
+layer_combine_entry_free (void *data)
+{
+  LayerCombineEntry *entry = data;
+
+  g_free (entry->source);
+  g_slice_free (LayerCombineEntry, entry);
+}
+
+static void
+init_layer_combine_key (LayerCombineKey *key,
+                        CoglPipelineLayer *layer,
+                        int previous_layer_index,
+                        CoglPipelineLayer *combine_authority)
+{
+  CoglPipelineLayerBigState *big_state = combine_authority->big_state;
+  int n_args;
+
+  /* The key is hashed and compared as raw memory so the unused
+     arguments must be zero */
+  memset (key, 0, sizeof (LayerCombineKey));
+
+  key->layer_index = layer->index;
+  key->previous_layer_index = previous_layer_index;
+  key->unit_index = _cogl_pipeline_layer_get_unit_index (layer);
+  key->combine_separate =
+    (_cogl_pipeline_layer_needs_combine_separate (combine_authority) &&
+     /* GL_DOT3_RGBA Is a bit weird as a GL_COMBINE_RGB function
+      * since if you use it, it overrides your ALPHA function...
+      */
+     big_state->texture_combine_rgb_func !=
+     COGL_PIPELINE_COMBINE_FUNC_DOT3_RGBA);
+
+  key->rgb_func = big_state->texture_combine_rgb_func;
+  n_args = _cogl_get_n_args_for_combine_func (key->rgb_func);
+  memcpy (key->rgb_src, big_state->texture_combine_rgb_src,
+          sizeof (CoglPipelineCombineSource) * n_args);
+  memcpy (key->rgb_op, big_state->texture_combine_rgb_op,
+          sizeof (CoglPipelineCombineOp) * n_args);
+
+  if (key->combine_separate)
+    {
+      key->alpha_func = big_state->texture_combine_alpha_func;
+      n_args = _cogl_get_n_args_for_combine_func (key->alpha_func);
+      memcpy (key->alpha_src, big_state->texture_combine_alpha_src,
+              sizeof (CoglPipelineCombineSource) * n_args);
+      memcpy (key->alpha_op, big_state->texture_combine_alpha_op,
+              sizeof (CoglPipelineCombineOp) * n_args);
+    }
+}
+
+static void
+generate_layer_combine (CoglPipeline *pipeline,
+                        CoglPipelineLayer *layer,
+                        int previous_layer_index,
+                        CoglPipelineLayer *combine_authority)
+{
+  CoglPipelineShaderState *shader_state = get_shader_state (pipeline);
+  CoglPipelineLayerBigState *big_state = combine_authority->big_state;
+  LayerCombineKey key;
+  LayerCombineEntry *entry;
+  gboolean use_cache;
+  size_t start;
+
+  COGL_STATIC_COUNTER (fragend_glsl_layer_cache_hit_counter,
+                       "glsl layer codegen cache hit counter",
+                       "Increments each time the generated code for "
+                       "a layer is found in the cache",
+                       0 /* no application private data */);
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  use_cache = G_LIKELY (!(COGL_DEBUG_ENABLED
+                          (COGL_DEBUG_DISABLE_PROGRAM_CACHES)));
+
+  if (use_cache)
+    {
+      if (ctx->codegen_layer_cache == NULL)
+        ctx->codegen_layer_cache =
+          g_hash_table_new_full (layer_combine_key_hash,
+                                 layer_combine_key_equal,
+                                 NULL, /* the key is part of the entry */
+                                 layer_combine_entry_free);
+
+      init_layer_combine_key (&key, layer, previous_layer_index,
+                              combine_authority);
+
+      entry = g_hash_table_lookup (ctx->codegen_layer_cache, &key);
+
+      if (entry)
+        {
+          COGL_COUNTER_INC (_cogl_uprof_context,
+                            fragend_glsl_layer_cache_hit_counter);
+          g_string_append_len (shader_state->header,
+                               entry->source,
+                               entry->source_len);
+          return;
+        }
+    }
+
+  start = shader_state->header->len;
+
+  g_string_append_printf (shader_state->header,
+                          "vec4\n"
+                          "cogl_real_generate_layer%i ()\n"
+                          "{\n"
+                          "  vec4 cogl_layer;\n",
+                          layer->index);
+
+  if (!_cogl_pipeline_layer_needs_combine_separate (combine_authority) ||
+      /* GL_DOT3_RGBA Is a bit weird as a GL_COMBINE_RGB function
+       * since if you use it, it overrides your ALPHA function...
+       */
+      big_state->texture_combine_rgb_func ==
+      COGL_PIPELINE_COMBINE_FUNC_DOT3_RGBA)
+    append_masked_combine (pipeline,
+                           layer,
+                           previous_layer_index,
+                           "rgba",
+                           big_state->texture_combine_rgb_func,
+                           big_state->texture_combine_rgb_src,
+                           big_state->texture_combine_rgb_op);
+  else
+    {
+      append_masked_combine (pipeline,
+                             layer,
+                             previous_layer_index,
+                             "rgb",
+                             big_state->texture_combine_rgb_func,
+                             big_state->texture_combine_rgb_src,
+                             big_state->texture_combine_rgb_op);
+      append_masked_combine (pipeline,
+                             layer,
+                             previous_layer_index,
+                             "a",
+                             big_state->texture_combine_alpha_func,
+                             big_state->texture_combine_alpha_src,
+                             big_state->texture_combine_alpha_op);
+    }
+
+  g_string_append (shader_state->header,
+                   "  return cogl_layer;\n"
+                   "}\n");
+
+  if (use_cache)
+    {
+      if (g_hash_table_size (ctx->codegen_layer_cache) >=
+          LAYER_COMBINE_CACHE_SIZE)
+        g_hash_table_remove_all (ctx->codegen_layer_cache);
+
+      entry = g_slice_new (LayerCombineEntry);
+      entry->key = key;
+      entry->source_len = shader_state->header->len - start;
+      entry->source = g_memdup (shader_state->header->str + start,
+                                entry->source_len);
+      g_hash_table_insert (ctx->codegen_layer_cache, &entry->key, entry);
+    }
+}
+
 static void
 ensure_layer_generated (CoglPipeline *pipeline,
                         int layer_index)
@@ -845,47 +1066,10 @@ ensure_layer_generated (CoglPipeline *pipeline,
                             big_state->texture_combine_alpha_func,
                             big_state->texture_combine_alpha_src);
 
-      g_string_append_printf (shader_state->header,
-                              "vec4\n"
-                              "cogl_real_generate_layer%i ()\n"
-                              "{\n"
-                              "  vec4 cogl_layer;\n",
-                              layer_index);
-
-      if (!_cogl_pipeline_layer_needs_combine_separate (combine_authority) ||
-          /* GL_DOT3_RGBA Is a bit weird as a GL_COMBINE_RGB function
-           * since if you use it, it overrides your ALPHA function...
-           */
-          big_state->texture_combine_rgb_func ==
-          COGL_PIPELINE_COMBINE_FUNC_DOT3_RGBA)
-        append_masked_combine (pipeline,
-                               layer,
-                               layer_data->previous_layer_index,
-                               "rgba",
-                               big_state->texture_combine_rgb_func,
-                               big_state->texture_combine_rgb_src,
-                               big_state->texture_combine_rgb_op);
-      else
-        {
-          append_masked_combine (pipeline,
-                                 layer,
-                                 layer_data->previous_layer_index,
-                                 "rgb",
-                                 big_state->texture_combine_rgb_func,
-                                 big_state->texture_combine_rgb_src,
-                                 big_state->texture_combine_rgb_op);
-          append_masked_combine (pipeline,
-                                 layer,
-                                 layer_data->previous_layer_index,
-                                 "a",
-                                 big_state->texture_combine_alpha_func,
-                                 big_state->texture_combine_alpha_src,
-                                 big_state->texture_combine_alpha_op);
-        }
-
-      g_string_append (shader_state->header,
-                       "  return cogl_layer;\n"
-                       "}\n");
+      generate_layer_combine (pipeline,
+                              layer,
+                              layer_data->previous_layer_index,
+                              combine_authority);
     }
 
   /* Wrap the layer code in any snippets that have been hooked */
@@ -901,6 +1085,9 @@ ensure_layer_generated (CoglPipeline *pipeline,
   snippet_data.return_type = "vec4";
   snippet_data.return_variable = "cogl_layer";
   snippet_data.source_buf = shader_state->header;
+  snippet_data.uniform_block_buf = shader_state->uniform_block;
+  snippet_data.uniform_block_instance =
+    COGL_PIPELINE_SNIPPET_FRAGMENT_UNIFORM_INSTANCE;
 
   _cogl_pipeline_snippet_generate_code (&snippet_data);
 
@@ -1019,8 +1206,9 @@ _cogl_pipeline_fragend_glsl_end (CoglPipeline *pipeline,
 
   if (shader_state->source)
     {
-      const char *source_strings[2];
-      GLint lengths[2];
+      const char *source_strings[3];
+      GLint lengths[3];
+      int n_strings = 0;
       GLint compile_status;
       GLuint shader;
       CoglPipelineSnippetData snippet_data;
@@ -1030,8 +1218,16 @@ _cogl_pipeline_fragend_glsl_end (CoglPipeline *pipeline,
                            "Increments each time a new GLSL "
                            "fragment shader is compiled",
                            0 /* no application private data */);
+      COGL_STATIC_TIMER (fragend_glsl_codegen_timer,
+                         "Material Flush", /* parent */
+                         "GLSL fragment codegen",
+                         "The time spent generating GLSL fragment shaders",
+                         0 /* no application private data */);
+
       COGL_COUNTER_INC (_cogl_uprof_context, fragend_glsl_compile_counter);
 
+      COGL_TIMER_START (_cogl_uprof_context, fragend_glsl_codegen_timer);
+
       /* We only need to generate code to calculate the fragment value
          for the last layer. If the value of this layer depends on any
          previous layers then it will recursively generate the code
@@ -1072,43 +1268,98 @@ _cogl_pipeline_fragend_glsl_end (CoglPipeline *pipeline,
       snippet_data.final_name = "main";
       snippet_data.function_prefix = "cogl_fragment_hook";
       snippet_data.source_buf = shader_state->source;
+      snippet_data.uniform_block_buf = shader_state->uniform_block;
+      snippet_data.uniform_block_instance =
+        COGL_PIPELINE_SNIPPET_FRAGMENT_UNIFORM_INSTANCE;
       _cogl_pipeline_snippet_generate_code (&snippet_data);
 
+      COGL_TIMER_STOP (_cogl_uprof_context, fragend_glsl_codegen_timer);
+
       GE_RET( shader, ctx, glCreateShader (GL_FRAGMENT_SHADER) );
 
-      lengths[0] = shader_state->header->len;
-      source_strings[0] = shader_state->header->str;
-      lengths[1] = shader_state->source->len;
-      source_strings[1] = shader_state->source->str;
+      /* The uniform block has to be declared before the snippets
+         refer to it */
+      if (shader_state->uniform_block)
+        {
+          _cogl_pipeline_snippet_declare_uniform_block
+            (shader_state->uniform_block,
+             COGL_PIPELINE_SNIPPET_FRAGMENT_UNIFORM_BLOCK,
+             COGL_PIPELINE_SNIPPET_FRAGMENT_UNIFORM_INSTANCE);
+          lengths[n_strings] = shader_state->uniform_block->len;
+          source_strings[n_strings++] = shader_state->uniform_block->str;
+        }
+
+      lengths[n_strings] = shader_state->header->len;
+      source_strings[n_strings++] = shader_state->header->str;
+      lengths[n_strings] = shader_state->source->len;
+      source_strings[n_strings++] = shader_state->source->str;
 
       _cogl_shader_set_source_with_boilerplate (shader, GL_FRAGMENT_SHADER,
                                                 shader_state
                                                 ->n_tex_coord_attribs,
-                                                2, /* count */
+                                                n_strings,
                                                 source_strings, lengths);
 
       GE( ctx, glCompileShader (shader) );
-      GE( ctx, glGetShaderiv (shader, GL_COMPILE_STATUS, &compile_status) );
 
-      if (!compile_status)
+      /* Querying the status would wait for the compiler so when
+         linking asynchronously we leave it to the progend to report
+         the errors when the link fails */
+      if (ctx->async_shaders_policy == COGL_ASYNC_SHADERS_DISABLED)
         {
-          GLint len = 0;
-          char *shader_log;
+          GE( ctx, glGetShaderiv (shader, GL_COMPILE_STATUS,
+                                  &compile_status) );
+
+          if (!compile_status)
+            {
+              GLint len = 0;
+              char *shader_log;
 
-          GE( ctx, glGetShaderiv (shader, GL_INFO_LOG_LENGTH, &len) );
-          shader_log = g_alloca (len);
-          GE( ctx, glGetShaderInfoLog (shader, len, &len, shader_log) );
-          g_warning ("Shader compilation failed:\n%s", shader_log);
+              GE( ctx, glGetShaderiv (shader, GL_INFO_LOG_LENGTH, &len) );
+              shader_log = g_alloca (len);
+              GE( ctx, glGetShaderInfoLog (shader, len, &len, shader_log) );
+              g_warning ("Shader compilation failed:\n%s", shader_log);
+            }
         }
 
       shader_state->header = NULL;
       shader_state->source = NULL;
+      shader_state->uniform_block = NULL;
       shader_state->gl_shader = shader;
     }
 
   return TRUE;
 }
 
+static gboolean
+precompile_add_layer_cb (CoglPipelineLayer *layer,
+                         void *user_data)
+{
+  /* No layer differences are passed so that only the code is
+     generated */
+  _cogl_pipeline_fragend_glsl_add_layer (user_data, layer, 0);
+
+  return TRUE;
+}
+
+static gboolean
+_cogl_pipeline_fragend_glsl_precompile (CoglPipeline *pipeline,
+                                        int n_tex_coord_attribs)
+{
+  if (!_cogl_pipeline_fragend_glsl_start (pipeline,
+                                          cogl_pipeline_get_n_layers (pipeline),
+                                          0, /* pipelines_difference */
+                                          n_tex_coord_attribs))
+    return FALSE;
+
+  _cogl_pipeline_foreach_layer_internal (pipeline,
+                                         precompile_add_layer_cb,
+                                         pipeline);
+
+  /* This only creates and compiles the shader */
+  return _cogl_pipeline_fragend_glsl_end (pipeline, 0);
+}
+
 static void
 _cogl_pipeline_fragend_glsl_pre_change_notify (CoglPipeline *pipeline,
                                                CoglPipelineState change,
@@ -1153,6 +1404,7 @@ const CoglPipelineFragend _cogl_pipeline_glsl_fragend =
   _cogl_pipeline_fragend_glsl_add_layer,
   NULL, /* passthrough */
   _cogl_pipeline_fragend_glsl_end,
+  _cogl_pipeline_fragend_glsl_precompile,
   _cogl_pipeline_fragend_glsl_pre_change_notify,
   NULL, /* pipeline_set_parent_notify */
   _cogl_pipeline_fragend_glsl_layer_pre_change_notify
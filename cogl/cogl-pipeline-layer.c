@@ -41,6 +41,7 @@
 #include "cogl-pipeline-opengl-private.h"
 #include "cogl-context-private.h"
 #include "cogl-texture-private.h"
+#include "cogl-slab-private.h"
 
 static void
 _cogl_pipeline_layer_free (CoglPipelineLayer *layer);
@@ -51,6 +52,12 @@ _cogl_pipeline_layer_free (CoglPipelineLayer *layer);
    so that the cogl_is_* function won't get defined */
 COGL_OBJECT_INTERNAL_DEFINE (PipelineLayer, pipeline_layer);
 
+static CoglSlabAllocator layer_slab =
+  COGL_SLAB_ALLOCATOR_INIT (NULL, sizeof (CoglPipelineLayer), 64);
+static CoglSlabAllocator layer_big_state_slab =
+  COGL_SLAB_ALLOCATOR_INIT ("CoglPipelineLayerBigState",
+                            sizeof (CoglPipelineLayerBigState), 16);
+
 
 CoglPipelineLayer *
 _cogl_pipeline_layer_get_authority (CoglPipelineLayer *layer,
@@ -311,7 +318,7 @@ init_layer_state:
   if (change & COGL_PIPELINE_LAYER_STATE_NEEDS_BIG_STATE &&
       !layer->has_big_state)
     {
-      layer->big_state = g_slice_new (CoglPipelineLayerBigState);
+      layer->big_state = _cogl_slab_alloc (&layer_big_state_slab);
       layer->has_big_state = TRUE;
     }
 
@@ -360,7 +367,7 @@ _cogl_pipeline_layer_set_parent (CoglPipelineLayer *layer,
 CoglPipelineLayer *
 _cogl_pipeline_layer_copy (CoglPipelineLayer *src)
 {
-  CoglPipelineLayer *layer = g_slice_new (CoglPipelineLayer);
+  CoglPipelineLayer *layer = _cogl_slab_alloc (&layer_slab);
 
   _cogl_pipeline_node_init (COGL_NODE (layer));
 
@@ -631,17 +638,17 @@ _cogl_pipeline_layer_free (CoglPipelineLayer *layer)
     _cogl_pipeline_snippet_list_free (&layer->big_state->fragment_snippets);
 
   if (layer->differences & COGL_PIPELINE_LAYER_STATE_NEEDS_BIG_STATE)
-    g_slice_free (CoglPipelineLayerBigState, layer->big_state);
+    _cogl_slab_free (&layer_big_state_slab, layer->big_state);
 
-  g_slice_free (CoglPipelineLayer, layer);
+  _cogl_slab_free (&layer_slab, layer);
 }
 
 void
 _cogl_pipeline_init_default_layers (void)
 {
-  CoglPipelineLayer *layer = g_slice_new0 (CoglPipelineLayer);
+  CoglPipelineLayer *layer = _cogl_slab_alloc0 (&layer_slab);
   CoglPipelineLayerBigState *big_state =
-    g_slice_new0 (CoglPipelineLayerBigState);
+    _cogl_slab_alloc0 (&layer_big_state_slab);
   CoglPipelineLayer *new;
 
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
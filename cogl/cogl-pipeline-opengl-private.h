@@ -87,6 +87,11 @@ typedef struct _CoglTextureUnit
    */
   gboolean           dirty_gl_texture;
 
+  /* The GL sampler object bound to the unit with glBindSampler or 0
+   * if the filter and wrap modes are taken from the texture object.
+   * This is only used when GL_ARB_sampler_objects is available */
+  GLuint             gl_sampler;
+
   /* A matrix stack giving us the means to associate a texture
    * transform matrix with the texture unit. */
   CoglMatrixStack   *matrix_stack;
@@ -132,6 +137,9 @@ _cogl_get_texture_unit (int index_);
 void
 _cogl_destroy_texture_units (void);
 
+void
+_cogl_destroy_samplers (void);
+
 void
 _cogl_set_active_texture_unit (int unit_index);
 
@@ -151,5 +159,14 @@ _cogl_pipeline_flush_gl_state (CoglPipeline *pipeline,
                                gboolean skip_gl_state,
                                int n_tex_coord_attribs);
 
+gboolean
+_cogl_pipeline_has_pending_precompiles (CoglContext *context);
+
+void
+_cogl_pipeline_dispatch_precompiles (CoglContext *context);
+
+void
+_cogl_pipeline_clear_pending_precompiles (CoglContext *context);
+
 #endif /* __COGL_PIPELINE_OPENGL_PRIVATE_H */
 
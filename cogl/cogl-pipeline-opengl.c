@@ -37,6 +37,7 @@
 #include "cogl-context-private.h"
 #include "cogl-texture-private.h"
 #include "cogl-framebuffer-private.h"
+#include "cogl-util.h"
 
 /* This is needed to set the color attribute on GLES2 */
 #ifdef HAVE_COGL_GLES2
@@ -60,6 +61,12 @@
 #ifndef GL_CLAMP_TO_BORDER
 #define GL_CLAMP_TO_BORDER 0x812d
 #endif
+#ifndef GL_TEXTURE_WRAP_R
+#define GL_TEXTURE_WRAP_R 0x8072
+#endif
+#ifndef GL_TEXTURE_3D
+#define GL_TEXTURE_3D 0x806F
+#endif
 
 
 static void
@@ -71,6 +78,7 @@ texture_unit_init (CoglTextureUnit *unit, int index_)
   unit->gl_target = 0;
   unit->is_foreign = FALSE;
   unit->dirty_gl_texture = FALSE;
+  unit->gl_sampler = 0;
   unit->matrix_stack = _cogl_matrix_stack_new ();
 
   unit->layer = NULL;
@@ -124,16 +132,133 @@ _cogl_destroy_texture_units (void)
   g_array_free (ctx->texture_units, TRUE);
 }
 
+/* Sampler objects are shared between all of the texture units that
+ * use the same filter and wrap modes. There can only be a handful of
+ * different combinations so the cache is never pruned */
+typedef struct
+{
+  GLenum min_filter;
+  GLenum mag_filter;
+  GLenum wrap_mode_s;
+  GLenum wrap_mode_t;
+  GLenum wrap_mode_p;
+} CoglSamplerCacheKey;
+
+typedef struct
+{
+  CoglSamplerCacheKey key;
+  GLuint gl_sampler;
+} CoglSamplerCacheEntry;
+
+static unsigned int
+sampler_cache_key_hash (const void *data)
+{
+  unsigned int hash;
+
+  hash = _cogl_util_one_at_a_time_hash (0, data,
+                                        sizeof (CoglSamplerCacheKey));
+
+  return _cogl_util_one_at_a_time_mix (hash);
+}
+
+static gboolean
+sampler_cache_key_equal (const void *a,
+                         const void *b)
+{
+  return !memcmp (a, b, sizeof (CoglSamplerCacheKey));
+}
+
+static void
+sampler_cache_entry_free (void *data)
+{
+  CoglSamplerCacheEntry *entry = data;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  GE (ctx, glDeleteSamplers (1, &entry->gl_sampler));
+
+  g_slice_free (CoglSamplerCacheEntry, entry);
+}
+
+void
+_cogl_destroy_samplers (void)
+{
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  if (ctx->sampler_cache)
+    g_hash_table_destroy (ctx->sampler_cache);
+}
+
+static GLuint
+get_gl_sampler (GLenum min_filter,
+                GLenum mag_filter,
+                GLenum wrap_mode_s,
+                GLenum wrap_mode_t,
+                GLenum wrap_mode_p)
+{
+  CoglSamplerCacheKey key;
+  CoglSamplerCacheEntry *entry;
+
+  COGL_STATIC_COUNTER (sampler_create_counter,
+                       "Sampler create counter",
+                       "Increments each time a GL sampler object is created",
+                       0 /* no application private data */);
+
+  _COGL_GET_CONTEXT (ctx, 0);
+
+  if (ctx->sampler_cache == NULL)
+    ctx->sampler_cache = g_hash_table_new_full (sampler_cache_key_hash,
+                                                sampler_cache_key_equal,
+                                                NULL, /* key destroy */
+                                                sampler_cache_entry_free);
+
+  /* Clear the whole struct so that any padding won't affect the hash
+     or the comparison */
+  memset (&key, 0, sizeof (key));
+  key.min_filter = min_filter;
+  key.mag_filter = mag_filter;
+  key.wrap_mode_s = wrap_mode_s;
+  key.wrap_mode_t = wrap_mode_t;
+  key.wrap_mode_p = wrap_mode_p;
+
+  entry = g_hash_table_lookup (ctx->sampler_cache, &key);
+
+  if (entry)
+    return entry->gl_sampler;
+
+  COGL_COUNTER_INC (_cogl_uprof_context, sampler_create_counter);
+
+  entry = g_slice_new (CoglSamplerCacheEntry);
+  entry->key = key;
+
+  GE (ctx, glGenSamplers (1, &entry->gl_sampler));
+  GE (ctx, glSamplerParameteri (entry->gl_sampler,
+                                GL_TEXTURE_MIN_FILTER,
+                                min_filter));
+  GE (ctx, glSamplerParameteri (entry->gl_sampler,
+                                GL_TEXTURE_MAG_FILTER,
+                                mag_filter));
+  GE (ctx, glSamplerParameteri (entry->gl_sampler,
+                                GL_TEXTURE_WRAP_S,
+                                wrap_mode_s));
+  GE (ctx, glSamplerParameteri (entry->gl_sampler,
+                                GL_TEXTURE_WRAP_T,
+                                wrap_mode_t));
+  GE (ctx, glSamplerParameteri (entry->gl_sampler,
+                                GL_TEXTURE_WRAP_R,
+                                wrap_mode_p));
+
+  g_hash_table_insert (ctx->sampler_cache, &entry->key, entry);
+
+  return entry->gl_sampler;
+}
+
 void
 _cogl_set_active_texture_unit (int unit_index)
 {
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
-  if (ctx->active_texture_unit != unit_index)
-    {
-      GE (ctx, glActiveTexture (GL_TEXTURE0 + unit_index));
-      ctx->active_texture_unit = unit_index;
-    }
+  _cogl_gl_state_active_texture (ctx, unit_index);
 }
 
 /* Note: _cogl_bind_gl_texture_transient conceptually has slightly
@@ -243,21 +368,7 @@ set_glsl_program (GLuint gl_program)
 {
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
-  if (ctx->current_gl_program != gl_program)
-    {
-      GLenum gl_error;
-
-      while ((gl_error = ctx->glGetError ()) != GL_NO_ERROR)
-        ;
-      ctx->glUseProgram (gl_program);
-      if (ctx->glGetError () == GL_NO_ERROR)
-        ctx->current_gl_program = gl_program;
-      else
-        {
-          GE( ctx, glUseProgram (0) );
-          ctx->current_gl_program = 0;
-        }
-    }
+  _cogl_gl_state_use_program (ctx, gl_program);
 }
 
 void
@@ -406,33 +517,13 @@ flush_depth_state (CoglDepthState *depth_state)
 {
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
-  if (ctx->depth_test_function_cache != depth_state->test_function)
-    {
-      GE (ctx, glDepthFunc (depth_state->test_function));
-      ctx->depth_test_function_cache = depth_state->test_function;
-    }
-
-  if (ctx->depth_writing_enabled_cache != depth_state->write_enabled)
-    {
-      GE (ctx, glDepthMask (depth_state->write_enabled ?
-                            GL_TRUE : GL_FALSE));
-      ctx->depth_writing_enabled_cache = depth_state->write_enabled;
-    }
-
-  if (ctx->driver != COGL_DRIVER_GLES1 &&
-      (ctx->depth_range_near_cache != depth_state->range_near ||
-       ctx->depth_range_far_cache != depth_state->range_far))
-    {
-      if (ctx->driver == COGL_DRIVER_GLES2)
-        GE (ctx, glDepthRangef (depth_state->range_near,
-                                depth_state->range_far));
-      else
-        GE (ctx, glDepthRange (depth_state->range_near,
-                               depth_state->range_far));
+  _cogl_gl_state_depth_func (ctx, depth_state->test_function);
+  _cogl_gl_state_depth_mask (ctx, depth_state->write_enabled);
 
-      ctx->depth_range_near_cache = depth_state->range_near;
-      ctx->depth_range_far_cache = depth_state->range_far;
-    }
+  if (ctx->driver != COGL_DRIVER_GLES1)
+    _cogl_gl_state_depth_range (ctx,
+                                depth_state->range_near,
+                                depth_state->range_far);
 }
 
 static void
@@ -471,8 +562,11 @@ _cogl_pipeline_flush_color_blend_alpha_depth_state (
       /* GLES 1 only has glBlendFunc */
       if (ctx->driver == COGL_DRIVER_GLES1)
         {
-          GE (ctx, glBlendFunc (blend_state->blend_src_factor_rgb,
-                                blend_state->blend_dst_factor_rgb));
+          _cogl_gl_state_blend_func (ctx,
+                                     blend_state->blend_src_factor_rgb,
+                                     blend_state->blend_dst_factor_rgb,
+                                     blend_state->blend_src_factor_rgb,
+                                     blend_state->blend_dst_factor_rgb);
         }
 #if defined(HAVE_COGL_GLES2) || defined(HAVE_COGL_GL)
       else
@@ -493,30 +587,18 @@ _cogl_pipeline_flush_color_blend_alpha_depth_state (
                 cogl_color_get_alpha_float (&blend_state->blend_constant);
 
 
-              GE (ctx, glBlendColor (red, green, blue, alpha));
+              _cogl_gl_state_blend_color (ctx, red, green, blue, alpha);
             }
 
-          if (ctx->glBlendEquationSeparate &&
-              blend_state->blend_equation_rgb !=
-              blend_state->blend_equation_alpha)
-            GE (ctx,
-                glBlendEquationSeparate (blend_state->blend_equation_rgb,
-                                         blend_state->blend_equation_alpha));
-          else
-            GE (ctx, glBlendEquation (blend_state->blend_equation_rgb));
-
-          if (ctx->glBlendFuncSeparate &&
-              (blend_state->blend_src_factor_rgb !=
-               blend_state->blend_src_factor_alpha ||
-               (blend_state->blend_src_factor_rgb !=
-                blend_state->blend_src_factor_alpha)))
-            GE (ctx, glBlendFuncSeparate (blend_state->blend_src_factor_rgb,
-                                          blend_state->blend_dst_factor_rgb,
-                                          blend_state->blend_src_factor_alpha,
-                                          blend_state->blend_dst_factor_alpha));
-          else
-            GE (ctx, glBlendFunc (blend_state->blend_src_factor_rgb,
-                                  blend_state->blend_dst_factor_rgb));
+          _cogl_gl_state_blend_equation (ctx,
+                                         blend_state->blend_equation_rgb,
+                                         blend_state->blend_equation_alpha);
+
+          _cogl_gl_state_blend_func (ctx,
+                                     blend_state->blend_src_factor_rgb,
+                                     blend_state->blend_dst_factor_rgb,
+                                     blend_state->blend_src_factor_alpha,
+                                     blend_state->blend_dst_factor_alpha);
         }
 #endif
     }
@@ -572,20 +654,11 @@ _cogl_pipeline_flush_color_blend_alpha_depth_state (
         _cogl_pipeline_get_authority (pipeline, COGL_PIPELINE_STATE_DEPTH);
       CoglDepthState *depth_state = &authority->big_state->depth_state;
 
+      _cogl_gl_state_set_enabled (ctx,
+                                  COGL_GL_STATE_CAP_DEPTH_TEST,
+                                  depth_state->test_enabled);
       if (depth_state->test_enabled)
-        {
-          if (ctx->depth_test_enabled_cache != TRUE)
-            {
-              GE (ctx, glEnable (GL_DEPTH_TEST));
-              ctx->depth_test_enabled_cache = depth_state->test_enabled;
-            }
-          flush_depth_state (depth_state);
-        }
-      else if (ctx->depth_test_enabled_cache != FALSE)
-        {
-          GE (ctx, glDisable (GL_DEPTH_TEST));
-          ctx->depth_test_enabled_cache = depth_state->test_enabled;
-        }
+        flush_depth_state (depth_state);
     }
 
   if (pipelines_difference & COGL_PIPELINE_STATE_LOGIC_OPS)
@@ -614,13 +687,13 @@ _cogl_pipeline_flush_color_blend_alpha_depth_state (
         = &authority->big_state->cull_face_state;
 
       if (cull_face_state->mode == COGL_PIPELINE_CULL_FACE_MODE_NONE)
-        GE( ctx, glDisable (GL_CULL_FACE) );
+        _cogl_gl_state_set_enabled (ctx, COGL_GL_STATE_CAP_CULL_FACE, FALSE);
       else
         {
           CoglFramebuffer *draw_framebuffer = cogl_get_draw_framebuffer ();
           gboolean invert_winding;
 
-          GE( ctx, glEnable (GL_CULL_FACE) );
+          _cogl_gl_state_set_enabled (ctx, COGL_GL_STATE_CAP_CULL_FACE, TRUE);
 
           switch (cull_face_state->mode)
             {
@@ -658,16 +731,11 @@ _cogl_pipeline_flush_color_blend_alpha_depth_state (
         }
     }
 
-  if (pipeline->real_blend_enable != ctx->gl_blend_enable_cache)
-    {
-      if (pipeline->real_blend_enable)
-        GE (ctx, glEnable (GL_BLEND));
-      else
-        GE (ctx, glDisable (GL_BLEND));
-      /* XXX: we shouldn't update any other blend state if blending
-       * is disabled! */
-      ctx->gl_blend_enable_cache = pipeline->real_blend_enable;
-    }
+  /* XXX: we shouldn't update any other blend state if blending
+   * is disabled! */
+  _cogl_gl_state_set_enabled (ctx,
+                              COGL_GL_STATE_CAP_BLEND,
+                              pipeline->real_blend_enable);
 }
 
 static int
@@ -748,8 +816,72 @@ typedef struct
 {
   int i;
   unsigned long *layer_differences;
+
+  /* When GL_ARB_multi_bind is available the texture units that need
+   * to be rebound are collected in these ranges so that they can all
+   * be bound with a single call once every layer has been visited */
+  int first_texture_unit, last_texture_unit;
+  int first_sampler_unit, last_sampler_unit;
 } CoglPipelineFlushLayerState;
 
+static void
+extend_bind_range (int *first, int *last, int unit_index)
+{
+  if (*first == -1 || unit_index < *first)
+    *first = unit_index;
+  if (*last == -1 || unit_index > *last)
+    *last = unit_index;
+}
+
+static void
+get_gl_wrap_modes (CoglPipelineLayer *layer,
+                   GLenum *gl_wrap_mode_s,
+                   GLenum *gl_wrap_mode_t,
+                   GLenum *gl_wrap_mode_p)
+{
+  CoglPipelineWrapModeInternal wrap_mode_s, wrap_mode_t, wrap_mode_p;
+
+  _cogl_pipeline_layer_get_wrap_modes (layer,
+                                       &wrap_mode_s,
+                                       &wrap_mode_t,
+                                       &wrap_mode_p);
+
+  if (wrap_mode_s == COGL_PIPELINE_WRAP_MODE_INTERNAL_AUTOMATIC)
+    *gl_wrap_mode_s = GL_CLAMP_TO_EDGE;
+  else
+    *gl_wrap_mode_s = wrap_mode_s;
+
+  if (wrap_mode_t == COGL_PIPELINE_WRAP_MODE_INTERNAL_AUTOMATIC)
+    *gl_wrap_mode_t = GL_CLAMP_TO_EDGE;
+  else
+    *gl_wrap_mode_t = wrap_mode_t;
+
+  if (wrap_mode_p == COGL_PIPELINE_WRAP_MODE_INTERNAL_AUTOMATIC)
+    *gl_wrap_mode_p = GL_CLAMP_TO_EDGE;
+  else
+    *gl_wrap_mode_p = wrap_mode_p;
+}
+
+/* Returns the sampler object to bind for the given layer or 0 if the
+ * filter and wrap modes should be set on the texture object instead */
+static GLuint
+get_layer_gl_sampler (CoglPipelineLayer *layer, GLenum gl_target)
+{
+  CoglPipelineFilter min, mag;
+  GLenum wrap_mode_s, wrap_mode_t, wrap_mode_p;
+
+  /* Rectangle textures only accept a subset of the filters and wrap
+   * modes so they keep using the texture parameters which the
+   * backend can validate */
+  if (gl_target != GL_TEXTURE_2D && gl_target != GL_TEXTURE_3D)
+    return 0;
+
+  _cogl_pipeline_layer_get_filters (layer, &min, &mag);
+  get_gl_wrap_modes (layer, &wrap_mode_s, &wrap_mode_t, &wrap_mode_p);
+
+  return get_gl_sampler (min, mag, wrap_mode_s, wrap_mode_t, wrap_mode_p);
+}
+
 static gboolean
 flush_layers_common_gl_state_cb (CoglPipelineLayer *layer, void *user_data)
 {
@@ -758,9 +890,23 @@ flush_layers_common_gl_state_cb (CoglPipelineLayer *layer, void *user_data)
   CoglTextureUnit             *unit = _cogl_get_texture_unit (unit_index);
   unsigned long                layers_difference =
     flush_state->layer_differences[unit_index];
+  gboolean                     multi_bind;
+
+  COGL_STATIC_COUNTER (texture_bind_counter,
+                       "Texture bind counter",
+                       "Increments each time glBindTexture is called "
+                       "while flushing pipeline layers",
+                       0 /* no application private data */);
+  COGL_STATIC_COUNTER (sampler_bind_counter,
+                       "Sampler bind counter",
+                       "Increments each time glBindSampler is called "
+                       "while flushing pipeline layers",
+                       0 /* no application private data */);
 
   _COGL_GET_CONTEXT (ctx, FALSE);
 
+  multi_bind = !!(ctx->private_feature_flags & COGL_PRIVATE_FEATURE_MULTI_BIND);
+
   /* There may not be enough texture units so we can bail out if
    * that's the case...
    */
@@ -794,7 +940,9 @@ flush_layers_common_gl_state_cb (CoglPipelineLayer *layer, void *user_data)
                                    &gl_texture,
                                    &gl_target);
 
-      _cogl_set_active_texture_unit (unit_index);
+      /* glBindTextures doesn't depend on the active texture unit */
+      if (!multi_bind)
+        _cogl_set_active_texture_unit (unit_index);
 
       /* NB: There are several Cogl components and some code in
        * Clutter that will temporarily bind arbitrary GL textures to
@@ -823,10 +971,17 @@ flush_layers_common_gl_state_cb (CoglPipelineLayer *layer, void *user_data)
        */
       if (unit->gl_texture != gl_texture || unit->is_foreign)
         {
-          if (unit_index == 1)
+          if (multi_bind)
+            extend_bind_range (&flush_state->first_texture_unit,
+                               &flush_state->last_texture_unit,
+                               unit_index);
+          else if (unit_index == 1)
             unit->dirty_gl_texture = TRUE;
           else
-            GE (ctx, glBindTexture (gl_target, gl_texture));
+            {
+              GE (ctx, glBindTexture (gl_target, gl_texture));
+              COGL_COUNTER_INC (_cogl_uprof_context, texture_bind_counter);
+            }
           unit->gl_texture = gl_texture;
           unit->gl_target = gl_target;
         }
@@ -840,6 +995,38 @@ flush_layers_common_gl_state_cb (CoglPipelineLayer *layer, void *user_data)
       unit->texture_storage_changed = FALSE;
     }
 
+  /* The multi-bind includes unit 1 whenever it is used by the
+   * pipeline and something has temporarily bound another texture to
+   * it. Any transient binds made later in the flush will mark it as
+   * dirty again so it will still be fixed up at the end of
+   * _cogl_pipeline_flush_gl_state() */
+  if (multi_bind && unit_index == 1 && unit->dirty_gl_texture)
+    extend_bind_range (&flush_state->first_texture_unit,
+                       &flush_state->last_texture_unit,
+                       unit_index);
+
+  if ((ctx->private_feature_flags & COGL_PRIVATE_FEATURE_SAMPLER_OBJECTS) &&
+      (layers_difference & (COGL_PIPELINE_LAYER_STATE_TEXTURE_DATA |
+                            COGL_PIPELINE_LAYER_STATE_FILTERS |
+                            COGL_PIPELINE_LAYER_STATE_WRAP_MODES)))
+    {
+      GLuint gl_sampler = get_layer_gl_sampler (layer, unit->gl_target);
+
+      if (unit->gl_sampler != gl_sampler)
+        {
+          if (multi_bind)
+            extend_bind_range (&flush_state->first_sampler_unit,
+                               &flush_state->last_sampler_unit,
+                               unit_index);
+          else
+            {
+              GE (ctx, glBindSampler (unit_index, gl_sampler));
+              COGL_COUNTER_INC (_cogl_uprof_context, sampler_bind_counter);
+            }
+          unit->gl_sampler = gl_sampler;
+        }
+    }
+
   /* Under GLES2 the fragment shader will use gl_PointCoord instead of
      replacing the texture coordinates */
 #if defined (HAVE_COGL_GLES) || defined (HAVE_COGL_GL)
@@ -870,6 +1057,58 @@ flush_layers_common_gl_state_cb (CoglPipelineLayer *layer, void *user_data)
   return TRUE;
 }
 
+/* Binds the textures for a range of units with one call. The units
+ * in between that didn't change are rebound with the texture that is
+ * already there */
+static void
+multi_bind_textures (int first, int last)
+{
+  int count = last - first + 1;
+  GLuint *gl_textures = g_alloca (sizeof (GLuint) * count);
+  int i;
+
+  COGL_STATIC_COUNTER (texture_multi_bind_counter,
+                       "Texture multi-bind counter",
+                       "Increments each time glBindTextures is called "
+                       "while flushing pipeline layers",
+                       0 /* no application private data */);
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  for (i = 0; i < count; i++)
+    {
+      CoglTextureUnit *unit = _cogl_get_texture_unit (first + i);
+
+      gl_textures[i] = unit->gl_texture;
+      unit->dirty_gl_texture = FALSE;
+    }
+
+  GE (ctx, glBindTextures (first, count, gl_textures));
+  COGL_COUNTER_INC (_cogl_uprof_context, texture_multi_bind_counter);
+}
+
+static void
+multi_bind_samplers (int first, int last)
+{
+  int count = last - first + 1;
+  GLuint *gl_samplers = g_alloca (sizeof (GLuint) * count);
+  int i;
+
+  COGL_STATIC_COUNTER (sampler_multi_bind_counter,
+                       "Sampler multi-bind counter",
+                       "Increments each time glBindSamplers is called "
+                       "while flushing pipeline layers",
+                       0 /* no application private data */);
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  for (i = 0; i < count; i++)
+    gl_samplers[i] = _cogl_get_texture_unit (first + i)->gl_sampler;
+
+  GE (ctx, glBindSamplers (first, count, gl_samplers));
+  COGL_COUNTER_INC (_cogl_uprof_context, sampler_multi_bind_counter);
+}
+
 static void
 _cogl_pipeline_flush_common_gl_state (CoglPipeline  *pipeline,
                                       unsigned long  pipelines_difference,
@@ -886,9 +1125,18 @@ _cogl_pipeline_flush_common_gl_state (CoglPipeline  *pipeline,
 
   state.i = 0;
   state.layer_differences = layer_differences;
+  state.first_texture_unit = state.last_texture_unit = -1;
+  state.first_sampler_unit = state.last_sampler_unit = -1;
   _cogl_pipeline_foreach_layer_internal (pipeline,
                                          flush_layers_common_gl_state_cb,
                                          &state);
+
+  if (state.first_texture_unit != -1)
+    multi_bind_textures (state.first_texture_unit,
+                         state.last_texture_unit);
+  if (state.first_sampler_unit != -1)
+    multi_bind_samplers (state.first_sampler_unit,
+                         state.last_sampler_unit);
 }
 
 /* Re-assert the layer's wrap modes on the given CoglTexture.
@@ -900,17 +1148,11 @@ static void
 _cogl_pipeline_layer_forward_wrap_modes (CoglPipelineLayer *layer,
                                          CoglTexture *texture)
 {
-  CoglPipelineWrapModeInternal wrap_mode_s, wrap_mode_t, wrap_mode_p;
   GLenum gl_wrap_mode_s, gl_wrap_mode_t, gl_wrap_mode_p;
 
   if (texture == NULL)
     return;
 
-  _cogl_pipeline_layer_get_wrap_modes (layer,
-                                       &wrap_mode_s,
-                                       &wrap_mode_t,
-                                       &wrap_mode_p);
-
   /* Update the wrap mode on the texture object. The texture backend
      should cache the value so that it will be a no-op if the object
      already has the same wrap mode set. The backend is best placed to
@@ -922,20 +1164,7 @@ _cogl_pipeline_layer_forward_wrap_modes (CoglPipelineLayer *layer,
      will break if the application tries to use different modes in
      different layers using the same texture. */
 
-  if (wrap_mode_s == COGL_PIPELINE_WRAP_MODE_INTERNAL_AUTOMATIC)
-    gl_wrap_mode_s = GL_CLAMP_TO_EDGE;
-  else
-    gl_wrap_mode_s = wrap_mode_s;
-
-  if (wrap_mode_t == COGL_PIPELINE_WRAP_MODE_INTERNAL_AUTOMATIC)
-    gl_wrap_mode_t = GL_CLAMP_TO_EDGE;
-  else
-    gl_wrap_mode_t = wrap_mode_t;
-
-  if (wrap_mode_p == COGL_PIPELINE_WRAP_MODE_INTERNAL_AUTOMATIC)
-    gl_wrap_mode_p = GL_CLAMP_TO_EDGE;
-  else
-    gl_wrap_mode_p = wrap_mode_p;
+  get_gl_wrap_modes (layer, &gl_wrap_mode_s, &gl_wrap_mode_t, &gl_wrap_mode_p);
 
   _cogl_texture_set_wrap_mode_parameters (texture,
                                           gl_wrap_mode_s,
@@ -948,8 +1177,9 @@ _cogl_pipeline_layer_forward_wrap_modes (CoglPipelineLayer *layer,
  * the filter and repeat modes whenever we use a texture since it may
  * be referenced by multiple pipelines with different modes.
  *
- * XXX: GL_ARB_sampler_objects fixes this in OpenGL so we should
- * eventually look at using this extension when available.
+ * When GL_ARB_sampler_objects is available the units that have a
+ * sampler bound are skipped because the sampler state overrides the
+ * texture parameters.
  */
 static void
 foreach_texture_unit_update_filter_and_wrap_modes (void)
@@ -963,7 +1193,7 @@ foreach_texture_unit_update_filter_and_wrap_modes (void)
       CoglTextureUnit *unit =
         &g_array_index (ctx->texture_units, CoglTextureUnit, i);
 
-      if (unit->layer)
+      if (unit->layer && !unit->gl_sampler)
         {
           CoglTexture *texture = _cogl_pipeline_layer_get_texture (unit->layer);
 
@@ -1167,9 +1397,12 @@ _cogl_pipeline_flush_gl_state (CoglPipeline *pipeline,
   if (ctx->current_pipeline == pipeline)
     {
       /* Bail out asap if we've been asked to re-flush the already current
-       * pipeline and we can see the pipeline hasn't changed */
+       * pipeline and we can see the pipeline hasn't changed. If the
+       * program is still being linked then we need to go through the
+       * progend again so that it can check whether it has finished */
       if (ctx->current_pipeline_age == pipeline->age &&
-          ctx->current_pipeline_skip_gl_color == skip_gl_color)
+          ctx->current_pipeline_skip_gl_color == skip_gl_color &&
+          !ctx->current_pipeline_link_pending)
         goto done;
 
       pipelines_difference = ctx->current_pipeline_changes_since_flush;
@@ -1210,6 +1443,11 @@ _cogl_pipeline_flush_gl_state (CoglPipeline *pipeline,
   if (n_layers > n_tex_coord_attribs)
     n_tex_coord_attribs = n_layers;
 
+  /* The GLSL progend will set these again if this pipeline's program
+     is still being linked */
+  ctx->current_pipeline_link_pending = FALSE;
+  ctx->current_pipeline_skip_draws = FALSE;
+
   /* First flush everything that's the same regardless of which
    * pipeline backend is being used...
    *
@@ -1416,3 +1654,117 @@ done:
   COGL_TIMER_STOP (_cogl_uprof_context, pipeline_flush_timer);
 }
 
+
+static void
+precompile_pipeline (CoglPipeline *pipeline)
+{
+  int n_tex_coord_attribs;
+  int i;
+
+  COGL_STATIC_COUNTER (pipeline_precompile_counter,
+                       "Pipeline precompile counter",
+                       "Increments each time a pipeline is precompiled",
+                       0 /* no application private data */);
+
+  COGL_COUNTER_INC (_cogl_uprof_context, pipeline_precompile_counter);
+
+  /* This picks the backends in the same order as
+   * _cogl_pipeline_flush_gl_state but only asks them to generate and
+   * link their programs. None of the GL state is touched so the
+   * current pipeline stays valid. The programs end up attached to the
+   * templates in the pipeline cache so later pipelines with the same
+   * codegen state will find them there.
+   *
+   * The number of texture coordinate attributes is the number of
+   * layers which is what the journal and most primitives will use.
+   */
+  n_tex_coord_attribs = cogl_pipeline_get_n_layers (pipeline);
+
+  if (pipeline->fragend == COGL_PIPELINE_FRAGEND_UNDEFINED)
+    _cogl_pipeline_set_fragend (pipeline, COGL_PIPELINE_FRAGEND_DEFAULT);
+
+  for (i = pipeline->fragend;
+       i < G_N_ELEMENTS (_cogl_pipeline_fragends);
+       i++, _cogl_pipeline_set_fragend (pipeline, i))
+    if (_cogl_pipeline_fragends[i]->precompile (pipeline,
+                                                n_tex_coord_attribs))
+      break;
+
+  if (pipeline->vertend == COGL_PIPELINE_VERTEND_UNDEFINED)
+    _cogl_pipeline_set_vertend (pipeline, COGL_PIPELINE_VERTEND_DEFAULT);
+
+  for (i = pipeline->vertend;
+       i < G_N_ELEMENTS (_cogl_pipeline_vertends);
+       i++, _cogl_pipeline_set_vertend (pipeline, i))
+    if (_cogl_pipeline_vertends[i]->precompile (pipeline,
+                                                n_tex_coord_attribs))
+      break;
+
+  for (i = 0; i < COGL_PIPELINE_N_PROGENDS; i++)
+    if (_cogl_pipeline_progends[i]->precompile)
+      _cogl_pipeline_progends[i]->precompile (pipeline, n_tex_coord_attribs);
+}
+
+void
+cogl_pipeline_precompile (CoglContext *context,
+                          CoglPipeline *pipeline,
+                          CoglPipelinePrecompileFlags flags)
+{
+  cogl_pipeline_precompile_many (context, &pipeline, 1, flags);
+}
+
+void
+cogl_pipeline_precompile_many (CoglContext *context,
+                               CoglPipeline **pipelines,
+                               int n_pipelines,
+                               CoglPipelinePrecompileFlags flags)
+{
+  int i;
+
+  _COGL_RETURN_IF_FAIL (cogl_is_context (context));
+
+  for (i = 0; i < n_pipelines; i++)
+    {
+      _COGL_RETURN_IF_FAIL (cogl_is_pipeline (pipelines[i]));
+
+      if ((flags & COGL_PIPELINE_PRECOMPILE_FLAG_IDLE))
+        g_queue_push_tail (&context->precompile_queue,
+                           cogl_object_ref (pipelines[i]));
+      else
+        precompile_pipeline (pipelines[i]);
+    }
+}
+
+gboolean
+_cogl_pipeline_has_pending_precompiles (CoglContext *context)
+{
+  return !g_queue_is_empty (&context->precompile_queue);
+}
+
+void
+_cogl_pipeline_dispatch_precompiles (CoglContext *context)
+{
+  CoglPipeline *pipeline;
+
+  /* Linking a program can take a noticeable amount of time so only
+   * one pipeline is compiled per dispatch. The poll timeout is zero
+   * while the queue isn't empty so the application will come back
+   * for the next one after it has had a chance to handle its own
+   * events */
+  pipeline = g_queue_pop_head (&context->precompile_queue);
+
+  if (pipeline)
+    {
+      precompile_pipeline (pipeline);
+      cogl_object_unref (pipeline);
+    }
+}
+
+void
+_cogl_pipeline_clear_pending_precompiles (CoglContext *context)
+{
+  CoglPipeline *pipeline;
+
+  while ((pipeline = g_queue_pop_head (&context->precompile_queue)))
+    cogl_object_unref (pipeline);
+}
@@ -295,6 +295,36 @@ typedef enum _CoglPipelineState
    COGL_PIPELINE_STATE_USER_SHADER | \
    COGL_PIPELINE_STATE_VERTEX_SNIPPETS)
 
+/* The state hashed by _cogl_pipeline_get_batch_hash(). This is the
+ * subset of the state the journal compares to decide whether two
+ * entries can be batched together for which hashing is consistent
+ * with _cogl_pipeline_equal(). For example the depth state is left
+ * out because it is considered equal whenever depth testing is
+ * disabled but the hash would still include the depth range */
+#define COGL_PIPELINE_STATE_BATCH_HASH \
+  (COGL_PIPELINE_STATE_REAL_BLEND_ENABLE | \
+   COGL_PIPELINE_STATE_LAYERS | \
+   COGL_PIPELINE_STATE_LIGHTING | \
+   COGL_PIPELINE_STATE_ALPHA_FUNC | \
+   COGL_PIPELINE_STATE_ALPHA_FUNC_REFERENCE | \
+   COGL_PIPELINE_STATE_USER_SHADER | \
+   COGL_PIPELINE_STATE_POINT_SIZE | \
+   COGL_PIPELINE_STATE_LOGIC_OPS | \
+   COGL_PIPELINE_STATE_CULL_FACE | \
+   COGL_PIPELINE_STATE_VERTEX_SNIPPETS | \
+   COGL_PIPELINE_STATE_FRAGMENT_SNIPPETS)
+
+/* The texture data is left out because the GL texture of an atlased
+ * texture can change without the pipeline being modified. */
+#define COGL_PIPELINE_LAYER_STATE_BATCH_HASH \
+  (COGL_PIPELINE_LAYER_STATE_TEXTURE_TARGET | \
+   COGL_PIPELINE_LAYER_STATE_FILTERS | \
+   COGL_PIPELINE_LAYER_STATE_COMBINE | \
+   COGL_PIPELINE_LAYER_STATE_USER_MATRIX | \
+   COGL_PIPELINE_LAYER_STATE_POINT_SPRITE_COORDS | \
+   COGL_PIPELINE_LAYER_STATE_VERTEX_SNIPPETS | \
+   COGL_PIPELINE_LAYER_STATE_FRAGMENT_SNIPPETS)
+
 typedef enum
 {
   COGL_PIPELINE_LIGHTING_STATE_PROPERTY_AMBIENT = 1,
@@ -425,6 +455,21 @@ typedef struct _CoglPipelineHashState
 typedef void (*CoglPipelineDestroyCallback)(CoglPipeline *pipeline,
                                             void *user_data);
 
+/* A flattened table of the authority for every sparse state group of
+ * a pipeline. It is freed whenever the pipeline is modified or
+ * reparented and it is only valid while ctx->pipeline_graph_age
+ * matches the age it was built with. */
+typedef struct
+{
+  unsigned long age;
+  CoglPipeline *authorities[COGL_PIPELINE_STATE_SPARSE_COUNT];
+
+  /* Memoized result of _cogl_pipeline_get_batch_hash(). This is
+   * invalidated along with the authorities. */
+  unsigned int batch_hash;
+  gboolean batch_hash_valid;
+} CoglPipelineAuthoritiesCache;
+
 struct _CoglPipeline
 {
   /* XXX: Please think twice about adding members that *have* be
@@ -507,11 +552,11 @@ struct _CoglPipeline
    * const GList of layers, which we track here... */
   GList                *deprecated_get_layers_list;
 
-  /* XXX: consider adding an authorities cache to speed up sparse
-   * property value lookups:
-   * CoglPipeline *authorities_cache[COGL_PIPELINE_N_SPARSE_PROPERTIES];
-   * and corresponding authorities_cache_dirty:1 bitfield
-   */
+  /* A cache of the authority for each sparse state group so that
+   * comparing and hashing pipelines doesn't have to walk the ancestry
+   * every time. This is only allocated the first time it is needed,
+   * see _cogl_pipeline_get_authorities() */
+  CoglPipelineAuthoritiesCache *authorities_cache;
 
   /* bitfields */
 
@@ -563,6 +608,11 @@ typedef struct _CoglPipelineFragend
   gboolean (*passthrough) (CoglPipeline *pipeline);
   gboolean (*end) (CoglPipeline *pipeline,
                    unsigned long pipelines_difference);
+  /* Generates and compiles any shader the fragend needs for the
+     pipeline without flushing any GL state. This returns FALSE if the
+     fragend can't handle the pipeline in the same way as start */
+  gboolean (*precompile) (CoglPipeline *pipeline,
+                          int n_tex_coord_attribs);
 
   void (*pipeline_pre_change_notify) (CoglPipeline *pipeline,
                                       CoglPipelineState change,
@@ -584,6 +634,11 @@ typedef struct _CoglPipelineVertend
                          unsigned long layers_difference);
   gboolean (*end) (CoglPipeline *pipeline,
                    unsigned long pipelines_difference);
+  /* Generates and compiles any shader the vertend needs for the
+     pipeline without flushing any GL state. This returns FALSE if the
+     vertend can't handle the pipeline in the same way as start */
+  gboolean (*precompile) (CoglPipeline *pipeline,
+                          int n_tex_coord_attribs);
 
   void (*pipeline_pre_change_notify) (CoglPipeline *pipeline,
                                       CoglPipelineState change,
@@ -598,6 +653,11 @@ typedef struct
   void (*end) (CoglPipeline *pipeline,
                unsigned long pipelines_difference,
                int n_tex_coord_attribs);
+  /* Links the program for the pipeline after the fragend and vertend
+     have been precompiled. This must not bind the program or update
+     any uniforms */
+  void (*precompile) (CoglPipeline *pipeline,
+                      int n_tex_coord_attribs);
   void (*pipeline_pre_change_notify) (CoglPipeline *pipeline,
                                       CoglPipelineState change,
                                       const CoglColor *new_color);
@@ -904,6 +964,20 @@ _cogl_pipeline_hash (CoglPipeline *pipeline,
                      unsigned long layer_differences,
                      CoglPipelineEvalFlags flags);
 
+/*
+ * _cogl_pipeline_get_batch_hash:
+ * @pipeline: A #CoglPipeline
+ *
+ * Returns a hash of the COGL_PIPELINE_STATE_BATCH_HASH and
+ * COGL_PIPELINE_LAYER_STATE_BATCH_HASH state of @pipeline. The hash
+ * is memoized until the pipeline or its ancestry is modified. If two
+ * pipelines have different batch hashes then _cogl_pipeline_equal()
+ * would consider them different when comparing the state used by the
+ * journal, so the journal can use this to avoid a full comparison.
+ */
+unsigned int
+_cogl_pipeline_get_batch_hash (CoglPipeline *pipeline);
+
 CoglPipeline *
 _cogl_pipeline_journal_ref (CoglPipeline *pipeline);
 
@@ -61,6 +61,7 @@ _cogl_pipeline_progend_fixed_pre_paint (CoglPipeline *pipeline)
 const CoglPipelineProgend _cogl_pipeline_fixed_progend =
   {
     NULL, /* end */
+    NULL, /* precompile */
     NULL, /* pre_change_notify */
     NULL, /* layer_pre_change_notify */
     _cogl_pipeline_progend_fixed_pre_paint
@@ -49,6 +49,52 @@
 #include "cogl-pipeline-state-private.h"
 #include "cogl-attribute-private.h"
 #include "cogl-framebuffer-private.h"
+#include "cogl-pipeline-snippet-private.h"
+#include "cogl-shader-boilerplate.h"
+#include "cogl-gl-state-private.h"
+
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER 0x8A11
+#endif
+#ifndef GL_ACTIVE_UNIFORM_BLOCKS
+#define GL_ACTIVE_UNIFORM_BLOCKS 0x8A36
+#endif
+#ifndef GL_UNIFORM_SIZE
+#define GL_UNIFORM_SIZE 0x8A38
+#endif
+#ifndef GL_UNIFORM_BLOCK_INDEX
+#define GL_UNIFORM_BLOCK_INDEX 0x8A3A
+#endif
+#ifndef GL_UNIFORM_OFFSET
+#define GL_UNIFORM_OFFSET 0x8A3B
+#endif
+#ifndef GL_UNIFORM_ARRAY_STRIDE
+#define GL_UNIFORM_ARRAY_STRIDE 0x8A3C
+#endif
+#ifndef GL_UNIFORM_MATRIX_STRIDE
+#define GL_UNIFORM_MATRIX_STRIDE 0x8A3D
+#endif
+#ifndef GL_UNIFORM_IS_ROW_MAJOR
+#define GL_UNIFORM_IS_ROW_MAJOR 0x8A3E
+#endif
+#ifndef GL_UNIFORM_BLOCK_DATA_SIZE
+#define GL_UNIFORM_BLOCK_DATA_SIZE 0x8A40
+#endif
+#ifndef GL_INVALID_INDEX
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+#endif
+#ifndef GL_DYNAMIC_DRAW
+#define GL_DYNAMIC_DRAW 0x88E8
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+/* Without GL_KHR_parallel_shader_compile the driver can't tell us
+   whether an asynchronous link has finished without waiting for it
+   so the status is only checked after the next frame or after this
+   many microseconds */
+#define LINK_CHECK_DELAY (16 * 1000)
 
 #ifdef HAVE_COGL_GLES2
 
@@ -95,7 +141,60 @@ typedef struct _UnitState
   GLint texture_matrix_uniform;
 } UnitState;
 
+/* If the GL driver supports uniform buffer objects then any custom
+   uniforms that the shaders declare inside a uniform block are
+   written into a copy of the block in client memory. The whole block
+   is then uploaded with a single buffer write when the pipeline is
+   flushed instead of making a glUniform call for each value. The
+   uniforms declared by snippets are packed into a block for each
+   shader stage by the fragend and vertend so they are handled the
+   same way. */
+typedef struct
+{
+  GLuint buffer;
+  GLuint binding;
+  int size;
+  guint8 *data;
+  gboolean dirty;
+} UniformBlock;
+
+/* The builtin matrices are in a block that is shared by every
+   program. It is always attached to this binding point and the
+   blocks of each program use the binding points after it */
+#define BUILTIN_BLOCK_BINDING 0
+
+/* The size of the builtin block. This is three mat4s with the std140
+   layout */
+#define BUILTIN_BLOCK_SIZE (sizeof (float) * 16 * 3)
+
+/* A custom uniform can be in a block that the user declared without
+   an instance name as well as in the packed blocks for both shader
+   stages */
+#define N_UNIFORM_BLOCK_NAMES 3
+
+typedef struct
+{
+  int block;
+  int array_size;
+  int offset;
+  int array_stride;
+  int matrix_stride;
+  gboolean row_major;
+} UniformBlockMember;
+
+/* Where to put the value of a custom uniform. If location is not -1
+   the value is set with glUniform* using location. The value is also
+   written into each uniform block that the uniform is a member of.
+   The block is an index into the uniform_blocks array. */
 typedef struct
+{
+  GLint location;
+
+  int n_members;
+  UniformBlockMember members[N_UNIFORM_BLOCK_NAMES];
+} UniformLocation;
+
+typedef struct _CoglPipelineProgramState
 {
   unsigned int ref_count;
 
@@ -105,6 +204,26 @@ typedef struct
 
   GLuint program;
 
+  /* When async shaders are enabled this is set from when the program
+     is linked until the link has finished. The program can't be used
+     in that time. The frame counter and time are recorded to know
+     when to check the status if the driver can't tell us */
+  gboolean link_pending;
+  unsigned int link_frame;
+  gint64 link_time;
+
+  /* Set when the program was linked by cogl_pipeline_precompile() so
+     that the uniform locations get queried the first time it is
+     flushed */
+  gboolean locations_dirty;
+
+  /* The ready program state of an ancestor pipeline that is used
+     instead while the link is pending. This holds a reference */
+  struct _CoglPipelineProgramState *placeholder;
+
+  /* The number of entries in unit_state */
+  int n_layers;
+
   /* To allow writing shaders that are portable between GLES 2 and
    * OpenGL Cogl prepends a number of boilerplate #defines and
    * declarations to user shaders. One of those declarations is an
@@ -130,11 +249,20 @@ typedef struct
    * so know if we need to update all of the uniforms */
   CoglPipeline *last_used_for_pipeline;
 
-  /* Array of GL uniform locations indexed by Cogl's uniform
+  /* Array of UniformLocations indexed by Cogl's uniform
      location. We are careful only to allocated this array if a custom
      uniform is actually set */
   GArray *uniform_locations;
 
+  /* The uniform blocks declared by the program. This is only used
+     when COGL_PRIVATE_FEATURE_UBOS is available */
+  UniformBlock *uniform_blocks;
+  int n_uniform_blocks;
+
+  /* The index of the block containing the builtin matrices or -1 if
+     the program doesn't use it */
+  int builtin_block;
+
   /* Array of attribute locations. */
   GArray *attribute_locations;
 
@@ -156,6 +284,21 @@ get_program_state (CoglPipeline *pipeline)
   return cogl_object_get_user_data (COGL_OBJECT (pipeline), &program_state_key);
 }
 
+/* While the program is being linked the pipeline may have been
+   flushed with the program of a placeholder instead. This returns the
+   program state that was really used or NULL if the draw is being
+   skipped */
+static CoglPipelineProgramState *
+get_flushed_program_state (CoglPipeline *pipeline)
+{
+  CoglPipelineProgramState *program_state = get_program_state (pipeline);
+
+  if (program_state && program_state->link_pending)
+    return program_state->placeholder;
+
+  return program_state;
+}
+
 #define UNIFORM_LOCATION_UNKNOWN -2
 
 #define ATTRIBUTE_LOCATION_UNKNOWN -2
@@ -176,7 +319,8 @@ int
 _cogl_pipeline_progend_glsl_get_attrib_location (CoglPipeline *pipeline,
                                                  int name_index)
 {
-  CoglPipelineProgramState *program_state = get_program_state (pipeline);
+  CoglPipelineProgramState *program_state =
+    get_flushed_program_state (pipeline);
   int *locations;
 
   _COGL_GET_CONTEXT (ctx, -1);
@@ -238,6 +382,136 @@ clear_flushed_matrix_stacks (CoglPipelineProgramState *program_state)
 
 #endif /* HAVE_COGL_GLES2 */
 
+static void
+clear_uniform_blocks (CoglPipelineProgramState *program_state)
+{
+  int i;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  for (i = 0; i < program_state->n_uniform_blocks; i++)
+    {
+      UniformBlock *block = program_state->uniform_blocks + i;
+
+      /* The builtin block doesn't have a buffer of its own */
+      if (block->buffer)
+        _cogl_gl_state_delete_buffer (ctx, block->buffer);
+      g_free (block->data);
+    }
+
+  g_free (program_state->uniform_blocks);
+  program_state->uniform_blocks = NULL;
+  program_state->n_uniform_blocks = 0;
+  program_state->builtin_block = -1;
+}
+
+/* This is called after the program is linked to create a buffer for
+   each of its uniform blocks. The builtin block is attached to
+   BUILTIN_BLOCK_BINDING and block i is attached to binding point
+   i + 1. The binding points are shared with every other program so
+   the buffers need to be rebound whenever the program is used. The
+   buffers are filled the first time the program is flushed */
+static void
+setup_uniform_blocks (CoglPipelineProgramState *program_state)
+{
+  GLint n_blocks;
+  GLuint builtin_block;
+  int i;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  clear_uniform_blocks (program_state);
+
+  if (!(ctx->private_feature_flags & COGL_PRIVATE_FEATURE_UBOS))
+    return;
+
+  GE( ctx, glGetProgramiv (program_state->program,
+                           GL_ACTIVE_UNIFORM_BLOCKS,
+                           &n_blocks) );
+
+  if (n_blocks <= 0)
+    return;
+
+  program_state->uniform_blocks = g_new (UniformBlock, n_blocks);
+  program_state->n_uniform_blocks = n_blocks;
+
+  GE_RET( builtin_block,
+          ctx, glGetUniformBlockIndex (program_state->program,
+                                       _COGL_BUILTIN_UNIFORM_BLOCK_NAME) );
+
+  for (i = 0; i < n_blocks; i++)
+    {
+      UniformBlock *block = program_state->uniform_blocks + i;
+      GLint size;
+
+      if ((GLuint) i == builtin_block)
+        {
+          program_state->builtin_block = i;
+
+          block->buffer = 0;
+          block->binding = BUILTIN_BLOCK_BINDING;
+          block->size = 0;
+          block->data = NULL;
+          block->dirty = FALSE;
+        }
+      else
+        {
+          GE( ctx, glGetActiveUniformBlockiv (program_state->program,
+                                              i,
+                                              GL_UNIFORM_BLOCK_DATA_SIZE,
+                                              &size) );
+
+          block->binding = i + 1;
+          block->size = size;
+          block->data = g_malloc0 (size);
+          block->dirty = TRUE;
+
+          GE( ctx, glGenBuffers (1, &block->buffer) );
+        }
+
+      GE( ctx, glUniformBlockBinding (program_state->program,
+                                      i,
+                                      block->binding) );
+    }
+}
+
+static void
+flush_uniform_blocks (CoglPipelineProgramState *program_state)
+{
+  int i;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  for (i = 0; i < program_state->n_uniform_blocks; i++)
+    {
+      UniformBlock *block = program_state->uniform_blocks + i;
+
+      /* The builtin block is bound in pre_paint */
+      if (i == program_state->builtin_block)
+        continue;
+
+      /* The binding points are shared with every other program so
+         they need to be restored every time the program is used. The
+         GL state tracker skips this if the buffer is still bound */
+      _cogl_gl_state_bind_uniform_buffer (ctx,
+                                          block->binding,
+                                          block->buffer);
+
+      if (block->dirty)
+        {
+          _cogl_gl_state_bind_buffer (ctx, GL_UNIFORM_BUFFER, block->buffer);
+
+          /* Respecifying the whole buffer lets the driver give us new
+             storage if the GPU is still using the old contents */
+          GE( ctx, glBufferData (GL_UNIFORM_BUFFER,
+                                 block->size,
+                                 block->data,
+                                 GL_DYNAMIC_DRAW) );
+          block->dirty = FALSE;
+        }
+    }
+}
+
 static CoglPipelineProgramState *
 program_state_new (int n_layers)
 {
@@ -246,9 +520,16 @@ program_state_new (int n_layers)
   program_state = g_slice_new (CoglPipelineProgramState);
   program_state->ref_count = 1;
   program_state->program = 0;
+  program_state->link_pending = FALSE;
+  program_state->locations_dirty = FALSE;
+  program_state->placeholder = NULL;
   program_state->n_tex_coord_attribs = 0;
+  program_state->n_layers = n_layers;
   program_state->unit_state = g_new (UnitState, n_layers);
   program_state->uniform_locations = NULL;
+  program_state->uniform_blocks = NULL;
+  program_state->n_uniform_blocks = 0;
+  program_state->builtin_block = -1;
   program_state->attribute_locations = NULL;
 #ifdef HAVE_COGL_GLES2
   _cogl_matrix_stack_init_cache (&program_state->modelview_cache);
@@ -259,23 +540,19 @@ program_state_new (int n_layers)
 }
 
 static void
-destroy_program_state (void *user_data,
-                       void *instance)
-{
-  CoglPipelineProgramState *program_state = user_data;
+set_placeholder (CoglPipelineProgramState *program_state,
+                 CoglPipelineProgramState *placeholder);
 
+static void
+program_state_unref (CoglPipelineProgramState *program_state)
+{
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
-  /* If the program state was last used for this pipeline then clear
-     it so that if same address gets used again for a new pipeline
-     then we won't think it's the same pipeline and avoid updating the
-     uniforms */
-  if (program_state->last_used_for_pipeline == instance)
-    program_state->last_used_for_pipeline = NULL;
-
   if (--program_state->ref_count == 0)
     {
+      set_placeholder (program_state, NULL);
       clear_attribute_cache (program_state);
+      clear_uniform_blocks (program_state);
 
 #ifdef HAVE_COGL_GLES2
       if (ctx->driver == COGL_DRIVER_GLES2)
@@ -297,6 +574,33 @@ destroy_program_state (void *user_data,
     }
 }
 
+static void
+set_placeholder (CoglPipelineProgramState *program_state,
+                 CoglPipelineProgramState *placeholder)
+{
+  if (placeholder)
+    placeholder->ref_count++;
+  if (program_state->placeholder)
+    program_state_unref (program_state->placeholder);
+  program_state->placeholder = placeholder;
+}
+
+static void
+destroy_program_state (void *user_data,
+                       void *instance)
+{
+  CoglPipelineProgramState *program_state = user_data;
+
+  /* If the program state was last used for this pipeline then clear
+     it so that if same address gets used again for a new pipeline
+     then we won't think it's the same pipeline and avoid updating the
+     uniforms */
+  if (program_state->last_used_for_pipeline == instance)
+    program_state->last_used_for_pipeline = NULL;
+
+  program_state_unref (program_state);
+}
+
 static void
 set_program_state (CoglPipeline *pipeline,
                   CoglPipelineProgramState *program_state)
@@ -316,14 +620,54 @@ dirty_program_state (CoglPipeline *pipeline)
                              NULL);
 }
 
+/* When linking asynchronously the shader compile status isn't
+   checked by the fragend and vertend so if the link fails this is
+   used to report any compile errors instead */
 static void
-link_program (GLint gl_program)
+report_shader_errors (GLuint gl_program)
 {
+  GLuint shaders[8];
+  GLsizei n_shaders;
+  int i;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  GE( ctx, glGetAttachedShaders (gl_program,
+                                 G_N_ELEMENTS (shaders),
+                                 &n_shaders,
+                                 shaders) );
+
+  for (i = 0; i < n_shaders; i++)
+    {
+      GLint compile_status;
+
+      GE( ctx, glGetShaderiv (shaders[i], GL_COMPILE_STATUS,
+                              &compile_status) );
+
+      if (!compile_status)
+        {
+          GLint len = 0;
+          char *shader_log;
+
+          GE( ctx, glGetShaderiv (shaders[i], GL_INFO_LOG_LENGTH, &len) );
+          shader_log = g_alloca (len);
+          GE( ctx, glGetShaderInfoLog (shaders[i], len, &len, shader_log) );
+          g_warning ("Shader compilation failed:\n%s", shader_log);
+        }
+    }
+}
+
+/* This waits for the link to finish if it hasn't already */
+static void
+finish_link (CoglPipelineProgramState *program_state)
+{
+  GLuint gl_program = program_state->program;
   GLint link_status;
 
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
-  GE( ctx, glLinkProgram (gl_program) );
+  program_state->link_pending = FALSE;
+  set_placeholder (program_state, NULL);
 
   GE( ctx, glGetProgramiv (gl_program, GL_LINK_STATUS, &link_status) );
 
@@ -344,7 +688,82 @@ link_program (GLint gl_program)
                  log_length, log);
 
       g_free (log);
+
+      if (ctx->async_shaders_policy != COGL_ASYNC_SHADERS_DISABLED)
+        report_shader_errors (gl_program);
     }
+
+  setup_uniform_blocks (program_state);
+}
+
+static void
+link_program (CoglPipelineProgramState *program_state)
+{
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  GE( ctx, glLinkProgram (program_state->program) );
+
+  if (ctx->async_shaders_policy == COGL_ASYNC_SHADERS_DISABLED)
+    finish_link (program_state);
+  else
+    {
+      /* Don't query anything about the program yet because that
+         would make the driver wait for the compiler */
+      program_state->link_pending = TRUE;
+      program_state->link_frame = ctx->frame_counter;
+      program_state->link_time = g_get_monotonic_time ();
+    }
+}
+
+/* Checks whether a pending link has finished without waiting for
+   it */
+static gboolean
+is_link_finished (CoglPipelineProgramState *program_state)
+{
+  GLint completed;
+
+  _COGL_GET_CONTEXT (ctx, TRUE);
+
+  if ((ctx->private_feature_flags &
+       COGL_PRIVATE_FEATURE_PARALLEL_SHADER_COMPILE))
+    {
+      GE( ctx, glGetProgramiv (program_state->program,
+                               GL_COMPLETION_STATUS_KHR,
+                               &completed) );
+      return completed;
+    }
+
+  /* Otherwise we give the driver until the next frame in the hope
+     that it is compiling on another thread */
+  return (ctx->frame_counter != program_state->link_frame ||
+          (g_get_monotonic_time () - program_state->link_time >=
+           LINK_CHECK_DELAY));
+}
+
+/* Looks for the closest ancestor of the pipeline that has a program
+   which is ready to use. The unit state is indexed by the layer
+   number so the ancestor must have the same number of layers */
+static CoglPipelineProgramState *
+find_placeholder (CoglPipeline *pipeline,
+                  CoglPipelineProgramState *program_state)
+{
+  CoglPipeline *parent;
+
+  for (parent = _cogl_pipeline_get_parent (pipeline);
+       parent;
+       parent = _cogl_pipeline_get_parent (parent))
+    {
+      CoglPipelineProgramState *parent_state = get_program_state (parent);
+
+      if (parent_state &&
+          parent_state != program_state &&
+          parent_state->program &&
+          !parent_state->link_pending &&
+          parent_state->n_layers == program_state->n_layers)
+        return parent_state;
+    }
+
+  return NULL;
 }
 
 typedef struct
@@ -493,6 +912,97 @@ typedef struct
   int value_index;
 } FlushUniformsClosure;
 
+static void
+get_uniform_location (CoglContext *ctx,
+                      CoglPipelineProgramState *program_state,
+                      const char *uniform_name,
+                      UniformLocation *location)
+{
+  const char *names[N_UNIFORM_BLOCK_NAMES];
+  GLuint indices[N_UNIFORM_BLOCK_NAMES];
+  char *vertex_name, *fragment_name;
+  int i;
+
+  location->n_members = 0;
+
+  GE_RET( location->location,
+          ctx, glGetUniformLocation (program_state->program,
+                                     uniform_name) );
+
+  /* Members of a uniform block don't have a location so we also need
+     to check whether the uniform is in a block. The snippet uniforms
+     are in blocks with an instance name so they are qualified with
+     the block name. If the same uniform is declared by snippets in
+     both stages then it will be in both blocks */
+  if (program_state->n_uniform_blocks == 0)
+    return;
+
+  vertex_name = g_strconcat (COGL_PIPELINE_SNIPPET_VERTEX_UNIFORM_BLOCK ".",
+                             uniform_name,
+                             NULL);
+  fragment_name =
+    g_strconcat (COGL_PIPELINE_SNIPPET_FRAGMENT_UNIFORM_BLOCK ".",
+                 uniform_name,
+                 NULL);
+
+  names[0] = uniform_name;
+  names[1] = vertex_name;
+  names[2] = fragment_name;
+
+  GE( ctx, glGetUniformIndices (program_state->program,
+                                N_UNIFORM_BLOCK_NAMES,
+                                names,
+                                indices) );
+
+  g_free (vertex_name);
+  g_free (fragment_name);
+
+  for (i = 0; i < N_UNIFORM_BLOCK_NAMES; i++)
+    {
+      UniformBlockMember *member = location->members + location->n_members;
+      GLuint index = indices[i];
+      GLint block;
+
+      if (index == GL_INVALID_INDEX)
+        continue;
+
+      GE( ctx, glGetActiveUniformsiv (program_state->program,
+                                      1, &index,
+                                      GL_UNIFORM_BLOCK_INDEX,
+                                      &block) );
+
+      /* The builtin matrices can't be set as custom uniforms */
+      if (block < 0 ||
+          block >= program_state->n_uniform_blocks ||
+          block == program_state->builtin_block)
+        continue;
+
+      member->block = block;
+      GE( ctx, glGetActiveUniformsiv (program_state->program,
+                                      1, &index,
+                                      GL_UNIFORM_SIZE,
+                                      &member->array_size) );
+      GE( ctx, glGetActiveUniformsiv (program_state->program,
+                                      1, &index,
+                                      GL_UNIFORM_OFFSET,
+                                      &member->offset) );
+      GE( ctx, glGetActiveUniformsiv (program_state->program,
+                                      1, &index,
+                                      GL_UNIFORM_ARRAY_STRIDE,
+                                      &member->array_stride) );
+      GE( ctx, glGetActiveUniformsiv (program_state->program,
+                                      1, &index,
+                                      GL_UNIFORM_MATRIX_STRIDE,
+                                      &member->matrix_stride) );
+      GE( ctx, glGetActiveUniformsiv (program_state->program,
+                                      1, &index,
+                                      GL_UNIFORM_IS_ROW_MAJOR,
+                                      &member->row_major) );
+
+      location->n_members++;
+    }
+}
+
 static gboolean
 flush_uniform_cb (int uniform_num, void *user_data)
 {
@@ -501,11 +1011,12 @@ flush_uniform_cb (int uniform_num, void *user_data)
   if (COGL_FLAGS_GET (data->uniform_differences, uniform_num))
     {
       GArray *uniform_locations;
-      GLint uniform_location;
+      UniformLocation *location;
+      int i;
 
       if (data->program_state->uniform_locations == NULL)
         data->program_state->uniform_locations =
-          g_array_new (FALSE, FALSE, sizeof (GLint));
+          g_array_new (FALSE, FALSE, sizeof (UniformLocation));
 
       uniform_locations = data->program_state->uniform_locations;
 
@@ -517,31 +1028,46 @@ flush_uniform_cb (int uniform_num, void *user_data)
 
           while (old_len <= uniform_num)
             {
-              g_array_index (uniform_locations, GLint, old_len) =
-                UNIFORM_LOCATION_UNKNOWN;
+              g_array_index (uniform_locations, UniformLocation,
+                             old_len).location = UNIFORM_LOCATION_UNKNOWN;
               old_len++;
             }
         }
 
-      uniform_location = g_array_index (uniform_locations, GLint, uniform_num);
+      location = &g_array_index (uniform_locations, UniformLocation,
+                                 uniform_num);
 
-      if (uniform_location == UNIFORM_LOCATION_UNKNOWN)
+      if (location->location == UNIFORM_LOCATION_UNKNOWN)
         {
           const char *uniform_name =
             g_ptr_array_index (data->ctx->uniform_names, uniform_num);
 
-          uniform_location =
-            data->ctx->glGetUniformLocation (data->program_state->program,
-                                             uniform_name);
-          g_array_index (uniform_locations, GLint, uniform_num) =
-            uniform_location;
+          get_uniform_location (data->ctx,
+                                data->program_state,
+                                uniform_name,
+                                location);
         }
 
-      if (uniform_location != -1)
+      if (location->location != -1)
         _cogl_boxed_value_set_uniform (data->ctx,
-                                       uniform_location,
+                                       location->location,
                                        data->values + data->value_index);
 
+      for (i = 0; i < location->n_members; i++)
+        {
+          UniformBlockMember *member = location->members + i;
+          UniformBlock *block =
+            data->program_state->uniform_blocks + member->block;
+
+          _cogl_boxed_value_write_to_block (data->values + data->value_index,
+                                            block->data + member->offset,
+                                            member->array_size,
+                                            member->array_stride,
+                                            member->matrix_stride,
+                                            member->row_major);
+          block->dirty = TRUE;
+        }
+
       data->n_differences--;
       COGL_FLAGS_SET (data->uniform_differences, uniform_num, FALSE);
     }
@@ -642,32 +1168,20 @@ _cogl_pipeline_progend_glsl_flush_uniforms (CoglPipeline *pipeline,
 
   if (uniforms_state)
     _cogl_bitmask_clear_all (&uniforms_state->changed_mask);
+
+  flush_uniform_blocks (program_state);
 }
 
-static void
-_cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
-                                 unsigned long pipelines_difference,
-                                 int n_tex_coord_attribs)
+static CoglPipelineProgramState *
+ensure_program_state (CoglPipeline *pipeline)
 {
   CoglPipelineProgramState *program_state;
-  GLuint gl_program;
-  gboolean program_changed = FALSE;
-  UpdateUniformsState state;
-  CoglProgram *user_program;
   CoglPipeline *template_pipeline = NULL;
 
-  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
-
-  /* If neither of the glsl fragend or vertends are used then we don't
-     need to do anything */
-  if (pipeline->fragend != COGL_PIPELINE_FRAGEND_GLSL &&
-      pipeline->vertend != COGL_PIPELINE_VERTEND_GLSL)
-    return;
+  _COGL_GET_CONTEXT (ctx, NULL);
 
   program_state = get_program_state (pipeline);
 
-  user_program = cogl_pipeline_get_user_program (pipeline);
-
   if (program_state == NULL)
     {
       CoglPipeline *authority;
@@ -721,6 +1235,21 @@ _cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
         }
     }
 
+  return program_state;
+}
+
+/* Creates and links the GL program if it doesn't already have an
+ * up-to-date one. This doesn't bind the program. Returns TRUE if a
+ * new program was linked and is ready to use straight away */
+static gboolean
+ensure_program_linked (CoglPipeline *pipeline,
+                       CoglPipelineProgramState *program_state,
+                       int n_tex_coord_attribs)
+{
+  CoglProgram *user_program = cogl_pipeline_get_user_program (pipeline);
+
+  _COGL_GET_CONTEXT (ctx, FALSE);
+
   /* If the program has changed since the last link then we do
    * need to relink
    *
@@ -734,6 +1263,9 @@ _cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
     {
       GE( ctx, glDeleteProgram (program_state->program) );
       program_state->program = 0;
+      program_state->link_pending = FALSE;
+      program_state->locations_dirty = FALSE;
+      set_placeholder (program_state, NULL);
     }
 
   if (program_state->program == 0)
@@ -769,11 +1301,87 @@ _cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
           (backend_shader = _cogl_pipeline_vertend_glsl_get_shader (pipeline)))
         GE( ctx, glAttachShader (program_state->program, backend_shader) );
 
-      link_program (program_state->program);
+      link_program (program_state);
+
+      program_state->n_tex_coord_attribs = n_tex_coord_attribs;
+
+      /* If the link is pending then the uniforms are queried once it
+         has finished */
+      return !program_state->link_pending;
+    }
+
+  return FALSE;
+}
 
+static void
+_cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
+                                 unsigned long pipelines_difference,
+                                 int n_tex_coord_attribs)
+{
+  CoglPipelineProgramState *program_state;
+  GLuint gl_program;
+  gboolean program_changed;
+  UpdateUniformsState state;
+  CoglProgram *user_program;
+  gboolean using_placeholder = FALSE;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  /* If neither of the glsl fragend or vertends are used then we don't
+     need to do anything */
+  if (pipeline->fragend != COGL_PIPELINE_FRAGEND_GLSL &&
+      pipeline->vertend != COGL_PIPELINE_VERTEND_GLSL)
+    return;
+
+  program_state = ensure_program_state (pipeline);
+
+  user_program = cogl_pipeline_get_user_program (pipeline);
+
+  program_changed = ensure_program_linked (pipeline,
+                                           program_state,
+                                           n_tex_coord_attribs);
+
+  /* If the program was linked by a precompile then nothing has been
+     queried from it yet */
+  if (program_state->locations_dirty)
+    {
+      program_state->locations_dirty = FALSE;
       program_changed = TRUE;
+    }
 
-      program_state->n_tex_coord_attribs = n_tex_coord_attribs;
+  if (program_state->link_pending)
+    {
+      CoglPipelineProgramState *placeholder = program_state->placeholder;
+
+      /* The placeholder can't be used if it has started relinking */
+      if (placeholder && placeholder->link_pending)
+        placeholder = NULL;
+
+      if (is_link_finished (program_state))
+        {
+          finish_link (program_state);
+          program_changed = TRUE;
+        }
+      else if (ctx->async_shaders_policy == COGL_ASYNC_SHADERS_SKIP)
+        {
+          ctx->current_pipeline_link_pending = TRUE;
+          ctx->current_pipeline_skip_draws = TRUE;
+          return;
+        }
+      else if (placeholder ||
+               (placeholder = find_placeholder (pipeline, program_state)))
+        {
+          set_placeholder (program_state, placeholder);
+          ctx->current_pipeline_link_pending = TRUE;
+          program_state = placeholder;
+          using_placeholder = TRUE;
+        }
+      else
+        {
+          /* There is nothing else to draw with so we have to wait */
+          finish_link (program_state);
+          program_changed = TRUE;
+        }
     }
 
   gl_program = program_state->program;
@@ -846,16 +1454,37 @@ _cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
                                               gl_program,
                                               program_changed);
 
+  /* The user program only remembers which uniforms have changed
+     since the last flush so they all need to be set on a
+     placeholder */
   if (user_program)
     _cogl_program_flush_uniforms (user_program,
                                   gl_program,
-                                  program_changed);
+                                  program_changed || using_placeholder);
 
   /* We need to track the last pipeline that the program was used with
    * so know if we need to update all of the uniforms */
   program_state->last_used_for_pipeline = pipeline;
 }
 
+static void
+_cogl_pipeline_progend_glsl_precompile (CoglPipeline *pipeline,
+                                        int n_tex_coord_attribs)
+{
+  CoglPipelineProgramState *program_state;
+
+  if (pipeline->fragend != COGL_PIPELINE_FRAGEND_GLSL &&
+      pipeline->vertend != COGL_PIPELINE_VERTEND_GLSL)
+    return;
+
+  program_state = ensure_program_state (pipeline);
+
+  /* The program isn't bound here so querying the uniforms is left
+     until it is first flushed */
+  if (ensure_program_linked (pipeline, program_state, n_tex_coord_attribs))
+    program_state->locations_dirty = TRUE;
+}
+
 static void
 _cogl_pipeline_progend_glsl_pre_change_notify (CoglPipeline *pipeline,
                                                CoglPipelineState change,
@@ -927,6 +1556,88 @@ _cogl_pipeline_progend_glsl_layer_pre_change_notify (
     }
 }
 
+/* The builtin block is shared by every program so the matrices only
+   need to be uploaded when the matrix stacks change rather than each
+   time a different program is used */
+static void
+flush_builtin_block (CoglContext *ctx,
+                     CoglMatrixStack *projection_stack,
+                     CoglMatrixStack *modelview_stack,
+                     gboolean flip)
+{
+  gboolean projection_changed;
+  gboolean modelview_changed;
+
+  projection_changed =
+    _cogl_matrix_stack_check_and_update_cache (projection_stack,
+                                               &ctx->builtin_projection_cache,
+                                               flip);
+  modelview_changed =
+    _cogl_matrix_stack_check_and_update_cache (modelview_stack,
+                                               &ctx->builtin_modelview_cache,
+                                               /* never flip modelview */
+                                               FALSE);
+
+  if (ctx->builtin_uniform_buffer == 0)
+    {
+      GE( ctx, glGenBuffers (1, &ctx->builtin_uniform_buffer) );
+      projection_changed = TRUE;
+    }
+
+  if (projection_changed || modelview_changed)
+    {
+      CoglMatrix modelview, projection;
+      float data[16 * 3];
+
+      _cogl_matrix_stack_get (modelview_stack, &modelview);
+
+      if (flip)
+        {
+          CoglMatrix tmp_matrix;
+          _cogl_matrix_stack_get (projection_stack, &tmp_matrix);
+          cogl_matrix_multiply (&projection,
+                                &ctx->y_flip_matrix,
+                                &tmp_matrix);
+        }
+      else
+        _cogl_matrix_stack_get (projection_stack, &projection);
+
+      /* The members are in the order that they are declared in
+         _COGL_BUILTIN_UNIFORM_BLOCK_GL */
+      memcpy (data, cogl_matrix_get_array (&modelview),
+              sizeof (float) * 16);
+      memcpy (data + 16, cogl_matrix_get_array (&projection),
+              sizeof (float) * 16);
+
+      /* The journal usually uses an identity matrix for the modelview
+         so we can optimise this common case by avoiding the matrix
+         multiplication */
+      if (_cogl_matrix_stack_has_identity_flag (modelview_stack))
+        memcpy (data + 32, cogl_matrix_get_array (&projection),
+                sizeof (float) * 16);
+      else
+        {
+          CoglMatrix combined;
+
+          cogl_matrix_multiply (&combined, &projection, &modelview);
+          memcpy (data + 32, cogl_matrix_get_array (&combined),
+                  sizeof (float) * 16);
+        }
+
+      _cogl_gl_state_bind_buffer (ctx,
+                                  GL_UNIFORM_BUFFER,
+                                  ctx->builtin_uniform_buffer);
+      GE( ctx, glBufferData (GL_UNIFORM_BUFFER,
+                             BUILTIN_BLOCK_SIZE,
+                             data,
+                             GL_DYNAMIC_DRAW) );
+    }
+
+  _cogl_gl_state_bind_uniform_buffer (ctx,
+                                      BUILTIN_BLOCK_BINDING,
+                                      ctx->builtin_uniform_buffer);
+}
+
 static void
 _cogl_pipeline_progend_glsl_pre_paint (CoglPipeline *pipeline)
 {
@@ -940,7 +1651,11 @@ _cogl_pipeline_progend_glsl_pre_paint (CoglPipeline *pipeline)
   if (pipeline->vertend != COGL_PIPELINE_VERTEND_GLSL)
     return;
 
-  program_state = get_program_state (pipeline);
+  program_state = get_flushed_program_state (pipeline);
+
+  /* Nothing is drawn if the program is still being linked */
+  if (program_state == NULL)
+    return;
 
   projection_stack = ctx->current_projection_stack;
   modelview_stack = ctx->current_modelview_stack;
@@ -1055,14 +1770,26 @@ _cogl_pipeline_progend_glsl_pre_paint (CoglPipeline *pipeline)
          geometry via the matrix and use the flip vertex instead */
       disable_flip = program_state->flip_uniform != -1;
 
-      _cogl_matrix_stack_flush_to_gl_builtins (ctx,
-                                               projection_stack,
-                                               COGL_MATRIX_PROJECTION,
-                                               disable_flip);
-      _cogl_matrix_stack_flush_to_gl_builtins (ctx,
-                                               modelview_stack,
-                                               COGL_MATRIX_MODELVIEW,
-                                               disable_flip);
+      if (program_state->builtin_block != -1)
+        flush_builtin_block (ctx,
+                             projection_stack,
+                             modelview_stack,
+                             needs_flip && !disable_flip);
+
+      /* User shaders can still refer to the fixed function matrices
+         directly so they are only skipped for generated programs */
+      if (program_state->builtin_block == -1 ||
+          cogl_pipeline_get_user_program (pipeline))
+        {
+          _cogl_matrix_stack_flush_to_gl_builtins (ctx,
+                                                   projection_stack,
+                                                   COGL_MATRIX_PROJECTION,
+                                                   disable_flip);
+          _cogl_matrix_stack_flush_to_gl_builtins (ctx,
+                                                   modelview_stack,
+                                                   COGL_MATRIX_MODELVIEW,
+                                                   disable_flip);
+        }
     }
 
   if (program_state->flip_uniform != -1
@@ -1098,6 +1825,7 @@ update_float_uniform (CoglPipeline *pipeline,
 const CoglPipelineProgend _cogl_pipeline_glsl_progend =
   {
     _cogl_pipeline_progend_glsl_end,
+    _cogl_pipeline_progend_glsl_precompile,
     _cogl_pipeline_progend_glsl_pre_change_notify,
     _cogl_pipeline_progend_glsl_layer_pre_change_notify,
     _cogl_pipeline_progend_glsl_pre_paint
@@ -82,11 +82,34 @@ typedef struct
 
   /* The string to generate the source into */
   GString *source_buf;
+
+  /* If this is not NULL then any plain uniforms of a basic type that
+     the snippets declare are moved into this string as members of a
+     uniform block. The snippet code will see them through a #define
+     that points into uniform_block_instance */
+  GString *uniform_block_buf;
+  const char *uniform_block_instance;
 } CoglPipelineSnippetData;
 
+/* The uniform blocks that snippet uniforms are packed into for each
+   shader stage. The progend finds the uniforms using the block names */
+#define COGL_PIPELINE_SNIPPET_VERTEX_UNIFORM_BLOCK "_CoglVertexUniforms"
+#define COGL_PIPELINE_SNIPPET_VERTEX_UNIFORM_INSTANCE "_cogl_vertex_uniforms"
+#define COGL_PIPELINE_SNIPPET_FRAGMENT_UNIFORM_BLOCK "_CoglFragmentUniforms"
+#define COGL_PIPELINE_SNIPPET_FRAGMENT_UNIFORM_INSTANCE \
+  "_cogl_fragment_uniforms"
+
 void
 _cogl_pipeline_snippet_generate_code (const CoglPipelineSnippetData *data);
 
+/* Wraps the members that were packed into uniform_block_buf in the
+   declaration of the block. Nothing is added if no uniforms were
+   packed */
+void
+_cogl_pipeline_snippet_declare_uniform_block (GString *uniform_block_buf,
+                                              const char *block_name,
+                                              const char *instance_name);
+
 void
 _cogl_pipeline_snippet_list_free (CoglPipelineSnippetList *list);
 
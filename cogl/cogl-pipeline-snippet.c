@@ -37,6 +37,160 @@
 
 /* Helper functions that are used by both GLSL pipeline backends */
 
+/* Uniforms of these types can be moved into a uniform block. Samplers
+   can't be in a block and any other type is left alone */
+static const char * const
+packable_uniform_types[] =
+  {
+    "float", "vec2", "vec3", "vec4",
+    "int", "ivec2", "ivec3", "ivec4",
+    "mat2", "mat3", "mat4"
+  };
+
+static gboolean
+is_identifier_char (char c)
+{
+  return g_ascii_isalnum (c) || c == '_';
+}
+
+static const char *
+skip_space (const char *p, const char *end)
+{
+  while (p < end && g_ascii_isspace (*p))
+    p++;
+  return p;
+}
+
+static const char *
+skip_identifier (const char *p, const char *end)
+{
+  if (p >= end || g_ascii_isdigit (*p))
+    return p;
+
+  while (p < end && is_identifier_char (*p))
+    p++;
+
+  return p;
+}
+
+/* Tries to parse a line of the form
+ *
+ *   uniform <type> <name>[<size>], <name>...;
+ *
+ * If it matches then a member is appended to the uniform block for
+ * each name and the line is replaced with a #define for each name.
+ * Anything else, including lines with comments or qualifiers, is left
+ * for the caller to copy unchanged */
+static gboolean
+pack_uniform_line (const CoglPipelineSnippetData *data,
+                   const char *p,
+                   const char *end)
+{
+  GString *members, *defines;
+  const char *type, *type_end;
+  gboolean packable = FALSE;
+  int i;
+
+  p = skip_space (p, end);
+
+  if (end - p < 8 || memcmp (p, "uniform", 7) || !g_ascii_isspace (p[7]))
+    return FALSE;
+
+  type = skip_space (p + 7, end);
+  type_end = skip_identifier (type, end);
+
+  for (i = 0; i < G_N_ELEMENTS (packable_uniform_types); i++)
+    if (strlen (packable_uniform_types[i]) == type_end - type &&
+        !memcmp (packable_uniform_types[i], type, type_end - type))
+      packable = TRUE;
+
+  if (!packable)
+    return FALSE;
+
+  members = g_string_new (NULL);
+  defines = g_string_new (NULL);
+
+  p = type_end;
+
+  while (TRUE)
+    {
+      const char *name = skip_space (p, end);
+      const char *name_end = skip_identifier (name, end);
+      const char *array = name_end, *array_end = name_end;
+
+      if (name_end == name)
+        goto fail;
+
+      p = skip_space (name_end, end);
+
+      if (p < end && *p == '[')
+        {
+          array = p;
+          while (p < end && *p != ']')
+            p++;
+          if (p >= end)
+            goto fail;
+          array_end = ++p;
+          p = skip_space (p, end);
+        }
+
+      g_string_append_printf (members, "  %.*s %.*s%.*s;\n",
+                              (int) (type_end - type), type,
+                              (int) (name_end - name), name,
+                              (int) (array_end - array), array);
+      g_string_append_printf (defines, "#define %.*s %s.%.*s\n",
+                              (int) (name_end - name), name,
+                              data->uniform_block_instance,
+                              (int) (name_end - name), name);
+
+      if (p < end && *p == ',')
+        p++;
+      else if (p < end && *p == ';')
+        break;
+      else
+        goto fail;
+    }
+
+  if (skip_space (p + 1, end) != end)
+    goto fail;
+
+  g_string_append_len (data->uniform_block_buf, members->str, members->len);
+  g_string_append_len (data->source_buf, defines->str, defines->len);
+
+  g_string_free (members, TRUE);
+  g_string_free (defines, TRUE);
+
+  return TRUE;
+
+ fail:
+  g_string_free (members, TRUE);
+  g_string_free (defines, TRUE);
+
+  return FALSE;
+}
+
+static void
+append_declarations (const CoglPipelineSnippetData *data,
+                     const char *declarations)
+{
+  const char *line, *line_end;
+
+  if (data->uniform_block_buf == NULL)
+    {
+      g_string_append (data->source_buf, declarations);
+      return;
+    }
+
+  for (line = declarations; *line; line = line_end)
+    {
+      line_end = strchr (line, '\n');
+      line_end = line_end ? line_end + 1 : line + strlen (line);
+
+      if (!pack_uniform_line (data, line, line_end))
+        g_string_append_len (data->source_buf, line, line_end - line);
+    }
+}
+
 void
 _cogl_pipeline_snippet_generate_code (const CoglPipelineSnippetData *data)
 {
@@ -105,7 +259,7 @@ _cogl_pipeline_snippet_generate_code (const CoglPipelineSnippetData *data)
         const char *source;
 
         if ((source = cogl_snippet_get_declarations (snippet->snippet)))
-          g_string_append (data->source_buf, source);
+          append_declarations (data, source);
 
         g_string_append_printf (data->source_buf,
                                 "\n"
@@ -182,6 +336,25 @@ _cogl_pipeline_snippet_generate_code (const CoglPipelineSnippetData *data)
       }
 }
 
+void
+_cogl_pipeline_snippet_declare_uniform_block (GString *uniform_block_buf,
+                                              const char *block_name,
+                                              const char *instance_name)
+{
+  char *start;
+
+  if (uniform_block_buf->len == 0)
+    return;
+
+  start = g_strdup_printf ("layout(std140) uniform %s\n"
+                           "{\n",
+                           block_name);
+  g_string_prepend (uniform_block_buf, start);
+  g_free (start);
+
+  g_string_append_printf (uniform_block_buf, "} %s;\n", instance_name);
+}
+
 static void
 _cogl_pipeline_snippet_free (CoglPipelineSnippet *pipeline_snippet)
 {
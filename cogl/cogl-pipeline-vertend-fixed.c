@@ -45,10 +45,7 @@
 const CoglPipelineVertend _cogl_pipeline_fixed_vertend;
 
 static gboolean
-_cogl_pipeline_vertend_fixed_start (CoglPipeline *pipeline,
-                                    int n_layers,
-                                    unsigned long pipelines_difference,
-                                    int n_tex_coord_attribs)
+can_handle_pipeline (CoglPipeline *pipeline)
 {
   CoglProgram *user_program;
 
@@ -73,6 +70,18 @@ _cogl_pipeline_vertend_fixed_start (CoglPipeline *pipeline,
       _cogl_program_has_vertex_shader (user_program))
     return FALSE;
 
+  return TRUE;
+}
+
+static gboolean
+_cogl_pipeline_vertend_fixed_start (CoglPipeline *pipeline,
+                                    int n_layers,
+                                    unsigned long pipelines_difference,
+                                    int n_tex_coord_attribs)
+{
+  if (!can_handle_pipeline (pipeline))
+    return FALSE;
+
   _cogl_use_vertex_program (0, COGL_PIPELINE_PROGRAM_TYPE_FIXED);
 
   return TRUE;
@@ -128,11 +137,20 @@ _cogl_pipeline_vertend_fixed_end (CoglPipeline *pipeline,
   return TRUE;
 }
 
+static gboolean
+_cogl_pipeline_vertend_fixed_precompile (CoglPipeline *pipeline,
+                                         int n_tex_coord_attribs)
+{
+  /* There is no shader to generate for the fixed function pipeline */
+  return can_handle_pipeline (pipeline);
+}
+
 const CoglPipelineVertend _cogl_pipeline_fixed_vertend =
 {
   _cogl_pipeline_vertend_fixed_start,
   _cogl_pipeline_vertend_fixed_add_layer,
   _cogl_pipeline_vertend_fixed_end,
+  _cogl_pipeline_vertend_fixed_precompile,
   NULL, /* pipeline_change_notify */
   NULL /* layer_change_notify */
 };
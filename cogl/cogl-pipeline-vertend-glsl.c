@@ -54,6 +54,10 @@ typedef struct
   GLuint gl_shader;
   GString *header, *source;
 
+  /* The members of the uniform block that the snippet uniforms are
+     packed into. This is NULL if uniform blocks aren't available */
+  GString *uniform_block;
+
   /* Age of the user program that was current when the shader was
      generated. We need to keep track of this because if the user
      program changes then we may need to redecide whether to generate
@@ -271,6 +275,14 @@ _cogl_pipeline_vertend_glsl_start (CoglPipeline *pipeline,
   shader_state->header = ctx->codegen_header_buffer;
   shader_state->source = ctx->codegen_source_buffer;
 
+  if ((ctx->private_feature_flags & COGL_PRIVATE_FEATURE_UBOS))
+    {
+      g_string_set_size (ctx->codegen_uniform_block_buffer, 0);
+      shader_state->uniform_block = ctx->codegen_uniform_block_buffer;
+    }
+  else
+    shader_state->uniform_block = NULL;
+
   g_string_append (shader_state->source,
                    "void\n"
                    "cogl_generated_source ()\n"
@@ -375,6 +387,9 @@ _cogl_pipeline_vertend_glsl_add_layer (CoglPipeline *pipeline,
   snippet_data.arguments = "cogl_matrix, cogl_tex_coord";
   snippet_data.argument_declarations = "mat4 cogl_matrix, vec4 cogl_tex_coord";
   snippet_data.source_buf = shader_state->header;
+  snippet_data.uniform_block_buf = shader_state->uniform_block;
+  snippet_data.uniform_block_instance =
+    COGL_PIPELINE_SNIPPET_VERTEX_UNIFORM_INSTANCE;
 
   _cogl_pipeline_snippet_generate_code (&snippet_data);
 
@@ -407,8 +422,9 @@ _cogl_pipeline_vertend_glsl_end (CoglPipeline *pipeline,
 
   if (shader_state->source)
     {
-      const char *source_strings[2];
-      GLint lengths[2];
+      const char *source_strings[3];
+      GLint lengths[3];
+      int n_strings = 0;
       GLint compile_status;
       GLuint shader;
       CoglPipelineSnippetData snippet_data;
@@ -445,6 +461,9 @@ _cogl_pipeline_vertend_glsl_end (CoglPipeline *pipeline,
       snippet_data.final_name = "cogl_vertex_transform";
       snippet_data.function_prefix = "cogl_vertex_transform";
       snippet_data.source_buf = shader_state->header;
+      snippet_data.uniform_block_buf = shader_state->uniform_block;
+      snippet_data.uniform_block_instance =
+        COGL_PIPELINE_SNIPPET_VERTEX_UNIFORM_INSTANCE;
       _cogl_pipeline_snippet_generate_code (&snippet_data);
 
       /* Add all of the hooks for vertex processing */
@@ -455,6 +474,9 @@ _cogl_pipeline_vertend_glsl_end (CoglPipeline *pipeline,
       snippet_data.final_name = "cogl_vertex_hook";
       snippet_data.function_prefix = "cogl_vertex_hook";
       snippet_data.source_buf = shader_state->source;
+      snippet_data.uniform_block_buf = shader_state->uniform_block;
+      snippet_data.uniform_block_instance =
+        COGL_PIPELINE_SNIPPET_VERTEX_UNIFORM_INSTANCE;
       _cogl_pipeline_snippet_generate_code (&snippet_data);
 
       g_string_append (shader_state->source,
@@ -480,39 +502,90 @@ _cogl_pipeline_vertend_glsl_end (CoglPipeline *pipeline,
 
       GE_RET( shader, ctx, glCreateShader (GL_VERTEX_SHADER) );
 
-      lengths[0] = shader_state->header->len;
-      source_strings[0] = shader_state->header->str;
-      lengths[1] = shader_state->source->len;
-      source_strings[1] = shader_state->source->str;
+      /* The uniform block has to be declared before the snippets
+         refer to it */
+      if (shader_state->uniform_block)
+        {
+          _cogl_pipeline_snippet_declare_uniform_block
+            (shader_state->uniform_block,
+             COGL_PIPELINE_SNIPPET_VERTEX_UNIFORM_BLOCK,
+             COGL_PIPELINE_SNIPPET_VERTEX_UNIFORM_INSTANCE);
+          lengths[n_strings] = shader_state->uniform_block->len;
+          source_strings[n_strings++] = shader_state->uniform_block->str;
+        }
+
+      lengths[n_strings] = shader_state->header->len;
+      source_strings[n_strings++] = shader_state->header->str;
+      lengths[n_strings] = shader_state->source->len;
+      source_strings[n_strings++] = shader_state->source->str;
 
       _cogl_shader_set_source_with_boilerplate (shader, GL_VERTEX_SHADER,
                                                 shader_state
                                                 ->n_tex_coord_attribs,
-                                                2, /* count */
+                                                n_strings,
                                                 source_strings, lengths);
 
       GE( ctx, glCompileShader (shader) );
-      GE( ctx, glGetShaderiv (shader, GL_COMPILE_STATUS, &compile_status) );
 
-      if (!compile_status)
+      /* Querying the status would wait for the compiler so when
+         linking asynchronously we leave it to the progend to report
+         the errors when the link fails */
+      if (ctx->async_shaders_policy == COGL_ASYNC_SHADERS_DISABLED)
         {
-          GLint len = 0;
-          char *shader_log;
+          GE( ctx, glGetShaderiv (shader, GL_COMPILE_STATUS,
+                                  &compile_status) );
+
+          if (!compile_status)
+            {
+              GLint len = 0;
+              char *shader_log;
 
-          GE( ctx, glGetShaderiv (shader, GL_INFO_LOG_LENGTH, &len) );
-          shader_log = g_alloca (len);
-          GE( ctx, glGetShaderInfoLog (shader, len, &len, shader_log) );
-          g_warning ("Shader compilation failed:\n%s", shader_log);
+              GE( ctx, glGetShaderiv (shader, GL_INFO_LOG_LENGTH, &len) );
+              shader_log = g_alloca (len);
+              GE( ctx, glGetShaderInfoLog (shader, len, &len, shader_log) );
+              g_warning ("Shader compilation failed:\n%s", shader_log);
+            }
         }
 
       shader_state->header = NULL;
       shader_state->source = NULL;
+      shader_state->uniform_block = NULL;
       shader_state->gl_shader = shader;
     }
 
   return TRUE;
 }
 
+static gboolean
+precompile_add_layer_cb (CoglPipelineLayer *layer,
+                         void *user_data)
+{
+  /* No layer differences are passed so that the user matrices aren't
+     flushed to the texture units */
+  _cogl_pipeline_vertend_glsl_add_layer (user_data, layer, 0);
+
+  return TRUE;
+}
+
+static gboolean
+_cogl_pipeline_vertend_glsl_precompile (CoglPipeline *pipeline,
+                                        int n_tex_coord_attribs)
+{
+  /* No pipeline differences are passed so that the point size isn't
+     flushed */
+  if (!_cogl_pipeline_vertend_glsl_start (pipeline,
+                                          cogl_pipeline_get_n_layers (pipeline),
+                                          0, /* pipelines_difference */
+                                          n_tex_coord_attribs))
+    return FALSE;
+
+  _cogl_pipeline_foreach_layer_internal (pipeline,
+                                         precompile_add_layer_cb,
+                                         pipeline);
+
+  return _cogl_pipeline_vertend_glsl_end (pipeline, 0);
+}
+
 static void
 _cogl_pipeline_vertend_glsl_pre_change_notify (CoglPipeline *pipeline,
                                                CoglPipelineState change,
@@ -558,6 +631,7 @@ const CoglPipelineVertend _cogl_pipeline_glsl_vertend =
     _cogl_pipeline_vertend_glsl_start,
     _cogl_pipeline_vertend_glsl_add_layer,
     _cogl_pipeline_vertend_glsl_end,
+    _cogl_pipeline_vertend_glsl_precompile,
     _cogl_pipeline_vertend_glsl_pre_change_notify,
     _cogl_pipeline_vertend_glsl_layer_pre_change_notify
   };
@@ -46,6 +46,7 @@
 #include "cogl-util.h"
 #include "cogl-profile.h"
 #include "cogl-depth-state-private.h"
+#include "cogl-slab-private.h"
 
 #include <glib.h>
 #include <glib/gprintf.h>
@@ -55,6 +56,15 @@ static void _cogl_pipeline_free (CoglPipeline *tex);
 static void recursively_free_layer_caches (CoglPipeline *pipeline);
 static gboolean _cogl_pipeline_is_weak (CoglPipeline *pipeline);
 
+/* Pipelines are copied and freed very often so they are allocated
+   from slabs instead of going through the general purpose allocator
+   each time */
+static CoglSlabAllocator pipeline_slab =
+  COGL_SLAB_ALLOCATOR_INIT (NULL, sizeof (CoglPipeline), 64);
+static CoglSlabAllocator big_state_slab =
+  COGL_SLAB_ALLOCATOR_INIT ("CoglPipelineBigState",
+                            sizeof (CoglPipelineBigState), 16);
+
 const CoglPipelineFragend *_cogl_pipeline_fragends[COGL_PIPELINE_N_FRAGENDS];
 const CoglPipelineVertend *_cogl_pipeline_vertends[COGL_PIPELINE_N_VERTENDS];
 /* The 'MAX' here is so that we don't define an empty array when there
@@ -105,10 +115,10 @@ void
 _cogl_pipeline_init_default_pipeline (void)
 {
   /* Create new - blank - pipeline */
-  CoglPipeline *pipeline = g_slice_new0 (CoglPipeline);
+  CoglPipeline *pipeline = _cogl_slab_alloc0 (&pipeline_slab);
   /* XXX: NB: It's important that we zero this to avoid polluting
    * pipeline hash values with un-initialized data */
-  CoglPipelineBigState *big_state = g_slice_new0 (CoglPipelineBigState);
+  CoglPipelineBigState *big_state = _cogl_slab_alloc0 (&big_state_slab);
   CoglPipelineLightingState *lighting_state = &big_state->lighting_state;
   CoglPipelineAlphaFuncState *alpha_state = &big_state->alpha_state;
   CoglPipelineBlendState *blend_state = &big_state->blend_state;
@@ -172,6 +182,8 @@ _cogl_pipeline_init_default_pipeline (void)
 
   pipeline->age = 0;
 
+  pipeline->authorities_cache = NULL;
+
   /* Use the same defaults as the GL spec... */
   cogl_color_init_from_4ub (&pipeline->color, 0xff, 0xff, 0xff, 0xff);
 
@@ -276,11 +288,33 @@ recursively_free_layer_caches (CoglPipeline *pipeline)
                                      NULL);
 }
 
+static void
+free_authorities_cache (CoglPipeline *pipeline)
+{
+  if (pipeline->authorities_cache)
+    {
+      g_slice_free (CoglPipelineAuthoritiesCache,
+                    pipeline->authorities_cache);
+      pipeline->authorities_cache = NULL;
+    }
+}
+
 static void
 _cogl_pipeline_set_parent (CoglPipeline *pipeline,
                            CoglPipeline *parent,
                            gboolean take_strong_reference)
 {
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  /* Changing the parent changes where the pipeline and all of its
+   * descendants find their authorities. It's not worth walking the
+   * descendants so if there are any then all of the caches are
+   * invalidated instead */
+  if (!COGL_LIST_EMPTY (&COGL_NODE (pipeline)->children))
+    ctx->pipeline_graph_age++;
+  else
+    free_authorities_cache (pipeline);
+
   /* Chain up */
   _cogl_pipeline_node_set_parent_real (COGL_NODE (pipeline),
                                        COGL_NODE (parent),
@@ -353,7 +387,7 @@ _cogl_pipeline_revert_weak_ancestors (CoglPipeline *strong)
 static CoglPipeline *
 _cogl_pipeline_copy (CoglPipeline *src, gboolean is_weak)
 {
-  CoglPipeline *pipeline = g_slice_new (CoglPipeline);
+  CoglPipeline *pipeline = _cogl_slab_alloc (&pipeline_slab);
 
   _cogl_pipeline_node_init (COGL_NODE (pipeline));
 
@@ -388,6 +422,8 @@ _cogl_pipeline_copy (CoglPipeline *src, gboolean is_weak)
 
   pipeline->age = 0;
 
+  pipeline->authorities_cache = NULL;
+
   _cogl_pipeline_set_parent (pipeline, src, !is_weak);
 
   /* The semantics for copying a weak pipeline are that we promote all
@@ -487,7 +523,9 @@ _cogl_pipeline_free (CoglPipeline *pipeline)
     }
 
   if (pipeline->differences & COGL_PIPELINE_STATE_NEEDS_BIG_STATE)
-    g_slice_free (CoglPipelineBigState, pipeline->big_state);
+    _cogl_slab_free (&big_state_slab, pipeline->big_state);
+
+  free_authorities_cache (pipeline);
 
   if (pipeline->differences & COGL_PIPELINE_STATE_LAYERS)
     {
@@ -506,7 +544,7 @@ _cogl_pipeline_free (CoglPipeline *pipeline)
 
   recursively_free_layer_caches (pipeline);
 
-  g_slice_free (CoglPipeline, pipeline);
+  _cogl_slab_free (&pipeline_slab, pipeline);
 }
 
 gboolean
@@ -903,7 +941,7 @@ _cogl_pipeline_copy_differences (CoglPipeline *dest,
     {
       if (!dest->has_big_state)
         {
-          dest->big_state = g_slice_new (CoglPipelineBigState);
+          dest->big_state = _cogl_slab_alloc (&big_state_slab);
           dest->has_big_state = TRUE;
         }
       big_state = dest->big_state;
@@ -1335,10 +1373,15 @@ _cogl_pipeline_pre_change_notify (CoglPipeline     *pipeline,
 
   pipeline->age++;
 
+  /* The change could make this pipeline an authority for a new state
+   * group. We know there are no dependants at this point so only its
+   * own cache needs to be thrown away */
+  free_authorities_cache (pipeline);
+
   if (change & COGL_PIPELINE_STATE_NEEDS_BIG_STATE &&
       !pipeline->has_big_state)
     {
-      pipeline->big_state = g_slice_new (CoglPipelineBigState);
+      pipeline->big_state = _cogl_slab_alloc (&big_state_slab);
       pipeline->has_big_state = TRUE;
     }
 
@@ -2137,13 +2180,40 @@ _cogl_pipeline_resolve_authorities (CoglPipeline *pipeline,
   g_assert (remaining == 0);
 }
 
+/* Returns the authority for every sparse state group of @pipeline.
+ * The result is cached with the pipeline and is only rebuilt after
+ * some pipeline has been modified or reparented. The returned array
+ * must not be kept across pipeline modifications. */
+static CoglPipeline **
+_cogl_pipeline_get_authorities (CoglPipeline *pipeline)
+{
+  CoglPipelineAuthoritiesCache *cache = pipeline->authorities_cache;
+
+  _COGL_GET_CONTEXT (ctx, NULL);
+
+  if (G_UNLIKELY (cache == NULL))
+    {
+      cache = g_slice_new (CoglPipelineAuthoritiesCache);
+      pipeline->authorities_cache = cache;
+    }
+  else if (cache->age == ctx->pipeline_graph_age)
+    return cache->authorities;
+
+  _cogl_pipeline_resolve_authorities (pipeline,
+                                      COGL_PIPELINE_STATE_ALL_SPARSE,
+                                      cache->authorities);
+  cache->age = ctx->pipeline_graph_age;
+  cache->batch_hash_valid = FALSE;
+
+  return cache->authorities;
+}
+
 /* Comparison of two arbitrary pipelines is done by:
- * 1) walking up the parents of each pipeline until a common
- *    ancestor is found, and at each step ORing together the
- *    difference masks.
+ * 1) looking up the cached authorities of each pipeline for every
+ *    sparse state group. Any group where both pipelines share the
+ *    same authority must be equal.
  *
- * 2) using the final difference mask to determine which state
- *    groups to compare.
+ * 2) comparing the remaining state groups that the caller asked for.
  *
  * This is used, for example, by the Cogl journal to compare pipelines so that
  * it can split up geometry that needs different OpenGL state.
@@ -2169,9 +2239,10 @@ _cogl_pipeline_equal (CoglPipeline *pipeline0,
                       CoglPipelineEvalFlags flags)
 {
   unsigned long pipelines_difference;
-  CoglPipeline *authorities0[COGL_PIPELINE_STATE_SPARSE_COUNT];
-  CoglPipeline *authorities1[COGL_PIPELINE_STATE_SPARSE_COUNT];
+  CoglPipeline **authorities0;
+  CoglPipeline **authorities1;
   gboolean ret;
+  int i;
 
   COGL_STATIC_TIMER (pipeline_equal_timer,
                      "Mainloop", /* parent */
@@ -2197,22 +2268,21 @@ _cogl_pipeline_equal (CoglPipeline *pipeline0,
 
   /* Then check sparse properties */
 
-  pipelines_difference =
-    _cogl_pipeline_compare_differences (pipeline0, pipeline1);
+  authorities0 = _cogl_pipeline_get_authorities (pipeline0);
+  authorities1 = _cogl_pipeline_get_authorities (pipeline1);
+
+  /* This gives the same mask as _cogl_pipeline_compare_differences()
+   * would because a state group can only have different authorities
+   * if one of the pipelines is an authority below the common
+   * ancestor */
+  pipelines_difference = 0;
+  for (i = 0; i < COGL_PIPELINE_STATE_SPARSE_COUNT; i++)
+    if (authorities0[i] != authorities1[i])
+      pipelines_difference |= 1L<<i;
 
   /* Only compare the sparse state groups requested by the caller... */
   pipelines_difference &= differences;
 
-  _cogl_pipeline_resolve_authorities (pipeline0,
-                                      pipelines_difference,
-                                      authorities0);
-  _cogl_pipeline_resolve_authorities (pipeline1,
-                                      pipelines_difference,
-                                      authorities1);
-
-  /* FIXME: we should resolve all the required authorities up front since
-   * that should reduce some repeat ancestor traversals. */
-
   if (pipelines_difference & COGL_PIPELINE_STATE_COLOR)
     {
       CoglPipeline *authority0 = authorities0[COGL_PIPELINE_STATE_COLOR_INDEX];
@@ -2746,8 +2816,7 @@ _cogl_pipeline_hash (CoglPipeline *pipeline,
                      unsigned long layer_differences,
                      CoglPipelineEvalFlags flags)
 {
-  CoglPipeline *authorities[COGL_PIPELINE_STATE_SPARSE_COUNT];
-  unsigned long mask;
+  CoglPipeline **authorities;
   int i;
   CoglPipelineHashState state;
   unsigned int final_hash = 0;
@@ -2767,8 +2836,7 @@ _cogl_pipeline_hash (CoglPipeline *pipeline,
 
   /* hash sparse state */
 
-  mask = differences & COGL_PIPELINE_STATE_ALL_SPARSE;
-  _cogl_pipeline_resolve_authorities (pipeline, mask, authorities);
+  authorities = _cogl_pipeline_get_authorities (pipeline);
 
   for (i = 0; i < COGL_PIPELINE_STATE_SPARSE_COUNT; i++)
     {
@@ -2793,6 +2861,28 @@ _cogl_pipeline_hash (CoglPipeline *pipeline,
   return _cogl_util_one_at_a_time_mix (final_hash);
 }
 
+unsigned int
+_cogl_pipeline_get_batch_hash (CoglPipeline *pipeline)
+{
+  CoglPipelineAuthoritiesCache *cache;
+
+  /* This makes sure the cache exists and is up to date */
+  _cogl_pipeline_get_authorities (pipeline);
+  cache = pipeline->authorities_cache;
+
+  if (!cache->batch_hash_valid)
+    {
+      cache->batch_hash =
+        _cogl_pipeline_hash (pipeline,
+                             COGL_PIPELINE_STATE_BATCH_HASH,
+                             COGL_PIPELINE_LAYER_STATE_BATCH_HASH,
+                             0);
+      cache->batch_hash_valid = TRUE;
+    }
+
+  return cache->batch_hash;
+}
+
 typedef struct
 {
   int i;
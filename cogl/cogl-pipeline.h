@@ -159,6 +159,76 @@ int
 cogl_pipeline_get_uniform_location (CoglPipeline *pipeline,
                                     const char *uniform_name);
 
+/**
+ * CoglPipelinePrecompileFlags:
+ * @COGL_PIPELINE_PRECOMPILE_FLAG_NONE: Compile the pipelines
+ *   immediately
+ * @COGL_PIPELINE_PRECOMPILE_FLAG_IDLE: Queue the pipelines and compile
+ *   them later from cogl_poll_dispatch()
+ *
+ * Flags to modify the behaviour of cogl_pipeline_precompile() and
+ * cogl_pipeline_precompile_many().
+ *
+ * Since: 1.10
+ * Stability: Unstable
+ */
+typedef enum
+{
+  COGL_PIPELINE_PRECOMPILE_FLAG_NONE = 0,
+  COGL_PIPELINE_PRECOMPILE_FLAG_IDLE = 1 << 0
+} CoglPipelinePrecompileFlags;
+
+/**
+ * cogl_pipeline_precompile:
+ * @context: A #CoglContext
+ * @pipeline: A #CoglPipeline object
+ * @flags: A set of #CoglPipelinePrecompileFlags
+ *
+ * Generates and links any GPU programs that will be needed to draw
+ * with @pipeline. Normally this happens the first time a pipeline is
+ * used which can cause a noticeable pause in the middle of a
+ * frame. Calling this function ahead of time, for example while a
+ * new scene is being loaded, avoids that pause.
+ *
+ * The programs are shared between all pipelines that have the same
+ * state affecting the generated code so it is not necessary to
+ * precompile the exact pipeline that will later be drawn. Changing
+ * state such as the color or the value of a uniform will not cause
+ * the program to be generated again.
+ *
+ * If @flags contains %COGL_PIPELINE_PRECOMPILE_FLAG_IDLE then the
+ * pipeline is only queued and the work is done later from
+ * cogl_poll_dispatch(), one pipeline at a time. While the queue is
+ * not empty cogl_poll_get_info() will return a timeout of zero. An
+ * application using cogl_glib_source_new() will have the queue
+ * processed automatically when the main loop runs the source.
+ *
+ * Since: 1.10
+ * Stability: Unstable
+ */
+void
+cogl_pipeline_precompile (CoglContext *context,
+                          CoglPipeline *pipeline,
+                          CoglPipelinePrecompileFlags flags);
+
+/**
+ * cogl_pipeline_precompile_many:
+ * @context: A #CoglContext
+ * @pipelines: An array of #CoglPipeline objects
+ * @n_pipelines: The number of pipelines in @pipelines
+ * @flags: A set of #CoglPipelinePrecompileFlags
+ *
+ * Precompiles all of the pipelines in @pipelines as if
+ * cogl_pipeline_precompile() was called for each of them.
+ *
+ * Since: 1.10
+ * Stability: Unstable
+ */
+void
+cogl_pipeline_precompile_many (CoglContext *context,
+                               CoglPipeline **pipelines,
+                               int n_pipelines,
+                               CoglPipelinePrecompileFlags flags);
 
 #endif /* COGL_ENABLE_EXPERIMENTAL_API */
 
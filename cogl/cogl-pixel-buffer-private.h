@@ -47,6 +47,12 @@ struct _CoglPixelBuffer
   unsigned int          stride;
 };
 
+/* Creates a buffer of @size bytes without any format
+ * information. This will be backed by a PBO if the driver supports
+ * them */
+CoglPixelBuffer *
+_cogl_pixel_buffer_new (CoglContext *context, unsigned int size);
+
 G_END_DECLS
 
 #endif /* __COGL_PIXEL_BUFFER_PRIVATE_H__ */
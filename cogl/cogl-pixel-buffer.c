@@ -67,7 +67,7 @@ _cogl_pixel_buffer_free (CoglPixelBuffer *buffer);
 
 COGL_BUFFER_DEFINE (PixelBuffer, pixel_buffer)
 
-static CoglPixelBuffer *
+CoglPixelBuffer *
 _cogl_pixel_buffer_new (CoglContext *context, unsigned int size)
 {
   CoglPixelBuffer *pixel_buffer = g_slice_new0 (CoglPixelBuffer);
@@ -30,6 +30,10 @@
 #include "cogl-poll.h"
 #include "cogl-winsys-private.h"
 #include "cogl-context-private.h"
+#include "cogl-pipeline-opengl-private.h"
+#include "cogl-readback-private.h"
+#include "cogl-memory-private.h"
+#include "cogl-tiled-texture-private.h"
 
 void
 cogl_poll_get_info (CoglContext *context,
@@ -38,6 +42,8 @@ cogl_poll_get_info (CoglContext *context,
                     gint64 *timeout)
 {
   const CoglWinsysVtable *winsys;
+  gint64 readback_timeout;
+  gint64 tile_timeout;
 
   _COGL_RETURN_IF_FAIL (cogl_is_context (context));
   _COGL_RETURN_IF_FAIL (poll_fds != NULL);
@@ -47,18 +53,39 @@ cogl_poll_get_info (CoglContext *context,
   winsys = _cogl_context_get_winsys (context);
 
   if (winsys->poll_get_info)
+    winsys->poll_get_info (context,
+                           poll_fds,
+                           n_poll_fds,
+                           timeout);
+  else
     {
-      winsys->poll_get_info (context,
-                             poll_fds,
-                             n_poll_fds,
-                             timeout);
-      return;
+      /* By default we'll assume Cogl doesn't need to block on anything */
+      *poll_fds = NULL;
+      *n_poll_fds = 0;
+      *timeout = -1; /* no timeout */
     }
 
-  /* By default we'll assume Cogl doesn't need to block on anything */
-  *poll_fds = NULL;
-  *n_poll_fds = 0;
-  *timeout = -1; /* no timeout */
+  /* If there are pipelines waiting to be precompiled or low memory
+   * callbacks waiting to be invoked then we want to be dispatched
+   * again straight away */
+  if (_cogl_pipeline_has_pending_precompiles (context) ||
+      _cogl_memory_has_pending_callbacks (context))
+    *timeout = 0;
+
+  /* The fences for asynchronous readbacks can't be waited on with a
+   * file descriptor so if there are any pending then we need to be
+   * woken up periodically to check them */
+  readback_timeout = _cogl_readback_get_timeout (context);
+  if (readback_timeout != -1 &&
+      (*timeout == -1 || readback_timeout < *timeout))
+    *timeout = readback_timeout;
+
+  /* The same goes for the threads loading the tiles of tiled
+   * textures */
+  tile_timeout = _cogl_tiled_texture_get_timeout (context);
+  if (tile_timeout != -1 &&
+      (*timeout == -1 || tile_timeout < *timeout))
+    *timeout = tile_timeout;
 }
 
 void
@@ -74,4 +101,9 @@ cogl_poll_dispatch (CoglContext *context,
 
   if (winsys->poll_dispatch)
     winsys->poll_dispatch (context, poll_fds, n_poll_fds);
+
+  _cogl_pipeline_dispatch_precompiles (context);
+  _cogl_readback_dispatch (context);
+  _cogl_tiled_texture_dispatch (context);
+  _cogl_memory_dispatch (context);
 }
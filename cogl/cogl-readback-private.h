@@ -0,0 +1,142 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_READBACK_PRIVATE_H
+#define __COGL_READBACK_PRIVATE_H
+
+#include <glib.h>
+
+#include "cogl-context.h"
+#include "cogl-pixel-buffer.h"
+#include "cogl-bitmap.h"
+
+/*
+ * A CoglReadback tracks an asynchronous read of pixels from the GPU.
+ * GL writes the pixels into a pixel buffer and a fence is inserted
+ * straight afterwards. cogl_poll_dispatch() checks the fences of the
+ * pending readbacks without blocking. Once a fence has signalled the
+ * buffer is mapped and the pixels are copied into the application's
+ * memory, flipped and converted to the requested premultiplied
+ * state. This is done on a separate thread when threads are
+ * available. The callbacks are always invoked from
+ * cogl_poll_dispatch() in the order the readbacks were started.
+ */
+
+typedef enum
+{
+  COGL_READBACK_STATE_WAITING,
+  COGL_READBACK_STATE_CONVERTING,
+  COGL_READBACK_STATE_DONE
+} CoglReadbackState;
+
+typedef struct _CoglReadback
+{
+  CoglReadbackState state;
+
+  /* The buffer that GL writes to. This is NULL if the pixels were
+     read synchronously */
+  CoglPixelBuffer *buffer;
+  int buffer_rowstride;
+  /* A GLsync, or NULL once it has signalled */
+  void *fence;
+  /* Only valid while the buffer is mapped for the conversion */
+  guint8 *buffer_data;
+
+  /* Wraps the application's memory with the format that was read */
+  CoglBitmap *dst_bmp;
+  guint8 *pixels;
+  int rowstride;
+  int width, height, bpp;
+  CoglPixelFormat format;
+  /* Whether the rows should be reversed while copying */
+  gboolean flip;
+
+  gboolean success;
+
+  CoglReadbackCallback callback;
+  void *user_data;
+} CoglReadback;
+
+/* Returns whether the driver has both PBOs and fences */
+gboolean
+_cogl_readback_is_supported (CoglContext *ctx);
+
+/* Creates a readback with a buffer big enough for @width x @height
+ * pixels of @read_format. When it completes the pixels will be in
+ * @pixels with the premultiplied state of @format */
+CoglReadback *
+_cogl_readback_new (CoglContext *ctx,
+                    int width,
+                    int height,
+                    CoglPixelFormat read_format,
+                    CoglPixelFormat format,
+                    int rowstride,
+                    guint8 *pixels,
+                    gboolean flip,
+                    CoglReadbackCallback callback,
+                    void *user_data);
+
+/* Binds the readback's buffer to GL_PIXEL_PACK_BUFFER and returns
+ * the pointer that should be passed to GL to read into it. The rows
+ * should be packed with buffer_rowstride */
+guint8 *
+_cogl_readback_bind (CoglReadback *readback);
+
+void
+_cogl_readback_unbind (CoglReadback *readback);
+
+/* Inserts a fence after GL has been asked to read into the buffer and
+ * adds the readback to the context's queue */
+void
+_cogl_readback_queue (CoglContext *ctx,
+                      CoglReadback *readback);
+
+/* Frees a readback that was never queued */
+void
+_cogl_readback_free (CoglReadback *readback);
+
+/* Queues the callback for pixels that have already been read
+ * synchronously so that the application is still notified from
+ * cogl_poll_dispatch() */
+void
+_cogl_readback_queue_completed (CoglContext *ctx,
+                                gboolean success,
+                                CoglReadbackCallback callback,
+                                void *user_data);
+
+/* Returns the maximum time in microseconds that cogl_poll_get_info()
+ * should let the application sleep for, or -1 if there are no
+ * pending readbacks */
+gint64
+_cogl_readback_get_timeout (CoglContext *ctx);
+
+void
+_cogl_readback_dispatch (CoglContext *ctx);
+
+/* Drops all of the pending readbacks without invoking their
+ * callbacks. This is used when the context is destroyed */
+void
+_cogl_readback_clear_pending (CoglContext *ctx);
+
+#endif /* __COGL_READBACK_PRIVATE_H */
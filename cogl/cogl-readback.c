@@ -0,0 +1,386 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "cogl-internal.h"
+#include "cogl-context-private.h"
+#include "cogl-readback-private.h"
+#include "cogl-pixel-buffer-private.h"
+#include "cogl-bitmap-private.h"
+
+#if defined (HAVE_COGL_GL)
+
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER GL_PIXEL_PACK_BUFFER_ARB
+#endif
+
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+
+#endif
+
+/* There is no file descriptor to wait on for a fence so while a
+   readback is pending the application is asked to wake up this often
+   (in microseconds) to check it */
+#define COGL_READBACK_POLL_INTERVAL 1000
+
+gboolean
+_cogl_readback_is_supported (CoglContext *ctx)
+{
+  return ((ctx->private_feature_flags &
+           (COGL_PRIVATE_FEATURE_PBOS | COGL_PRIVATE_FEATURE_FENCES)) ==
+          (COGL_PRIVATE_FEATURE_PBOS | COGL_PRIVATE_FEATURE_FENCES));
+}
+
+CoglReadback *
+_cogl_readback_new (CoglContext *ctx,
+                    int width,
+                    int height,
+                    CoglPixelFormat read_format,
+                    CoglPixelFormat format,
+                    int rowstride,
+                    guint8 *pixels,
+                    gboolean flip,
+                    CoglReadbackCallback callback,
+                    void *user_data)
+{
+  CoglReadback *readback = g_slice_new0 (CoglReadback);
+
+  readback->state = COGL_READBACK_STATE_WAITING;
+
+  readback->width = width;
+  readback->height = height;
+  readback->bpp = _cogl_get_format_bpp (read_format);
+  readback->buffer_rowstride = width * readback->bpp;
+  readback->buffer = _cogl_pixel_buffer_new (ctx,
+                                             readback->buffer_rowstride *
+                                             height);
+
+  readback->dst_bmp = _cogl_bitmap_new_from_data (pixels,
+                                                  read_format,
+                                                  width, height,
+                                                  rowstride,
+                                                  NULL, /* destroy_fn */
+                                                  NULL);
+  readback->pixels = pixels;
+  readback->rowstride = rowstride;
+  readback->format = format;
+  readback->flip = flip;
+
+  readback->callback = callback;
+  readback->user_data = user_data;
+
+  return readback;
+}
+
+guint8 *
+_cogl_readback_bind (CoglReadback *readback)
+{
+  CoglBuffer *buffer = COGL_BUFFER (readback->buffer);
+  guint8 *ptr;
+
+  ptr = _cogl_buffer_bind (buffer, COGL_BUFFER_BIND_TARGET_PIXEL_PACK);
+
+  /* GL writes to the buffer before it is ever mapped so the storage
+     needs to be created here instead of lazily by the buffer code. It
+     will only be read once by the CPU */
+#if defined (HAVE_COGL_GL)
+  if (!buffer->store_created)
+    {
+      GE( buffer->context, glBufferData (GL_PIXEL_PACK_BUFFER,
+                                         buffer->size,
+                                         NULL,
+                                         GL_STREAM_READ) );
+      buffer->store_created = TRUE;
+    }
+#endif
+
+  return ptr;
+}
+
+void
+_cogl_readback_unbind (CoglReadback *readback)
+{
+  _cogl_buffer_unbind (COGL_BUFFER (readback->buffer));
+}
+
+void
+_cogl_readback_free (CoglReadback *readback)
+{
+  if (readback->buffer)
+    cogl_object_unref (readback->buffer);
+  if (readback->dst_bmp)
+    cogl_object_unref (readback->dst_bmp);
+
+  g_slice_free (CoglReadback, readback);
+}
+
+void
+_cogl_readback_queue (CoglContext *ctx,
+                      CoglReadback *readback)
+{
+#ifdef GL_ARB_sync
+  readback->fence = ctx->glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+
+  g_queue_push_tail (&ctx->pending_readbacks, readback);
+}
+
+void
+_cogl_readback_queue_completed (CoglContext *ctx,
+                                gboolean success,
+                                CoglReadbackCallback callback,
+                                void *user_data)
+{
+  CoglReadback *readback = g_slice_new0 (CoglReadback);
+
+  readback->state = COGL_READBACK_STATE_DONE;
+  readback->success = success;
+  readback->callback = callback;
+  readback->user_data = user_data;
+
+  g_queue_push_tail (&ctx->pending_readbacks, readback);
+}
+
+/* Checks without blocking whether GL has finished writing to the
+   buffer */
+static gboolean
+check_fence (CoglContext *ctx,
+             CoglReadback *readback)
+{
+#ifdef GL_ARB_sync
+  if (readback->fence)
+    {
+      GLenum status;
+
+      /* The flush makes sure the fence will eventually signal even
+         if nothing else causes the commands to be submitted */
+      status = ctx->glClientWaitSync (readback->fence,
+                                      GL_SYNC_FLUSH_COMMANDS_BIT,
+                                      0);
+
+      if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return FALSE;
+
+      ctx->glDeleteSync (readback->fence);
+      readback->fence = NULL;
+    }
+#endif
+
+  return TRUE;
+}
+
+/* This may be called from the thread pool so it must not touch GL or
+   any reference counts */
+static void
+convert_readback (CoglReadback *readback)
+{
+  size_t row_size = readback->width * readback->bpp;
+  int y;
+
+  for (y = 0; y < readback->height; y++)
+    {
+      int src_y = readback->flip ? readback->height - y - 1 : y;
+
+      memcpy (readback->pixels + y * readback->rowstride,
+              readback->buffer_data + src_y * readback->buffer_rowstride,
+              row_size);
+    }
+
+  /* Convert to the premult format specified by the caller in-place.
+     This will do nothing if the premult status is already correct */
+  readback->success =
+    _cogl_bitmap_convert_premult_status (readback->dst_bmp, readback->format);
+}
+
+static void
+convert_readback_thread_cb (void *data, void *user_data)
+{
+  CoglReadback *readback = data;
+  GAsyncQueue *done_queue = user_data;
+
+  convert_readback (readback);
+
+  g_async_queue_push (done_queue, readback);
+}
+
+static gboolean
+ensure_readback_thread_pool (CoglContext *ctx)
+{
+  GError *error = NULL;
+
+  if (ctx->readback_thread_pool)
+    return TRUE;
+
+  if (ctx->readback_threads_failed)
+    return FALSE;
+
+#if !GLIB_CHECK_VERSION (2, 31, 0)
+  /* Older versions of GLib need the application to initialize the
+     thread system */
+  if (!g_thread_supported ())
+    {
+      ctx->readback_threads_failed = TRUE;
+      return FALSE;
+    }
+#endif
+
+  ctx->readback_done_queue = g_async_queue_new ();
+
+  /* A single thread is enough because the conversion is only a copy
+     and it just needs to be kept out of the application's thread */
+  ctx->readback_thread_pool =
+    g_thread_pool_new (convert_readback_thread_cb,
+                       ctx->readback_done_queue,
+                       1, /* max_threads */
+                       FALSE, /* not exclusive */
+                       &error);
+  if (ctx->readback_thread_pool == NULL)
+    {
+      g_warning ("Failed to create the readback thread pool: %s",
+                 error->message);
+      g_error_free (error);
+      g_async_queue_unref (ctx->readback_done_queue);
+      ctx->readback_done_queue = NULL;
+      ctx->readback_threads_failed = TRUE;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+start_conversion (CoglContext *ctx,
+                  CoglReadback *readback)
+{
+  readback->buffer_data = cogl_buffer_map (COGL_BUFFER (readback->buffer),
+                                           COGL_BUFFER_ACCESS_READ,
+                                           0 /* hints */);
+
+  if (readback->buffer_data == NULL)
+    {
+      readback->success = FALSE;
+      readback->state = COGL_READBACK_STATE_DONE;
+    }
+  else if (ensure_readback_thread_pool (ctx))
+    {
+      readback->state = COGL_READBACK_STATE_CONVERTING;
+      g_thread_pool_push (ctx->readback_thread_pool, readback, NULL);
+    }
+  else
+    {
+      convert_readback (readback);
+      readback->state = COGL_READBACK_STATE_DONE;
+    }
+}
+
+gint64
+_cogl_readback_get_timeout (CoglContext *ctx)
+{
+  CoglReadback *readback = g_queue_peek_head (&ctx->pending_readbacks);
+
+  if (readback == NULL)
+    return -1;
+
+  if (readback->state == COGL_READBACK_STATE_DONE ||
+      (readback->state == COGL_READBACK_STATE_WAITING &&
+       check_fence (ctx, readback)) ||
+      (ctx->readback_done_queue &&
+       g_async_queue_length (ctx->readback_done_queue) > 0))
+    return 0;
+
+  return COGL_READBACK_POLL_INTERVAL;
+}
+
+void
+_cogl_readback_dispatch (CoglContext *ctx)
+{
+  CoglReadback *readback;
+  GList *l;
+
+  /* The fences signal in order so we can stop at the first one that
+     is still pending */
+  for (l = ctx->pending_readbacks.head; l; l = l->next)
+    {
+      readback = l->data;
+
+      if (readback->state != COGL_READBACK_STATE_WAITING)
+        continue;
+
+      if (!check_fence (ctx, readback))
+        break;
+
+      start_conversion (ctx, readback);
+    }
+
+  if (ctx->readback_done_queue)
+    while ((readback = g_async_queue_try_pop (ctx->readback_done_queue)))
+      readback->state = COGL_READBACK_STATE_DONE;
+
+  /* The callbacks are invoked in the same order that the readbacks
+     were started */
+  while ((readback = g_queue_peek_head (&ctx->pending_readbacks)) &&
+         readback->state == COGL_READBACK_STATE_DONE)
+    {
+      g_queue_pop_head (&ctx->pending_readbacks);
+
+      if (readback->buffer_data)
+        cogl_buffer_unmap (COGL_BUFFER (readback->buffer));
+
+      readback->callback (readback->success, readback->user_data);
+
+      _cogl_readback_free (readback);
+    }
+}
+
+void
+_cogl_readback_clear_pending (CoglContext *ctx)
+{
+  CoglReadback *readback;
+
+  /* Wait for any conversions that are still running */
+  if (ctx->readback_thread_pool)
+    g_thread_pool_free (ctx->readback_thread_pool, FALSE, TRUE);
+  if (ctx->readback_done_queue)
+    g_async_queue_unref (ctx->readback_done_queue);
+
+  while ((readback = g_queue_pop_head (&ctx->pending_readbacks)))
+    {
+#ifdef GL_ARB_sync
+      if (readback->fence)
+        ctx->glDeleteSync (readback->fence);
+#endif
+
+      if (readback->buffer_data)
+        cogl_buffer_unmap (COGL_BUFFER (readback->buffer));
+
+      _cogl_readback_free (readback);
+    }
+}
@@ -29,12 +29,31 @@
 
 #include "cogl.h"
 
+/* The builtin matrices are either taken from the fixed function
+   state or, if uniform buffer objects are available, from a uniform
+   block that is shared by every program. One of these is put in front
+   of the rest of the boilerplate. The extension has to be enabled
+   before any other declarations */
+#define _COGL_BUILTIN_MATRICES_GL \
+  "#define cogl_modelview_matrix gl_ModelViewMatrix\n" \
+  "#define cogl_modelview_projection_matrix gl_ModelViewProjectionMatrix\n" \
+  "#define cogl_projection_matrix gl_ProjectionMatrix\n"
+
+#define _COGL_BUILTIN_UNIFORM_BLOCK_GL \
+  "#extension GL_ARB_uniform_buffer_object : enable\n" \
+  "\n" \
+  "layout(std140) uniform " _COGL_BUILTIN_UNIFORM_BLOCK_NAME "\n" \
+  "{\n" \
+  "  mat4 cogl_modelview_matrix;\n" \
+  "  mat4 cogl_projection_matrix;\n" \
+  "  mat4 cogl_modelview_projection_matrix;\n" \
+  "};\n"
+
+#define _COGL_BUILTIN_UNIFORM_BLOCK_NAME "_CoglBuiltins"
+
 #define _COGL_COMMON_SHADER_BOILERPLATE_GL \
   "#define COGL_VERSION 100\n" \
   "\n" \
-  "#define cogl_modelview_matrix gl_ModelViewMatrix\n" \
-  "#define cogl_modelview_projection_matrix gl_ModelViewProjectionMatrix\n" \
-  "#define cogl_projection_matrix gl_ProjectionMatrix\n" \
   "#define cogl_texture_matrix gl_TextureMatrix\n" \
   "\n"
 
@@ -184,8 +184,8 @@ _cogl_shader_set_source_with_boilerplate (GLuint shader_gl_handle,
   const char *vertex_boilerplate;
   const char *fragment_boilerplate;
 
-  const char **strings = g_alloca (sizeof (char *) * (count_in + 3));
-  GLint *lengths = g_alloca (sizeof (GLint) * (count_in + 3));
+  const char **strings = g_alloca (sizeof (char *) * (count_in + 4));
+  GLint *lengths = g_alloca (sizeof (GLint) * (count_in + 4));
   int count = 0;
   char *tex_coord_declarations = NULL;
 
@@ -211,6 +211,19 @@ _cogl_shader_set_source_with_boilerplate (GLuint shader_gl_handle,
       lengths[count++] = sizeof (texture_3d_extension) - 1;
     }
 
+  if (ctx->driver != COGL_DRIVER_GLES2)
+    {
+      const char *builtin_matrices;
+
+      if ((ctx->private_feature_flags & COGL_PRIVATE_FEATURE_UBOS))
+        builtin_matrices = _COGL_BUILTIN_UNIFORM_BLOCK_GL;
+      else
+        builtin_matrices = _COGL_BUILTIN_MATRICES_GL;
+
+      strings[count] = builtin_matrices;
+      lengths[count++] = strlen (builtin_matrices);
+    }
+
   if (shader_gl_type == GL_VERTEX_SHADER)
     {
       strings[count] = vertex_boilerplate;
@@ -0,0 +1,74 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_SLAB_PRIVATE_H
+#define __COGL_SLAB_PRIVATE_H
+
+#include <glib.h>
+
+#include "cogl-debug.h"
+
+/*
+ * A CoglSlabAllocator hands out fixed size blocks of memory for one
+ * type of structure. The blocks are carved out of larger slabs and
+ * freed blocks are kept on a free list to be reused by the next
+ * allocation so that structures which are created and destroyed
+ * every frame don't have to go through the general purpose
+ * allocator. The slabs are never returned to the system.
+ *
+ * The allocators are meant to be declared statically using
+ * COGL_SLAB_ALLOCATOR_INIT. They are not thread safe.
+ */
+
+typedef struct _CoglSlabAllocator
+{
+  /* If this is not NULL then the allocations are reported under this
+     name by cogl_debug_object_foreach_type(). Allocators for
+     CoglObjects should leave it as NULL because the objects are
+     already counted */
+  const char *name;
+
+  size_t object_size;
+  int objects_per_slab;
+
+  void *free_list;
+  GSList *slabs;
+
+  CoglDebugTypeStats stats;
+} CoglSlabAllocator;
+
+#define COGL_SLAB_ALLOCATOR_INIT(name, object_size, objects_per_slab) \
+  { (name), (object_size), (objects_per_slab), NULL, NULL, { 0, 0, 0 } }
+
+void *
+_cogl_slab_alloc (CoglSlabAllocator *slab);
+
+void *
+_cogl_slab_alloc0 (CoglSlabAllocator *slab);
+
+void
+_cogl_slab_free (CoglSlabAllocator *slab,
+                 void *object);
+
+#endif /* __COGL_SLAB_PRIVATE_H */
@@ -0,0 +1,106 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "cogl-slab-private.h"
+
+/* Every block is aligned to this so that any structure can be stored
+   in it */
+#define COGL_SLAB_ALIGNMENT MAX (sizeof (void *), sizeof (double))
+
+static size_t
+get_block_size (CoglSlabAllocator *slab)
+{
+  /* The block needs to be big enough to hold the free list link */
+  size_t size = MAX (slab->object_size, sizeof (void *));
+
+  return (size + COGL_SLAB_ALIGNMENT - 1) & ~(COGL_SLAB_ALIGNMENT - 1);
+}
+
+static void
+add_slab (CoglSlabAllocator *slab)
+{
+  size_t block_size = get_block_size (slab);
+  guint8 *data = g_malloc (block_size * slab->objects_per_slab);
+  int i;
+
+  slab->slabs = g_slist_prepend (slab->slabs, data);
+
+  /* Link the blocks in order so that consecutive allocations are
+     next to each other in memory */
+  for (i = slab->objects_per_slab - 1; i >= 0; i--)
+    {
+      void **block = (void **) (data + block_size * i);
+
+      *block = slab->free_list;
+      slab->free_list = block;
+    }
+
+  if (slab->name && slab->slabs->next == NULL)
+    _cogl_debug_register_type_stats (slab->name, &slab->stats);
+}
+
+void *
+_cogl_slab_alloc (CoglSlabAllocator *slab)
+{
+  void **block;
+
+  if (G_UNLIKELY (slab->free_list == NULL))
+    add_slab (slab);
+
+  block = slab->free_list;
+  slab->free_list = *block;
+
+  slab->stats.instance_count++;
+  slab->stats.n_allocations++;
+
+  return block;
+}
+
+void *
+_cogl_slab_alloc0 (CoglSlabAllocator *slab)
+{
+  void *object = _cogl_slab_alloc (slab);
+
+  memset (object, 0, slab->object_size);
+
+  return object;
+}
+
+void
+_cogl_slab_free (CoglSlabAllocator *slab,
+                 void *object)
+{
+  void **block = object;
+
+  *block = slab->free_list;
+  slab->free_list = block;
+
+  slab->stats.instance_count--;
+}
@@ -28,6 +28,16 @@
 #include "cogl-pipeline-private.h"
 #include "cogl-texture-private.h"
 
+/* The number of separate regions of the base level that are tracked
+   for updating the mipmaps before they start getting merged */
+#define COGL_TEXTURE_2D_MAX_DIRTY_RECTS 4
+
+typedef struct _CoglTexture2DDirtyRect
+{
+  int x1, y1;
+  int x2, y2;
+} CoglTexture2DDirtyRect;
+
 struct _CoglTexture2D
 {
   CoglTexture     _parent;
@@ -46,7 +56,13 @@ struct _CoglTexture2D
   GLint           wrap_mode_s;
   GLint           wrap_mode_t;
   gboolean        auto_mipmap;
+  /* If this is set then the whole mipmap chain needs to be
+     regenerated */
   gboolean        mipmaps_dirty;
+  /* Otherwise these are the regions of the base level that have been
+     modified since the mipmaps were last updated */
+  int             n_dirty_rects;
+  CoglTexture2DDirtyRect dirty_rects[COGL_TEXTURE_2D_MAX_DIRTY_RECTS];
   gboolean        is_foreign;
 
   CoglTexturePixel first_pixel;
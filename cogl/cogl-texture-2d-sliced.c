@@ -45,6 +45,7 @@
 #include "cogl-spans.h"
 #include "cogl-journal-private.h"
 #include "cogl-pipeline-opengl-private.h"
+#include "cogl-upload-ring-private.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -130,41 +131,27 @@ _cogl_texture_2d_sliced_foreach_sub_texture_in_region (
                                          &data);
 }
 
-static guint8 *
-_cogl_texture_2d_sliced_allocate_waste_buffer (CoglTexture2DSliced *tex_2ds,
-                                               CoglPixelFormat format)
+/* A region of a slice's waste that needs to be filled by replicating
+   the pixels along the edge of the source image */
+typedef struct
 {
-  CoglSpan *last_x_span;
-  CoglSpan *last_y_span;
-  guint8   *waste_buf = NULL;
-
-  /* If the texture has any waste then allocate a buffer big enough to
-     fill the gaps */
-  last_x_span = &g_array_index (tex_2ds->slice_x_spans, CoglSpan,
-                                tex_2ds->slice_x_spans->len - 1);
-  last_y_span = &g_array_index (tex_2ds->slice_y_spans, CoglSpan,
-                                tex_2ds->slice_y_spans->len - 1);
-  if (last_x_span->waste > 0 || last_y_span->waste > 0)
-    {
-      int bpp = _cogl_get_format_bpp (format);
-      CoglSpan  *first_x_span
-        = &g_array_index (tex_2ds->slice_x_spans, CoglSpan, 0);
-      CoglSpan  *first_y_span
-        = &g_array_index (tex_2ds->slice_y_spans, CoglSpan, 0);
-      unsigned int right_size = first_y_span->size * last_x_span->waste;
-      unsigned int bottom_size = first_x_span->size * last_y_span->waste;
-
-      waste_buf = g_malloc (MAX (right_size, bottom_size) * bpp);
-    }
-
-  return waste_buf;
-}
+  CoglTexture2D *slice_tex;
+  /* The position of the waste within the slice */
+  int dst_x, dst_y;
+  int width, height;
+  /* The first pixel to replicate in the source bitmap */
+  int src_x, src_y;
+  /* Waste on the right is filled from a column of pixels that are
+     each repeated across the width. Waste at the bottom is filled
+     from a row of src_width pixels that is repeated down the height
+     with its last pixel repeated to fill the width */
+  gboolean is_right;
+  int src_width;
+} CoglTexture2DSlicedWaste;
 
 static void
-_cogl_texture_2d_sliced_set_waste (CoglTexture2DSliced *tex_2ds,
-                                   CoglBitmap *source_bmp,
+_cogl_texture_2d_sliced_add_waste (GArray *waste_rects,
                                    CoglTexture2D *slice_tex,
-                                   guint8 *waste_buf,
                                    CoglSpan *x_span,
                                    CoglSpan *y_span,
                                    CoglSpanIter *x_iter,
@@ -174,138 +161,231 @@ _cogl_texture_2d_sliced_set_waste (CoglTexture2DSliced *tex_2ds,
                                    int dst_x,
                                    int dst_y)
 {
-  gboolean need_x, need_y;
+  CoglTexture2DSlicedWaste waste;
+
+  waste.slice_tex = slice_tex;
 
   /* If the x_span is sliced and the upload touches the
      rightmost pixels then fill the waste with copies of the
      pixels */
-  need_x = x_span->waste > 0 &&
-    x_iter->intersect_end - x_iter->pos >= x_span->size - x_span->waste;
+  if (x_span->waste > 0 &&
+      x_iter->intersect_end - x_iter->pos >= x_span->size - x_span->waste)
+    {
+      waste.dst_x = x_span->size - x_span->waste;
+      waste.dst_y = y_iter->intersect_start - y_span->start;
+      waste.width = x_span->waste;
+      waste.height = y_iter->intersect_end - y_iter->intersect_start;
+      waste.src_x = (src_x + (int) x_span->start + (int) x_span->size -
+                     (int) x_span->waste - dst_x - 1);
+      waste.src_y = src_y + (int) y_iter->intersect_start - dst_y;
+      waste.is_right = TRUE;
+      waste.src_width = 1;
+
+      g_array_append_val (waste_rects, waste);
+    }
 
   /* same for the bottom-most pixels */
-  need_y = y_span->waste > 0 &&
-    y_iter->intersect_end - y_iter->pos >= y_span->size - y_span->waste;
-
-  if (need_x || need_y)
+  if (y_span->waste > 0 &&
+      y_iter->intersect_end - y_iter->pos >= y_span->size - y_span->waste)
     {
-      int bmp_rowstride = _cogl_bitmap_get_rowstride (source_bmp);
-      CoglPixelFormat source_format = _cogl_bitmap_get_format (source_bmp);
-      int bpp = _cogl_get_format_bpp (source_format);
-      guint8 *bmp_data;
-      const guint8 *src;
-      guint8 *dst;
-      unsigned int wy, wx;
-      CoglBitmap *waste_bmp;
+      waste.dst_x = x_iter->intersect_start - x_iter->pos;
+      waste.dst_y = y_span->size - y_span->waste;
+      waste.src_width = x_iter->intersect_end - x_iter->intersect_start;
+
+      /* If the upload also touches the right edge then this covers
+         the corner of the waste as well */
+      if (x_iter->intersect_end - x_iter->pos
+          >= x_span->size - x_span->waste)
+        waste.width = x_span->size + x_iter->pos - x_iter->intersect_start;
+      else
+        waste.width = waste.src_width;
 
-      bmp_data = _cogl_bitmap_map (source_bmp, COGL_BUFFER_ACCESS_READ, 0);
+      waste.height = y_span->waste;
+      waste.src_x = src_x + (int) x_iter->intersect_start - dst_x;
+      waste.src_y = (src_y + (int) y_span->start + (int) y_span->size -
+                     (int) y_span->waste - dst_y - 1);
+      waste.is_right = FALSE;
 
-      if (bmp_data == NULL)
-        return;
+      g_array_append_val (waste_rects, waste);
+    }
+}
 
-      if (need_x)
+/* Extends the block of @block_size bytes at the start of @data to
+   @n_blocks copies by doubling the copied region each time */
+static void
+replicate_block (guint8 *data,
+                 gsize block_size,
+                 int n_blocks)
+{
+  int n_done = 1;
+
+  while (n_done < n_blocks)
+    {
+      int n_copy = MIN (n_done, n_blocks - n_done);
+
+      memcpy (data + n_done * block_size, data, n_copy * block_size);
+      n_done += n_copy;
+    }
+}
+
+/* The waste is usually written into a pixel buffer that is mapped
+   write-only and may be uncached so this never reads back from dst.
+   Each row is built in the scratch buffer instead, which must be big
+   enough for one row of the waste, and then copied out */
+static void
+fill_waste (const CoglTexture2DSlicedWaste *waste,
+            const guint8 *bmp_data,
+            int bmp_rowstride,
+            int bpp,
+            guint8 *scratch,
+            guint8 *dst,
+            int dst_rowstride)
+{
+  const guint8 *src = bmp_data + waste->src_y * bmp_rowstride +
+    waste->src_x * bpp;
+  int y;
+
+  if (waste->is_right)
+    for (y = 0; y < waste->height; y++)
+      {
+        memcpy (scratch, src, bpp);
+        replicate_block (scratch, bpp, waste->width);
+        memcpy (dst, scratch, waste->width * bpp);
+        src += bmp_rowstride;
+        dst += dst_rowstride;
+      }
+  else
+    {
+      memcpy (scratch, src, waste->src_width * bpp);
+      replicate_block (scratch + (waste->src_width - 1) * bpp,
+                       bpp,
+                       waste->width - waste->src_width + 1);
+      /* Every row is the same */
+      for (y = 0; y < waste->height; y++)
         {
-          src = (bmp_data + ((src_y + (int) y_iter->intersect_start - dst_y) *
-                             bmp_rowstride) +
-                 (src_x + (int)x_span->start + (int)x_span->size -
-                  (int)x_span->waste - dst_x - 1) * bpp);
+          memcpy (dst, scratch, waste->width * bpp);
+          dst += dst_rowstride;
+        }
+    }
+}
 
-          dst = waste_buf;
+/* Fills all of the waste that an upload touched. The source bitmap is
+   only mapped once and the waste for every slice is staged together,
+   in a pixel buffer from the upload ring if possible so that GL can
+   queue the uploads without copying the data again */
+static void
+_cogl_texture_2d_sliced_upload_waste (CoglBitmap *source_bmp,
+                                      GArray *waste_rects)
+{
+  CoglPixelFormat source_format = _cogl_bitmap_get_format (source_bmp);
+  int bpp = _cogl_get_format_bpp (source_format);
+  int bmp_rowstride = _cogl_bitmap_get_rowstride (source_bmp);
+  CoglUploadRingSlot *slot = NULL;
+  guint8 *bmp_data;
+  guint8 *staging = NULL;
+  gsize staging_size = 0;
+  guint8 *scratch;
+  int max_width = 0;
+  gsize offset;
+  int i;
 
-          for (wy = 0;
-               wy < y_iter->intersect_end - y_iter->intersect_start;
-               wy++)
-            {
-              for (wx = 0; wx < x_span->waste; wx++)
-                {
-                  memcpy (dst, src, bpp);
-                  dst += bpp;
-                }
-              src += bmp_rowstride;
-            }
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
-          waste_bmp =
-            _cogl_bitmap_new_from_data (waste_buf,
-                                        source_format,
-                                        x_span->waste,
-                                        y_iter->intersect_end -
-                                        y_iter->intersect_start,
-                                        x_span->waste * bpp,
-                                        NULL,
-                                        NULL);
+  if (waste_rects->len == 0)
+    return;
 
-          cogl_texture_set_region_from_bitmap (COGL_TEXTURE (slice_tex),
-                                               0, /* src_x */
-                                               0, /* src_y */
-                                               /* dst_x */
-                                               x_span->size - x_span->waste,
-                                               y_iter->intersect_start -
-                                               y_span->start, /* dst_y */
-                                               x_span->waste, /* dst_width */
-                                               /* dst_height */
-                                               y_iter->intersect_end -
-                                               y_iter->intersect_start,
-                                               waste_bmp);
-
-          cogl_object_unref (waste_bmp);
-        }
+  /* The rows of each rectangle are padded to a multiple of 4 bytes so
+     that GL can use its default alignment */
+  for (i = 0; i < waste_rects->len; i++)
+    {
+      CoglTexture2DSlicedWaste *waste =
+        &g_array_index (waste_rects, CoglTexture2DSlicedWaste, i);
 
-      if (need_y)
-        {
-          unsigned int copy_width, intersect_width;
+      staging_size += ((waste->width * bpp + 3) & ~3) * waste->height;
+      max_width = MAX (max_width, waste->width);
+    }
 
-          src = (bmp_data + ((src_x + (int) x_iter->intersect_start - dst_x) *
-                             bpp) +
-                 (src_y + (int)y_span->start + (int)y_span->size -
-                  (int)y_span->waste - dst_y - 1) * bmp_rowstride);
+  bmp_data = _cogl_bitmap_map (source_bmp, COGL_BUFFER_ACCESS_READ, 0);
 
-          dst = waste_buf;
+  if (bmp_data == NULL)
+    return;
 
-          if (x_iter->intersect_end - x_iter->pos
-              >= x_span->size - x_span->waste)
-            copy_width = x_span->size + x_iter->pos - x_iter->intersect_start;
-          else
-            copy_width = x_iter->intersect_end - x_iter->intersect_start;
+  if (_cogl_upload_ring_is_supported (ctx))
+    {
+      slot = _cogl_upload_ring_acquire (ctx, &ctx->upload_ring,
+                                        staging_size);
+      staging = cogl_buffer_map (COGL_BUFFER (slot->buffer),
+                                 COGL_BUFFER_ACCESS_WRITE,
+                                 COGL_BUFFER_MAP_HINT_DISCARD);
+      if (staging == NULL)
+        slot = NULL;
+    }
 
-          intersect_width = x_iter->intersect_end - x_iter->intersect_start;
+  if (staging == NULL)
+    staging = g_malloc (staging_size);
 
-          for (wy = 0; wy < y_span->waste; wy++)
-            {
-              memcpy (dst, src, intersect_width * bpp);
-              dst += intersect_width * bpp;
-
-              for (wx = intersect_width; wx < copy_width; wx++)
-                {
-                  memcpy (dst, dst - bpp, bpp);
-                  dst += bpp;
-                }
-            }
+  scratch = g_malloc (max_width * bpp);
 
-          waste_bmp =
-            _cogl_bitmap_new_from_data (waste_buf,
-                                        source_format,
-                                        copy_width,
-                                        y_span->waste,
-                                        copy_width * bpp,
-                                        NULL,
-                                        NULL);
+  for (i = 0, offset = 0; i < waste_rects->len; i++)
+    {
+      CoglTexture2DSlicedWaste *waste =
+        &g_array_index (waste_rects, CoglTexture2DSlicedWaste, i);
+      int rowstride = (waste->width * bpp + 3) & ~3;
 
-          cogl_texture_set_region_from_bitmap (COGL_TEXTURE (slice_tex),
-                                               0, /* src_x */
-                                               0, /* src_y */
-                                               /* dst_x */
-                                               x_iter->intersect_start -
-                                               x_iter->pos,
-                                               /* dst_y */
-                                               y_span->size - y_span->waste,
-                                               copy_width, /* dst_width */
-                                               y_span->waste, /* dst_height */
-                                               waste_bmp);
-
-          cogl_object_unref (waste_bmp);
-        }
+      fill_waste (waste, bmp_data, bmp_rowstride, bpp, scratch,
+                  staging + offset, rowstride);
 
-      _cogl_bitmap_unmap (source_bmp);
+      offset += rowstride * waste->height;
     }
+
+  g_free (scratch);
+
+  _cogl_bitmap_unmap (source_bmp);
+
+  if (slot)
+    cogl_buffer_unmap (COGL_BUFFER (slot->buffer));
+
+  for (i = 0, offset = 0; i < waste_rects->len; i++)
+    {
+      CoglTexture2DSlicedWaste *waste =
+        &g_array_index (waste_rects, CoglTexture2DSlicedWaste, i);
+      int rowstride = (waste->width * bpp + 3) & ~3;
+      CoglBitmap *waste_bmp;
+
+      if (slot)
+        waste_bmp = cogl_bitmap_new_from_buffer (COGL_BUFFER (slot->buffer),
+                                                 source_format,
+                                                 waste->width,
+                                                 waste->height,
+                                                 rowstride,
+                                                 offset);
+      else
+        waste_bmp = _cogl_bitmap_new_from_data (staging + offset,
+                                                source_format,
+                                                waste->width,
+                                                waste->height,
+                                                rowstride,
+                                                NULL,
+                                                NULL);
+
+      cogl_texture_set_region_from_bitmap (COGL_TEXTURE (waste->slice_tex),
+                                           0, /* src_x */
+                                           0, /* src_y */
+                                           waste->dst_x,
+                                           waste->dst_y,
+                                           waste->width,
+                                           waste->height,
+                                           waste_bmp);
+
+      cogl_object_unref (waste_bmp);
+
+      offset += rowstride * waste->height;
+    }
+
+  if (slot)
+    _cogl_upload_ring_release (ctx, &ctx->upload_ring, slot);
+  else
+    g_free (staging);
 }
 
 static gboolean
@@ -316,13 +396,9 @@ _cogl_texture_2d_sliced_upload_to_gl (CoglTexture2DSliced *tex_2ds,
   CoglSpan        *y_span;
   CoglTexture2D   *slice_tex;
   int              x, y;
-  guint8          *waste_buf;
-  CoglPixelFormat  bmp_format;
+  GArray          *waste_rects;
 
-  bmp_format = _cogl_bitmap_get_format (bmp);
-
-  waste_buf = _cogl_texture_2d_sliced_allocate_waste_buffer (tex_2ds,
-                                                             bmp_format);
+  waste_rects = g_array_new (FALSE, FALSE, sizeof (CoglTexture2DSlicedWaste));
 
   /* Iterate vertical slices */
   for (y = 0; y < tex_2ds->slice_y_spans->len; ++y)
@@ -365,10 +441,8 @@ _cogl_texture_2d_sliced_upload_to_gl (CoglTexture2DSliced *tex_2ds,
                                   y_span->waste);
           y_iter.pos = y_span->start;
 
-          _cogl_texture_2d_sliced_set_waste (tex_2ds,
-                                             bmp,
+          _cogl_texture_2d_sliced_add_waste (waste_rects,
                                              slice_tex,
-                                             waste_buf,
                                              x_span, y_span,
                                              &x_iter, &y_iter,
                                              0, /* src_x */
@@ -378,8 +452,9 @@ _cogl_texture_2d_sliced_upload_to_gl (CoglTexture2DSliced *tex_2ds,
         }
     }
 
-  if (waste_buf)
-    g_free (waste_buf);
+  _cogl_texture_2d_sliced_upload_waste (bmp, waste_rects);
+
+  g_array_free (waste_rects, TRUE);
 
   return TRUE;
 }
@@ -404,13 +479,9 @@ _cogl_texture_2d_sliced_upload_subregion_to_gl (CoglTexture2DSliced *tex_2ds,
   int               source_x = 0, source_y = 0;
   int               inter_w = 0, inter_h = 0;
   int               local_x = 0, local_y = 0;
-  guint8           *waste_buf;
-  CoglPixelFormat   source_format;
+  GArray           *waste_rects;
 
-  source_format = _cogl_bitmap_get_format (source_bmp);
-
-  waste_buf =
-    _cogl_texture_2d_sliced_allocate_waste_buffer (tex_2ds, source_format);
+  waste_rects = g_array_new (FALSE, FALSE, sizeof (CoglTexture2DSlicedWaste));
 
   /* Iterate vertical spans */
   for (source_y = src_y,
@@ -473,10 +544,8 @@ _cogl_texture_2d_sliced_upload_subregion_to_gl (CoglTexture2DSliced *tex_2ds,
                                                inter_h, /* height */
                                                source_bmp);
 
-          _cogl_texture_2d_sliced_set_waste (tex_2ds,
-                                             source_bmp,
+          _cogl_texture_2d_sliced_add_waste (waste_rects,
                                              slice_tex,
-                                             waste_buf,
                                              x_span, y_span,
                                              &x_iter, &y_iter,
                                              src_x, src_y,
@@ -484,7 +553,9 @@ _cogl_texture_2d_sliced_upload_subregion_to_gl (CoglTexture2DSliced *tex_2ds,
         }
     }
 
-  g_free (waste_buf);
+  _cogl_texture_2d_sliced_upload_waste (source_bmp, waste_rects);
+
+  g_array_free (waste_rects, TRUE);
 
   return TRUE;
 }
@@ -608,6 +679,26 @@ _cogl_texture_2d_sliced_set_wrap_mode_parameters (CoglTexture *tex,
     }
 }
 
+/* The slices are accounted as part of a sliced texture instead of as
+   regular 2D textures. The padding that is never sampled is accounted
+   separately as waste */
+static void
+account_slice_memory (CoglTexture *slice_tex,
+                      const CoglSpan *x_span,
+                      const CoglSpan *y_span)
+{
+  double used_fraction = (((x_span->size - x_span->waste) *
+                           (y_span->size - y_span->waste)) /
+                          (x_span->size * y_span->size));
+  gsize waste = slice_tex->memory_size -
+    (gsize) (slice_tex->memory_size * used_fraction);
+
+  _cogl_texture_set_memory_usage (slice_tex,
+                                  COGL_MEMORY_TYPE_TEXTURE_2D_SLICED,
+                                  slice_tex->memory_size,
+                                  waste);
+}
+
 static gboolean
 _cogl_texture_2d_sliced_slices_create (CoglContext *ctx,
                                        CoglTexture2DSliced *tex_2ds,
@@ -766,6 +857,10 @@ _cogl_texture_2d_sliced_slices_create (CoglContext *ctx,
               g_error_free (error);
               return FALSE;
             }
+
+          account_slice_memory (COGL_TEXTURE (slice_textures[y * n_x_slices +
+                                                             x]),
+                                x_span, y_span);
         }
     }
 
@@ -848,6 +943,15 @@ cogl_texture_2d_sliced_new_with_size (CoglContext *ctx,
   if (internal_format == COGL_PIXEL_FORMAT_ANY)
     internal_format = COGL_PIXEL_FORMAT_RGBA_8888_PRE;
 
+  /* Compressed data can't be split into slices */
+  if (_cogl_pixel_format_is_compressed (internal_format))
+    {
+      g_set_error (error, COGL_TEXTURE_ERROR,
+                   COGL_TEXTURE_ERROR_FORMAT,
+                   "Compressed textures can not be sliced");
+      return NULL;
+    }
+
   /* Init texture with empty bitmap */
   tex_2ds = g_new (CoglTexture2DSliced, 1);
 
@@ -885,6 +989,11 @@ _cogl_texture_2d_sliced_new_from_bitmap (CoglBitmap      *bmp,
 
   _COGL_RETURN_VAL_IF_FAIL (cogl_is_bitmap (bmp), NULL);
 
+  /* Compressed data can't be split into slices. If it was too big
+     for a single texture then creating the texture has to fail */
+  if (_cogl_pixel_format_is_compressed (_cogl_bitmap_get_format (bmp)))
+    return NULL;
+
   width = _cogl_bitmap_get_width (bmp);
   height = _cogl_bitmap_get_height (bmp);
 
@@ -39,6 +39,8 @@
 #include "cogl-journal-private.h"
 #include "cogl-pipeline-opengl-private.h"
 #include "cogl-framebuffer-private.h"
+#include "cogl-clip-stack.h"
+#include "cogl-memory-private.h"
 #ifdef COGL_HAS_EGL_SUPPORT
 #include "cogl-winsys-egl-private.h"
 #endif
@@ -50,7 +52,19 @@
 #include <wayland-server.h>
 #endif
 
+#ifndef GL_READ_FRAMEBUFFER
+#define GL_READ_FRAMEBUFFER 0x8CA8
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER
+#define GL_DRAW_FRAMEBUFFER 0x8CA9
+#endif
+
 static void _cogl_texture_2d_free (CoglTexture2D *tex_2d);
+static void _cogl_texture_2d_add_dirty_rect (CoglTexture2D *tex_2d,
+                                             int x,
+                                             int y,
+                                             int width,
+                                             int height);
 
 COGL_TEXTURE_DEFINE (Texture2D, texture_2d);
 
@@ -137,6 +151,29 @@ _cogl_texture_2d_can_create (unsigned int width,
   return TRUE;
 }
 
+static gsize
+_cogl_texture_2d_get_memory_size (CoglTexture2D *tex_2d,
+                                  gboolean mipmaps)
+{
+  return _cogl_memory_calculate_texture_size (tex_2d->format,
+                                              tex_2d->width,
+                                              tex_2d->height,
+                                              1, /* depth */
+                                              mipmaps);
+}
+
+/* Accounts for the base level of a texture whose storage Cogl has
+   just allocated */
+static void
+_cogl_texture_2d_init_memory_usage (CoglTexture2D *tex_2d)
+{
+  _cogl_texture_set_memory_usage (COGL_TEXTURE (tex_2d),
+                                  COGL_MEMORY_TYPE_TEXTURE_2D,
+                                  _cogl_texture_2d_get_memory_size (tex_2d,
+                                                                    FALSE),
+                                  0);
+}
+
 static CoglTexture2D *
 _cogl_texture_2d_create_base (unsigned int     width,
                               unsigned int     height,
@@ -151,6 +188,7 @@ _cogl_texture_2d_create_base (unsigned int     width,
   tex_2d->width = width;
   tex_2d->height = height;
   tex_2d->mipmaps_dirty = TRUE;
+  tex_2d->n_dirty_rects = 0;
   tex_2d->auto_mipmap = (flags & COGL_TEXTURE_NO_AUTO_MIPMAP) == 0;
 
   /* We default to GL_LINEAR for both filters */
@@ -184,6 +222,16 @@ cogl_texture_2d_new_with_size (CoglContext *ctx,
   if (internal_format == COGL_PIXEL_FORMAT_ANY)
     internal_format = COGL_PIXEL_FORMAT_RGBA_8888_PRE;
 
+  /* Compressed textures can't be modified after they are created so
+     there is no point in creating an empty one */
+  if (_cogl_pixel_format_is_compressed (internal_format))
+    {
+      g_set_error (error, COGL_TEXTURE_ERROR,
+                   COGL_TEXTURE_ERROR_FORMAT,
+                   "Compressed textures can only be created from data");
+      return NULL;
+    }
+
   if (!_cogl_texture_2d_can_create (width, height, internal_format))
     {
       g_set_error (error, COGL_TEXTURE_ERROR,
@@ -208,6 +256,104 @@ cogl_texture_2d_new_with_size (CoglContext *ctx,
   GE( ctx, glTexImage2D (GL_TEXTURE_2D, 0, gl_intformat,
                          width, height, 0, gl_format, gl_type, NULL) );
 
+  _cogl_texture_2d_init_memory_usage (tex_2d);
+
+  return _cogl_texture_2d_handle_new (tex_2d);
+}
+
+static gboolean
+compressed_format_supported (CoglContext *ctx,
+                             CoglPixelFormat format)
+{
+  switch (format & COGL_UNPREMULT_MASK)
+    {
+    case COGL_PIXEL_FORMAT_ETC1_RGB_8:
+      return cogl_has_feature (ctx, COGL_FEATURE_ID_TEXTURE_ETC1);
+
+    case COGL_PIXEL_FORMAT_ETC2_RGB_8:
+    case COGL_PIXEL_FORMAT_ETC2_RGBA_8:
+      return cogl_has_feature (ctx, COGL_FEATURE_ID_TEXTURE_ETC2);
+
+    case COGL_PIXEL_FORMAT_S3TC_DXT1_RGB:
+    case COGL_PIXEL_FORMAT_S3TC_DXT3_RGBA:
+    case COGL_PIXEL_FORMAT_S3TC_DXT5_RGBA:
+      return cogl_has_feature (ctx, COGL_FEATURE_ID_TEXTURE_S3TC);
+
+    default:
+      return FALSE;
+    }
+}
+
+static CoglHandle
+_cogl_texture_2d_new_from_compressed_bitmap (CoglContext *ctx,
+                                             CoglBitmap *bmp,
+                                             CoglTextureFlags flags,
+                                             GError **error)
+{
+  CoglTexture2D *tex_2d;
+  CoglPixelFormat format = _cogl_bitmap_get_format (bmp);
+  int width = _cogl_bitmap_get_width (bmp);
+  int height = _cogl_bitmap_get_height (bmp);
+  GLenum gl_intformat;
+  GLenum gl_format;
+  GLenum gl_type;
+
+  if (!compressed_format_supported (ctx, format))
+    {
+      g_set_error (error, COGL_TEXTURE_ERROR,
+                   COGL_TEXTURE_ERROR_FORMAT,
+                   "The compressed format is not supported by the GPU");
+      return NULL;
+    }
+
+  /* The data is passed straight to GL so it has to be tightly
+     packed */
+  if (_cogl_bitmap_get_rowstride (bmp) !=
+      _cogl_get_format_block_size (format) * ((width + 3) / 4))
+    {
+      g_set_error (error, COGL_TEXTURE_ERROR,
+                   COGL_TEXTURE_ERROR_BAD_PARAMETER,
+                   "The rowstride of compressed data must be the size "
+                   "of a row of blocks");
+      return NULL;
+    }
+
+  ctx->texture_driver->pixel_format_to_gl (format,
+                                           &gl_intformat,
+                                           &gl_format,
+                                           &gl_type);
+
+  if ((!cogl_has_feature (ctx, COGL_FEATURE_ID_TEXTURE_NPOT) &&
+       (!_cogl_util_is_pot (width) || !_cogl_util_is_pot (height))) ||
+      !ctx->texture_driver->size_supported (GL_TEXTURE_2D,
+                                            gl_format,
+                                            gl_type,
+                                            width,
+                                            height))
+    {
+      g_set_error (error, COGL_TEXTURE_ERROR,
+                   COGL_TEXTURE_ERROR_SIZE,
+                   "Failed to create texture 2d due to size/format"
+                   " constraints");
+      return NULL;
+    }
+
+  /* GL can't generate mipmaps for compressed textures */
+  tex_2d = _cogl_texture_2d_create_base (width, height,
+                                         flags | COGL_TEXTURE_NO_AUTO_MIPMAP,
+                                         format);
+
+  ctx->texture_driver->gen (GL_TEXTURE_2D, 1, &tex_2d->gl_texture);
+  ctx->texture_driver->upload_compressed_to_gl (GL_TEXTURE_2D,
+                                                tex_2d->gl_texture,
+                                                FALSE,
+                                                bmp,
+                                                gl_intformat);
+
+  tex_2d->gl_format = gl_intformat;
+
+  _cogl_texture_2d_init_memory_usage (tex_2d);
+
   return _cogl_texture_2d_handle_new (tex_2d);
 }
 
@@ -232,6 +378,18 @@ _cogl_texture_2d_new_from_bitmap (CoglBitmap      *bmp,
     _cogl_texture_determine_internal_format (_cogl_bitmap_get_format (bmp),
                                              internal_format);
 
+  if (_cogl_pixel_format_is_compressed (internal_format))
+    {
+      if (internal_format == _cogl_bitmap_get_format (bmp))
+        return _cogl_texture_2d_new_from_compressed_bitmap (ctx, bmp,
+                                                            flags, error);
+
+      g_set_error (error, COGL_TEXTURE_ERROR,
+                   COGL_TEXTURE_ERROR_FORMAT,
+                   "Cogl can not compress texture data");
+      return NULL;
+    }
+
   if (!_cogl_texture_2d_can_create (_cogl_bitmap_get_width (bmp),
                                     _cogl_bitmap_get_height (bmp),
                                     internal_format))
@@ -287,6 +445,8 @@ _cogl_texture_2d_new_from_bitmap (CoglBitmap      *bmp,
 
   tex_2d->gl_format = gl_intformat;
 
+  _cogl_texture_2d_init_memory_usage (tex_2d);
+
   cogl_object_unref (dst_bmp);
 
   return _cogl_texture_2d_handle_new (tex_2d);
@@ -605,7 +765,7 @@ _cogl_texture_2d_copy_from_framebuffer (CoglHandle handle,
                             src_x, src_y,
                             width, height);
 
-  tex_2d->mipmaps_dirty = TRUE;
+  _cogl_texture_2d_add_dirty_rect (tex_2d, dst_x, dst_y, width, height);
 }
 
 static int
@@ -686,6 +846,21 @@ _cogl_texture_2d_set_filters (CoglTexture *tex,
   tex_2d->min_filter = min_filter;
   tex_2d->mag_filter = mag_filter;
 
+  /* Compressed textures only ever have the first level because GL
+     can't generate the mipmaps for them. A mipmap filter would make
+     the texture incomplete, and GLES has no GL_TEXTURE_MAX_LEVEL to
+     work around that, so the filter falls back to the equivalent
+     filter without mipmapping */
+  if (_cogl_pixel_format_is_compressed (tex_2d->format))
+    {
+      if (min_filter == GL_NEAREST_MIPMAP_NEAREST ||
+          min_filter == GL_NEAREST_MIPMAP_LINEAR)
+        min_filter = GL_NEAREST;
+      else if (min_filter == GL_LINEAR_MIPMAP_NEAREST ||
+               min_filter == GL_LINEAR_MIPMAP_LINEAR)
+        min_filter = GL_LINEAR;
+    }
+
   /* Apply new filters to the texture */
   _cogl_bind_gl_texture_transient (GL_TEXTURE_2D,
                                    tex_2d->gl_texture,
@@ -694,43 +869,252 @@ _cogl_texture_2d_set_filters (CoglTexture *tex,
   GE( ctx, glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter) );
 }
 
+static int
+dirty_rect_area (const CoglTexture2DDirtyRect *rect)
+{
+  return (rect->x2 - rect->x1) * (rect->y2 - rect->y1);
+}
+
 static void
-_cogl_texture_2d_pre_paint (CoglTexture *tex, CoglTexturePrePaintFlags flags)
+union_dirty_rects (CoglTexture2DDirtyRect *dst,
+                   const CoglTexture2DDirtyRect *a,
+                   const CoglTexture2DDirtyRect *b)
 {
-  CoglTexture2D *tex_2d = COGL_TEXTURE_2D (tex);
+  dst->x1 = MIN (a->x1, b->x1);
+  dst->y1 = MIN (a->y1, b->y1);
+  dst->x2 = MAX (a->x2, b->x2);
+  dst->y2 = MAX (a->y2, b->y2);
+}
 
-  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+static void
+_cogl_texture_2d_add_dirty_rect (CoglTexture2D *tex_2d,
+                                 int x,
+                                 int y,
+                                 int width,
+                                 int height)
+{
+  CoglTexture2DDirtyRect rect;
+  int best_rect = -1;
+  int best_growth = G_MAXINT;
+  int i;
 
-  /* Only update if the mipmaps are dirty */
-  if ((flags & COGL_TEXTURE_NEEDS_MIPMAP) &&
-      tex_2d->auto_mipmap && tex_2d->mipmaps_dirty)
+  /* If the whole chain is going to be regenerated anyway then there
+     is no need to track the region */
+  if (tex_2d->mipmaps_dirty || width <= 0 || height <= 0)
+    return;
+
+  rect.x1 = x;
+  rect.y1 = y;
+  rect.x2 = x + width;
+  rect.y2 = y + height;
+
+  /* Find the existing rectangle that would grow the least if the new
+     rectangle was merged into it */
+  for (i = 0; i < tex_2d->n_dirty_rects; i++)
     {
-      _cogl_bind_gl_texture_transient (GL_TEXTURE_2D,
+      CoglTexture2DDirtyRect merged;
+      int growth;
+
+      union_dirty_rects (&merged, tex_2d->dirty_rects + i, &rect);
+      growth = dirty_rect_area (&merged) -
+        dirty_rect_area (tex_2d->dirty_rects + i);
+
+      if (growth < best_growth)
+        {
+          best_rect = i;
+          best_growth = growth;
+        }
+    }
+
+  /* Merging doesn't cost anything if the union doesn't cover any more
+     texels than the two rectangles would separately. Otherwise we
+     only merge when there is no room left */
+  if (best_rect != -1 &&
+      (best_growth <= dirty_rect_area (&rect) ||
+       tex_2d->n_dirty_rects >= COGL_TEXTURE_2D_MAX_DIRTY_RECTS))
+    union_dirty_rects (tex_2d->dirty_rects + best_rect,
+                       tex_2d->dirty_rects + best_rect,
+                       &rect);
+  else
+    tex_2d->dirty_rects[tex_2d->n_dirty_rects++] = rect;
+}
+
+/* Updates only the dirty regions of the mipmap chain by downsampling
+   each level into the next with a linear blit. This returns FALSE if
+   the whole chain should be regenerated instead */
+static gboolean
+_cogl_texture_2d_update_mipmap_regions (CoglContext *ctx,
+                                        CoglTexture2D *tex_2d)
+{
+  CoglTexture2DDirtyRect rects[COGL_TEXTURE_2D_MAX_DIRTY_RECTS];
+  int n_rects = tex_2d->n_dirty_rects;
+  int src_width, src_height;
+  int dirty_area = 0;
+  gboolean ret = TRUE;
+  int level, i;
+
+  /* The GLES blit extensions can't scale so this only works with big
+     GL */
+  if (ctx->driver != COGL_DRIVER_GL ||
+      !(ctx->private_feature_flags & COGL_PRIVATE_FEATURE_OFFSCREEN_BLIT))
+    return FALSE;
+
+  for (i = 0; i < n_rects; i++)
+    dirty_area += dirty_rect_area (tex_2d->dirty_rects + i);
+
+  /* If most of the texture has changed then a single call to
+     regenerate the whole chain is likely to be faster */
+  if (dirty_area * 2 > tex_2d->width * tex_2d->height)
+    return FALSE;
+
+  memcpy (rects, tex_2d->dirty_rects,
+          sizeof (CoglTexture2DDirtyRect) * n_rects);
+
+  if (ctx->mipmap_fbos[0] == 0)
+    GE( ctx, glGenFramebuffers (2, ctx->mipmap_fbos) );
+
+  /* We are about to bind our own framebuffers so Cogl needs to rebind
+     the current framebuffer before it next draws */
+  ctx->current_draw_buffer_changes |= COGL_FRAMEBUFFER_STATE_BIND;
+
+  /* The blit is affected by the scissor so we need to disable it and
+     make sure the clip state gets flushed again later */
+  _cogl_gl_state_set_enabled (ctx, COGL_GL_STATE_CAP_SCISSOR_TEST, FALSE);
+  if (ctx->current_clip_stack_valid)
+    {
+      _cogl_clip_stack_unref (ctx->current_clip_stack);
+      ctx->current_clip_stack_valid = FALSE;
+    }
+  ctx->current_draw_buffer_changes |= COGL_FRAMEBUFFER_STATE_CLIP;
+
+  GE( ctx, glBindFramebuffer (GL_READ_FRAMEBUFFER, ctx->mipmap_fbos[0]) );
+  GE( ctx, glBindFramebuffer (GL_DRAW_FRAMEBUFFER, ctx->mipmap_fbos[1]) );
+
+  src_width = tex_2d->width;
+  src_height = tex_2d->height;
+
+  for (level = 1; src_width > 1 || src_height > 1; level++)
+    {
+      int dst_width = MAX (src_width >> 1, 1);
+      int dst_height = MAX (src_height >> 1, 1);
+
+      GE( ctx, glFramebufferTexture2D (GL_READ_FRAMEBUFFER,
+                                       GL_COLOR_ATTACHMENT0,
+                                       GL_TEXTURE_2D,
                                        tex_2d->gl_texture,
-                                       tex_2d->is_foreign);
+                                       level - 1) );
+      GE( ctx, glFramebufferTexture2D (GL_DRAW_FRAMEBUFFER,
+                                       GL_COLOR_ATTACHMENT0,
+                                       GL_TEXTURE_2D,
+                                       tex_2d->gl_texture,
+                                       level) );
+
+      /* Not all formats can be rendered to */
+      if (level == 1 &&
+          (ctx->glCheckFramebufferStatus (GL_READ_FRAMEBUFFER) !=
+           GL_FRAMEBUFFER_COMPLETE ||
+           ctx->glCheckFramebufferStatus (GL_DRAW_FRAMEBUFFER) !=
+           GL_FRAMEBUFFER_COMPLETE))
+        {
+          ret = FALSE;
+          break;
+        }
 
-      /* glGenerateMipmap is defined in the FBO extension. If it's not
-         available we'll fallback to temporarily enabling
-         GL_GENERATE_MIPMAP and reuploading the first pixel */
-      if (cogl_has_feature (ctx, COGL_FEATURE_ID_OFFSCREEN))
-        ctx->texture_driver->gl_generate_mipmaps (GL_TEXTURE_2D);
-#if defined(HAVE_COGL_GLES) || defined(HAVE_COGL_GL)
-      else
+      for (i = 0; i < n_rects; i++)
         {
-          GE( ctx, glTexParameteri (GL_TEXTURE_2D,
-                                    GL_GENERATE_MIPMAP,
-                                    GL_TRUE) );
-          GE( ctx, glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, 1, 1,
-                                    tex_2d->first_pixel.gl_format,
-                                    tex_2d->first_pixel.gl_type,
-                                    tex_2d->first_pixel.data) );
-          GE( ctx, glTexParameteri (GL_TEXTURE_2D,
-                                    GL_GENERATE_MIPMAP,
-                                    GL_FALSE) );
+          CoglTexture2DDirtyRect *rect = rects + i;
+
+          /* Round outwards so that the rectangle in the next level
+             covers every texel that was affected */
+          rect->x1 = rect->x1 >> 1;
+          rect->y1 = rect->y1 >> 1;
+          rect->x2 = MIN ((rect->x2 + 1) >> 1, dst_width);
+          rect->y2 = MIN ((rect->y2 + 1) >> 1, dst_height);
+
+          /* Scaling down by two with a linear filter samples exactly
+             between each 2x2 block of texels so this is the same box
+             filter that glGenerateMipmap would normally use */
+          GE( ctx, glBlitFramebuffer (rect->x1 * 2,
+                                      rect->y1 * 2,
+                                      MIN (rect->x2 * 2, src_width),
+                                      MIN (rect->y2 * 2, src_height),
+                                      rect->x1, rect->y1,
+                                      rect->x2, rect->y2,
+                                      GL_COLOR_BUFFER_BIT,
+                                      GL_LINEAR) );
         }
+
+      src_width = dst_width;
+      src_height = dst_height;
+    }
+
+  /* Detach the texture so that the framebuffers don't keep it alive */
+  GE( ctx, glFramebufferTexture2D (GL_READ_FRAMEBUFFER,
+                                   GL_COLOR_ATTACHMENT0,
+                                   GL_TEXTURE_2D, 0, 0) );
+  GE( ctx, glFramebufferTexture2D (GL_DRAW_FRAMEBUFFER,
+                                   GL_COLOR_ATTACHMENT0,
+                                   GL_TEXTURE_2D, 0, 0) );
+
+  return ret;
+}
+
+static void
+_cogl_texture_2d_generate_mipmaps (CoglContext *ctx,
+                                   CoglTexture2D *tex_2d)
+{
+  _cogl_bind_gl_texture_transient (GL_TEXTURE_2D,
+                                   tex_2d->gl_texture,
+                                   tex_2d->is_foreign);
+
+  /* glGenerateMipmap is defined in the FBO extension. If it's not
+     available we'll fallback to temporarily enabling
+     GL_GENERATE_MIPMAP and reuploading the first pixel */
+  if (cogl_has_feature (ctx, COGL_FEATURE_ID_OFFSCREEN))
+    ctx->texture_driver->gl_generate_mipmaps (GL_TEXTURE_2D);
+#if defined(HAVE_COGL_GLES) || defined(HAVE_COGL_GL)
+  else
+    {
+      GE( ctx, glTexParameteri (GL_TEXTURE_2D,
+                                GL_GENERATE_MIPMAP,
+                                GL_TRUE) );
+      GE( ctx, glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, 1, 1,
+                                tex_2d->first_pixel.gl_format,
+                                tex_2d->first_pixel.gl_type,
+                                tex_2d->first_pixel.data) );
+      GE( ctx, glTexParameteri (GL_TEXTURE_2D,
+                                GL_GENERATE_MIPMAP,
+                                GL_FALSE) );
+    }
 #endif
 
+  /* GL now has storage for the whole mipmap chain */
+  _cogl_texture_update_memory_size (COGL_TEXTURE (tex_2d),
+                                    _cogl_texture_2d_get_memory_size (tex_2d,
+                                                                      TRUE));
+}
+
+static void
+_cogl_texture_2d_pre_paint (CoglTexture *tex, CoglTexturePrePaintFlags flags)
+{
+  CoglTexture2D *tex_2d = COGL_TEXTURE_2D (tex);
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  /* Only update if the mipmaps are dirty */
+  if ((flags & COGL_TEXTURE_NEEDS_MIPMAP) &&
+      tex_2d->auto_mipmap &&
+      (tex_2d->mipmaps_dirty || tex_2d->n_dirty_rects > 0))
+    {
+      /* If only part of the base level has changed since the mipmaps
+         were last generated then we can try to update just the
+         affected regions of each level */
+      if (tex_2d->mipmaps_dirty ||
+          !_cogl_texture_2d_update_mipmap_regions (ctx, tex_2d))
+        _cogl_texture_2d_generate_mipmaps (ctx, tex_2d);
+
       tex_2d->mipmaps_dirty = FALSE;
+      tex_2d->n_dirty_rects = 0;
     }
 }
 
@@ -791,7 +1175,9 @@ _cogl_texture_2d_set_region (CoglTexture    *tex,
                                                gl_format,
                                                gl_type);
 
-  tex_2d->mipmaps_dirty = TRUE;
+  _cogl_texture_2d_add_dirty_rect (tex_2d,
+                                   dst_x, dst_y,
+                                   dst_width, dst_height);
 
   cogl_object_unref (bmp);
 
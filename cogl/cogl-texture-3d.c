@@ -37,6 +37,7 @@
 #include "cogl-journal-private.h"
 #include "cogl-pipeline-private.h"
 #include "cogl-pipeline-opengl-private.h"
+#include "cogl-memory-private.h"
 
 #include <string.h>
 #include <math.h>
@@ -99,6 +100,17 @@ _cogl_texture_3d_free (CoglTexture3D *tex_3d)
   _cogl_texture_free (COGL_TEXTURE (tex_3d));
 }
 
+static gsize
+_cogl_texture_3d_get_memory_size (CoglTexture3D *tex_3d,
+                                  gboolean mipmaps)
+{
+  return _cogl_memory_calculate_texture_size (tex_3d->format,
+                                              tex_3d->width,
+                                              tex_3d->height,
+                                              tex_3d->depth,
+                                              mipmaps);
+}
+
 static CoglTexture3D *
 _cogl_texture_3d_create_base (unsigned int     width,
                               unsigned int     height,
@@ -231,6 +243,12 @@ cogl_texture_3d_new_with_size (unsigned int     width,
   GE( ctx, glTexImage3D (GL_TEXTURE_3D, 0, gl_intformat,
                          width, height, depth, 0, gl_format, gl_type, NULL) );
 
+  _cogl_texture_set_memory_usage (COGL_TEXTURE (tex_3d),
+                                  COGL_MEMORY_TYPE_TEXTURE_3D,
+                                  _cogl_texture_3d_get_memory_size (tex_3d,
+                                                                    FALSE),
+                                  0);
+
   return _cogl_texture_3d_handle_new (tex_3d);
 }
 
@@ -309,6 +327,12 @@ _cogl_texture_3d_new_from_bitmap (CoglBitmap      *bmp,
 
   tex_3d->gl_format = gl_intformat;
 
+  _cogl_texture_set_memory_usage (COGL_TEXTURE (tex_3d),
+                                  COGL_MEMORY_TYPE_TEXTURE_3D,
+                                  _cogl_texture_3d_get_memory_size (tex_3d,
+                                                                    FALSE),
+                                  0);
+
   cogl_object_unref (dst_bmp);
 
   return _cogl_texture_3d_handle_new (tex_3d);
@@ -529,6 +553,10 @@ _cogl_texture_3d_pre_paint (CoglTexture *tex, CoglTexturePrePaintFlags flags)
         }
 #endif
 
+      _cogl_texture_update_memory_size (tex,
+                                        _cogl_texture_3d_get_memory_size
+                                        (tex_3d, TRUE));
+
       tex_3d->mipmaps_dirty = FALSE;
     }
 }
@@ -109,6 +109,19 @@ struct _CoglTextureDriver
                        GLuint       source_gl_format,
                        GLuint       source_gl_type);
 
+  /*
+   * Replaces the contents of the GL texture with a bitmap in one of
+   * the compressed formats using glCompressedTexImage2D. Only the base
+   * level is uploaded. The rowstride of the bitmap must be the size of
+   * a tightly packed row of blocks.
+   */
+  void
+  (* upload_compressed_to_gl) (GLenum       gl_target,
+                               GLuint       gl_handle,
+                               gboolean     is_foreign,
+                               CoglBitmap  *source_bmp,
+                               GLint        internal_gl_format);
+
   /*
    * This sets up the glPixelStore state for an download to a destination with
    * the same size, and with no offset.
@@ -28,6 +28,7 @@
 #include "cogl-handle.h"
 #include "cogl-pipeline-private.h"
 #include "cogl-spans.h"
+#include "cogl-context.h"
 
 typedef struct _CoglTextureVtable     CoglTextureVtable;
 
@@ -129,6 +130,12 @@ struct _CoglTexture
   CoglObject               _parent;
   GList                   *framebuffers;
   const CoglTextureVtable *vtable;
+  /* The number of bytes of GPU memory that the texture has accounted
+     for in the context. memory_waste is the part of it that is never
+     sampled */
+  CoglMemoryType           memory_type;
+  gsize                    memory_size;
+  gsize                    memory_waste;
 };
 
 typedef enum _CoglTextureChangeFlags
@@ -165,6 +172,25 @@ _cogl_texture_init (CoglTexture *texture,
 void
 _cogl_texture_free (CoglTexture *texture);
 
+/* Records the number of bytes that the texture's storage uses in the
+ * GPU. @waste is the part of @size that is never sampled and it is
+ * accounted as COGL_MEMORY_TYPE_TEXTURE_2D_SLICED_WASTE instead of
+ * @type. Textures whose storage isn't owned by Cogl should never call
+ * this */
+void
+_cogl_texture_set_memory_usage (CoglTexture *texture,
+                                CoglMemoryType type,
+                                gsize size,
+                                gsize waste);
+
+/* Changes the size of the storage that has already been recorded,
+ * for example when the mipmaps are generated. The waste is scaled by
+ * the same amount. This does nothing if the texture isn't
+ * accounted */
+void
+_cogl_texture_update_memory_size (CoglTexture *texture,
+                                  gsize size);
+
 /* This is used to register a type to the list of handle types that
    will be considered a texture in cogl_is_texture() */
 void
@@ -38,6 +38,7 @@
 #include "cogl-handle.h"
 #include "cogl-journal-private.h"
 #include "cogl-pipeline-opengl-private.h"
+#include "cogl-memory-private.h"
 
 #include <string.h>
 #include <math.h>
@@ -177,6 +178,22 @@ _cogl_texture_rectangle_create_base (unsigned int     width,
   return tex_rect;
 }
 
+/* Rectangle textures can't have mipmaps so the storage never grows */
+static void
+_cogl_texture_rectangle_init_memory_usage (CoglTextureRectangle *tex_rect)
+{
+  gsize size = _cogl_memory_calculate_texture_size (tex_rect->format,
+                                                    tex_rect->width,
+                                                    tex_rect->height,
+                                                    1, /* depth */
+                                                    FALSE /* mipmaps */);
+
+  _cogl_texture_set_memory_usage (COGL_TEXTURE (tex_rect),
+                                  COGL_MEMORY_TYPE_TEXTURE_RECTANGLE,
+                                  size,
+                                  0);
+}
+
 CoglTextureRectangle *
 cogl_texture_rectangle_new_with_size (CoglContext *ctx,
                                       int width,
@@ -212,6 +229,8 @@ cogl_texture_rectangle_new_with_size (CoglContext *ctx,
   GE( ctx, glTexImage2D (GL_TEXTURE_RECTANGLE_ARB, 0, gl_intformat,
                          width, height, 0, gl_format, gl_type, NULL) );
 
+  _cogl_texture_rectangle_init_memory_usage (tex_rect);
+
   return _cogl_texture_rectangle_object_new (tex_rect);
 }
 
@@ -265,6 +284,8 @@ _cogl_texture_rectangle_new_from_bitmap (CoglBitmap      *bmp,
 
   tex_rect->gl_format = gl_intformat;
 
+  _cogl_texture_rectangle_init_memory_usage (tex_rect);
+
   cogl_object_unref (dst_bmp);
 
   return _cogl_texture_rectangle_object_new (tex_rect);
@@ -52,6 +52,8 @@
 #include "cogl-object-private.h"
 #include "cogl-primitives.h"
 #include "cogl-framebuffer-private.h"
+#include "cogl-readback-private.h"
+#include "cogl-memory-private.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -130,14 +132,59 @@ _cogl_texture_init (CoglTexture *texture,
 {
   texture->vtable = vtable;
   texture->framebuffers = NULL;
+  texture->memory_type = COGL_MEMORY_TYPE_TEXTURE_2D;
+  texture->memory_size = 0;
+  texture->memory_waste = 0;
 }
 
 void
 _cogl_texture_free (CoglTexture *texture)
 {
+  if (texture->memory_size)
+    _cogl_texture_set_memory_usage (texture, texture->memory_type, 0, 0);
+
   g_free (texture);
 }
 
+void
+_cogl_texture_set_memory_usage (CoglTexture *texture,
+                                CoglMemoryType type,
+                                gsize size,
+                                gsize waste)
+{
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  _COGL_RETURN_IF_FAIL (waste <= size);
+
+  _cogl_memory_remove (ctx, texture->memory_type,
+                       texture->memory_size - texture->memory_waste);
+  _cogl_memory_remove (ctx, COGL_MEMORY_TYPE_TEXTURE_2D_SLICED_WASTE,
+                       texture->memory_waste);
+
+  texture->memory_type = type;
+  texture->memory_size = size;
+  texture->memory_waste = waste;
+
+  _cogl_memory_add (ctx, type, size - waste);
+  _cogl_memory_add (ctx, COGL_MEMORY_TYPE_TEXTURE_2D_SLICED_WASTE, waste);
+}
+
+void
+_cogl_texture_update_memory_size (CoglTexture *texture,
+                                  gsize size)
+{
+  gsize waste;
+
+  if (texture->memory_size == 0 || texture->memory_size == size)
+    return;
+
+  waste = (gsize) ((double) texture->memory_waste * size /
+                   texture->memory_size);
+
+  _cogl_texture_set_memory_usage (texture, texture->memory_type,
+                                  size, waste);
+}
+
 static gboolean
 _cogl_texture_needs_premult_conversion (CoglPixelFormat src_format,
                                         CoglPixelFormat dst_format)
@@ -153,6 +200,11 @@ CoglPixelFormat
 _cogl_texture_determine_internal_format (CoglPixelFormat src_format,
                                          CoglPixelFormat dst_format)
 {
+  /* Cogl can't convert compressed data so the texture has to use the
+   * same format */
+  if (_cogl_pixel_format_is_compressed (src_format))
+    return src_format;
+
   /* If the application hasn't specified a specific format then we'll
    * pick the most appropriate. By default Cogl will use a
    * premultiplied internal format. Later we will add control over
@@ -684,12 +736,17 @@ cogl_texture_set_region_from_bitmap (CoglTexture *texture,
   if (dst_width == 0 || dst_height == 0)
     return TRUE;
 
+  /* Compressed textures can only be replaced as a whole */
+  if (_cogl_pixel_format_is_compressed (_cogl_bitmap_get_format (bmp)) ||
+      _cogl_pixel_format_is_compressed (cogl_texture_get_format (texture)))
+    return FALSE;
+
   /* Note that we don't prepare the bitmap for upload here because
      some backends may be internally using a different format for the
      actual GL texture than that reported by
      cogl_texture_get_format. For example the atlas textures are
-     always stored in an RGBA texture even if the texture format is
-     advertised as RGB. */
+     always stored in an RGB ordered texture even if the texture format
+     is advertised as BGR. */
 
   ret = texture->vtable->set_region (texture,
                                      src_x, src_y,
@@ -748,6 +805,130 @@ cogl_texture_set_region (CoglTexture     *texture,
   return ret;
 }
 
+gboolean
+cogl_texture_set_region_async (CoglTexture     *texture,
+                               int              src_x,
+                               int              src_y,
+                               int              dst_x,
+                               int              dst_y,
+                               unsigned int     dst_width,
+                               unsigned int     dst_height,
+                               int              width,
+                               int              height,
+                               CoglPixelFormat  format,
+                               unsigned int     rowstride,
+                               const guint8    *data,
+                               unsigned int    *upload_id)
+{
+  CoglUploadRing *ring;
+  CoglUploadRingSlot *slot;
+  CoglPixelFormat internal_format;
+  CoglBitmap *source_bmp;
+  unsigned int slot_rowstride;
+  guint8 *slot_data;
+  gboolean ret;
+  int bpp;
+  int y;
+
+  _COGL_GET_CONTEXT (ctx, FALSE);
+
+  ring = &ctx->upload_ring;
+
+  _COGL_RETURN_VAL_IF_FAIL ((width - src_x) >= dst_width, FALSE);
+  _COGL_RETURN_VAL_IF_FAIL ((height - src_y) >= dst_height, FALSE);
+
+  /* Check for valid format */
+  if (format == COGL_PIXEL_FORMAT_ANY)
+    return FALSE;
+
+  bpp = _cogl_get_format_bpp (format);
+
+  /* Rowstride from width if none specified */
+  if (rowstride == 0)
+    rowstride = bpp * width;
+
+  internal_format =
+    _cogl_texture_determine_internal_format (format,
+                                             cogl_texture_get_format (texture));
+
+  /* If the data needs converting before it can be uploaded then the
+     conversion would have to read back from the pixel buffer so we
+     might as well upload it directly */
+  if (!_cogl_upload_ring_is_supported (ctx) ||
+      _cogl_texture_needs_premult_conversion (format, internal_format))
+    goto sync_upload;
+
+  /* Only the region that will be uploaded is copied. The rows are
+     padded to a multiple of 4 bytes so that GL can use its default
+     alignment */
+  slot_rowstride = (dst_width * bpp + 3) & ~3;
+
+  slot = _cogl_upload_ring_acquire (ctx, ring, slot_rowstride * dst_height);
+
+  slot_data = cogl_buffer_map (COGL_BUFFER (slot->buffer),
+                               COGL_BUFFER_ACCESS_WRITE,
+                               COGL_BUFFER_MAP_HINT_DISCARD);
+  if (slot_data == NULL)
+    goto sync_upload;
+
+  for (y = 0; y < dst_height; y++)
+    memcpy (slot_data + y * slot_rowstride,
+            data + (src_y + y) * rowstride + src_x * bpp,
+            dst_width * bpp);
+
+  cogl_buffer_unmap (COGL_BUFFER (slot->buffer));
+
+  source_bmp = cogl_bitmap_new_from_buffer (COGL_BUFFER (slot->buffer),
+                                            format,
+                                            dst_width,
+                                            dst_height,
+                                            slot_rowstride,
+                                            0 /* offset */);
+
+  /* The upload will now be sourced from the bound PBO so GL only has
+     to queue it */
+  ret = cogl_texture_set_region_from_bitmap (texture,
+                                             0, 0,
+                                             dst_x, dst_y,
+                                             dst_width, dst_height,
+                                             source_bmp);
+
+  cogl_object_unref (source_bmp);
+
+  if (upload_id)
+    *upload_id = _cogl_upload_ring_release (ctx, ring, slot);
+  else
+    _cogl_upload_ring_release (ctx, ring, slot);
+
+  return ret;
+
+ sync_upload:
+  ret = cogl_texture_set_region (texture,
+                                 src_x, src_y,
+                                 dst_x, dst_y,
+                                 dst_width, dst_height,
+                                 width, height,
+                                 format,
+                                 rowstride,
+                                 data);
+
+  /* The data has already been copied so the upload can be reported
+     as complete straight away */
+  if (upload_id)
+    *upload_id = ring->completed_serial;
+
+  return ret;
+}
+
+gboolean
+cogl_texture_is_upload_complete (CoglTexture *texture,
+                                 unsigned int upload_id)
+{
+  _COGL_GET_CONTEXT (ctx, TRUE);
+
+  return _cogl_upload_ring_is_complete (ctx, &ctx->upload_ring, upload_id);
+}
+
 /* Reads back the contents of a texture by rendering it to the framebuffer
  * and reading back the resulting pixels.
  *
@@ -1196,6 +1377,10 @@ cogl_texture_get_data (CoglTexture     *texture,
   if (format == COGL_PIXEL_FORMAT_ANY)
     format = cogl_texture_get_format (texture);
 
+  /* The data can be decompressed but not compressed */
+  if (_cogl_pixel_format_is_compressed (format))
+    return 0;
+
   tex_width = cogl_texture_get_width (texture);
   tex_height = cogl_texture_get_height (texture);
 
@@ -1319,6 +1504,90 @@ cogl_texture_get_data (CoglTexture     *texture,
   return byte_size;
 }
 
+void
+cogl_texture_get_data_async (CoglTexture *texture,
+                             CoglPixelFormat format,
+                             unsigned int rowstride,
+                             guint8 *data,
+                             CoglReadbackCallback callback,
+                             void *user_data)
+{
+  CoglReadback *readback;
+  CoglPixelFormat closest_format;
+  GLenum closest_gl_format;
+  GLenum closest_gl_type;
+  int tex_width;
+  int tex_height;
+  guint8 *ptr;
+  gboolean ret;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  _COGL_RETURN_IF_FAIL (data != NULL);
+  _COGL_RETURN_IF_FAIL (callback != NULL);
+
+  /* Default to internal format if none specified */
+  if (format == COGL_PIXEL_FORMAT_ANY)
+    format = cogl_texture_get_format (texture);
+
+  tex_width = cogl_texture_get_width (texture);
+  tex_height = cogl_texture_get_height (texture);
+
+  /* Rowstride from texture width if none specified */
+  if (rowstride == 0)
+    rowstride = tex_width * _cogl_get_format_bpp (format);
+
+  closest_format =
+    ctx->texture_driver->find_best_gl_get_data_format (format,
+                                                       &closest_gl_format,
+                                                       &closest_gl_type);
+
+  /* Only a 2D texture can be read directly into a pixel buffer with
+   * a single glGetTexImage. Anything else, or a format that would
+   * need converting, is read synchronously */
+  if (!_cogl_readback_is_supported (ctx) ||
+      !cogl_is_texture_2d (texture) ||
+      closest_format != format)
+    {
+      ret = cogl_texture_get_data (texture, format, rowstride, data) != 0;
+      _cogl_readback_queue_completed (ctx, ret, callback, user_data);
+      return;
+    }
+
+  /* If there are any dependent framebuffers on the texture then we
+     need to flush their journals so the texture contents will be
+     up-to-date */
+  _cogl_texture_flush_journal_rendering (texture);
+
+  readback = _cogl_readback_new (ctx,
+                                 tex_width, tex_height,
+                                 format,
+                                 format,
+                                 rowstride,
+                                 data,
+                                 FALSE, /* flip */
+                                 callback,
+                                 user_data);
+
+  /* With a pixel pack buffer bound the data pointer is an offset
+     into the buffer and GL only has to queue the read */
+  ptr = _cogl_readback_bind (readback);
+  ret = texture->vtable->get_data (texture,
+                                   format,
+                                   readback->buffer_rowstride,
+                                   ptr);
+  _cogl_readback_unbind (readback);
+
+  if (ret)
+    _cogl_readback_queue (ctx, readback);
+  else
+    {
+      _cogl_readback_free (readback);
+      ret = cogl_texture_get_data (texture, format, rowstride, data) != 0;
+      _cogl_readback_queue_completed (ctx, ret, callback, user_data);
+    }
+}
+
 static void
 _cogl_texture_framebuffer_destroy_cb (void *user_data,
                                       void *instance)
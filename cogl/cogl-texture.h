@@ -359,6 +359,46 @@ cogl_texture_get_data (CoglTexture *texture,
                        unsigned int rowstride,
                        guint8 *data);
 
+#if defined (COGL_ENABLE_EXPERIMENTAL_API)
+
+#define cogl_texture_get_data_async cogl_texture_get_data_async_EXP
+/**
+ * cogl_texture_get_data_async:
+ * @texture: a #CoglTexture pointer.
+ * @format: the #CoglPixelFormat to store the texture as.
+ * @rowstride: the rowstride of @data in bytes or pass 0 to calculate
+ *             from the bytes-per-pixel of @format multiplied by the
+ *             @texture width.
+ * @data: memory location to write the @texture's contents. This must
+ *   be big enough for the whole texture.
+ * @callback: A #CoglReadbackCallback to invoke when the data is ready
+ * @user_data: Private data to pass to @callback
+ *
+ * Starts copying the pixel data from @texture to system memory
+ * without waiting for the GPU. This is like cogl_texture_get_data()
+ * except that @data will not be written until @callback is
+ * invoked. The callback is always invoked from
+ * cogl_poll_dispatch(), even if the data could be read straight
+ * away. @data must remain valid until then.
+ *
+ * The read is only asynchronous when the driver supports pixel
+ * buffers and fences and @texture is a #CoglTexture2D that doesn't
+ * need a format conversion. Otherwise the data is read synchronously
+ * before this function returns.
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+void
+cogl_texture_get_data_async (CoglTexture *texture,
+                             CoglPixelFormat format,
+                             unsigned int rowstride,
+                             guint8 *data,
+                             CoglReadbackCallback callback,
+                             void *user_data);
+
+#endif
+
 /**
  * cogl_texture_set_region:
  * @texture a #CoglTexture.
@@ -437,6 +477,86 @@ cogl_texture_set_region_from_bitmap (CoglTexture *texture,
                                      unsigned int dst_width,
                                      unsigned int dst_height,
                                      CoglBitmap *bitmap);
+
+#define cogl_texture_set_region_async cogl_texture_set_region_async_EXP
+/**
+ * cogl_texture_set_region_async:
+ * @texture: a #CoglTexture.
+ * @src_x: upper left coordinate to use from source data.
+ * @src_y: upper left coordinate to use from source data.
+ * @dst_x: upper left destination horizontal coordinate.
+ * @dst_y: upper left destination vertical coordinate.
+ * @dst_width: width of destination region to write. (Must be less
+ *   than or equal to @width)
+ * @dst_height: height of destination region to write. (Must be less
+ *   than or equal to @height)
+ * @width: width of source data buffer.
+ * @height: height of source data buffer.
+ * @format: the #CoglPixelFormat used in the source buffer.
+ * @rowstride: rowstride of source buffer (computed from width if none
+ * specified)
+ * @data: the actual pixel data.
+ * @upload_id: (out): return location for an identifier for the
+ *   upload, or %NULL
+ *
+ * Sets the pixels in a rectangular subregion of @texture in the same
+ * way as cogl_texture_set_region() but without waiting for the GPU
+ * to copy the data. The region is first copied into a staging pixel
+ * buffer and the texture is then updated from that buffer so that
+ * the driver only has to queue the upload. This is useful for
+ * streaming large images such as video frames where a synchronous
+ * upload would stall the application.
+ *
+ * Cogl keeps a small number of staging buffers. If they are all
+ * still being read by the GPU then this function will wait for the
+ * oldest one to become free.
+ *
+ * @data can be freed or reused as soon as this function returns.
+ * The returned @upload_id can be passed to
+ * cogl_texture_is_upload_complete() to find out when the GPU has
+ * finished with the upload. If the driver doesn't support pixel
+ * buffers and fences then the data is uploaded synchronously and the
+ * upload will be reported as complete straight away.
+ *
+ * Return value: %TRUE if the subregion upload was successful, and
+ *   %FALSE otherwise
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+gboolean
+cogl_texture_set_region_async (CoglTexture *texture,
+                               int src_x,
+                               int src_y,
+                               int dst_x,
+                               int dst_y,
+                               unsigned int dst_width,
+                               unsigned int dst_height,
+                               int width,
+                               int height,
+                               CoglPixelFormat format,
+                               unsigned int rowstride,
+                               const guint8 *data,
+                               unsigned int *upload_id);
+
+#define cogl_texture_is_upload_complete cogl_texture_is_upload_complete_EXP
+/**
+ * cogl_texture_is_upload_complete:
+ * @texture: the #CoglTexture that was updated
+ * @upload_id: an identifier returned by cogl_texture_set_region_async()
+ *
+ * Checks whether the GPU has finished an upload started with
+ * cogl_texture_set_region_async(). This never blocks.
+ *
+ * Return value: %TRUE if the upload has completed, and %FALSE if it
+ *   is still pending
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+gboolean
+cogl_texture_is_upload_complete (CoglTexture *texture,
+                                 unsigned int upload_id);
 #endif
 
 /**
@@ -0,0 +1,102 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_TILED_TEXTURE_PRIVATE_H
+#define __COGL_TILED_TEXTURE_PRIVATE_H
+
+#include "cogl-texture-private.h"
+#include "cogl-texture-2d.h"
+#include "cogl-tiled-texture.h"
+
+#include <glib.h>
+
+typedef enum
+{
+  COGL_TILED_TEXTURE_TILE_EMPTY,
+  COGL_TILED_TEXTURE_TILE_LOADING,
+  COGL_TILED_TEXTURE_TILE_LOADED,
+  COGL_TILED_TEXTURE_TILE_FAILED
+} CoglTiledTextureTileState;
+
+typedef struct _CoglTiledTextureTile
+{
+  CoglTiledTextureTileState state;
+  /* The texture from the pool that holds the tile. This is only set
+     while the tile is loaded */
+  CoglTexture2D *texture;
+  /* The tile's node in the lru queue while it is loaded */
+  GList lru_link;
+} CoglTiledTextureTile;
+
+struct _CoglTiledTexture
+{
+  CoglTexture _parent;
+
+  int width;
+  int height;
+  int tile_size;
+  int n_tiles_x;
+  int n_tiles_y;
+  CoglPixelFormat format;
+
+  /* n_tiles_x * n_tiles_y tiles in rows */
+  CoglTiledTextureTile *tiles;
+
+  /* The loaded tiles with the most recently used at the head. The
+     length is never more than max_tiles */
+  GQueue lru;
+  int max_tiles;
+
+  /* A 1x1 texture with all of its components set to zero that is
+     drawn in place of the tiles that aren't loaded */
+  CoglTexture2D *placeholder;
+
+  /* The number of tiles that have been requested from the source but
+     not loaded yet. Each of these holds a reference on the texture */
+  int n_pending;
+
+  CoglTiledTextureSource source;
+  void *source_data;
+
+  CoglTiledTextureLoadCallback load_callback;
+  void *load_callback_data;
+};
+
+/* Returns the maximum time in microseconds that cogl_poll_get_info()
+ * should let the application sleep for, or -1 if no tiles are being
+ * loaded */
+gint64
+_cogl_tiled_texture_get_timeout (CoglContext *ctx);
+
+/* Uploads the tiles that have finished loading. Tiles are loaded
+ * immediately from here if threads aren't available */
+void
+_cogl_tiled_texture_dispatch (CoglContext *ctx);
+
+/* Waits for the tiles that are being loaded and drops them. This is
+ * used when the context is destroyed */
+void
+_cogl_tiled_texture_clear_pending (CoglContext *ctx);
+
+#endif /* __COGL_TILED_TEXTURE_PRIVATE_H */
@@ -0,0 +1,818 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "cogl.h"
+#include "cogl-internal.h"
+#include "cogl-util.h"
+#include "cogl-texture-private.h"
+#include "cogl-tiled-texture-private.h"
+#include "cogl-texture-driver.h"
+#include "cogl-context-private.h"
+#include "cogl-object.h"
+
+#include <string.h>
+#include <math.h>
+
+/* There is no file descriptor to wait on for the loading threads so
+   while a tile is being loaded the application is asked to wake up
+   this often (in microseconds) to check it */
+#define COGL_TILED_TEXTURE_POLL_INTERVAL 1000
+
+/* The number of tiles that can be loaded at the same time. The
+   sources will typically be decoding images so it's worth using more
+   than one thread */
+#define COGL_TILED_TEXTURE_MAX_THREADS 2
+
+typedef struct _CoglTiledTextureLoad
+{
+  /* The load holds a reference on the texture */
+  CoglTiledTexture *tiled_tex;
+  int tile_index;
+
+  /* The region of the image covered by the tile */
+  int x, y;
+  int width, height;
+
+  /* Always has room for a whole tile so that the edge tiles can be
+     padded */
+  guint8 *data;
+  int rowstride;
+
+  gboolean success;
+} CoglTiledTextureLoad;
+
+static void _cogl_tiled_texture_free (CoglTiledTexture *tiled_tex);
+
+COGL_TEXTURE_DEFINE (TiledTexture, tiled_texture);
+
+static const CoglTextureVtable cogl_tiled_texture_vtable;
+
+/* The tiles at the right and bottom edges of the image are smaller
+   than the textures they are stored in. The rest of the texture is
+   filled by repeating the last column and row so that linear
+   filtering at the edge of the image doesn't pick up garbage */
+static void
+pad_tile (CoglTiledTextureLoad *load)
+{
+  int tile_size = load->tiled_tex->tile_size;
+  int bpp = _cogl_get_format_bpp (load->tiled_tex->format);
+  guint8 *row;
+  int x, y;
+
+  if (load->width < tile_size)
+    for (y = 0; y < load->height; y++)
+      {
+        row = load->data + y * load->rowstride;
+
+        for (x = load->width; x < tile_size; x++)
+          memcpy (row + x * bpp, row + (load->width - 1) * bpp, bpp);
+      }
+
+  row = load->data + (load->height - 1) * load->rowstride;
+
+  for (y = load->height; y < tile_size; y++)
+    memcpy (load->data + y * load->rowstride, row, tile_size * bpp);
+}
+
+/* This may be called from the thread pool so it must not touch GL or
+   any reference counts */
+static void
+run_load (CoglTiledTextureLoad *load)
+{
+  CoglTiledTexture *tiled_tex = load->tiled_tex;
+
+  load->success = tiled_tex->source (load->x, load->y,
+                                     load->width, load->height,
+                                     tiled_tex->format,
+                                     load->rowstride,
+                                     load->data,
+                                     tiled_tex->source_data);
+
+  if (load->success)
+    pad_tile (load);
+}
+
+static void
+run_load_thread_cb (void *data, void *user_data)
+{
+  CoglTiledTextureLoad *load = data;
+  GAsyncQueue *done_queue = user_data;
+
+  run_load (load);
+
+  g_async_queue_push (done_queue, load);
+}
+
+static gboolean
+ensure_load_thread_pool (CoglContext *ctx)
+{
+  GError *error = NULL;
+
+  if (ctx->tile_thread_pool)
+    return TRUE;
+
+  if (ctx->tile_threads_failed)
+    return FALSE;
+
+#if !GLIB_CHECK_VERSION (2, 31, 0)
+  /* Older versions of GLib need the application to initialize the
+     thread system */
+  if (!g_thread_supported ())
+    {
+      ctx->tile_threads_failed = TRUE;
+      return FALSE;
+    }
+#endif
+
+  ctx->tile_done_queue = g_async_queue_new ();
+
+  ctx->tile_thread_pool =
+    g_thread_pool_new (run_load_thread_cb,
+                       ctx->tile_done_queue,
+                       COGL_TILED_TEXTURE_MAX_THREADS,
+                       FALSE, /* not exclusive */
+                       &error);
+  if (ctx->tile_thread_pool == NULL)
+    {
+      g_warning ("Failed to create the tile loading thread pool: %s",
+                 error->message);
+      g_error_free (error);
+      g_async_queue_unref (ctx->tile_done_queue);
+      ctx->tile_done_queue = NULL;
+      ctx->tile_threads_failed = TRUE;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+free_load (CoglTiledTextureLoad *load)
+{
+  load->tiled_tex->n_pending--;
+
+  g_free (load->data);
+  cogl_object_unref (load->tiled_tex);
+  g_slice_free (CoglTiledTextureLoad, load);
+}
+
+static void
+queue_load (CoglTiledTexture *tiled_tex,
+            int tile_index)
+{
+  CoglTiledTextureLoad *load = g_slice_new (CoglTiledTextureLoad);
+  int tile_size = tiled_tex->tile_size;
+  int tile_x = tile_index % tiled_tex->n_tiles_x;
+  int tile_y = tile_index / tiled_tex->n_tiles_x;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  load->tiled_tex = cogl_object_ref (tiled_tex);
+  load->tile_index = tile_index;
+  load->x = tile_x * tile_size;
+  load->y = tile_y * tile_size;
+  load->width = MIN (tile_size, tiled_tex->width - load->x);
+  load->height = MIN (tile_size, tiled_tex->height - load->y);
+  load->rowstride = tile_size * _cogl_get_format_bpp (tiled_tex->format);
+  load->data = g_malloc (load->rowstride * tile_size);
+  load->success = FALSE;
+
+  tiled_tex->tiles[tile_index].state = COGL_TILED_TEXTURE_TILE_LOADING;
+  tiled_tex->n_pending++;
+
+  /* Without threads the tile is loaded from the next
+     cogl_poll_dispatch() so that at least drawing doesn't wait for
+     it */
+  if (ensure_load_thread_pool (ctx))
+    {
+      ctx->n_running_tile_loads++;
+      g_thread_pool_push (ctx->tile_thread_pool, load, NULL);
+    }
+  else
+    g_queue_push_tail (&ctx->pending_tile_loads, load);
+}
+
+/* Gets a texture to store a newly loaded tile in. New textures are
+   allocated until the pool is full and after that the least recently
+   used tile is evicted */
+static CoglTexture2D *
+get_pool_texture (CoglTiledTexture *tiled_tex)
+{
+  CoglTiledTextureTile *tile;
+  CoglTexture2D *texture;
+  GList *link;
+
+  _COGL_GET_CONTEXT (ctx, NULL);
+
+  if (tiled_tex->lru.length < tiled_tex->max_tiles)
+    {
+      texture = cogl_texture_2d_new_with_size (ctx,
+                                               tiled_tex->tile_size,
+                                               tiled_tex->tile_size,
+                                               tiled_tex->format,
+                                               NULL);
+      if (texture)
+        return texture;
+
+      /* If the GPU is out of memory then make do with the tiles that
+         are already allocated */
+      if (tiled_tex->lru.length == 0)
+        return NULL;
+    }
+
+  link = g_queue_pop_tail_link (&tiled_tex->lru);
+  tile = link->data;
+
+  texture = tile->texture;
+  tile->texture = NULL;
+  tile->state = COGL_TILED_TEXTURE_TILE_EMPTY;
+
+  /* The journal may still be referencing the texture with the
+   * contents of the old tile so we need to flush before replacing
+   * them. Textures can't be used while the journal is being flushed
+   * so we don't have to consider recursion here. */
+  cogl_flush ();
+
+  return texture;
+}
+
+static void
+finish_load (CoglTiledTextureLoad *load)
+{
+  CoglTiledTexture *tiled_tex = load->tiled_tex;
+  CoglTiledTextureTile *tile = tiled_tex->tiles + load->tile_index;
+
+  if (!load->success)
+    {
+      /* The source couldn't provide the tile so there's no point in
+         asking for it again */
+      tile->state = COGL_TILED_TEXTURE_TILE_FAILED;
+    }
+  else if ((tile->texture = get_pool_texture (tiled_tex)) == NULL)
+    {
+      /* There wasn't a texture to put the tile in. That isn't a
+         problem with the tile so it is requested again the next time
+         it is drawn in case some memory has become available */
+      tile->state = COGL_TILED_TEXTURE_TILE_EMPTY;
+    }
+  else
+    {
+      /* The whole texture is replaced including the padding */
+      cogl_texture_set_region_async (COGL_TEXTURE (tile->texture),
+                                     0, 0, /* src_x/y */
+                                     0, 0, /* dst_x/y */
+                                     tiled_tex->tile_size,
+                                     tiled_tex->tile_size,
+                                     tiled_tex->tile_size,
+                                     tiled_tex->tile_size,
+                                     tiled_tex->format,
+                                     load->rowstride,
+                                     load->data,
+                                     NULL /* upload_id */);
+
+      tile->state = COGL_TILED_TEXTURE_TILE_LOADED;
+      g_queue_push_head_link (&tiled_tex->lru, &tile->lru_link);
+
+      if (tiled_tex->load_callback)
+        tiled_tex->load_callback (tiled_tex,
+                                  load->x, load->y,
+                                  load->width, load->height,
+                                  tiled_tex->load_callback_data);
+    }
+
+  free_load (load);
+}
+
+gint64
+_cogl_tiled_texture_get_timeout (CoglContext *ctx)
+{
+  if (ctx->pending_tile_loads.length > 0 ||
+      (ctx->tile_done_queue &&
+       g_async_queue_length (ctx->tile_done_queue) > 0))
+    return 0;
+
+  if (ctx->n_running_tile_loads > 0)
+    return COGL_TILED_TEXTURE_POLL_INTERVAL;
+
+  return -1;
+}
+
+void
+_cogl_tiled_texture_dispatch (CoglContext *ctx)
+{
+  CoglTiledTextureLoad *load;
+
+  while ((load = g_queue_pop_head (&ctx->pending_tile_loads)))
+    {
+      run_load (load);
+      finish_load (load);
+    }
+
+  if (ctx->tile_done_queue)
+    while ((load = g_async_queue_try_pop (ctx->tile_done_queue)))
+      {
+        ctx->n_running_tile_loads--;
+        finish_load (load);
+      }
+}
+
+void
+_cogl_tiled_texture_clear_pending (CoglContext *ctx)
+{
+  CoglTiledTextureLoad *load;
+
+  /* Wait for any loads that are still running */
+  if (ctx->tile_thread_pool)
+    g_thread_pool_free (ctx->tile_thread_pool, FALSE, TRUE);
+
+  if (ctx->tile_done_queue)
+    {
+      while ((load = g_async_queue_try_pop (ctx->tile_done_queue)))
+        free_load (load);
+
+      g_async_queue_unref (ctx->tile_done_queue);
+    }
+
+  while ((load = g_queue_pop_head (&ctx->pending_tile_loads)))
+    free_load (load);
+
+  ctx->n_running_tile_loads = 0;
+}
+
+/* Returns the texture that should be drawn for a tile. Tiles that
+   haven't been loaded are requested from the source and drawn with
+   the placeholder in the meantime */
+static CoglTexture *
+get_tile_for_drawing (CoglTiledTexture *tiled_tex,
+                      int tile_index)
+{
+  CoglTiledTextureTile *tile = tiled_tex->tiles + tile_index;
+
+  switch (tile->state)
+    {
+    case COGL_TILED_TEXTURE_TILE_LOADED:
+      /* Mark it as the most recently used */
+      g_queue_unlink (&tiled_tex->lru, &tile->lru_link);
+      g_queue_push_head_link (&tiled_tex->lru, &tile->lru_link);
+      return COGL_TEXTURE (tile->texture);
+
+    case COGL_TILED_TEXTURE_TILE_EMPTY:
+      queue_load (tiled_tex, tile_index);
+      break;
+
+    case COGL_TILED_TEXTURE_TILE_LOADING:
+    case COGL_TILED_TEXTURE_TILE_FAILED:
+      break;
+    }
+
+  return COGL_TEXTURE (tiled_tex->placeholder);
+}
+
+static void
+_cogl_tiled_texture_foreach_sub_texture_in_region (
+                                       CoglTexture *tex,
+                                       float virtual_tx_1,
+                                       float virtual_ty_1,
+                                       float virtual_tx_2,
+                                       float virtual_ty_2,
+                                       CoglMetaTextureCallback callback,
+                                       void *user_data)
+{
+  CoglTiledTexture *tiled_tex = COGL_TILED_TEXTURE (tex);
+  int tile_size = tiled_tex->tile_size;
+  float x_1, y_1, x_2, y_2;
+  int first_x, first_y, last_x, last_y;
+  int tile_x, tile_y;
+
+  /* Only the tiles that intersect the region are visited so that
+     only those get loaded */
+  x_1 = CLAMP (MIN (virtual_tx_1, virtual_tx_2), 0, 1) * tiled_tex->width;
+  y_1 = CLAMP (MIN (virtual_ty_1, virtual_ty_2), 0, 1) * tiled_tex->height;
+  x_2 = CLAMP (MAX (virtual_tx_1, virtual_tx_2), 0, 1) * tiled_tex->width;
+  y_2 = CLAMP (MAX (virtual_ty_1, virtual_ty_2), 0, 1) * tiled_tex->height;
+
+  first_x = CLAMP ((int) (x_1 / tile_size), 0, tiled_tex->n_tiles_x - 1);
+  first_y = CLAMP ((int) (y_1 / tile_size), 0, tiled_tex->n_tiles_y - 1);
+  last_x = CLAMP ((int) ceilf (x_2 / tile_size) - 1,
+                  first_x, tiled_tex->n_tiles_x - 1);
+  last_y = CLAMP ((int) ceilf (y_2 / tile_size) - 1,
+                  first_y, tiled_tex->n_tiles_y - 1);
+
+  for (tile_y = first_y; tile_y <= last_y; tile_y++)
+    for (tile_x = first_x; tile_x <= last_x; tile_x++)
+      {
+        float tile_left = tile_x * tile_size;
+        float tile_top = tile_y * tile_size;
+        float meta_coords[4];
+        float tile_coords[4];
+        CoglTexture *sub_texture;
+
+        meta_coords[0] = MAX (x_1, tile_left);
+        meta_coords[1] = MAX (y_1, tile_top);
+        meta_coords[2] = MIN (x_2, tile_left + tile_size);
+        meta_coords[3] = MIN (y_2, tile_top + tile_size);
+
+        tile_coords[0] = (meta_coords[0] - tile_left) / tile_size;
+        tile_coords[1] = (meta_coords[1] - tile_top) / tile_size;
+        tile_coords[2] = (meta_coords[2] - tile_left) / tile_size;
+        tile_coords[3] = (meta_coords[3] - tile_top) / tile_size;
+
+        meta_coords[0] /= tiled_tex->width;
+        meta_coords[1] /= tiled_tex->height;
+        meta_coords[2] /= tiled_tex->width;
+        meta_coords[3] /= tiled_tex->height;
+
+        sub_texture =
+          get_tile_for_drawing (tiled_tex,
+                                tile_y * tiled_tex->n_tiles_x + tile_x);
+
+        callback (sub_texture, tile_coords, meta_coords, user_data);
+      }
+}
+
+static void
+_cogl_tiled_texture_free (CoglTiledTexture *tiled_tex)
+{
+  int n_tiles = tiled_tex->n_tiles_x * tiled_tex->n_tiles_y;
+  int i;
+
+  /* The pending loads hold a reference so there can't be any left */
+  g_warn_if_fail (tiled_tex->n_pending == 0);
+
+  for (i = 0; i < n_tiles; i++)
+    if (tiled_tex->tiles[i].texture)
+      cogl_object_unref (tiled_tex->tiles[i].texture);
+
+  g_free (tiled_tex->tiles);
+
+  cogl_object_unref (tiled_tex->placeholder);
+
+  /* Chain up */
+  _cogl_texture_free (COGL_TEXTURE (tiled_tex));
+}
+
+CoglTiledTexture *
+cogl_tiled_texture_new (CoglContext *ctx,
+                        int width,
+                        int height,
+                        int tile_size,
+                        int max_tiles,
+                        CoglPixelFormat internal_format,
+                        CoglTiledTextureSource source,
+                        void *user_data,
+                        GError **error)
+{
+  CoglTiledTexture *tiled_tex;
+  CoglTexture2D *placeholder;
+  guint8 placeholder_data[16] = { 0 };
+  GLenum gl_intformat;
+  GLenum gl_type;
+  int n_tiles;
+  int i;
+
+  _COGL_RETURN_VAL_IF_FAIL (width > 0 && height > 0, NULL);
+  _COGL_RETURN_VAL_IF_FAIL (tile_size > 0, NULL);
+  _COGL_RETURN_VAL_IF_FAIL (max_tiles > 0, NULL);
+  _COGL_RETURN_VAL_IF_FAIL (source != NULL, NULL);
+
+  /* The tiles are filled in from client memory so the format must be
+     one that can be written to */
+  if (internal_format == COGL_PIXEL_FORMAT_ANY ||
+      _cogl_pixel_format_is_compressed (internal_format))
+    {
+      g_set_error (error, COGL_TEXTURE_ERROR,
+                   COGL_TEXTURE_ERROR_FORMAT,
+                   "Tiled textures need an uncompressed internal format");
+      return NULL;
+    }
+
+  /* Check the size of the tiles up front so that the tiles don't all
+     fail to load later */
+  ctx->texture_driver->pixel_format_to_gl (internal_format,
+                                           &gl_intformat,
+                                           NULL,
+                                           &gl_type);
+
+  if ((!cogl_has_feature (ctx, COGL_FEATURE_ID_TEXTURE_NPOT) &&
+       !_cogl_util_is_pot (tile_size)) ||
+      !ctx->texture_driver->size_supported (GL_TEXTURE_2D,
+                                            gl_intformat,
+                                            gl_type,
+                                            tile_size,
+                                            tile_size))
+    {
+      g_set_error (error, COGL_TEXTURE_ERROR,
+                   COGL_TEXTURE_ERROR_SIZE,
+                   "Failed to create tiled texture due to tile size/format"
+                   " constraints");
+      return NULL;
+    }
+
+  placeholder = cogl_texture_2d_new_from_data (ctx,
+                                               1, 1,
+                                               internal_format,
+                                               internal_format,
+                                               0, /* rowstride */
+                                               placeholder_data,
+                                               error);
+  if (placeholder == NULL)
+    return NULL;
+
+  tiled_tex = g_new (CoglTiledTexture, 1);
+
+  _cogl_texture_init (COGL_TEXTURE (tiled_tex), &cogl_tiled_texture_vtable);
+
+  tiled_tex->width = width;
+  tiled_tex->height = height;
+  tiled_tex->tile_size = tile_size;
+  tiled_tex->n_tiles_x = (width + tile_size - 1) / tile_size;
+  tiled_tex->n_tiles_y = (height + tile_size - 1) / tile_size;
+  tiled_tex->format = internal_format;
+
+  n_tiles = tiled_tex->n_tiles_x * tiled_tex->n_tiles_y;
+  tiled_tex->tiles = g_new0 (CoglTiledTextureTile, n_tiles);
+  for (i = 0; i < n_tiles; i++)
+    tiled_tex->tiles[i].lru_link.data = tiled_tex->tiles + i;
+
+  g_queue_init (&tiled_tex->lru);
+  tiled_tex->max_tiles = max_tiles;
+
+  tiled_tex->placeholder = placeholder;
+
+  tiled_tex->n_pending = 0;
+
+  tiled_tex->source = source;
+  tiled_tex->source_data = user_data;
+
+  tiled_tex->load_callback = NULL;
+  tiled_tex->load_callback_data = NULL;
+
+  return _cogl_tiled_texture_handle_new (tiled_tex);
+}
+
+void
+cogl_tiled_texture_set_load_callback (CoglTiledTexture *tiled_texture,
+                                      CoglTiledTextureLoadCallback callback,
+                                      void *user_data)
+{
+  _COGL_RETURN_IF_FAIL (cogl_is_tiled_texture (tiled_texture));
+
+  tiled_texture->load_callback = callback;
+  tiled_texture->load_callback_data = user_data;
+}
+
+int
+cogl_tiled_texture_get_n_loaded_tiles (CoglTiledTexture *tiled_texture)
+{
+  _COGL_RETURN_VAL_IF_FAIL (cogl_is_tiled_texture (tiled_texture), 0);
+
+  return tiled_texture->lru.length;
+}
+
+int
+cogl_tiled_texture_get_n_pending_tiles (CoglTiledTexture *tiled_texture)
+{
+  _COGL_RETURN_VAL_IF_FAIL (cogl_is_tiled_texture (tiled_texture), 0);
+
+  return tiled_texture->n_pending;
+}
+
+static gboolean
+_cogl_tiled_texture_set_region (CoglTexture    *tex,
+                                int             src_x,
+                                int             src_y,
+                                int             dst_x,
+                                int             dst_y,
+                                unsigned int    dst_width,
+                                unsigned int    dst_height,
+                                CoglBitmap     *bmp)
+{
+  /* The contents of the tiles always come from the source and most
+     of the tiles aren't in memory so there is nowhere to put the
+     data */
+  return FALSE;
+}
+
+static int
+_cogl_tiled_texture_get_max_waste (CoglTexture *tex)
+{
+  CoglTiledTexture *tiled_tex = COGL_TILED_TEXTURE (tex);
+
+  /* The textures for the tiles at the edges are padded */
+  return MAX (tiled_tex->n_tiles_x * tiled_tex->tile_size - tiled_tex->width,
+              tiled_tex->n_tiles_y * tiled_tex->tile_size - tiled_tex->height);
+}
+
+static gboolean
+_cogl_tiled_texture_is_sliced (CoglTexture *tex)
+{
+  /* Even with a single tile the texture that is drawn may change at
+     any time so it always needs to be resolved with the
+     CoglMetaTexture interface */
+  return TRUE;
+}
+
+static gboolean
+_cogl_tiled_texture_can_hardware_repeat (CoglTexture *tex)
+{
+  return FALSE;
+}
+
+static void
+_cogl_tiled_texture_transform_coords_to_gl (CoglTexture *tex,
+                                            float *s,
+                                            float *t)
+{
+  CoglTiledTexture *tiled_tex = COGL_TILED_TEXTURE (tex);
+
+  /* APIs such as cogl_polygon() that can't cope with sliced textures
+     draw with the texture from get_gl_texture() so the coordinates
+     are mapped to match that. The placeholder is a single texel so
+     the scaling makes no difference for it */
+  *s *= tiled_tex->width / (float) tiled_tex->tile_size;
+  *t *= tiled_tex->height / (float) tiled_tex->tile_size;
+
+  /* Let the child texture further transform the coords */
+  if (tiled_tex->tiles[0].texture)
+    _cogl_texture_transform_coords_to_gl (COGL_TEXTURE (tiled_tex->tiles[0].
+                                                        texture),
+                                          s, t);
+  else
+    _cogl_texture_transform_coords_to_gl (COGL_TEXTURE (tiled_tex->
+                                                        placeholder),
+                                          s, t);
+}
+
+static CoglTransformResult
+_cogl_tiled_texture_transform_quad_coords_to_gl (CoglTexture *tex,
+                                                 float *coords)
+{
+  return COGL_TRANSFORM_SOFTWARE_REPEAT;
+}
+
+static gboolean
+_cogl_tiled_texture_get_gl_texture (CoglTexture *tex,
+                                    GLuint *out_gl_handle,
+                                    GLenum *out_gl_target)
+{
+  CoglTiledTexture *tiled_tex = COGL_TILED_TEXTURE (tex);
+
+  /* Like sliced textures this just gives the first texture, which is
+     the placeholder until the first tile is loaded */
+  if (tiled_tex->tiles[0].texture)
+    return cogl_texture_get_gl_texture (COGL_TEXTURE (tiled_tex->tiles[0].
+                                                      texture),
+                                        out_gl_handle, out_gl_target);
+  else
+    return cogl_texture_get_gl_texture (COGL_TEXTURE (tiled_tex->placeholder),
+                                        out_gl_handle, out_gl_target);
+}
+
+static void
+_cogl_tiled_texture_set_filters (CoglTexture *tex,
+                                 GLenum min_filter,
+                                 GLenum mag_filter)
+{
+  CoglTiledTexture *tiled_tex = COGL_TILED_TEXTURE (tex);
+  GList *l;
+
+  _cogl_texture_set_filters (COGL_TEXTURE (tiled_tex->placeholder),
+                             min_filter, mag_filter);
+
+  for (l = tiled_tex->lru.head; l; l = l->next)
+    {
+      CoglTiledTextureTile *tile = l->data;
+      _cogl_texture_set_filters (COGL_TEXTURE (tile->texture),
+                                 min_filter, mag_filter);
+    }
+}
+
+static void
+_cogl_tiled_texture_pre_paint (CoglTexture *tex,
+                               CoglTexturePrePaintFlags flags)
+{
+  CoglTiledTexture *tiled_tex = COGL_TILED_TEXTURE (tex);
+  GList *l;
+
+  _cogl_texture_pre_paint (COGL_TEXTURE (tiled_tex->placeholder), flags);
+
+  for (l = tiled_tex->lru.head; l; l = l->next)
+    {
+      CoglTiledTextureTile *tile = l->data;
+      _cogl_texture_pre_paint (COGL_TEXTURE (tile->texture), flags);
+    }
+}
+
+static void
+_cogl_tiled_texture_ensure_non_quad_rendering (CoglTexture *tex)
+{
+  CoglTiledTexture *tiled_tex = COGL_TILED_TEXTURE (tex);
+  GList *l;
+
+  _cogl_texture_ensure_non_quad_rendering
+    (COGL_TEXTURE (tiled_tex->placeholder));
+
+  for (l = tiled_tex->lru.head; l; l = l->next)
+    {
+      CoglTiledTextureTile *tile = l->data;
+      _cogl_texture_ensure_non_quad_rendering (COGL_TEXTURE (tile->texture));
+    }
+}
+
+static void
+_cogl_tiled_texture_set_wrap_mode_parameters (CoglTexture *tex,
+                                              GLenum wrap_mode_s,
+                                              GLenum wrap_mode_t,
+                                              GLenum wrap_mode_p)
+{
+  CoglTiledTexture *tiled_tex = COGL_TILED_TEXTURE (tex);
+  GList *l;
+
+  /* Pass the set wrap mode on to all of the loaded tiles */
+  _cogl_texture_set_wrap_mode_parameters
+    (COGL_TEXTURE (tiled_tex->placeholder),
+     wrap_mode_s, wrap_mode_t, wrap_mode_p);
+
+  for (l = tiled_tex->lru.head; l; l = l->next)
+    {
+      CoglTiledTextureTile *tile = l->data;
+      _cogl_texture_set_wrap_mode_parameters (COGL_TEXTURE (tile->texture),
+                                              wrap_mode_s,
+                                              wrap_mode_t,
+                                              wrap_mode_p);
+    }
+}
+
+static CoglPixelFormat
+_cogl_tiled_texture_get_format (CoglTexture *tex)
+{
+  return COGL_TILED_TEXTURE (tex)->format;
+}
+
+static GLenum
+_cogl_tiled_texture_get_gl_format (CoglTexture *tex)
+{
+  CoglTiledTexture *tiled_tex = COGL_TILED_TEXTURE (tex);
+
+  return _cogl_texture_get_gl_format (COGL_TEXTURE (tiled_tex->placeholder));
+}
+
+static int
+_cogl_tiled_texture_get_width (CoglTexture *tex)
+{
+  return COGL_TILED_TEXTURE (tex)->width;
+}
+
+static int
+_cogl_tiled_texture_get_height (CoglTexture *tex)
+{
+  return COGL_TILED_TEXTURE (tex)->height;
+}
+
+static const CoglTextureVtable
+cogl_tiled_texture_vtable =
+  {
+    _cogl_tiled_texture_set_region,
+    NULL, /* get_data */
+    _cogl_tiled_texture_foreach_sub_texture_in_region,
+    _cogl_tiled_texture_get_max_waste,
+    _cogl_tiled_texture_is_sliced,
+    _cogl_tiled_texture_can_hardware_repeat,
+    _cogl_tiled_texture_transform_coords_to_gl,
+    _cogl_tiled_texture_transform_quad_coords_to_gl,
+    _cogl_tiled_texture_get_gl_texture,
+    _cogl_tiled_texture_set_filters,
+    _cogl_tiled_texture_pre_paint,
+    _cogl_tiled_texture_ensure_non_quad_rendering,
+    _cogl_tiled_texture_set_wrap_mode_parameters,
+    _cogl_tiled_texture_get_format,
+    _cogl_tiled_texture_get_gl_format,
+    _cogl_tiled_texture_get_width,
+    _cogl_tiled_texture_get_height,
+    NULL /* is_foreign */
+  };
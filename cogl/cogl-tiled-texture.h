@@ -0,0 +1,234 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#if !defined(__COGL_H_INSIDE__) && !defined(CLUTTER_COMPILATION)
+#error "Only <cogl/cogl.h> can be included directly."
+#endif
+
+#ifndef __COGL_TILED_TEXTURE_H
+#define __COGL_TILED_TEXTURE_H
+
+#include "cogl-context.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:cogl-tiled-texture
+ * @short_description: Functions for streaming images that are too
+ *                     large to fit in GPU memory
+ *
+ * A #CoglTiledTexture represents an image that is split into a grid
+ * of square tiles. Unlike a #CoglTexture2DSliced, the tiles are not
+ * all allocated up front. Instead the texture keeps a fixed size pool
+ * of GPU textures and the image data for a tile is only requested from
+ * the application when the tile is visited by
+ * cogl_meta_texture_foreach_in_region(), for example when it is drawn
+ * with cogl_rectangle(). When the pool is full the tile that was least
+ * recently used is evicted to make room. This makes it possible to
+ * pan around images that are much larger than the available GPU
+ * memory.
+ *
+ * The tiles are loaded asynchronously so drawing never waits for the
+ * image data. Until a tile has been loaded it is drawn with all of its
+ * components set to zero, which is transparent if the format has an
+ * alpha channel.
+ * The loaded tiles are uploaded from cogl_poll_dispatch() so the
+ * application must integrate Cogl with its main loop using
+ * cogl_poll_get_info().
+ *
+ * A #CoglTiledTexture implements the #CoglMetaTexture interface.
+ */
+
+#define COGL_TILED_TEXTURE(tex) ((CoglTiledTexture *) tex)
+typedef struct _CoglTiledTexture CoglTiledTexture;
+
+/**
+ * CoglTiledTextureSource:
+ * @x: The left edge of the tile in pixels
+ * @y: The top edge of the tile in pixels
+ * @width: The width of the tile in pixels
+ * @height: The height of the tile in pixels
+ * @format: The #CoglPixelFormat to write the data in
+ * @rowstride: The number of bytes between the starts of the rows in
+ *   @data
+ * @data: The memory to write the image data for the tile to
+ * @user_data: The private data passed to cogl_tiled_texture_new()
+ *
+ * The type of the callback used to fetch the image data for a tile of
+ * a #CoglTiledTexture. The tiles at the right and bottom edges of the
+ * image may be smaller than the tile size.
+ *
+ * If threads are available the callback is invoked from a separate
+ * thread so that slow operations such as decoding the image don't
+ * block the application. It must not call any Cogl functions and it
+ * may be called for several tiles at the same time.
+ *
+ * Return value: %TRUE if @data was filled in or %FALSE if the tile
+ *   could not be loaded. Tiles that fail to load are never requested
+ *   again.
+ * Since: 1.10
+ * Stability: unstable
+ */
+typedef gboolean (* CoglTiledTextureSource) (int x,
+                                             int y,
+                                             int width,
+                                             int height,
+                                             CoglPixelFormat format,
+                                             int rowstride,
+                                             guint8 *data,
+                                             void *user_data);
+
+/**
+ * CoglTiledTextureLoadCallback:
+ * @tiled_texture: The #CoglTiledTexture that a tile was loaded for
+ * @x: The left edge of the tile in pixels
+ * @y: The top edge of the tile in pixels
+ * @width: The width of the tile in pixels
+ * @height: The height of the tile in pixels
+ * @user_data: The private data passed to
+ *   cogl_tiled_texture_set_load_callback()
+ *
+ * The type of the callback used to notify the application that the
+ * contents of a tile have changed so that it can redraw. This is
+ * always invoked from cogl_poll_dispatch().
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+typedef void (* CoglTiledTextureLoadCallback) (CoglTiledTexture *tiled_texture,
+                                               int x,
+                                               int y,
+                                               int width,
+                                               int height,
+                                               void *user_data);
+
+#define cogl_tiled_texture_new cogl_tiled_texture_new_EXP
+/**
+ * cogl_tiled_texture_new:
+ * @context: A #CoglContext
+ * @width: The width of the whole image in pixels
+ * @height: The height of the whole image in pixels
+ * @tile_size: The width and height of each tile in pixels
+ * @max_tiles: The maximum number of tiles that can be resident in
+ *   GPU memory at the same time
+ * @internal_format: The #CoglPixelFormat of the tiles. This is also
+ *   the format that @source must write in.
+ * @source: A #CoglTiledTextureSource to fetch the tiles with
+ * @user_data: Private data to pass to @source
+ * @error: A #GError for exceptions
+ *
+ * Creates a #CoglTiledTexture. No GPU memory is allocated until the
+ * tiles are visited. At most @max_tiles tiles of @tile_size x
+ * @tile_size pixels are allocated so this should be large enough to
+ * cover the largest area of the image that will be drawn at once
+ * otherwise the tiles will be continuously reloaded.
+ *
+ * If the driver doesn't support non power of two textures then
+ * @tile_size must be a power of two. Compressed formats can't be used.
+ *
+ * Return value: A new #CoglTiledTexture or %NULL if the parameters
+ *   are not supported, in which case @error will be set.
+ * Since: 1.10
+ * Stability: unstable
+ */
+CoglTiledTexture *
+cogl_tiled_texture_new (CoglContext *context,
+                        int width,
+                        int height,
+                        int tile_size,
+                        int max_tiles,
+                        CoglPixelFormat internal_format,
+                        CoglTiledTextureSource source,
+                        void *user_data,
+                        GError **error);
+
+#define cogl_tiled_texture_set_load_callback \
+  cogl_tiled_texture_set_load_callback_EXP
+/**
+ * cogl_tiled_texture_set_load_callback:
+ * @tiled_texture: A #CoglTiledTexture
+ * @callback: A #CoglTiledTextureLoadCallback or %NULL
+ * @user_data: Private data to pass to @callback
+ *
+ * Sets a callback that will be invoked whenever a tile has been
+ * loaded. Applications will typically want to redraw in response.
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+void
+cogl_tiled_texture_set_load_callback (CoglTiledTexture *tiled_texture,
+                                      CoglTiledTextureLoadCallback callback,
+                                      void *user_data);
+
+#define cogl_tiled_texture_get_n_loaded_tiles \
+  cogl_tiled_texture_get_n_loaded_tiles_EXP
+/**
+ * cogl_tiled_texture_get_n_loaded_tiles:
+ * @tiled_texture: A #CoglTiledTexture
+ *
+ * Return value: the number of tiles that are currently resident in
+ *   GPU memory. This is never more than the maximum passed to
+ *   cogl_tiled_texture_new().
+ * Since: 1.10
+ * Stability: unstable
+ */
+int
+cogl_tiled_texture_get_n_loaded_tiles (CoglTiledTexture *tiled_texture);
+
+#define cogl_tiled_texture_get_n_pending_tiles \
+  cogl_tiled_texture_get_n_pending_tiles_EXP
+/**
+ * cogl_tiled_texture_get_n_pending_tiles:
+ * @tiled_texture: A #CoglTiledTexture
+ *
+ * Return value: the number of tiles that have been requested from the
+ *   #CoglTiledTextureSource but that haven't been loaded yet.
+ * Since: 1.10
+ * Stability: unstable
+ */
+int
+cogl_tiled_texture_get_n_pending_tiles (CoglTiledTexture *tiled_texture);
+
+#define cogl_is_tiled_texture cogl_is_tiled_texture_EXP
+/**
+ * cogl_is_tiled_texture:
+ * @object: A #CoglObject
+ *
+ * Checks whether @object is a #CoglTiledTexture.
+ *
+ * Return value: %TRUE if the passed @object represents a
+ *               #CoglTiledTexture and %FALSE otherwise.
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+gboolean
+cogl_is_tiled_texture (void *object);
+
+G_END_DECLS
+
+#endif /* __COGL_TILED_TEXTURE_H */
@@ -137,6 +137,11 @@ typedef struct _CoglQuaternion CoglQuaternion;
  * circular dependencies. */
 typedef struct _CoglEuler CoglEuler;
 
+/* CoglContext is forward declared here too so that headers such as
+ * cogl-pipeline.h can take a context without depending on
+ * cogl-context.h */
+typedef struct _CoglContext CoglContext;
+
 /**
  * CoglFixed:
  *
@@ -193,6 +198,18 @@ typedef struct _CoglTextureVertex       CoglTextureVertex;
  * @COGL_PIXEL_FORMAT_ABGR_8888_PRE: Premultiplied ABGR, 32 bits
  * @COGL_PIXEL_FORMAT_RGBA_4444_PRE: Premultiplied RGBA, 16 bits
  * @COGL_PIXEL_FORMAT_RGBA_5551_PRE: Premultiplied RGBA, 16 bits
+ * @COGL_PIXEL_FORMAT_ETC1_RGB_8: ETC1 compressed RGB, 4 bits per pixel.
+ *   Since 1.10
+ * @COGL_PIXEL_FORMAT_ETC2_RGB_8: ETC2 compressed RGB, 4 bits per pixel.
+ *   Since 1.10
+ * @COGL_PIXEL_FORMAT_ETC2_RGBA_8: ETC2 compressed RGB with EAC
+ *   compressed alpha, 8 bits per pixel. Since 1.10
+ * @COGL_PIXEL_FORMAT_S3TC_DXT1_RGB: S3TC (DXT1) compressed RGB, 4 bits
+ *   per pixel. Since 1.10
+ * @COGL_PIXEL_FORMAT_S3TC_DXT3_RGBA: S3TC (DXT3) compressed RGBA, 8
+ *   bits per pixel. Since 1.10
+ * @COGL_PIXEL_FORMAT_S3TC_DXT5_RGBA: S3TC (DXT5) compressed RGBA, 8
+ *   bits per pixel. Since 1.10
  *
  * Pixel formats used by COGL. For the formats with a byte per
  * component, the order of the components specify the order in
@@ -212,6 +229,14 @@ typedef struct _CoglTextureVertex       CoglTextureVertex;
  * internal format. Cogl will try to pick the best format to use
  * internally and convert the texture data if necessary.
  *
+ * The compressed formats store blocks of 4x4 pixels. The rowstride
+ * of a bitmap in one of these formats is the number of bytes in a
+ * row of blocks. Cogl can not convert to or from these formats so a
+ * texture created from compressed data always keeps the same
+ * format. Whether the GPU can use them should be checked with
+ * cogl_has_feature() and %COGL_FEATURE_ID_TEXTURE_ETC1,
+ * %COGL_FEATURE_ID_TEXTURE_ETC2 or %COGL_FEATURE_ID_TEXTURE_S3TC.
+ *
  * Since: 0.8
  */
 typedef enum { /*< prefix=COGL_PIXEL_FORMAT >*/
@@ -224,6 +249,13 @@ typedef enum { /*< prefix=COGL_PIXEL_FORMAT >*/
   COGL_PIXEL_FORMAT_YUV           = 7,
   COGL_PIXEL_FORMAT_G_8           = 8,
 
+  COGL_PIXEL_FORMAT_ETC1_RGB_8     = 9,
+  COGL_PIXEL_FORMAT_ETC2_RGB_8     = 10,
+  COGL_PIXEL_FORMAT_ETC2_RGBA_8    = 11 | COGL_A_BIT,
+  COGL_PIXEL_FORMAT_S3TC_DXT1_RGB  = 12,
+  COGL_PIXEL_FORMAT_S3TC_DXT3_RGBA = 13 | COGL_A_BIT,
+  COGL_PIXEL_FORMAT_S3TC_DXT5_RGBA = 14 | COGL_A_BIT,
+
   COGL_PIXEL_FORMAT_RGB_888       =  COGL_PIXEL_FORMAT_24,
   COGL_PIXEL_FORMAT_BGR_888       = (COGL_PIXEL_FORMAT_24 | COGL_BGR_BIT),
 
@@ -717,6 +749,22 @@ typedef enum
   COGL_WINDING_COUNTER_CLOCKWISE
 } CoglWinding;
 
+/**
+ * CoglReadbackCallback:
+ * @success: %TRUE if the pixels were read successfully
+ * @user_data: The private data passed when the readback was started
+ *
+ * The type of the callback used to notify the application that an
+ * asynchronous readback started with
+ * cogl_framebuffer_read_pixels_async() or
+ * cogl_texture_get_data_async() has completed. The callback is
+ * always invoked from cogl_poll_dispatch().
+ *
+ * Since: 1.10
+ * Stability: unstable
+ */
+typedef void (* CoglReadbackCallback) (gboolean success, void *user_data);
+
 G_END_DECLS
 
 #endif /* __COGL_TYPES_H__ */
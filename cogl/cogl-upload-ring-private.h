@@ -0,0 +1,101 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifndef __COGL_UPLOAD_RING_PRIVATE_H
+#define __COGL_UPLOAD_RING_PRIVATE_H
+
+#include <glib.h>
+
+#include "cogl-context.h"
+#include "cogl-pixel-buffer.h"
+
+/*
+ * The upload ring is a small set of pixel buffers that texture data
+ * is staged in so that glTexSubImage2D can read it from a bound PBO
+ * instead of from client memory. GL can then return as soon as the
+ * upload is queued rather than waiting for the data to be copied.
+ *
+ * A fence is inserted after each upload. A slot is only reused once
+ * its fence has signalled so the CPU never writes into a buffer that
+ * the GPU may still be reading from. The application only stalls if
+ * it queues uploads faster than the GPU can consume them, in which
+ * case it waits for the oldest slot.
+ *
+ * Every upload is given a serial number. Fences signal in the order
+ * they were inserted so all uploads up to and including the last
+ * serial that was seen to complete are also known to be complete.
+ */
+
+#define COGL_UPLOAD_RING_N_SLOTS 4
+
+typedef struct _CoglUploadRingSlot
+{
+  CoglPixelBuffer *buffer;
+  /* A GLsync, or NULL if the slot is free */
+  void *fence;
+  unsigned int serial;
+} CoglUploadRingSlot;
+
+typedef struct _CoglUploadRing
+{
+  CoglUploadRingSlot slots[COGL_UPLOAD_RING_N_SLOTS];
+  int next_slot;
+
+  unsigned int last_serial;
+  unsigned int completed_serial;
+} CoglUploadRing;
+
+void
+_cogl_upload_ring_init (CoglUploadRing *ring);
+
+void
+_cogl_upload_ring_destroy (CoglContext *ctx,
+                           CoglUploadRing *ring);
+
+/* Returns whether the driver has both PBOs and fences */
+gboolean
+_cogl_upload_ring_is_supported (CoglContext *ctx);
+
+/* Returns the next slot with a pixel buffer of at least @size
+ * bytes. This will wait for the GPU if the slot is still in use */
+CoglUploadRingSlot *
+_cogl_upload_ring_acquire (CoglContext *ctx,
+                           CoglUploadRing *ring,
+                           unsigned int size);
+
+/* Inserts a fence after an upload has been issued from the slot's
+ * buffer and returns the serial number for the upload */
+unsigned int
+_cogl_upload_ring_release (CoglContext *ctx,
+                           CoglUploadRing *ring,
+                           CoglUploadRingSlot *slot);
+
+/* Checks without blocking whether the upload with the given serial
+ * number has completed */
+gboolean
+_cogl_upload_ring_is_complete (CoglContext *ctx,
+                               CoglUploadRing *ring,
+                               unsigned int serial);
+
+#endif /* __COGL_UPLOAD_RING_PRIVATE_H */
@@ -0,0 +1,217 @@
+/*
+ * Cogl
+ *
+ * An object oriented GL/GLES Abstraction/Utility Layer
+ *
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "cogl-internal.h"
+#include "cogl-context-private.h"
+#include "cogl-upload-ring-private.h"
+#include "cogl-pixel-buffer-private.h"
+#include "cogl-profile.h"
+
+/* Compares two serial numbers allowing for them to wrap around */
+static gboolean
+serial_after (unsigned int a, unsigned int b)
+{
+  return (int) (a - b) > 0;
+}
+
+void
+_cogl_upload_ring_init (CoglUploadRing *ring)
+{
+  memset (ring, 0, sizeof (CoglUploadRing));
+}
+
+#ifdef GL_ARB_sync
+
+static void
+retire_slot (CoglContext *ctx,
+             CoglUploadRing *ring,
+             CoglUploadRingSlot *slot)
+{
+  ctx->glDeleteSync (slot->fence);
+  slot->fence = NULL;
+
+  if (serial_after (slot->serial, ring->completed_serial))
+    ring->completed_serial = slot->serial;
+}
+
+#endif /* GL_ARB_sync */
+
+void
+_cogl_upload_ring_destroy (CoglContext *ctx,
+                           CoglUploadRing *ring)
+{
+  int i;
+
+  for (i = 0; i < COGL_UPLOAD_RING_N_SLOTS; i++)
+    {
+      CoglUploadRingSlot *slot = ring->slots + i;
+
+#ifdef GL_ARB_sync
+      if (slot->fence)
+        retire_slot (ctx, ring, slot);
+#endif
+
+      if (slot->buffer)
+        cogl_object_unref (slot->buffer);
+    }
+}
+
+gboolean
+_cogl_upload_ring_is_supported (CoglContext *ctx)
+{
+  return ((ctx->private_feature_flags &
+           (COGL_PRIVATE_FEATURE_PBOS | COGL_PRIVATE_FEATURE_FENCES)) ==
+          (COGL_PRIVATE_FEATURE_PBOS | COGL_PRIVATE_FEATURE_FENCES));
+}
+
+CoglUploadRingSlot *
+_cogl_upload_ring_acquire (CoglContext *ctx,
+                           CoglUploadRing *ring,
+                           unsigned int size)
+{
+  CoglUploadRingSlot *slot = ring->slots + ring->next_slot;
+
+  COGL_STATIC_COUNTER (upload_ring_stall_counter,
+                       "Upload ring stalls",
+                       "Increments each time a texture upload has to wait "
+                       "for the GPU to finish with a staging buffer",
+                       0 /* no application private data */);
+
+  ring->next_slot = (ring->next_slot + 1) % COGL_UPLOAD_RING_N_SLOTS;
+
+#ifdef GL_ARB_sync
+  if (slot->fence)
+    {
+      GLenum status;
+
+      /* Check whether the fence has already signalled before counting
+         this as a stall */
+      status = ctx->glClientWaitSync (slot->fence, 0, 0);
+
+      if (status == GL_TIMEOUT_EXPIRED)
+        {
+          COGL_COUNTER_INC (_cogl_uprof_context, upload_ring_stall_counter);
+
+          do
+            status = ctx->glClientWaitSync (slot->fence,
+                                            GL_SYNC_FLUSH_COMMANDS_BIT,
+                                            G_GUINT64_CONSTANT (1000000000));
+          while (status == GL_TIMEOUT_EXPIRED);
+        }
+
+      retire_slot (ctx, ring, slot);
+    }
+#endif /* GL_ARB_sync */
+
+  if (slot->buffer &&
+      cogl_buffer_get_size (COGL_BUFFER (slot->buffer)) < size)
+    {
+      cogl_object_unref (slot->buffer);
+      slot->buffer = NULL;
+    }
+
+  if (slot->buffer == NULL)
+    {
+      slot->buffer = _cogl_pixel_buffer_new (ctx, size);
+      /* Each buffer is completely rewritten for every upload */
+      cogl_buffer_set_update_hint (COGL_BUFFER (slot->buffer),
+                                   COGL_BUFFER_UPDATE_HINT_STREAM);
+    }
+
+  return slot;
+}
+
+unsigned int
+_cogl_upload_ring_release (CoglContext *ctx,
+                           CoglUploadRing *ring,
+                           CoglUploadRingSlot *slot)
+{
+  slot->serial = ++ring->last_serial;
+
+#ifdef GL_ARB_sync
+  slot->fence = ctx->glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+
+  /* If the fence couldn't be created then there is no way to tell
+     when the upload is finished so we'll just have to assume it is */
+  if (slot->fence == NULL)
+    ring->completed_serial = slot->serial;
+
+  return slot->serial;
+}
+
+gboolean
+_cogl_upload_ring_is_complete (CoglContext *ctx,
+                               CoglUploadRing *ring,
+                               unsigned int serial)
+{
+#ifdef GL_ARB_sync
+  CoglUploadRingSlot *slot = NULL;
+  GLenum status;
+  int i;
+
+  if (!serial_after (serial, ring->completed_serial))
+    return TRUE;
+
+  _COGL_RETURN_VAL_IF_FAIL (!serial_after (serial, ring->last_serial), FALSE);
+
+  for (i = 0; i < COGL_UPLOAD_RING_N_SLOTS; i++)
+    if (ring->slots[i].fence && ring->slots[i].serial == serial)
+      {
+        slot = ring->slots + i;
+        break;
+      }
+
+  /* Slots are only reused once their fence has been retired which
+     would have updated the completed serial */
+  if (slot == NULL)
+    return TRUE;
+
+  /* The flush makes sure the fence will eventually signal even if
+     nothing else causes the commands to be submitted */
+  status = ctx->glClientWaitSync (slot->fence,
+                                  GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  0);
+
+  if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    return FALSE;
+
+  /* The fences signal in order so any older uploads are also
+     complete */
+  for (i = 0; i < COGL_UPLOAD_RING_N_SLOTS; i++)
+    if (ring->slots[i].fence &&
+        !serial_after (ring->slots[i].serial, serial))
+      retire_slot (ctx, ring, ring->slots + i);
+
+  return TRUE;
+#else
+  return TRUE;
+#endif /* GL_ARB_sync */
+}
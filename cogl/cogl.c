@@ -651,6 +651,11 @@ cogl_end_gl (void)
       return;
     }
   ctx->in_begin_gl_block = FALSE;
+
+  /* The application is meant to restore any state it changed but it
+   * is easy to forget some of the state that Cogl shadows (such as
+   * the buffer bindings) so we stop trusting all of it */
+  _cogl_gl_state_invalidate (&ctx->gl_state);
 }
 
 void
@@ -84,6 +84,7 @@ typedef struct _CoglFramebuffer CoglFramebuffer;
 #include <cogl/cogl-texture-3d.h>
 #include <cogl/cogl-texture-2d-sliced.h>
 #include <cogl/cogl-sub-texture.h>
+#include <cogl/cogl-tiled-texture.h>
 #include <cogl/cogl-meta-texture.h>
 #include <cogl/cogl-index-buffer.h>
 #include <cogl/cogl-attribute-buffer.h>
@@ -210,6 +211,13 @@ cogl_features_available (CoglFeatureFlags features);
  * @COGL_FEATURE_ID_SWAP_BUFFERS_EVENT:
  *     Available if the window system supports reporting an event
  *     for swap buffer completions.
+ * @COGL_FEATURE_ID_TEXTURE_ETC1: Textures can be created from data in
+ *     the %COGL_PIXEL_FORMAT_ETC1_RGB_8 format.
+ * @COGL_FEATURE_ID_TEXTURE_ETC2: Textures can be created from data in
+ *     the %COGL_PIXEL_FORMAT_ETC2_RGB_8 and
+ *     %COGL_PIXEL_FORMAT_ETC2_RGBA_8 formats.
+ * @COGL_FEATURE_ID_TEXTURE_S3TC: Textures can be created from data in
+ *     the S3TC formats such as %COGL_PIXEL_FORMAT_S3TC_DXT1_RGB.
  *
  * All the capabilities that can vary between different GPUs supported
  * by Cogl. Applications that depend on any of these features should explicitly
@@ -237,6 +245,9 @@ typedef enum _CoglFeatureID
   COGL_FEATURE_ID_MAP_BUFFER_FOR_WRITE,
   COGL_FEATURE_ID_MIRRORED_REPEAT,
   COGL_FEATURE_ID_SWAP_BUFFERS_EVENT,
+  COGL_FEATURE_ID_TEXTURE_ETC1,
+  COGL_FEATURE_ID_TEXTURE_ETC2,
+  COGL_FEATURE_ID_TEXTURE_S3TC,
 
   /*< private > */
   _COGL_N_FEATURE_IDS
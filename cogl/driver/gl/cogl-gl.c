@@ -252,6 +252,35 @@ _cogl_gl_update_features (CoglContext *context,
                       COGL_FEATURE_ID_MAP_BUFFER_FOR_WRITE, TRUE);
     }
 
+  /* Uniform buffers are only used to upload uniform values so we also
+     need the buffer functions from the VBO extension. The generated
+     shaders don't declare a GLSL version so they can only declare
+     uniform blocks if the extension can be enabled in the shader */
+  if (context->glGetUniformBlockIndex && context->glGenBuffers &&
+      _cogl_check_extension ("GL_ARB_uniform_buffer_object", gl_extensions))
+    private_flags |= COGL_PRIVATE_FEATURE_UBOS;
+
+  if (context->glMaxShaderCompilerThreads)
+    private_flags |= COGL_PRIVATE_FEATURE_PARALLEL_SHADER_COMPILE;
+
+  if (context->glGenSamplers)
+    {
+      private_flags |= COGL_PRIVATE_FEATURE_SAMPLER_OBJECTS;
+
+      /* Multi-bind is only used to bind samplers together with the
+         textures so there's no point in using it without them */
+      if (context->glBindTextures)
+        private_flags |= COGL_PRIVATE_FEATURE_MULTI_BIND;
+    }
+
+  if (context->glGenVertexArrays)
+    private_flags |= COGL_PRIVATE_FEATURE_VERTEX_ARRAY_OBJECTS;
+
+#ifdef GL_ARB_sync
+  if (context->glFenceSync)
+    private_flags |= COGL_PRIVATE_FEATURE_FENCES;
+#endif
+
   if (_cogl_check_extension ("GL_ARB_texture_rectangle", gl_extensions))
     {
       flags |= COGL_FEATURE_TEXTURE_RECTANGLE;
@@ -265,6 +294,17 @@ _cogl_gl_update_features (CoglContext *context,
       COGL_FLAGS_SET (ctx->features, COGL_FEATURE_ID_TEXTURE_3D, TRUE);
     }
 
+  if (_cogl_check_extension ("GL_EXT_texture_compression_s3tc", gl_extensions))
+    COGL_FLAGS_SET (ctx->features, COGL_FEATURE_ID_TEXTURE_S3TC, TRUE);
+
+  /* ETC2 decoders can also decode ETC1 data */
+  if (COGL_CHECK_GL_VERSION (gl_major, gl_minor, 4, 3) ||
+      _cogl_check_extension ("GL_ARB_ES3_compatibility", gl_extensions))
+    {
+      COGL_FLAGS_SET (ctx->features, COGL_FEATURE_ID_TEXTURE_ETC1, TRUE);
+      COGL_FLAGS_SET (ctx->features, COGL_FEATURE_ID_TEXTURE_ETC2, TRUE);
+    }
+
   if (context->glEGLImageTargetTexture2D)
     private_flags |= COGL_PRIVATE_FEATURE_TEXTURE_2D_FROM_EGL_IMAGE;
 
@@ -46,6 +46,27 @@
 #include <stdlib.h>
 #include <math.h>
 
+/* Compressed formats from GL_EXT_texture_compression_s3tc,
+   GL_OES_compressed_ETC1_RGB8_texture and GLES 3 */
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
 static void
 _cogl_texture_driver_gen (GLenum   gl_target,
                           GLsizei  n,
@@ -257,6 +278,42 @@ _cogl_texture_driver_upload_to_gl_3d (GLenum       gl_target,
   _cogl_bitmap_unbind (source_bmp);
 }
 
+static void
+_cogl_texture_driver_upload_compressed_to_gl (GLenum       gl_target,
+                                              GLuint       gl_handle,
+                                              gboolean     is_foreign,
+                                              CoglBitmap  *source_bmp,
+                                              GLint        internal_gl_format)
+{
+  int width = _cogl_bitmap_get_width (source_bmp);
+  int height = _cogl_bitmap_get_height (source_bmp);
+  int size;
+  guint8 *data;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  /* The rowstride is the size of a row of 4x4 blocks */
+  size = _cogl_bitmap_get_rowstride (source_bmp) * ((height + 3) / 4);
+
+  data = _cogl_bitmap_bind (source_bmp, COGL_BUFFER_ACCESS_READ, 0);
+
+  _cogl_bind_gl_texture_transient (gl_target, gl_handle, is_foreign);
+
+  GE( ctx, glCompressedTexImage2D (gl_target, 0,
+                                   internal_gl_format,
+                                   width, height,
+                                   0, /* border */
+                                   size,
+                                   data) );
+
+  /* Only the base level is uploaded and GL can't generate mipmaps
+     for compressed formats so the texture is limited to one level.
+     That way it is still complete if a mipmap filter is used */
+  GE( ctx, glTexParameteri (gl_target, GL_TEXTURE_MAX_LEVEL, 0) );
+
+  _cogl_bitmap_unbind (source_bmp);
+}
+
 static gboolean
 _cogl_texture_driver_gl_get_tex_image (GLenum  gl_target,
                                        GLenum  dest_gl_format,
@@ -385,6 +442,31 @@ _cogl_texture_driver_pixel_format_from_gl_internal (GLenum gl_int_format,
 
       *out_format = COGL_PIXEL_FORMAT_RGBA_8888;
       return TRUE;
+
+    case GL_COMPRESSED_RGB8_ETC2:
+
+      *out_format = COGL_PIXEL_FORMAT_ETC2_RGB_8;
+      return TRUE;
+
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+
+      *out_format = COGL_PIXEL_FORMAT_ETC2_RGBA_8;
+      return TRUE;
+
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+
+      *out_format = COGL_PIXEL_FORMAT_S3TC_DXT1_RGB;
+      return TRUE;
+
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+
+      *out_format = COGL_PIXEL_FORMAT_S3TC_DXT3_RGBA;
+      return TRUE;
+
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+
+      *out_format = COGL_PIXEL_FORMAT_S3TC_DXT5_RGBA;
+      return TRUE;
     }
 
   return FALSE;
@@ -482,6 +564,36 @@ _cogl_texture_driver_pixel_format_to_gl (CoglPixelFormat  format,
       gltype = GL_UNSIGNED_SHORT_5_5_5_1;
       break;
 
+      /* Cogl can't convert to or from the compressed formats so the
+         GL format and type are only used to check the texture size */
+    case COGL_PIXEL_FORMAT_ETC1_RGB_8:
+      /* ETC1 data is also valid ETC2 data */
+    case COGL_PIXEL_FORMAT_ETC2_RGB_8:
+      glintformat = GL_COMPRESSED_RGB8_ETC2;
+      glformat = GL_RGB;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+    case COGL_PIXEL_FORMAT_ETC2_RGBA_8:
+      glintformat = GL_COMPRESSED_RGBA8_ETC2_EAC;
+      glformat = GL_RGBA;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+    case COGL_PIXEL_FORMAT_S3TC_DXT1_RGB:
+      glintformat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+      glformat = GL_RGB;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+    case COGL_PIXEL_FORMAT_S3TC_DXT3_RGBA:
+      glintformat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+      glformat = GL_RGBA;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+    case COGL_PIXEL_FORMAT_S3TC_DXT5_RGBA:
+      glintformat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+      glformat = GL_RGBA;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+
       /* FIXME: check extensions for YUV support */
     default:
       break;
@@ -542,6 +654,7 @@ _cogl_texture_driver_gl =
     _cogl_texture_driver_upload_subregion_to_gl,
     _cogl_texture_driver_upload_to_gl,
     _cogl_texture_driver_upload_to_gl_3d,
+    _cogl_texture_driver_upload_compressed_to_gl,
     _cogl_texture_driver_prep_gl_for_pixels_download,
     _cogl_texture_driver_gl_get_tex_image,
     _cogl_texture_driver_size_supported,
@@ -33,6 +33,18 @@
 #include "cogl-feature-private.h"
 #include "cogl-renderer-private.h"
 
+/* GLES 3 has GL_UNPACK_ROW_LENGTH in core. GLES 2 and later report
+   the version as "OpenGL ES N.M" followed by vendor information */
+static gboolean
+_cogl_gles_check_version_3 (CoglContext *context)
+{
+  const char *version = (const char *) context->glGetString (GL_VERSION);
+
+  return (version &&
+          g_str_has_prefix (version, "OpenGL ES ") &&
+          version[10] >= '3' && version[10] <= '9');
+}
+
 gboolean
 _cogl_gles_update_features (CoglContext *context,
                             GError **error)
@@ -151,6 +163,17 @@ _cogl_gles_update_features (CoglContext *context,
       COGL_FLAGS_SET (context->features, COGL_FEATURE_ID_TEXTURE_3D, TRUE);
     }
 
+  if (_cogl_check_extension ("GL_EXT_texture_compression_s3tc", gl_extensions))
+    COGL_FLAGS_SET (context->features, COGL_FEATURE_ID_TEXTURE_S3TC, TRUE);
+
+  if (_cogl_check_extension ("GL_OES_compressed_ETC1_RGB8_texture",
+                             gl_extensions))
+    COGL_FLAGS_SET (context->features, COGL_FEATURE_ID_TEXTURE_ETC1, TRUE);
+
+  /* ETC2 is only available in core GLES 3 */
+  if (_cogl_gles_check_version_3 (context))
+    COGL_FLAGS_SET (context->features, COGL_FEATURE_ID_TEXTURE_ETC2, TRUE);
+
   if (context->glMapBuffer)
     {
       /* The GL_OES_mapbuffer extension doesn't support mapping for
@@ -163,6 +186,20 @@ _cogl_gles_update_features (CoglContext *context,
   if (context->glEGLImageTargetTexture2D)
     private_flags |= COGL_PRIVATE_FEATURE_TEXTURE_2D_FROM_EGL_IMAGE;
 
+  if (context->glMaxShaderCompilerThreads)
+    private_flags |= COGL_PRIVATE_FEATURE_PARALLEL_SHADER_COMPILE;
+
+  if (context->driver == COGL_DRIVER_GLES2 &&
+      (_cogl_gles_check_version_3 (context) ||
+       _cogl_check_extension ("GL_EXT_unpack_subimage", gl_extensions)))
+    private_flags |= COGL_PRIVATE_FEATURE_UNPACK_SUBIMAGE;
+
+  /* The fixed function arrays are never used with GLES2 so the vertex
+     array objects from GL_OES_vertex_array_object can hold all of the
+     attribute state */
+  if (context->driver == COGL_DRIVER_GLES2 && context->glGenVertexArrays)
+    private_flags |= COGL_PRIVATE_FEATURE_VERTEX_ARRAY_OBJECTS;
+
   /* Cache features */
   context->private_feature_flags |= private_flags;
   context->feature_flags |= flags;
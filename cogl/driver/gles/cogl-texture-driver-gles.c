@@ -52,6 +52,40 @@
 #ifndef GL_MAX_3D_TEXTURE_SIZE_OES
 #define GL_MAX_3D_TEXTURE_SIZE_OES 0x8073
 #endif
+/* These are from GLES 3 and GL_EXT_unpack_subimage */
+#ifndef GL_UNPACK_ROW_LENGTH
+#define GL_UNPACK_ROW_LENGTH 0x0CF2
+#endif
+#ifndef GL_UNPACK_SKIP_ROWS
+#define GL_UNPACK_SKIP_ROWS 0x0CF3
+#endif
+#ifndef GL_UNPACK_SKIP_PIXELS
+#define GL_UNPACK_SKIP_PIXELS 0x0CF4
+#endif
+/* Compressed formats from GL_EXT_texture_compression_s3tc,
+   GL_OES_compressed_ETC1_RGB8_texture and GLES 3 */
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
+/* Scratch memory used to repack a bitmap is kept for the next upload
+   unless it grows bigger than this */
+#define TEXTURE_UPLOAD_ARENA_MAX_SIZE (1024 * 1024)
 
 static void
 _cogl_texture_driver_gen (GLenum   gl_target,
@@ -84,11 +118,35 @@ _cogl_texture_driver_gen (GLenum   gl_target,
     }
 }
 
+/* If GL_UNPACK_ROW_LENGTH is available then the data can be uploaded
+ * from a sub-region of a larger bitmap */
+static void
+prep_gl_for_pixels_upload_full (int pixels_rowstride,
+                                int pixels_src_x,
+                                int pixels_src_y,
+                                int pixels_bpp)
+{
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  if ((ctx->private_feature_flags & COGL_PRIVATE_FEATURE_UNPACK_SUBIMAGE))
+    {
+      GE( ctx, glPixelStorei (GL_UNPACK_ROW_LENGTH,
+                              pixels_rowstride / pixels_bpp) );
+
+      GE( ctx, glPixelStorei (GL_UNPACK_SKIP_PIXELS, pixels_src_x) );
+      GE( ctx, glPixelStorei (GL_UNPACK_SKIP_ROWS, pixels_src_y) );
+    }
+  else
+    g_assert (pixels_src_x == 0 && pixels_src_y == 0);
+
+  _cogl_texture_prep_gl_alignment_for_pixels_upload (pixels_rowstride);
+}
+
 static void
 _cogl_texture_driver_prep_gl_for_pixels_upload (int pixels_rowstride,
                                                 int pixels_bpp)
 {
-  _cogl_texture_prep_gl_alignment_for_pixels_upload (pixels_rowstride);
+  prep_gl_for_pixels_upload_full (pixels_rowstride, 0, 0, pixels_bpp);
 }
 
 static void
@@ -98,30 +156,93 @@ _cogl_texture_driver_prep_gl_for_pixels_download (int pixels_rowstride,
   _cogl_texture_prep_gl_alignment_for_pixels_download (pixels_rowstride);
 }
 
+/* Returns whether GL would work out the same rowstride for rows of
+   the given width using just GL_UNPACK_ALIGNMENT */
+static gboolean
+rowstride_matches_alignment (int rowstride,
+                             int width,
+                             int bpp)
+{
+  /* Work out the alignment of the source rowstride */
+  int alignment = 1 << (_cogl_util_ffs (rowstride) - 1);
+  alignment = MIN (alignment, 8);
+
+  return ((width * bpp + alignment - 1) & ~(alignment - 1)) == rowstride;
+}
+
+/* Returns whether data with the given rowstride can be uploaded
+   directly, either because GL_UNPACK_ROW_LENGTH is available or
+   because the rows are only padded to the alignment */
+static gboolean
+can_upload_rowstride (CoglContext *ctx,
+                      int rowstride,
+                      int width,
+                      int bpp)
+{
+  if (rowstride == 0)
+    return TRUE;
+
+  if ((ctx->private_feature_flags & COGL_PRIVATE_FEATURE_UNPACK_SUBIMAGE) &&
+      rowstride_matches_alignment (rowstride, rowstride / bpp, bpp))
+    return TRUE;
+
+  return rowstride_matches_alignment (rowstride, width, bpp);
+}
+
+/* Creates a tightly packed bitmap whose data is in the context's
+   scratch arena. It must be destroyed before release_scratch_memory()
+   is called */
+static CoglBitmap *
+new_scratch_bitmap (CoglContext *ctx,
+                    CoglPixelFormat format,
+                    int width,
+                    int height)
+{
+  int rowstride = width * _cogl_get_format_bpp (format);
+
+  /* Round the rowstride up to the next nearest multiple of 4 bytes */
+  rowstride = (rowstride + 3) & ~3;
+
+  return _cogl_bitmap_new_from_data (_cogl_arena_alloc
+                                     (&ctx->texture_upload_arena,
+                                      rowstride * height),
+                                     format,
+                                     width, height,
+                                     rowstride,
+                                     NULL, /* destroy_fn */
+                                     NULL);
+}
+
+static void
+release_scratch_memory (CoglContext *ctx)
+{
+  _cogl_arena_trim (&ctx->texture_upload_arena,
+                    TEXTURE_UPLOAD_ARENA_MAX_SIZE);
+}
+
 static CoglBitmap *
-prepare_bitmap_alignment_for_upload (CoglBitmap *src_bmp)
+prepare_bitmap_alignment_for_upload (CoglContext *ctx,
+                                     CoglBitmap *src_bmp)
 {
   CoglPixelFormat format = _cogl_bitmap_get_format (src_bmp);
   int bpp = _cogl_get_format_bpp (format);
   int src_rowstride = _cogl_bitmap_get_rowstride (src_bmp);
   int width = _cogl_bitmap_get_width (src_bmp);
-  int alignment = 1;
+  int height = _cogl_bitmap_get_height (src_bmp);
+  CoglBitmap *dst_bmp;
 
-  if (src_rowstride == 0)
+  if (can_upload_rowstride (ctx, src_rowstride, width, bpp))
     return cogl_object_ref (src_bmp);
 
-  /* Work out the alignment of the source rowstride */
-  alignment = 1 << (_cogl_util_ffs (src_rowstride) - 1);
-  alignment = MIN (alignment, 8);
+  /* Otherwise we need to copy the bitmap to pack the rows */
+  dst_bmp = new_scratch_bitmap (ctx, format, width, height);
+  _cogl_bitmap_copy_subregion (src_bmp,
+                               dst_bmp,
+                               0, 0, /* src_x/y */
+                               0, 0, /* dst_x/y */
+                               width, height);
 
-  /* If the aligned data equals the rowstride then we can upload from
-     the bitmap directly using GL_UNPACK_ALIGNMENT */
-  if (((width * bpp + alignment - 1) & ~(alignment - 1)) == src_rowstride)
-    return cogl_object_ref (src_bmp);
-  /* Otherwise we need to copy the bitmap to pack the alignment
-     because GLES has no GL_ROW_LENGTH */
-  else
-    return _cogl_bitmap_copy (src_bmp);
+  return dst_bmp;
 }
 
 static void
@@ -141,40 +262,48 @@ _cogl_texture_driver_upload_subregion_to_gl (GLenum       gl_target,
   guint8 *data;
   CoglPixelFormat source_format = _cogl_bitmap_get_format (source_bmp);
   int bpp = _cogl_get_format_bpp (source_format);
+  int source_rowstride = _cogl_bitmap_get_rowstride (source_bmp);
   CoglBitmap *slice_bmp;
   int rowstride;
 
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
-  /* If we are copying a sub region of the source bitmap then we need
-     to copy it because GLES does not support GL_UNPACK_ROW_LENGTH */
-  if (src_x != 0 || src_y != 0 ||
-      width != _cogl_bitmap_get_width (source_bmp) ||
-      height != _cogl_bitmap_get_height (source_bmp))
+  if (src_x == 0 && src_y == 0 &&
+      width == _cogl_bitmap_get_width (source_bmp) &&
+      height == _cogl_bitmap_get_height (source_bmp))
+    {
+      slice_bmp = prepare_bitmap_alignment_for_upload (ctx, source_bmp);
+      rowstride = _cogl_bitmap_get_rowstride (slice_bmp);
+    }
+  /* With GL_UNPACK_ROW_LENGTH the sub region can be uploaded straight
+     from the source bitmap */
+  else if ((ctx->private_feature_flags &
+            COGL_PRIVATE_FEATURE_UNPACK_SUBIMAGE) &&
+           can_upload_rowstride (ctx, source_rowstride, width, bpp))
     {
-      rowstride = bpp * width;
-      rowstride = (rowstride + 3) & ~3;
-      slice_bmp =
-        _cogl_bitmap_new_from_data (g_malloc (height * rowstride),
-                                    source_format,
-                                    width, height,
-                                    rowstride,
-                                    (CoglBitmapDestroyNotify) g_free,
-                                    NULL);
+      slice_bmp = cogl_object_ref (source_bmp);
+      rowstride = source_rowstride;
+    }
+  /* Otherwise we need to copy the sub region because GLES 2 does not
+     support GL_UNPACK_ROW_LENGTH */
+  else
+    {
+      slice_bmp = new_scratch_bitmap (ctx, source_format, width, height);
+      rowstride = _cogl_bitmap_get_rowstride (slice_bmp);
       _cogl_bitmap_copy_subregion (source_bmp,
                                    slice_bmp,
                                    src_x, src_y,
                                    0, 0, /* dst_x/y */
                                    width, height);
-    }
-  else
-    {
-      slice_bmp = prepare_bitmap_alignment_for_upload (source_bmp);
-      rowstride = _cogl_bitmap_get_rowstride (slice_bmp);
+      src_x = 0;
+      src_y = 0;
     }
 
   /* Setup gl alignment to match rowstride and top-left corner */
-  _cogl_texture_driver_prep_gl_for_pixels_upload (rowstride, bpp);
+  if (slice_bmp == source_bmp)
+    prep_gl_for_pixels_upload_full (rowstride, src_x, src_y, bpp);
+  else
+    _cogl_texture_driver_prep_gl_for_pixels_upload (rowstride, bpp);
 
   data = _cogl_bitmap_bind (slice_bmp, COGL_BUFFER_ACCESS_READ, 0);
 
@@ -190,6 +319,8 @@ _cogl_texture_driver_upload_subregion_to_gl (GLenum       gl_target,
   _cogl_bitmap_unbind (slice_bmp);
 
   cogl_object_unref (slice_bmp);
+
+  release_scratch_memory (ctx);
 }
 
 static void
@@ -210,7 +341,7 @@ _cogl_texture_driver_upload_to_gl (GLenum       gl_target,
 
   _COGL_GET_CONTEXT (ctx, NO_RETVAL);
 
-  bmp = prepare_bitmap_alignment_for_upload (source_bmp);
+  bmp = prepare_bitmap_alignment_for_upload (ctx, source_bmp);
   rowstride = _cogl_bitmap_get_rowstride (bmp);
 
   /* Setup gl alignment to match rowstride and top-left corner */
@@ -231,6 +362,8 @@ _cogl_texture_driver_upload_to_gl (GLenum       gl_target,
   _cogl_bitmap_unbind (bmp);
 
   cogl_object_unref (bmp);
+
+  release_scratch_memory (ctx);
 }
 
 static void
@@ -264,8 +397,6 @@ _cogl_texture_driver_upload_to_gl_3d (GLenum       gl_target,
       int image_height = bmp_height / depth;
       int i;
 
-      _cogl_texture_driver_prep_gl_for_pixels_upload (bmp_width * bpp, bpp);
-
       /* Initialize the texture with empty data and then upload each
          image with a sub-region update */
 
@@ -280,13 +411,13 @@ _cogl_texture_driver_upload_to_gl_3d (GLenum       gl_target,
                              source_gl_type,
                              NULL) );
 
-      bmp = _cogl_bitmap_new_from_data (g_malloc (bpp * bmp_width * height),
-                                        _cogl_bitmap_get_format (source_bmp),
-                                        bmp_width,
-                                        height,
-                                        bpp * bmp_width,
-                                        (CoglBitmapDestroyNotify) g_free,
-                                        NULL);
+      bmp = new_scratch_bitmap (ctx,
+                                _cogl_bitmap_get_format (source_bmp),
+                                bmp_width,
+                                height);
+
+      _cogl_texture_driver_prep_gl_for_pixels_upload
+        (_cogl_bitmap_get_rowstride (bmp), bpp);
 
       for (i = 0; i < depth; i++)
         {
@@ -316,6 +447,8 @@ _cogl_texture_driver_upload_to_gl_3d (GLenum       gl_target,
         }
 
       cogl_object_unref (bmp);
+
+      release_scratch_memory (ctx);
     }
   else
     {
@@ -338,6 +471,37 @@ _cogl_texture_driver_upload_to_gl_3d (GLenum       gl_target,
     }
 }
 
+static void
+_cogl_texture_driver_upload_compressed_to_gl (GLenum       gl_target,
+                                              GLuint       gl_handle,
+                                              gboolean     is_foreign,
+                                              CoglBitmap  *source_bmp,
+                                              GLint        internal_gl_format)
+{
+  int width = _cogl_bitmap_get_width (source_bmp);
+  int height = _cogl_bitmap_get_height (source_bmp);
+  int size;
+  guint8 *data;
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  /* The rowstride is the size of a row of 4x4 blocks */
+  size = _cogl_bitmap_get_rowstride (source_bmp) * ((height + 3) / 4);
+
+  data = _cogl_bitmap_bind (source_bmp, COGL_BUFFER_ACCESS_READ, 0);
+
+  _cogl_bind_gl_texture_transient (gl_target, gl_handle, is_foreign);
+
+  GE( ctx, glCompressedTexImage2D (gl_target, 0,
+                                   internal_gl_format,
+                                   width, height,
+                                   0, /* border */
+                                   size,
+                                   data) );
+
+  _cogl_bitmap_unbind (source_bmp);
+}
+
 /* NB: GLES doesn't support glGetTexImage2D, so cogl-texture will instead
  * fallback to a generic render + readpixels approach to downloading
  * texture data. (See _cogl_texture_draw_and_read() ) */
@@ -472,6 +636,39 @@ _cogl_texture_driver_pixel_format_to_gl (CoglPixelFormat  format,
       gltype = GL_UNSIGNED_SHORT_5_5_5_1;
       break;
 
+      /* Cogl can't convert to or from the compressed formats so the
+         GL format and type are only used to check the texture size */
+    case COGL_PIXEL_FORMAT_ETC1_RGB_8:
+      glintformat = GL_ETC1_RGB8_OES;
+      glformat = GL_RGB;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+    case COGL_PIXEL_FORMAT_ETC2_RGB_8:
+      glintformat = GL_COMPRESSED_RGB8_ETC2;
+      glformat = GL_RGB;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+    case COGL_PIXEL_FORMAT_ETC2_RGBA_8:
+      glintformat = GL_COMPRESSED_RGBA8_ETC2_EAC;
+      glformat = GL_RGBA;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+    case COGL_PIXEL_FORMAT_S3TC_DXT1_RGB:
+      glintformat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+      glformat = GL_RGB;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+    case COGL_PIXEL_FORMAT_S3TC_DXT3_RGBA:
+      glintformat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+      glformat = GL_RGBA;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+    case COGL_PIXEL_FORMAT_S3TC_DXT5_RGBA:
+      glintformat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+      glformat = GL_RGBA;
+      gltype = GL_UNSIGNED_BYTE;
+      break;
+
       /* FIXME: check extensions for YUV support */
     default:
       break;
@@ -527,6 +724,7 @@ _cogl_texture_driver_gles =
     _cogl_texture_driver_upload_subregion_to_gl,
     _cogl_texture_driver_upload_to_gl,
     _cogl_texture_driver_upload_to_gl_3d,
+    _cogl_texture_driver_upload_compressed_to_gl,
     _cogl_texture_driver_prep_gl_for_pixels_download,
     _cogl_texture_driver_gl_get_tex_image,
     _cogl_texture_driver_size_supported,
@@ -128,6 +128,126 @@ COGL_EXT_END ()
 
 
 
+/* The functions in ARB_uniform_buffer_object don't have a suffix */
+COGL_EXT_BEGIN (uniform_buffer_object, 3, 1,
+                0, /* not in either GLES */
+                "ARB:\0",
+                "uniform_buffer_object\0")
+COGL_EXT_FUNCTION (void, glGetUniformIndices,
+                   (GLuint                program,
+                    GLsizei               uniformCount,
+                    const GLchar * const *uniformNames,
+                    GLuint               *uniformIndices))
+COGL_EXT_FUNCTION (void, glGetActiveUniformsiv,
+                   (GLuint                program,
+                    GLsizei               uniformCount,
+                    const GLuint         *uniformIndices,
+                    GLenum                pname,
+                    GLint                *params))
+COGL_EXT_FUNCTION (GLuint, glGetUniformBlockIndex,
+                   (GLuint                program,
+                    const GLchar         *uniformBlockName))
+COGL_EXT_FUNCTION (void, glGetActiveUniformBlockiv,
+                   (GLuint                program,
+                    GLuint                uniformBlockIndex,
+                    GLenum                pname,
+                    GLint                *params))
+COGL_EXT_FUNCTION (void, glUniformBlockBinding,
+                   (GLuint                program,
+                    GLuint                uniformBlockIndex,
+                    GLuint                uniformBlockBinding))
+COGL_EXT_FUNCTION (void, glBindBufferBase,
+                   (GLenum                target,
+                    GLuint                index,
+                    GLuint                buffer))
+COGL_EXT_END ()
+
+COGL_EXT_BEGIN (parallel_shader_compile, 255, 255,
+                0, /* not in either GLES */
+                "KHR\0ARB\0",
+                "parallel_shader_compile\0")
+COGL_EXT_FUNCTION (void, glMaxShaderCompilerThreads,
+                   (GLuint                count))
+COGL_EXT_END ()
+
+COGL_EXT_BEGIN (sampler_objects, 3, 3,
+                0, /* not in either GLES */
+                "ARB:\0",
+                "sampler_objects\0")
+COGL_EXT_FUNCTION (void, glGenSamplers,
+                   (GLsizei               count,
+                    GLuint               *samplers))
+COGL_EXT_FUNCTION (void, glDeleteSamplers,
+                   (GLsizei               count,
+                    const GLuint         *samplers))
+COGL_EXT_FUNCTION (void, glBindSampler,
+                   (GLuint                unit,
+                    GLuint                sampler))
+COGL_EXT_FUNCTION (void, glSamplerParameteri,
+                   (GLuint                sampler,
+                    GLenum                pname,
+                    GLint                 param))
+COGL_EXT_END ()
+
+/* The GLsync type is only available if the GL headers are new enough
+ * to have the extension */
+#ifdef GL_ARB_sync
+COGL_EXT_BEGIN (sync, 3, 2,
+                0, /* not in either GLES */
+                "ARB:\0",
+                "sync\0")
+COGL_EXT_FUNCTION (GLsync, glFenceSync,
+                   (GLenum                condition,
+                    GLbitfield            flags))
+COGL_EXT_FUNCTION (GLenum, glClientWaitSync,
+                   (GLsync                sync,
+                    GLbitfield            flags,
+                    GLuint64              timeout))
+COGL_EXT_FUNCTION (void, glDeleteSync,
+                   (GLsync                sync))
+COGL_EXT_END ()
+#endif /* GL_ARB_sync */
+
+COGL_EXT_BEGIN (multi_bind, 4, 4,
+                0, /* not in either GLES */
+                "ARB:\0",
+                "multi_bind\0")
+COGL_EXT_FUNCTION (void, glBindTextures,
+                   (GLuint                first,
+                    GLsizei               count,
+                    const GLuint         *textures))
+COGL_EXT_FUNCTION (void, glBindSamplers,
+                   (GLuint                first,
+                    GLsizei               count,
+                    const GLuint         *samplers))
+COGL_EXT_END ()
+
+COGL_EXT_BEGIN (vertex_array_object, 3, 0,
+                0, /* not in either GLES */
+                "ARB:\0OES\0",
+                "vertex_array_object\0")
+COGL_EXT_FUNCTION (void, glBindVertexArray,
+                   (GLuint                array))
+COGL_EXT_FUNCTION (void, glDeleteVertexArrays,
+                   (GLsizei               n,
+                    const GLuint         *arrays))
+COGL_EXT_FUNCTION (void, glGenVertexArrays,
+                   (GLsizei               n,
+                    GLuint               *arrays))
+COGL_EXT_END ()
+
+COGL_EXT_BEGIN (draw_elements_base_vertex, 3, 2,
+                0, /* not in either GLES */
+                "ARB:\0OES\0EXT\0",
+                "draw_elements_base_vertex\0")
+COGL_EXT_FUNCTION (void, glDrawElementsBaseVertex,
+                   (GLenum                mode,
+                    GLsizei               count,
+                    GLenum                type,
+                    const GLvoid         *indices,
+                    GLint                 basevertex))
+COGL_EXT_END ()
+
 COGL_EXT_BEGIN (offscreen_blit, 255, 255,
                 0, /* not in either GLES */
                 "EXT\0ANGLE\0",
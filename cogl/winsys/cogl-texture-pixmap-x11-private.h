@@ -40,6 +40,10 @@
 
 #define COGL_TEXTURE_PIXMAP_X11(tex) ((CoglTexturePixmapX11 *) tex)
 
+/* The maximum number of separate damage rectangles that are tracked
+   before they are merged together */
+#define COGL_TEXTURE_PIXMAP_X11_MAX_DAMAGE_RECTS 8
+
 typedef struct _CoglDamageRectangle CoglDamageRectangle;
 
 struct _CoglDamageRectangle
@@ -71,7 +75,11 @@ struct _CoglTexturePixmapX11
   Damage damage;
   CoglTexturePixmapX11ReportLevel damage_report_level;
   gboolean damage_owned;
-  CoglDamageRectangle damage_rect;
+  /* The regions that need to be fetched from the pixmap the next
+     time the texture is used. Rectangles that mostly overlap are
+     merged together */
+  int n_damage_rects;
+  CoglDamageRectangle damage_rects[COGL_TEXTURE_PIXMAP_X11_MAX_DAMAGE_RECTS];
 
   void *winsys;
 
@@ -65,34 +65,38 @@ COGL_TEXTURE_DEFINE (TexturePixmapX11, texture_pixmap_x11);
 
 static const CoglTextureVtable cogl_texture_pixmap_x11_vtable;
 
+static unsigned int
+cogl_damage_rectangle_area (const CoglDamageRectangle *damage_rect)
+{
+  return ((damage_rect->x2 - damage_rect->x1) *
+          (damage_rect->y2 - damage_rect->y1));
+}
+
 static void
-cogl_damage_rectangle_union (CoglDamageRectangle *damage_rect,
-                             int x,
-                             int y,
-                             int width,
-                             int height)
+cogl_damage_rectangle_union (CoglDamageRectangle *dst,
+                             const CoglDamageRectangle *src)
 {
-  /* If the damage region is empty then we'll just copy the new
-     rectangle directly */
-  if (damage_rect->x1 == damage_rect->x2 ||
-      damage_rect->y1 == damage_rect->y2)
-    {
-      damage_rect->x1 = x;
-      damage_rect->y1 = y;
-      damage_rect->x2 = x + width;
-      damage_rect->y2 = y + height;
-    }
-  else
-    {
-      if (damage_rect->x1 > x)
-        damage_rect->x1 = x;
-      if (damage_rect->y1 > y)
-        damage_rect->y1 = y;
-      if (damage_rect->x2 < x + width)
-        damage_rect->x2 = x + width;
-      if (damage_rect->y2 < y + height)
-        damage_rect->y2 = y + height;
-    }
+  dst->x1 = MIN (dst->x1, src->x1);
+  dst->y1 = MIN (dst->y1, src->y1);
+  dst->x2 = MAX (dst->x2, src->x2);
+  dst->y2 = MAX (dst->y2, src->y2);
+}
+
+/* Returns the number of extra pixels that would have to be fetched if
+   the two rectangles were replaced with their union instead of being
+   fetched separately. This is negative when they overlap enough that
+   the union is cheaper */
+static int
+cogl_damage_rectangle_union_cost (const CoglDamageRectangle *a,
+                                  const CoglDamageRectangle *b)
+{
+  CoglDamageRectangle u = *a;
+
+  cogl_damage_rectangle_union (&u, b);
+
+  return ((int) cogl_damage_rectangle_area (&u) -
+          (int) cogl_damage_rectangle_area (a) -
+          (int) cogl_damage_rectangle_area (b));
 }
 
 static gboolean
@@ -104,6 +108,92 @@ cogl_damage_rectangle_is_whole (const CoglDamageRectangle *damage_rect,
           && damage_rect->x2 == width && damage_rect->y2 == height);
 }
 
+static gboolean
+_cogl_texture_pixmap_x11_is_whole_damaged (CoglTexturePixmapX11 *tex_pixmap)
+{
+  return (tex_pixmap->n_damage_rects == 1 &&
+          cogl_damage_rectangle_is_whole (tex_pixmap->damage_rects,
+                                          tex_pixmap->width,
+                                          tex_pixmap->height));
+}
+
+static void
+_cogl_texture_pixmap_x11_remove_damage_rect (CoglTexturePixmapX11 *tex_pixmap,
+                                             int index)
+{
+  tex_pixmap->damage_rects[index] =
+    tex_pixmap->damage_rects[--tex_pixmap->n_damage_rects];
+}
+
+/* Adds a rectangle to the list of regions that need updating. The
+   rectangle is merged with any existing rectangles that overlap it
+   enough that fetching their union wouldn't transfer more pixels than
+   fetching them separately. If the list is full then it is merged with
+   whichever rectangle grows the least */
+static void
+_cogl_texture_pixmap_x11_add_damage (CoglTexturePixmapX11 *tex_pixmap,
+                                     int x,
+                                     int y,
+                                     int width,
+                                     int height)
+{
+  CoglDamageRectangle rect;
+  gboolean merged;
+  int i;
+
+  /* Clip the rectangle to the pixmap */
+  rect.x1 = CLAMP (x, 0, (int) tex_pixmap->width);
+  rect.y1 = CLAMP (y, 0, (int) tex_pixmap->height);
+  rect.x2 = CLAMP (x + width, 0, (int) tex_pixmap->width);
+  rect.y2 = CLAMP (y + height, 0, (int) tex_pixmap->height);
+
+  if (rect.x1 >= rect.x2 || rect.y1 >= rect.y2 ||
+      _cogl_texture_pixmap_x11_is_whole_damaged (tex_pixmap))
+    return;
+
+  /* Keep absorbing existing rectangles until the new one doesn't
+     overlap any of them enough */
+  do
+    {
+      merged = FALSE;
+
+      for (i = 0; i < tex_pixmap->n_damage_rects; i++)
+        if (cogl_damage_rectangle_union_cost (&rect,
+                                              tex_pixmap->damage_rects + i)
+            <= 0)
+          {
+            cogl_damage_rectangle_union (&rect, tex_pixmap->damage_rects + i);
+            _cogl_texture_pixmap_x11_remove_damage_rect (tex_pixmap, i);
+            merged = TRUE;
+            break;
+          }
+    }
+  while (merged);
+
+  if (tex_pixmap->n_damage_rects >= COGL_TEXTURE_PIXMAP_X11_MAX_DAMAGE_RECTS)
+    {
+      int best = 0;
+      int best_cost = G_MAXINT;
+
+      for (i = 0; i < tex_pixmap->n_damage_rects; i++)
+        {
+          int cost =
+            cogl_damage_rectangle_union_cost (&rect,
+                                              tex_pixmap->damage_rects + i);
+
+          if (cost < best_cost)
+            {
+              best = i;
+              best_cost = cost;
+            }
+        }
+
+      cogl_damage_rectangle_union (tex_pixmap->damage_rects + best, &rect);
+    }
+  else
+    tex_pixmap->damage_rects[tex_pixmap->n_damage_rects++] = rect;
+}
+
 static const CoglWinsysVtable *
 _cogl_texture_pixmap_x11_get_winsys (CoglTexturePixmapX11 *tex_pixmap)
 {
@@ -119,7 +209,7 @@ process_damage_event (CoglTexturePixmapX11 *tex_pixmap,
                       XDamageNotifyEvent *damage_event)
 {
   Display *display;
-  enum { DO_NOTHING, NEEDS_SUBTRACT, NEED_BOUNDING_BOX } handle_mode;
+  enum { DO_NOTHING, NEEDS_SUBTRACT, NEED_REGION } handle_mode;
   const CoglWinsysVtable *winsys;
 
   _COGL_GET_CONTEXT (ctxt, NO_RETVAL);
@@ -140,9 +230,9 @@ process_damage_event (CoglTexturePixmapX11 *tex_pixmap,
 
     case COGL_TEXTURE_PIXMAP_X11_DAMAGE_DELTA_RECTANGLES:
     case COGL_TEXTURE_PIXMAP_X11_DAMAGE_NON_EMPTY:
-      /* For delta rectangles and non empty we'll query the damage
-         region for the bounding box */
-      handle_mode = NEED_BOUNDING_BOX;
+      /* For delta rectangles and non empty we'll query the
+         rectangles of the damage region */
+      handle_mode = NEED_REGION;
       break;
 
     case COGL_TEXTURE_PIXMAP_X11_DAMAGE_BOUNDING_BOX:
@@ -157,16 +247,14 @@ process_damage_event (CoglTexturePixmapX11 *tex_pixmap,
     }
 
   /* If the damage already covers the whole rectangle then we don't
-     need to request the bounding box of the region because we're
-     going to update the whole texture anyway. */
-  if (cogl_damage_rectangle_is_whole (&tex_pixmap->damage_rect,
-                                      tex_pixmap->width,
-                                      tex_pixmap->height))
+     need to request the rectangles of the region because we're going
+     to update the whole texture anyway. */
+  if (_cogl_texture_pixmap_x11_is_whole_damaged (tex_pixmap))
     {
       if (handle_mode != DO_NOTHING)
         XDamageSubtract (display, tex_pixmap->damage, None, None);
     }
-  else if (handle_mode == NEED_BOUNDING_BOX)
+  else if (handle_mode == NEED_REGION)
     {
       XserverRegion parts;
       int r_count;
@@ -174,7 +262,8 @@ process_damage_event (CoglTexturePixmapX11 *tex_pixmap,
       XRectangle *r_damage;
 
       /* We need to extract the damage region so we can get the
-         bounding box */
+         rectangles. They are tracked separately so that distant
+         damage doesn't cause everything in between to be fetched */
 
       parts = XFixesCreateRegion (display, 0, 0);
       XDamageSubtract (display, tex_pixmap->damage, None, parts);
@@ -182,13 +271,25 @@ process_damage_event (CoglTexturePixmapX11 *tex_pixmap,
                                              parts,
                                              &r_count,
                                              &r_bounds);
-      cogl_damage_rectangle_union (&tex_pixmap->damage_rect,
-                                   r_bounds.x,
-                                   r_bounds.y,
-                                   r_bounds.width,
-                                   r_bounds.height);
       if (r_damage)
-        XFree (r_damage);
+        {
+          int i;
+
+          for (i = 0; i < r_count; i++)
+            _cogl_texture_pixmap_x11_add_damage (tex_pixmap,
+                                                 r_damage[i].x,
+                                                 r_damage[i].y,
+                                                 r_damage[i].width,
+                                                 r_damage[i].height);
+
+          XFree (r_damage);
+        }
+      else
+        _cogl_texture_pixmap_x11_add_damage (tex_pixmap,
+                                             r_bounds.x,
+                                             r_bounds.y,
+                                             r_bounds.width,
+                                             r_bounds.height);
 
       XFixesDestroyRegion (display, parts);
     }
@@ -199,11 +300,11 @@ process_damage_event (CoglTexturePixmapX11 *tex_pixmap,
            don't care what the region actually was */
         XDamageSubtract (display, tex_pixmap->damage, None, None);
 
-      cogl_damage_rectangle_union (&tex_pixmap->damage_rect,
-                                   damage_event->area.x,
-                                   damage_event->area.y,
-                                   damage_event->area.width,
-                                   damage_event->area.height);
+      _cogl_texture_pixmap_x11_add_damage (tex_pixmap,
+                                           damage_event->area.x,
+                                           damage_event->area.y,
+                                           damage_event->area.width,
+                                           damage_event->area.height);
     }
 
   if (tex_pixmap->winsys)
@@ -326,10 +427,11 @@ cogl_texture_pixmap_x11_new (guint32 pixmap,
     }
 
   /* Assume the entire pixmap is damaged to begin with */
-  tex_pixmap->damage_rect.x1 = 0;
-  tex_pixmap->damage_rect.x2 = tex_pixmap->width;
-  tex_pixmap->damage_rect.y1 = 0;
-  tex_pixmap->damage_rect.y2 = tex_pixmap->height;
+  tex_pixmap->n_damage_rects = 1;
+  tex_pixmap->damage_rects[0].x1 = 0;
+  tex_pixmap->damage_rects[0].x2 = tex_pixmap->width;
+  tex_pixmap->damage_rects[0].y1 = 0;
+  tex_pixmap->damage_rects[0].y2 = tex_pixmap->height;
 
   winsys = _cogl_texture_pixmap_x11_get_winsys (tex_pixmap);
   if (winsys->texture_pixmap_x11_create)
@@ -439,8 +541,7 @@ cogl_texture_pixmap_x11_update_area (CoglHandle handle,
       winsys->texture_pixmap_x11_damage_notify (tex_pixmap);
     }
 
-  cogl_damage_rectangle_union (&tex_pixmap->damage_rect,
-                               x, y, width, height);
+  _cogl_texture_pixmap_x11_add_damage (tex_pixmap, x, y, width, height);
 }
 
 gboolean
@@ -473,108 +574,10 @@ cogl_texture_pixmap_x11_set_damage_object (CoglHandle handle,
     set_damage_object_internal (ctxt, tex_pixmap, damage, report_level);
 }
 
-static void
-_cogl_texture_pixmap_x11_update_image_texture (CoglTexturePixmapX11 *tex_pixmap)
+static CoglPixelFormat
+get_image_format (XImage *image)
 {
-  Display *display;
   CoglPixelFormat image_format;
-  XImage *image;
-  int src_x, src_y;
-  int x, y, width, height;
-
-  display = cogl_xlib_get_display ();
-
-  /* If the damage region is empty then there's nothing to do */
-  if (tex_pixmap->damage_rect.x2 == tex_pixmap->damage_rect.x1)
-    return;
-
-  x = tex_pixmap->damage_rect.x1;
-  y = tex_pixmap->damage_rect.y1;
-  width = tex_pixmap->damage_rect.x2 - x;
-  height = tex_pixmap->damage_rect.y2 - y;
-
-  /* We lazily create the texture the first time it is needed in case
-     this texture can be entirely handled using the GLX texture
-     instead */
-  if (tex_pixmap->tex == COGL_INVALID_HANDLE)
-    {
-      CoglPixelFormat texture_format;
-
-      texture_format = (tex_pixmap->depth >= 32
-                        ? COGL_PIXEL_FORMAT_RGBA_8888_PRE
-                        : COGL_PIXEL_FORMAT_RGB_888);
-
-      tex_pixmap->tex = cogl_texture_new_with_size (tex_pixmap->width,
-                                                    tex_pixmap->height,
-                                                    COGL_TEXTURE_NONE,
-                                                    texture_format);
-    }
-
-  if (tex_pixmap->image == NULL)
-    {
-      /* If we also haven't got a shm segment then this must be the
-         first time we've tried to update, so lets try allocating shm
-         first */
-      if (tex_pixmap->shm_info.shmid == -1)
-        try_alloc_shm (tex_pixmap);
-
-      if (tex_pixmap->shm_info.shmid == -1)
-        {
-          COGL_NOTE (TEXTURE_PIXMAP, "Updating %p using XGetImage", tex_pixmap);
-
-          /* We'll fallback to using a regular XImage. We'll download
-             the entire area instead of a sub region because presumably
-             if this is the first update then the entire pixmap is
-             needed anyway and it saves trying to manually allocate an
-             XImage at the right size */
-          tex_pixmap->image = XGetImage (display,
-                                         tex_pixmap->pixmap,
-                                         0, 0,
-                                         tex_pixmap->width, tex_pixmap->height,
-                                         AllPlanes, ZPixmap);
-          image = tex_pixmap->image;
-          src_x = x;
-          src_y = y;
-        }
-      else
-        {
-          COGL_NOTE (TEXTURE_PIXMAP, "Updating %p using XShmGetImage",
-                     tex_pixmap);
-
-          /* Create a temporary image using the beginning of the
-             shared memory segment and the right size for the region
-             we want to update. We need to reallocate the XImage every
-             time because there is no XShmGetSubImage. */
-          image = XShmCreateImage (display,
-                                   tex_pixmap->visual,
-                                   tex_pixmap->depth,
-                                   ZPixmap,
-                                   NULL,
-                                   &tex_pixmap->shm_info,
-                                   width,
-                                   height);
-          image->data = tex_pixmap->shm_info.shmaddr;
-          src_x = 0;
-          src_y = 0;
-
-          XShmGetImage (display, tex_pixmap->pixmap, image, x, y, AllPlanes);
-        }
-    }
-  else
-    {
-      COGL_NOTE (TEXTURE_PIXMAP, "Updating %p using XGetSubImage", tex_pixmap);
-
-      image = tex_pixmap->image;
-      src_x = x;
-      src_y = y;
-
-      XGetSubImage (display,
-                    tex_pixmap->pixmap,
-                    x, y, width, height,
-                    AllPlanes, ZPixmap,
-                    image,
-                    x, y);
-    }
 
   /* xlib doesn't appear to fill in image->{red,green,blue}_mask so
      this just assumes that the image is stored as ARGB from most
@@ -618,21 +621,169 @@ _cogl_texture_pixmap_x11_update_image_texture (CoglTexturePixmapX11 *tex_pixmap)
         image_format |= COGL_BGR_BIT;
     }
 
+  return image_format;
+}
+
+/* Copies one damaged rectangle of the pixmap into the texture. If
+   @fetch is FALSE then the rectangle is already up to date in
+   tex_pixmap->image. Returns the number of bytes that were
+   transferred from the X server */
+static gsize
+_cogl_texture_pixmap_x11_update_rectangle (CoglTexturePixmapX11 *tex_pixmap,
+                                           const CoglDamageRectangle *rect,
+                                           gboolean fetch)
+{
+  Display *display = cogl_xlib_get_display ();
+  XImage *image;
+  int src_x, src_y;
+  int x = rect->x1;
+  int y = rect->y1;
+  int width = rect->x2 - rect->x1;
+  int height = rect->y2 - rect->y1;
+  gsize n_bytes = 0;
+
+  if (tex_pixmap->shm_info.shmid != -1)
+    {
+      /* The shared memory segment is big enough for the whole pixmap
+         so it is kept for the lifetime of the texture. We only need a
+         temporary image header with the right size for the rectangle
+         because there is no XShmGetSubImage. Creating it doesn't
+         involve the server */
+      image = XShmCreateImage (display,
+                               tex_pixmap->visual,
+                               tex_pixmap->depth,
+                               ZPixmap,
+                               NULL,
+                               &tex_pixmap->shm_info,
+                               width,
+                               height);
+      image->data = tex_pixmap->shm_info.shmaddr;
+      src_x = 0;
+      src_y = 0;
+
+      XShmGetImage (display, tex_pixmap->pixmap, image, x, y, AllPlanes);
+
+      n_bytes = (gsize) image->bytes_per_line * height;
+    }
+  else
+    {
+      image = tex_pixmap->image;
+      src_x = x;
+      src_y = y;
+
+      if (fetch)
+        {
+          XGetSubImage (display,
+                        tex_pixmap->pixmap,
+                        x, y, width, height,
+                        AllPlanes, ZPixmap,
+                        image,
+                        x, y);
+
+          n_bytes = (gsize) width * height * image->bits_per_pixel / 8;
+        }
+    }
+
   cogl_texture_set_region (tex_pixmap->tex,
                            src_x, src_y,
                            x, y, width, height,
                            image->width,
                            image->height,
-                           image_format,
+                           get_image_format (image),
                            image->bytes_per_line,
                            (const guint8 *) image->data);
 
-  /* If we have a shared memory segment then the XImage would be a
+  /* If we have a shared memory segment then the XImage is a
      temporary one with no data allocated so we can just XFree it */
   if (tex_pixmap->shm_info.shmid != -1)
     XFree (image);
 
-  memset (&tex_pixmap->damage_rect, 0, sizeof (CoglDamageRectangle));
+  return n_bytes;
+}
+
+static void
+_cogl_texture_pixmap_x11_update_image_texture (CoglTexturePixmapX11 *tex_pixmap)
+{
+  Display *display;
+  gboolean fetch = TRUE;
+  gsize n_bytes = 0;
+  int i;
+
+  display = cogl_xlib_get_display ();
+
+  /* If the damage region is empty then there's nothing to do */
+  if (tex_pixmap->n_damage_rects == 0)
+    return;
+
+  /* We lazily create the texture the first time it is needed in case
+     this texture can be entirely handled using the GLX texture
+     instead */
+  if (tex_pixmap->tex == COGL_INVALID_HANDLE)
+    {
+      CoglPixelFormat texture_format;
+
+      texture_format = (tex_pixmap->depth >= 32
+                        ? COGL_PIXEL_FORMAT_RGBA_8888_PRE
+                        : COGL_PIXEL_FORMAT_RGB_888);
+
+      tex_pixmap->tex = cogl_texture_new_with_size (tex_pixmap->width,
+                                                    tex_pixmap->height,
+                                                    COGL_TEXTURE_NONE,
+                                                    texture_format);
+    }
+
+  if (tex_pixmap->image == NULL)
+    {
+      /* If we also haven't got a shm segment then this must be the
+         first time we've tried to update, so lets try allocating shm
+         first */
+      if (tex_pixmap->shm_info.shmid == -1)
+        try_alloc_shm (tex_pixmap);
+
+      if (tex_pixmap->shm_info.shmid == -1)
+        {
+          COGL_NOTE (TEXTURE_PIXMAP, "Updating %p using XGetImage", tex_pixmap);
+
+          /* We'll fallback to using a regular XImage. We'll download
+             the entire area instead of a sub region because presumably
+             if this is the first update then the entire pixmap is
+             needed anyway and it saves trying to manually allocate an
+             XImage at the right size */
+          tex_pixmap->image = XGetImage (display,
+                                         tex_pixmap->pixmap,
+                                         0, 0,
+                                         tex_pixmap->width, tex_pixmap->height,
+                                         AllPlanes, ZPixmap);
+
+          n_bytes = ((gsize) tex_pixmap->image->bytes_per_line *
+                     tex_pixmap->image->height);
+
+          /* The damaged rectangles only need to be uploaded */
+          fetch = FALSE;
+        }
+      else
+        COGL_NOTE (TEXTURE_PIXMAP, "Updating %p using XShmGetImage",
+                   tex_pixmap);
+    }
+  else
+    COGL_NOTE (TEXTURE_PIXMAP, "Updating %p using XGetSubImage", tex_pixmap);
+
+  for (i = 0; i < tex_pixmap->n_damage_rects; i++)
+    n_bytes +=
+      _cogl_texture_pixmap_x11_update_rectangle (tex_pixmap,
+                                                 tex_pixmap->damage_rects + i,
+                                                 fetch);
+
+  COGL_NOTE (TEXTURE_PIXMAP,
+             "Updated %i rectangles of %p (%ux%u), transferring %"
+             G_GSIZE_FORMAT " bytes",
+             tex_pixmap->n_damage_rects,
+             tex_pixmap,
+             tex_pixmap->width,
+             tex_pixmap->height,
+             n_bytes);
+
+  tex_pixmap->n_damage_rects = 0;
 }
 
 static void
@@ -0,0 +1,774 @@
+/*
+ * Replays a file written by running an application with
+ * COGL_DEBUG=capture and reports the time taken for each frame.
+ *
+ * Usage: cogl-replay [-n REPEATS] FILE
+ *
+ * The stream is replayed into an offscreen framebuffer so the timings
+ * don't depend on the window system. The reported CPU time is the time
+ * taken for Cogl to submit the frame to GL and the total time also
+ * includes waiting for the GPU to finish. The pipeline state in the
+ * capture is only an approximation of the original pipelines so the
+ * numbers are mainly useful for comparing two builds of Cogl against
+ * the same capture.
+ *
+ * Unlike the other examples this can only be built inside the Cogl
+ * source tree because it needs cogl-capture-format.h which isn't
+ * installed.
+ */
+
+#include <cogl/cogl.h>
+#include <cogl/cogl-capture-format.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+typedef struct
+{
+  const guint8 *data;
+  const guint8 *end;
+  gboolean error;
+} Reader;
+
+typedef struct
+{
+  CoglCaptureRecordType type;
+  const guint8 *payload;
+  guint32 size;
+} Record;
+
+typedef struct
+{
+  /* Offsets into the array of records */
+  int first_record;
+  int n_records;
+} Frame;
+
+typedef struct
+{
+  CoglContext *ctx;
+  CoglFramebuffer *fb;
+
+  GArray *records;
+  GArray *frames;
+
+  /* Maps from texture hash to CoglTexture */
+  GHashTable *textures;
+  CoglTexture *white_texture;
+
+  /* Maps from the serialized pipeline state to a CoglPipeline so
+   * that the replay doesn't create a new pipeline for every entry */
+  GHashTable *pipelines;
+
+  int max_width;
+  int max_height;
+} ReplayState;
+
+typedef struct
+{
+  const guint8 *data;
+  gsize len;
+} PipelineKey;
+
+static void
+read_data (Reader *reader, void *data, gsize len)
+{
+  if (reader->error || (size_t) (reader->end - reader->data) < len)
+    {
+      reader->error = TRUE;
+      memset (data, 0, len);
+      return;
+    }
+
+  memcpy (data, reader->data, len);
+  reader->data += len;
+}
+
+static const guint8 *
+skip_data (Reader *reader, gsize len)
+{
+  const guint8 *ret = reader->data;
+
+  if (reader->error || (size_t) (reader->end - reader->data) < len)
+    {
+      reader->error = TRUE;
+      return NULL;
+    }
+
+  reader->data += len;
+
+  return ret;
+}
+
+static guint32
+read_uint32 (Reader *reader)
+{
+  guint32 value;
+  read_data (reader, &value, sizeof (value));
+  return value;
+}
+
+static gint32
+read_int32 (Reader *reader)
+{
+  gint32 value;
+  read_data (reader, &value, sizeof (value));
+  return value;
+}
+
+static guint64
+read_uint64 (Reader *reader)
+{
+  guint64 value;
+  read_data (reader, &value, sizeof (value));
+  return value;
+}
+
+static void
+read_matrix (Reader *reader, CoglMatrix *matrix)
+{
+  float values[16];
+
+  read_data (reader, values, sizeof (values));
+  cogl_matrix_init_from_array (matrix, values);
+}
+
+static guint
+pipeline_key_hash (gconstpointer key)
+{
+  const PipelineKey *pipeline_key = key;
+  guint hash = 2166136261u;
+  gsize i;
+
+  for (i = 0; i < pipeline_key->len; i++)
+    {
+      hash ^= pipeline_key->data[i];
+      hash *= 16777619;
+    }
+
+  return hash;
+}
+
+static gboolean
+pipeline_key_equal (gconstpointer a, gconstpointer b)
+{
+  const PipelineKey *key_a = a;
+  const PipelineKey *key_b = b;
+
+  return (key_a->len == key_b->len &&
+          memcmp (key_a->data, key_b->data, key_a->len) == 0);
+}
+
+static CoglPipeline *
+read_pipeline (ReplayState *state, Reader *reader)
+{
+  const guint8 *start = reader->data;
+  guint8 color[4];
+  guint32 flags, n_layers;
+  PipelineKey key;
+  CoglPipeline *pipeline;
+  CoglDepthState depth_state;
+  int i;
+
+  read_data (reader, color, sizeof (color));
+  flags = read_uint32 (reader);
+  n_layers = read_uint32 (reader);
+  skip_data (reader, n_layers * sizeof (guint64));
+
+  if (reader->error)
+    return NULL;
+
+  key.data = start;
+  key.len = reader->data - start;
+
+  pipeline = g_hash_table_lookup (state->pipelines, &key);
+  if (pipeline)
+    return pipeline;
+
+  pipeline = cogl_pipeline_new ();
+
+  cogl_pipeline_set_color4ub (pipeline,
+                              color[0], color[1], color[2], color[3]);
+
+  for (i = 0; i < n_layers; i++)
+    {
+      guint64 hash;
+      CoglTexture *texture;
+
+      memcpy (&hash,
+              start + sizeof (color) + sizeof (guint32) * 2 +
+              i * sizeof (guint64),
+              sizeof (hash));
+      texture = g_hash_table_lookup (state->textures, &hash);
+      if (texture == NULL)
+        texture = state->white_texture;
+
+      cogl_pipeline_set_layer_texture (pipeline, i, texture);
+    }
+
+  if (!(flags & COGL_CAPTURE_PIPELINE_FLAG_BLEND))
+    cogl_pipeline_set_blend (pipeline, "RGBA = ADD (SRC_COLOR, 0)", NULL);
+
+  cogl_depth_state_init (&depth_state);
+  cogl_depth_state_set_test_enabled (&depth_state,
+                                     !!(flags &
+                                        COGL_CAPTURE_PIPELINE_FLAG_DEPTH_TEST));
+  cogl_depth_state_set_write_enabled (&depth_state,
+                                      !!(flags &
+                                         COGL_CAPTURE_PIPELINE_FLAG_DEPTH_WRITE));
+  cogl_pipeline_set_depth_state (pipeline, &depth_state, NULL);
+
+  g_hash_table_insert (state->pipelines,
+                       g_memdup (&key, sizeof (key)),
+                       pipeline);
+
+  return pipeline;
+}
+
+static void
+read_framebuffer_state (ReplayState *state, Reader *reader)
+{
+  float viewport[4];
+  CoglMatrix projection;
+
+  /* The width and height are only needed for sizing the offscreen
+   * framebuffer */
+  skip_data (reader, sizeof (guint32) * 2);
+  read_data (reader, viewport, sizeof (viewport));
+  read_matrix (reader, &projection);
+
+  cogl_framebuffer_set_viewport (state->fb,
+                                 viewport[0], viewport[1],
+                                 viewport[2], viewport[3]);
+  cogl_framebuffer_set_projection_matrix (state->fb, &projection);
+}
+
+static gboolean
+push_clip (ReplayState *state, Reader *reader)
+{
+  guint32 has_clip = read_uint32 (reader);
+  gint32 x0 = read_int32 (reader);
+  gint32 y0 = read_int32 (reader);
+  gint32 x1 = read_int32 (reader);
+  gint32 y1 = read_int32 (reader);
+
+  if (!has_clip)
+    return FALSE;
+
+  cogl_framebuffer_push_scissor_clip (state->fb, x0, y0, x1 - x0, y1 - y0);
+
+  return TRUE;
+}
+
+/* Primitives logged in the journal are stored as a list of
+ * triangles where each vertex has a packed color, an x, y, z
+ * position and a texture coordinate for every layer */
+static void
+replay_journal_primitive (ReplayState *state,
+                          Reader *reader,
+                          CoglPipeline *pipeline,
+                          int n_layers,
+                          int n_vertices)
+{
+  int stride = (n_layers * 2 + 4) * sizeof (float);
+  gsize size = stride * n_vertices;
+  CoglAttribute **attributes;
+  CoglAttributeBuffer *buffer;
+  guint8 *data;
+  int layer;
+
+  data = g_malloc (size);
+  read_data (reader, data, size);
+  if (reader->error)
+    {
+      g_free (data);
+      return;
+    }
+
+  buffer = cogl_attribute_buffer_new (state->ctx, size, data);
+  g_free (data);
+
+  attributes = g_alloca (sizeof (CoglAttribute *) * (n_layers + 2));
+  attributes[0] = cogl_attribute_new (buffer, "cogl_color_in",
+                                      stride, 0, 4,
+                                      COGL_ATTRIBUTE_TYPE_UNSIGNED_BYTE);
+  attributes[1] = cogl_attribute_new (buffer, "cogl_position_in",
+                                      stride, sizeof (float), 3,
+                                      COGL_ATTRIBUTE_TYPE_FLOAT);
+  for (layer = 0; layer < n_layers; layer++)
+    {
+      char *name = g_strdup_printf ("cogl_tex_coord%d_in", layer);
+      attributes[layer + 2] =
+        cogl_attribute_new (buffer, name,
+                            stride, sizeof (float) * (4 + layer * 2), 2,
+                            COGL_ATTRIBUTE_TYPE_FLOAT);
+      g_free (name);
+    }
+
+  cogl_framebuffer_draw_attributes (state->fb, pipeline,
+                                    COGL_VERTICES_MODE_TRIANGLES,
+                                    0, n_vertices,
+                                    attributes, n_layers + 2);
+
+  for (layer = 0; layer < n_layers + 2; layer++)
+    cogl_object_unref (attributes[layer]);
+  cogl_object_unref (buffer);
+}
+
+static void
+replay_journal (ReplayState *state, Reader *reader)
+{
+  guint32 n_entries;
+  int i;
+
+  read_framebuffer_state (state, reader);
+  n_entries = read_uint32 (reader);
+
+  for (i = 0; i < n_entries && !reader->error; i++)
+    {
+      CoglPipeline *pipeline = read_pipeline (state, reader);
+      gboolean clipped = push_clip (state, reader);
+      CoglMatrix modelview;
+      int n_layers, n_vertices, stride, layer;
+      float *v;
+      float *tex_coords;
+
+      read_matrix (reader, &modelview);
+
+      if (pipeline == NULL)
+        break;
+
+      n_layers = cogl_pipeline_get_n_layers (pipeline);
+      n_vertices = read_uint32 (reader);
+
+      cogl_framebuffer_set_modelview_matrix (state->fb, &modelview);
+
+      if (n_vertices > 0)
+        {
+          replay_journal_primitive (state, reader, pipeline,
+                                    n_layers, n_vertices);
+          if (clipped)
+            cogl_framebuffer_pop_clip (state->fb);
+          continue;
+        }
+
+      stride = n_layers * 2 + 2;
+
+      v = g_alloca (sizeof (float) * (stride * 2 + 1));
+      read_data (reader, v, sizeof (float) * (stride * 2 + 1));
+      /* Skip the packed color */
+      v++;
+
+      tex_coords = g_alloca (sizeof (float) * n_layers * 4);
+      for (layer = 0; layer < n_layers; layer++)
+        {
+          tex_coords[layer * 4 + 0] = v[2 + layer * 2];
+          tex_coords[layer * 4 + 1] = v[2 + layer * 2 + 1];
+          tex_coords[layer * 4 + 2] = v[stride + 2 + layer * 2];
+          tex_coords[layer * 4 + 3] = v[stride + 2 + layer * 2 + 1];
+        }
+
+      cogl_set_source (pipeline);
+      cogl_rectangle_with_multitexture_coords (v[0], v[1],
+                                               v[stride], v[stride + 1],
+                                               tex_coords, n_layers * 4);
+
+      if (clipped)
+        cogl_framebuffer_pop_clip (state->fb);
+    }
+}
+
+static void
+replay_draw (ReplayState *state, Reader *reader)
+{
+  CoglPipeline *pipeline;
+  gboolean clipped;
+  CoglMatrix modelview;
+  CoglVerticesMode mode;
+  int first_vertex, n_vertices;
+  guint32 n_buffers, n_attributes;
+  CoglAttributeBuffer **buffers;
+  CoglAttribute **attributes;
+  gboolean skip = FALSE;
+  int i;
+
+  read_framebuffer_state (state, reader);
+  pipeline = read_pipeline (state, reader);
+  clipped = push_clip (state, reader);
+  read_matrix (reader, &modelview);
+
+  mode = read_uint32 (reader);
+  first_vertex = read_int32 (reader);
+  n_vertices = read_int32 (reader);
+
+  n_buffers = read_uint32 (reader);
+  buffers = g_alloca (sizeof (CoglAttributeBuffer *) * n_buffers);
+  for (i = 0; i < n_buffers; i++)
+    {
+      guint32 size = read_uint32 (reader);
+      const guint8 *data = skip_data (reader, size);
+
+      /* The buffer couldn't be read back during the capture */
+      if (size == 0 || data == NULL)
+        {
+          buffers[i] = NULL;
+          skip = TRUE;
+        }
+      else
+        buffers[i] = cogl_attribute_buffer_new (state->ctx, size, data);
+    }
+
+  n_attributes = read_uint32 (reader);
+  attributes = g_alloca (sizeof (CoglAttribute *) * n_attributes);
+  for (i = 0; i < n_attributes; i++)
+    {
+      guint32 name_len = read_uint32 (reader);
+      const char *name_data = (const char *) skip_data (reader, name_len);
+      char *name = g_strndup (name_data ? name_data : "", name_len);
+      guint32 buffer_index = read_uint32 (reader);
+      guint32 stride = read_uint32 (reader);
+      guint32 offset = read_uint32 (reader);
+      guint32 n_components = read_uint32 (reader);
+      guint32 type = read_uint32 (reader);
+      guint32 normalized = read_uint32 (reader);
+
+      if (buffer_index >= n_buffers || buffers[buffer_index] == NULL)
+        {
+          attributes[i] = NULL;
+          skip = TRUE;
+        }
+      else
+        {
+          attributes[i] = cogl_attribute_new (buffers[buffer_index],
+                                              name,
+                                              stride,
+                                              offset,
+                                              n_components,
+                                              type);
+          cogl_attribute_set_normalized (attributes[i], normalized);
+        }
+
+      g_free (name);
+    }
+
+  if (pipeline && !skip && !reader->error)
+    {
+      cogl_framebuffer_set_modelview_matrix (state->fb, &modelview);
+
+      if (read_uint32 (reader))
+        {
+          CoglIndicesType type = read_uint32 (reader);
+          guint32 size = read_uint32 (reader);
+          const guint8 *data = skip_data (reader, size);
+          int index_size = (type == COGL_INDICES_TYPE_UNSIGNED_BYTE ? 1 :
+                            type == COGL_INDICES_TYPE_UNSIGNED_SHORT ? 2 : 4);
+
+          if (size > 0 && data)
+            {
+              CoglIndices *indices = cogl_indices_new (state->ctx,
+                                                       type,
+                                                       data,
+                                                       size / index_size);
+
+              cogl_framebuffer_draw_indexed_attributes (state->fb,
+                                                        pipeline,
+                                                        mode,
+                                                        first_vertex,
+                                                        n_vertices,
+                                                        indices,
+                                                        attributes,
+                                                        n_attributes);
+              cogl_object_unref (indices);
+            }
+        }
+      else
+        cogl_framebuffer_draw_attributes (state->fb,
+                                          pipeline,
+                                          mode,
+                                          first_vertex,
+                                          n_vertices,
+                                          attributes,
+                                          n_attributes);
+    }
+
+  for (i = 0; i < n_attributes; i++)
+    if (attributes[i])
+      cogl_object_unref (attributes[i]);
+  for (i = 0; i < n_buffers; i++)
+    if (buffers[i])
+      cogl_object_unref (buffers[i]);
+
+  if (clipped)
+    cogl_framebuffer_pop_clip (state->fb);
+}
+
+static void
+load_texture (ReplayState *state, const Record *record)
+{
+  Reader reader = { record->payload, record->payload + record->size, FALSE };
+  guint64 hash = read_uint64 (&reader);
+  guint32 width = read_uint32 (&reader);
+  guint32 height = read_uint32 (&reader);
+  const guint8 *data = skip_data (&reader, width * height * 4);
+  CoglTexture *texture;
+
+  if (data == NULL || width == 0 || height == 0)
+    return;
+
+  texture = COGL_TEXTURE (cogl_texture_2d_new_from_data (state->ctx,
+                                                         width, height,
+                                                         COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                         COGL_PIXEL_FORMAT_ANY,
+                                                         width * 4,
+                                                         data,
+                                                         NULL));
+  if (texture)
+    g_hash_table_insert (state->textures,
+                         g_memdup (&hash, sizeof (hash)),
+                         texture);
+}
+
+static gboolean
+load_capture (ReplayState *state, const guint8 *data, gsize len)
+{
+  Reader reader = { data, data + len, FALSE };
+  char magic[COGL_CAPTURE_MAGIC_SIZE];
+  Frame frame;
+
+  read_data (&reader, magic, sizeof (magic));
+  if (reader.error || memcmp (magic, COGL_CAPTURE_MAGIC, sizeof (magic)))
+    {
+      fprintf (stderr, "Not a Cogl capture file\n");
+      return FALSE;
+    }
+
+  if (read_uint32 (&reader) != COGL_CAPTURE_VERSION)
+    {
+      fprintf (stderr, "Unsupported capture version\n");
+      return FALSE;
+    }
+
+  frame.first_record = 0;
+  frame.n_records = 0;
+
+  while (reader.data < reader.end)
+    {
+      Record record;
+      Reader payload;
+
+      record.type = read_uint32 (&reader);
+      record.size = read_uint32 (&reader);
+      record.payload = skip_data (&reader, record.size);
+
+      if (reader.error)
+        {
+          fprintf (stderr, "Capture file is truncated\n");
+          break;
+        }
+
+      switch (record.type)
+        {
+        case COGL_CAPTURE_RECORD_FRAME:
+          g_array_append_val (state->frames, frame);
+          frame.first_record = state->records->len;
+          frame.n_records = 0;
+          break;
+
+        case COGL_CAPTURE_RECORD_TEXTURE:
+          /* Textures are all created up front so that their upload
+           * isn't included in the frame timings */
+          load_texture (state, &record);
+          break;
+
+        case COGL_CAPTURE_RECORD_JOURNAL:
+        case COGL_CAPTURE_RECORD_DRAW:
+          payload.data = record.payload;
+          payload.end = record.payload + record.size;
+          payload.error = FALSE;
+          state->max_width = MAX (state->max_width, read_uint32 (&payload));
+          state->max_height = MAX (state->max_height, read_uint32 (&payload));
+
+          g_array_append_val (state->records, record);
+          frame.n_records++;
+          break;
+
+        default:
+          /* Skip unknown records */
+          break;
+        }
+    }
+
+  /* Applications that only render offscreen never swap so everything
+   * after the last swap is treated as one more frame */
+  if (frame.n_records)
+    g_array_append_val (state->frames, frame);
+
+  return TRUE;
+}
+
+static void
+replay_frame (ReplayState *state, const Frame *frame)
+{
+  int i;
+
+  cogl_framebuffer_clear4f (state->fb,
+                            COGL_BUFFER_BIT_COLOR | COGL_BUFFER_BIT_DEPTH,
+                            0, 0, 0, 1);
+
+  for (i = 0; i < frame->n_records; i++)
+    {
+      const Record *record =
+        &g_array_index (state->records, Record,
+                        frame->first_record + i);
+      Reader reader = { record->payload,
+                        record->payload + record->size,
+                        FALSE };
+
+      if (record->type == COGL_CAPTURE_RECORD_JOURNAL)
+        replay_journal (state, &reader);
+      else
+        replay_draw (state, &reader);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  ReplayState state;
+  CoglTexture2D *fb_texture;
+  GError *error = NULL;
+  char *contents;
+  gsize len;
+  guint8 white[4] = { 0xff, 0xff, 0xff, 0xff };
+  int n_repeats = 1;
+  const char *filename;
+  double total_cpu = 0, total_gpu = 0;
+  double min_cpu = G_MAXDOUBLE, max_cpu = 0;
+  int n_frames = 0;
+  int repeat, i;
+
+  if (argc == 4 && strcmp (argv[1], "-n") == 0)
+    {
+      n_repeats = MAX (atoi (argv[2]), 1);
+      filename = argv[3];
+    }
+  else if (argc == 2)
+    filename = argv[1];
+  else
+    {
+      fprintf (stderr, "usage: %s [-n REPEATS] FILE\n", argv[0]);
+      return 1;
+    }
+
+  if (!g_file_get_contents (filename, &contents, &len, &error))
+    {
+      fprintf (stderr, "Failed to read capture: %s\n", error->message);
+      return 1;
+    }
+
+  memset (&state, 0, sizeof (state));
+
+  state.ctx = cogl_context_new (NULL, &error);
+  if (!state.ctx)
+    {
+      fprintf (stderr, "Failed to create context: %s\n", error->message);
+      return 1;
+    }
+
+  state.records = g_array_new (FALSE, FALSE, sizeof (Record));
+  state.frames = g_array_new (FALSE, FALSE, sizeof (Frame));
+  state.textures = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                          g_free, cogl_object_unref);
+  state.pipelines = g_hash_table_new_full (pipeline_key_hash,
+                                           pipeline_key_equal,
+                                           g_free, cogl_object_unref);
+  state.white_texture =
+    COGL_TEXTURE (cogl_texture_2d_new_from_data (state.ctx,
+                                                 1, 1,
+                                                 COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                 COGL_PIXEL_FORMAT_ANY,
+                                                 4,
+                                                 white,
+                                                 NULL));
+
+  if (!load_capture (&state, (const guint8 *) contents, len))
+    return 1;
+
+  if (state.frames->len == 0)
+    {
+      fprintf (stderr, "The capture doesn't contain any rendering\n");
+      return 1;
+    }
+
+  fb_texture = cogl_texture_2d_new_with_size (state.ctx,
+                                              MAX (state.max_width, 1),
+                                              MAX (state.max_height, 1),
+                                              COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                              &error);
+  if (!fb_texture)
+    {
+      fprintf (stderr, "Failed to create framebuffer texture: %s\n",
+               error->message);
+      return 1;
+    }
+
+  state.fb = COGL_FRAMEBUFFER (cogl_offscreen_new_to_texture (fb_texture));
+  if (!cogl_framebuffer_allocate (state.fb, &error))
+    {
+      fprintf (stderr, "Failed to allocate framebuffer: %s\n", error->message);
+      return 1;
+    }
+
+  cogl_push_framebuffer (state.fb);
+
+  printf ("frame\tcpu (ms)\ttotal (ms)\n");
+
+  for (repeat = 0; repeat < n_repeats; repeat++)
+    for (i = 0; i < state.frames->len; i++)
+      {
+        gint64 start, cpu_end, gpu_end;
+        double cpu_ms, gpu_ms;
+
+        start = g_get_monotonic_time ();
+
+        replay_frame (&state, &g_array_index (state.frames, Frame, i));
+        cogl_flush ();
+
+        cpu_end = g_get_monotonic_time ();
+
+        cogl_framebuffer_finish (state.fb);
+
+        gpu_end = g_get_monotonic_time ();
+
+        cpu_ms = (cpu_end - start) / 1000.0;
+        gpu_ms = (gpu_end - start) / 1000.0;
+
+        printf ("%d\t%.3f\t%.3f\n", i, cpu_ms, gpu_ms);
+
+        total_cpu += cpu_ms;
+        total_gpu += gpu_ms;
+        min_cpu = MIN (min_cpu, cpu_ms);
+        max_cpu = MAX (max_cpu, cpu_ms);
+        n_frames++;
+      }
+
+  printf ("\n%d frames: cpu min %.3f avg %.3f max %.3f ms, "
+          "total avg %.3f ms\n",
+          n_frames, min_cpu, total_cpu / n_frames, max_cpu,
+          total_gpu / n_frames);
+
+  cogl_pop_framebuffer ();
+
+  g_hash_table_destroy (state.pipelines);
+  g_hash_table_destroy (state.textures);
+  cogl_object_unref (state.white_texture);
+  cogl_object_unref (state.fb);
+  cogl_object_unref (fb_texture);
+  g_array_free (state.records, TRUE);
+  g_array_free (state.frames, TRUE);
+  cogl_object_unref (state.ctx);
+  g_free (contents);
+
+  return 0;
+}
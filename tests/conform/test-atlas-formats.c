@@ -0,0 +1,88 @@
+#include <cogl/cogl.h>
+
+#include <string.h>
+
+#include "test-utils.h"
+
+#define TEX_SIZE 8
+
+static CoglHandle
+create_texture (CoglPixelFormat format, int bpp, guint8 value)
+{
+  guint8 data[TEX_SIZE * TEX_SIZE * 4];
+
+  memset (data, value, sizeof (data));
+
+  return cogl_texture_new_from_data (TEX_SIZE, TEX_SIZE,
+                                     COGL_TEXTURE_NONE,
+                                     format, /* format */
+                                     format, /* internal format */
+                                     TEX_SIZE * bpp, /* rowstride */
+                                     data);
+}
+
+static GLuint
+get_gl_texture (CoglHandle texture)
+{
+  GLuint gl_handle;
+
+  cogl_texture_get_gl_texture (texture, &gl_handle, NULL);
+
+  return gl_handle;
+}
+
+static void
+verify_texture (CoglHandle texture,
+                CoglPixelFormat format,
+                int bpp,
+                guint8 value)
+{
+  guint8 data[TEX_SIZE * TEX_SIZE * 4];
+  int i;
+
+  g_assert_cmpint (cogl_texture_get_format (texture), ==, format);
+
+  cogl_texture_get_data (texture, format, TEX_SIZE * bpp, data);
+
+  for (i = 0; i < TEX_SIZE * TEX_SIZE * bpp; i++)
+    g_assert_cmpint (data[i], ==, value);
+}
+
+void
+test_cogl_atlas_formats (TestUtilsGTestFixture *fixture,
+                         void *data)
+{
+  TestUtilsSharedState *shared_state = data;
+  CoglHandle alpha_a, alpha_b, rgb, rgba;
+
+  alpha_a = create_texture (COGL_PIXEL_FORMAT_A_8, 1, 0x40);
+  alpha_b = create_texture (COGL_PIXEL_FORMAT_A_8, 1, 0x80);
+  rgb = create_texture (COGL_PIXEL_FORMAT_RGB_888, 3, 0xc0);
+  rgba = create_texture (COGL_PIXEL_FORMAT_RGBA_8888_PRE, 4, 0xff);
+
+  /* The textures should all keep their own format and data regardless
+     of which atlas they were put in */
+  verify_texture (alpha_a, COGL_PIXEL_FORMAT_A_8, 1, 0x40);
+  verify_texture (alpha_b, COGL_PIXEL_FORMAT_A_8, 1, 0x80);
+  verify_texture (rgb, COGL_PIXEL_FORMAT_RGB_888, 3, 0xc0);
+  verify_texture (rgba, COGL_PIXEL_FORMAT_RGBA_8888_PRE, 4, 0xff);
+
+  /* The atlas is only used if FBOs are available */
+  if (cogl_has_feature (shared_state->ctx, COGL_FEATURE_ID_OFFSCREEN))
+    {
+      /* Alpha-only textures should share an atlas with each other
+         but not with the textures of other formats */
+      g_assert_cmpint (get_gl_texture (alpha_a), ==, get_gl_texture (alpha_b));
+      g_assert_cmpint (get_gl_texture (alpha_a), !=, get_gl_texture (rgb));
+      g_assert_cmpint (get_gl_texture (alpha_a), !=, get_gl_texture (rgba));
+      g_assert_cmpint (get_gl_texture (rgb), !=, get_gl_texture (rgba));
+    }
+
+  cogl_object_unref (alpha_a);
+  cogl_object_unref (alpha_b);
+  cogl_object_unref (rgb);
+  cogl_object_unref (rgba);
+
+  if (g_test_verbose ())
+    g_print ("OK\n");
+}
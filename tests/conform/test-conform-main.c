@@ -169,6 +169,12 @@ main (int argc, char **argv)
 
   ADD_TEST ("/cogl", test_cogl_offscreen);
 
+  ADD_TEST ("/cogl/journal", test_cogl_journal_stats);
+  ADD_TEST ("/cogl", test_cogl_read_pixels_async);
+  ADD_TEST ("/cogl", test_cogl_memory_usage);
+  ADD_TEST ("/cogl", test_cogl_tiled_texture);
+  ADD_TEST ("/cogl", test_cogl_atlas_formats);
+
   /* left to the end because they aren't currently very orthogonal and tend to
    * break subsequent tests! */
   UNPORTED_TEST ("/cogl", test_cogl_viewport);
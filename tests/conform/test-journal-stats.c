@@ -0,0 +1,257 @@
+#include <cogl/cogl.h>
+
+#include <string.h>
+
+#include "test-utils.h"
+
+typedef struct _TestState
+{
+  CoglContext *context;
+  CoglFramebuffer *fb;
+} TestState;
+
+static void
+draw_rectangles (CoglPipeline *pipeline, int n_rectangles, int *offset)
+{
+  int i;
+
+  cogl_push_source (pipeline);
+
+  for (i = 0; i < n_rectangles; i++)
+    {
+      cogl_rectangle (*offset, 0, *offset + 10, 10);
+      *offset += 10;
+    }
+
+  cogl_pop_source ();
+}
+
+static void
+test_same_pipeline (TestState *state, CoglPipeline *plain)
+{
+  CoglJournalStats stats;
+  int offset = 0;
+
+  cogl_framebuffer_reset_journal_stats (state->fb);
+
+  draw_rectangles (plain, 4, &offset);
+
+  /* Nothing should be counted until the journal is flushed */
+  cogl_framebuffer_get_journal_stats (state->fb, &stats);
+  g_assert_cmpint (stats.n_flushes, ==, 0);
+  g_assert_cmpint (stats.n_entries, ==, 0);
+
+  cogl_framebuffer_finish (state->fb);
+
+  cogl_framebuffer_get_journal_stats (state->fb, &stats);
+  g_assert_cmpint (stats.n_flushes, ==, 1);
+  g_assert_cmpint (stats.n_entries, ==, 4);
+  g_assert_cmpint (stats.n_batches, ==, 1);
+  g_assert_cmpint (stats.n_clip_breaks, ==, 0);
+  g_assert_cmpint (stats.n_stride_breaks, ==, 0);
+  g_assert_cmpint (stats.n_layer_breaks, ==, 0);
+  g_assert_cmpint (stats.n_pipeline_breaks, ==, 0);
+  g_assert (stats.n_bytes_uploaded > 0);
+}
+
+static void
+test_breaks (TestState *state, CoglPipeline *plain)
+{
+  CoglJournalStats stats, last_stats;
+  CoglPipeline *textured, *blended;
+  CoglHandle tex;
+  guint8 tex_data[4] = { 0xff, 0xff, 0xff, 0xff };
+  int offset = 0;
+
+  tex = cogl_texture_new_from_data (1, 1, /* size */
+                                    COGL_TEXTURE_NO_ATLAS,
+                                    COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                    COGL_PIXEL_FORMAT_ANY,
+                                    4, /* rowstride */
+                                    tex_data);
+  textured = cogl_pipeline_copy (plain);
+  cogl_pipeline_set_layer_texture (textured, 0, tex);
+  cogl_handle_unref (tex);
+
+  blended = cogl_pipeline_copy (plain);
+  cogl_pipeline_set_blend (blended, "RGBA = ADD (SRC_COLOR, 0)", NULL);
+
+  cogl_framebuffer_reset_journal_stats (state->fb);
+
+  /* plain -> textured changes the number of layers and textured ->
+   * plain changes it back. plain -> blended changes the pipeline */
+  draw_rectangles (plain, 2, &offset);
+  draw_rectangles (textured, 2, &offset);
+  draw_rectangles (plain, 2, &offset);
+  draw_rectangles (blended, 2, &offset);
+
+  cogl_framebuffer_finish (state->fb);
+
+  cogl_framebuffer_get_journal_stats (state->fb, &stats);
+  cogl_framebuffer_get_last_journal_flush_stats (state->fb, &last_stats);
+
+  g_assert_cmpint (stats.n_flushes, ==, 1);
+  g_assert_cmpint (stats.n_entries, ==, 8);
+  g_assert_cmpint (stats.n_layer_breaks, ==, 2);
+  g_assert_cmpint (stats.n_pipeline_breaks, ==, 1);
+  g_assert_cmpint (stats.n_batches, ==, 4);
+
+  g_assert_cmpint (last_stats.n_entries, ==, stats.n_entries);
+  g_assert_cmpint (last_stats.n_batches, ==, stats.n_batches);
+
+  /* A second flush should accumulate in the totals but the last
+   * flush stats should only describe the new flush */
+  draw_rectangles (plain, 1, &offset);
+  cogl_framebuffer_finish (state->fb);
+
+  cogl_framebuffer_get_journal_stats (state->fb, &stats);
+  cogl_framebuffer_get_last_journal_flush_stats (state->fb, &last_stats);
+
+  g_assert_cmpint (stats.n_flushes, ==, 2);
+  g_assert_cmpint (stats.n_entries, ==, 9);
+  g_assert_cmpint (last_stats.n_flushes, ==, 1);
+  g_assert_cmpint (last_stats.n_entries, ==, 1);
+  g_assert_cmpint (last_stats.n_batches, ==, 1);
+
+  cogl_object_unref (textured);
+  cogl_object_unref (blended);
+}
+
+static void
+test_primitives (TestState *state, CoglPipeline *plain)
+{
+  CoglJournalStats stats;
+  CoglVertexP2 verts[] = { { 0, 20 }, { 10, 30 }, { 20, 20 } };
+  CoglPrimitive *primitive;
+  int offset = 0;
+
+  primitive = cogl_primitive_new_p2 (state->context,
+                                     COGL_VERTICES_MODE_TRIANGLES,
+                                     G_N_ELEMENTS (verts),
+                                     verts);
+
+  cogl_framebuffer_reset_journal_stats (state->fb);
+
+  /* A small primitive using the same pipeline should be logged into
+   * the journal from the copy the buffer keeps of its data and
+   * batched together with the rectangles */
+  draw_rectangles (plain, 2, &offset);
+  cogl_framebuffer_draw_primitive (state->fb, plain, primitive);
+  draw_rectangles (plain, 2, &offset);
+
+  cogl_framebuffer_finish (state->fb);
+
+  cogl_framebuffer_get_journal_stats (state->fb, &stats);
+  g_assert_cmpint (stats.n_flushes, ==, 1);
+  g_assert_cmpint (stats.n_entries, ==, 5);
+  g_assert_cmpint (stats.n_batches, ==, 1);
+
+  cogl_object_unref (primitive);
+}
+
+static CoglPipeline *
+make_deep_copy (CoglPipeline *parent, int depth)
+{
+  CoglPipeline *pipeline = cogl_object_ref (parent);
+  int i;
+
+  /* Each copy overrides a state group that doesn't affect batching
+   * so that the ancestry doesn't get pruned */
+  for (i = 0; i < depth; i++)
+    {
+      CoglPipeline *copy = cogl_pipeline_copy (pipeline);
+      cogl_pipeline_set_color4ub (copy, i, 0x00, 0x00, 0xff);
+      cogl_object_unref (pipeline);
+      pipeline = copy;
+    }
+
+  return pipeline;
+}
+
+static void
+test_deep_ancestry (TestState *state, CoglPipeline *plain)
+{
+  CoglJournalStats stats;
+  CoglPipeline *parent, *a, *b;
+  int offset = 0;
+
+  parent = cogl_pipeline_copy (plain);
+  cogl_pipeline_set_point_size (parent, 4.0f);
+
+  a = make_deep_copy (parent, 16);
+  b = make_deep_copy (parent, 16);
+
+  /* Two different pipelines with the same state should batch
+   * together however deep their ancestry is */
+  cogl_framebuffer_reset_journal_stats (state->fb);
+  draw_rectangles (a, 2, &offset);
+  draw_rectangles (b, 2, &offset);
+  cogl_framebuffer_finish (state->fb);
+
+  cogl_framebuffer_get_journal_stats (state->fb, &stats);
+  g_assert_cmpint (stats.n_batches, ==, 1);
+  g_assert_cmpint (stats.n_pipeline_breaks, ==, 0);
+
+  /* Modifying a pipeline must not leave a stale cached comparison */
+  cogl_pipeline_set_point_size (b, 8.0f);
+
+  cogl_framebuffer_reset_journal_stats (state->fb);
+  draw_rectangles (a, 2, &offset);
+  draw_rectangles (b, 2, &offset);
+  cogl_framebuffer_finish (state->fb);
+
+  cogl_framebuffer_get_journal_stats (state->fb, &stats);
+  g_assert_cmpint (stats.n_batches, ==, 2);
+  g_assert_cmpint (stats.n_pipeline_breaks, ==, 1);
+
+  /* Modifying the shared ancestor makes a copy-on-write so a should
+   * keep its old state and no longer match the ancestor */
+  cogl_pipeline_set_point_size (parent, 8.0f);
+
+  cogl_framebuffer_reset_journal_stats (state->fb);
+  draw_rectangles (a, 2, &offset);
+  draw_rectangles (parent, 2, &offset);
+  draw_rectangles (b, 2, &offset);
+  cogl_framebuffer_finish (state->fb);
+
+  cogl_framebuffer_get_journal_stats (state->fb, &stats);
+  g_assert_cmpint (stats.n_batches, ==, 2);
+  g_assert_cmpint (stats.n_pipeline_breaks, ==, 1);
+
+  cogl_object_unref (a);
+  cogl_object_unref (b);
+  cogl_object_unref (parent);
+}
+
+void
+test_cogl_journal_stats (TestUtilsGTestFixture *fixture,
+                         void *data)
+{
+  TestUtilsSharedState *shared_state = data;
+  TestState state;
+  CoglPipeline *plain;
+
+  state.context = shared_state->ctx;
+  state.fb = shared_state->fb;
+
+  cogl_ortho (0, cogl_framebuffer_get_width (state.fb), /* left, right */
+              cogl_framebuffer_get_height (state.fb), 0, /* bottom, top */
+              -1, 100 /* z near, far */);
+
+  /* Make sure nothing is left over in the journal from the initial
+   * clear */
+  cogl_framebuffer_finish (state.fb);
+
+  plain = cogl_pipeline_new ();
+  cogl_pipeline_set_color4ub (plain, 0xff, 0x00, 0x00, 0xff);
+
+  test_same_pipeline (&state, plain);
+  test_breaks (&state, plain);
+  test_primitives (&state, plain);
+  test_deep_ancestry (&state, plain);
+
+  cogl_object_unref (plain);
+
+  if (g_test_verbose ())
+    g_print ("OK\n");
+}
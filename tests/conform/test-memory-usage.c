@@ -0,0 +1,104 @@
+#include <cogl/cogl.h>
+
+#include "test-utils.h"
+
+#define TEX_SIZE 64
+
+static void
+low_memory_cb (CoglContext *context,
+               gsize usage,
+               gsize budget,
+               void *user_data)
+{
+  int *n_callbacks = user_data;
+
+  g_assert_cmpuint (usage, >, budget);
+
+  (*n_callbacks)++;
+}
+
+static void
+dispatch (CoglContext *context)
+{
+  CoglPollFD *poll_fds;
+  int n_poll_fds;
+  gint64 timeout;
+
+  cogl_poll_get_info (context, &poll_fds, &n_poll_fds, &timeout);
+  cogl_poll_dispatch (context, poll_fds, 0);
+}
+
+void
+test_cogl_memory_usage (TestUtilsGTestFixture *fixture,
+                        void *data)
+{
+  TestUtilsSharedState *shared_state = data;
+  CoglContext *context = shared_state->ctx;
+  gsize base_usage, base_total;
+  CoglTexture2D *tex;
+  CoglPollFD *poll_fds;
+  int n_poll_fds;
+  gint64 timeout;
+  int n_callbacks = 0;
+  unsigned int id;
+
+  base_usage = cogl_context_get_memory_usage (context,
+                                              COGL_MEMORY_TYPE_TEXTURE_2D);
+  base_total = cogl_context_get_total_memory_usage (context);
+
+  tex = cogl_texture_2d_new_with_size (context,
+                                       TEX_SIZE, TEX_SIZE,
+                                       COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                       NULL);
+  g_assert (tex != NULL);
+
+  g_assert_cmpuint (cogl_context_get_memory_usage (context,
+                                                   COGL_MEMORY_TYPE_TEXTURE_2D),
+                    ==,
+                    base_usage + TEX_SIZE * TEX_SIZE * 4);
+  g_assert_cmpuint (cogl_context_get_total_memory_usage (context),
+                    ==,
+                    base_total + TEX_SIZE * TEX_SIZE * 4);
+
+  id = cogl_context_add_low_memory_callback (context,
+                                             low_memory_cb,
+                                             &n_callbacks);
+
+  /* Setting a budget that is already exceeded should queue the
+     callbacks but they must not be invoked until the application
+     dispatches */
+  cogl_context_set_memory_budget (context,
+                                  cogl_context_get_total_memory_usage
+                                  (context) - 1);
+  g_assert_cmpint (n_callbacks, ==, 0);
+
+  cogl_poll_get_info (context, &poll_fds, &n_poll_fds, &timeout);
+  g_assert_cmpint (timeout, ==, 0);
+
+  dispatch (context);
+  g_assert_cmpint (n_callbacks, ==, 1);
+
+  /* The callbacks shouldn't be invoked again until the usage drops
+     back within the budget */
+  dispatch (context);
+  g_assert_cmpint (n_callbacks, ==, 1);
+
+  cogl_object_unref (tex);
+
+  g_assert_cmpuint (cogl_context_get_memory_usage (context,
+                                                   COGL_MEMORY_TYPE_TEXTURE_2D),
+                    ==,
+                    base_usage);
+  g_assert_cmpuint (cogl_context_get_total_memory_usage (context),
+                    ==,
+                    base_total);
+
+  dispatch (context);
+  g_assert_cmpint (n_callbacks, ==, 1);
+
+  cogl_context_remove_low_memory_callback (context, id);
+  cogl_context_set_memory_budget (context, 0);
+
+  if (g_test_verbose ())
+    g_print ("OK\n");
+}
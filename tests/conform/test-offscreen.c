@@ -180,6 +180,107 @@ test_flush (TestState *state)
     }
 }
 
+static void
+draw_direct_rectangle (CoglFramebuffer *framebuffer,
+                       CoglPipeline *pipeline,
+                       float x_1,
+                       float y_1,
+                       float x_2,
+                       float y_2)
+{
+  CoglVertexP2 quad[6] =
+    { { x_1, y_1 }, { x_2, y_1 }, { x_2, y_2 },
+      { x_1, y_1 }, { x_2, y_2 }, { x_1, y_2 } };
+  CoglVertexP2 verts[G_N_ELEMENTS (quad) * 12];
+  CoglContext *context = cogl_framebuffer_get_context (framebuffer);
+  CoglPrimitive *primitive;
+  int i;
+
+  /* Primitives with more vertices than the journal will log are
+     drawn straight away so the quad is repeated to get over the
+     limit */
+  for (i = 0; i < G_N_ELEMENTS (verts); i++)
+    verts[i] = quad[i % G_N_ELEMENTS (quad)];
+
+  primitive = cogl_primitive_new_p2 (context,
+                                     COGL_VERTICES_MODE_TRIANGLES,
+                                     G_N_ELEMENTS (verts), verts);
+  cogl_framebuffer_draw_primitive (framebuffer, pipeline, primitive);
+  cogl_object_unref (primitive);
+}
+
+static void
+test_journal_modelview (TestState *state)
+{
+  CoglTexture2D *tex_a, *tex_b;
+  CoglHandle offscreen_a, offscreen_b;
+  CoglFramebuffer *fb_a, *fb_b;
+  CoglPipeline *pipeline;
+  CoglColor clear_color;
+  guint8 data[16 * 4 * 16];
+  int x, y;
+
+  /* This tests that alternating journaled and direct drawing on two
+     framebuffers doesn't leave one of them drawing with the other's
+     modelview matrix */
+
+  tex_a = cogl_texture_2d_new_with_size (state->context,
+                                         16, 16, /* width/height */
+                                         COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                         NULL);
+  tex_b = cogl_texture_2d_new_with_size (state->context,
+                                         16, 16, /* width/height */
+                                         COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                         NULL);
+  offscreen_a = cogl_offscreen_new_to_texture (COGL_TEXTURE (tex_a));
+  offscreen_b = cogl_offscreen_new_to_texture (COGL_TEXTURE (tex_b));
+  fb_a = COGL_FRAMEBUFFER (offscreen_a);
+  fb_b = COGL_FRAMEBUFFER (offscreen_b);
+
+  cogl_color_init_from_4ub (&clear_color, 0, 0, 0, 255);
+  cogl_framebuffer_clear (fb_a, COGL_BUFFER_BIT_COLOR, &clear_color);
+  cogl_framebuffer_clear (fb_b, COGL_BUFFER_BIT_COLOR, &clear_color);
+
+  /* Anything drawn on B with its own modelview ends up outside of
+     the framebuffer */
+  cogl_framebuffer_translate (fb_b, 100, 0, 0);
+
+  pipeline = cogl_pipeline_new ();
+
+  /* Direct draw on the left half of A */
+  cogl_pipeline_set_color4ub (pipeline, 0x00, 0xff, 0x00, 0xff);
+  draw_direct_rectangle (fb_a, pipeline, -1, -1, 0, 1);
+
+  /* Journaled draw on B which is then flushed */
+  cogl_push_framebuffer (fb_b);
+  cogl_set_source_color4ub (0xff, 0x00, 0x00, 0xff);
+  cogl_rectangle (-1, -1, 1, 1);
+  cogl_pop_framebuffer ();
+  cogl_flush ();
+
+  /* Direct draw on the right half of A. This must still use A's
+     identity modelview */
+  cogl_pipeline_set_color4ub (pipeline, 0x00, 0x00, 0xff, 0xff);
+  draw_direct_rectangle (fb_a, pipeline, 0, -1, 1, 1);
+
+  cogl_texture_get_data (COGL_TEXTURE (tex_a),
+                         COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                         16 * 4, /* rowstride */
+                         data);
+
+  for (y = 1; y < 15; y++)
+    for (x = 1; x < 15; x++)
+      if (x != 7 && x != 8)
+        test_utils_compare_pixel (data + x * 4 + y * 16 * 4,
+                                  x < 8 ? 0x00ff00ff : 0x0000ffff);
+
+  cogl_object_unref (pipeline);
+  cogl_handle_unref (offscreen_a);
+  cogl_handle_unref (offscreen_b);
+  cogl_object_unref (tex_a);
+  cogl_object_unref (tex_b);
+}
+
 void
 test_cogl_offscreen (TestUtilsGTestFixture *fixture,
                      void *data)
@@ -193,6 +294,7 @@ test_cogl_offscreen (TestUtilsGTestFixture *fixture,
 
   test_paint (&state);
   test_flush (&state);
+  test_journal_modelview (&state);
 
   if (g_test_verbose ())
     g_print ("OK\n");
@@ -0,0 +1,138 @@
+#include <cogl/cogl.h>
+
+#include <string.h>
+
+#include "test-utils.h"
+
+#define RECT_SIZE 16
+
+typedef struct _TestState
+{
+  CoglContext *context;
+  CoglFramebuffer *fb;
+  /* Records the order that the callbacks were invoked in */
+  int n_callbacks;
+  int order[2];
+} TestState;
+
+typedef struct _ReadbackClosure
+{
+  TestState *state;
+  int id;
+  gboolean success;
+} ReadbackClosure;
+
+static void
+readback_cb (gboolean success, void *user_data)
+{
+  ReadbackClosure *closure = user_data;
+  TestState *state = closure->state;
+
+  g_assert_cmpint (state->n_callbacks, <, G_N_ELEMENTS (state->order));
+
+  closure->success = success;
+  state->order[state->n_callbacks++] = closure->id;
+}
+
+static void
+wait_for_callbacks (TestState *state, int n_callbacks)
+{
+  while (state->n_callbacks < n_callbacks)
+    {
+      CoglPollFD *poll_fds;
+      int n_poll_fds;
+      gint64 timeout;
+
+      cogl_poll_get_info (state->context, &poll_fds, &n_poll_fds, &timeout);
+
+      /* Something must be pending otherwise this would never finish */
+      g_assert (timeout != -1);
+
+      if (timeout > 0)
+        g_usleep (timeout);
+
+      cogl_poll_dispatch (state->context, poll_fds, 0);
+    }
+}
+
+static void
+check_rect (const guint8 *pixels, int rowstride, guint32 expected)
+{
+  int x, y;
+
+  for (y = 0; y < RECT_SIZE; y++)
+    for (x = 0; x < RECT_SIZE; x++)
+      test_utils_compare_pixel (pixels + y * rowstride + x * 4, expected);
+}
+
+void
+test_cogl_read_pixels_async (TestUtilsGTestFixture *fixture,
+                             void *data)
+{
+  TestUtilsSharedState *shared_state = data;
+  TestState state;
+  ReadbackClosure red_closure, green_closure;
+  /* Use a rowstride bigger than the rectangle to check that it is
+     respected */
+  int rowstride = RECT_SIZE * 4 + 8;
+  guint8 *red_pixels = g_malloc0 (rowstride * RECT_SIZE);
+  guint8 *green_pixels = g_malloc0 (rowstride * RECT_SIZE);
+
+  state.context = shared_state->ctx;
+  state.fb = shared_state->fb;
+  state.n_callbacks = 0;
+
+  cogl_ortho (0, cogl_framebuffer_get_width (state.fb), /* left, right */
+              cogl_framebuffer_get_height (state.fb), 0, /* bottom, top */
+              -1, 100 /* z near, far */);
+
+  cogl_set_source_color4ub (0xff, 0x00, 0x00, 0xff);
+  cogl_rectangle (0, 0, RECT_SIZE, RECT_SIZE);
+  cogl_set_source_color4ub (0x00, 0xff, 0x00, 0xff);
+  cogl_rectangle (RECT_SIZE, 0, RECT_SIZE * 2, RECT_SIZE);
+
+  red_closure.state = &state;
+  red_closure.id = 0;
+  red_closure.success = FALSE;
+  cogl_framebuffer_read_pixels_async (state.fb,
+                                      0, 0, RECT_SIZE, RECT_SIZE,
+                                      COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                      rowstride,
+                                      red_pixels,
+                                      readback_cb,
+                                      &red_closure);
+
+  green_closure.state = &state;
+  green_closure.id = 1;
+  green_closure.success = FALSE;
+  cogl_framebuffer_read_pixels_async (state.fb,
+                                      RECT_SIZE, 0, RECT_SIZE, RECT_SIZE,
+                                      COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                      rowstride,
+                                      green_pixels,
+                                      readback_cb,
+                                      &green_closure);
+
+  /* The callbacks must never be invoked before the application
+     dispatches */
+  g_assert_cmpint (state.n_callbacks, ==, 0);
+
+  wait_for_callbacks (&state, 2);
+
+  /* The callbacks should be invoked in the order the reads were
+     started */
+  g_assert_cmpint (state.order[0], ==, 0);
+  g_assert_cmpint (state.order[1], ==, 1);
+
+  g_assert (red_closure.success);
+  g_assert (green_closure.success);
+
+  check_rect (red_pixels, rowstride, 0xff0000ff);
+  check_rect (green_pixels, rowstride, 0x00ff00ff);
+
+  g_free (red_pixels);
+  g_free (green_pixels);
+
+  if (g_test_verbose ())
+    g_print ("OK\n");
+}
@@ -0,0 +1,224 @@
+#include <cogl/cogl.h>
+
+#include <string.h>
+
+#include "test-utils.h"
+
+#define TILE_SIZE 16
+#define N_TILES_X 4
+#define N_TILES_Y 2
+#define MAX_TILES 4
+
+typedef struct _TestState
+{
+  CoglContext *context;
+  CoglTiledTexture *tex;
+  /* Incremented from the loading threads */
+  volatile int n_source_calls;
+  int n_load_callbacks;
+} TestState;
+
+static guint32
+get_tile_color (int tile_x, int tile_y)
+{
+  return (((0x10 + tile_x * 0x40) << 24) |
+          ((0x10 + tile_y * 0x80) << 16) |
+          0xff00 |
+          0xff);
+}
+
+static gboolean
+tile_source_cb (int x,
+                int y,
+                int width,
+                int height,
+                CoglPixelFormat format,
+                int rowstride,
+                guint8 *data,
+                void *user_data)
+{
+  TestState *state = user_data;
+  guint32 color = get_tile_color (x / TILE_SIZE, y / TILE_SIZE);
+  int px, py;
+
+  g_assert_cmpint (format, ==, COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+  g_assert_cmpint (width, ==, TILE_SIZE);
+  g_assert_cmpint (height, ==, TILE_SIZE);
+
+  for (py = 0; py < height; py++)
+    for (px = 0; px < width; px++)
+      {
+        guint8 *p = data + py * rowstride + px * 4;
+
+        p[0] = color >> 24;
+        p[1] = color >> 16;
+        p[2] = color >> 8;
+        p[3] = color;
+      }
+
+  g_atomic_int_inc (&state->n_source_calls);
+
+  return TRUE;
+}
+
+static void
+load_cb (CoglTiledTexture *tex,
+         int x,
+         int y,
+         int width,
+         int height,
+         void *user_data)
+{
+  TestState *state = user_data;
+
+  g_assert (tex == state->tex);
+
+  state->n_load_callbacks++;
+}
+
+static void
+wait_for_tiles (TestState *state)
+{
+  while (cogl_tiled_texture_get_n_pending_tiles (state->tex) > 0)
+    {
+      CoglPollFD *poll_fds;
+      int n_poll_fds;
+      gint64 timeout;
+
+      cogl_poll_get_info (state->context, &poll_fds, &n_poll_fds, &timeout);
+
+      /* Something must be pending otherwise this would never finish */
+      g_assert (timeout != -1);
+
+      if (timeout > 0)
+        g_usleep (timeout);
+
+      cogl_poll_dispatch (state->context, poll_fds, 0);
+    }
+}
+
+static void
+draw_columns (TestState *state, int first_column, int n_columns)
+{
+  float tx_1 = first_column / (float) N_TILES_X;
+  float tx_2 = (first_column + n_columns) / (float) N_TILES_X;
+
+  cogl_set_source_texture (COGL_TEXTURE (state->tex));
+  cogl_rectangle_with_texture_coords (first_column * TILE_SIZE, 0,
+                                      (first_column + n_columns) * TILE_SIZE,
+                                      N_TILES_Y * TILE_SIZE,
+                                      tx_1, 0.0f, tx_2, 1.0f);
+}
+
+static void
+draw_first_tile_polygon (TestState *state)
+{
+  float tx = 1.0f / N_TILES_X;
+  float ty = 1.0f / N_TILES_Y;
+  CoglTextureVertex vertices[4] =
+    {
+      { 0, 0, 0, 0, 0 },
+      { 0, TILE_SIZE, 0, 0, ty },
+      { TILE_SIZE, TILE_SIZE, 0, tx, ty },
+      { TILE_SIZE, 0, 0, tx, 0 }
+    };
+
+  cogl_set_source_texture (COGL_TEXTURE (state->tex));
+  cogl_polygon (vertices, G_N_ELEMENTS (vertices), FALSE);
+}
+
+static void
+check_columns (int first_column, int n_columns)
+{
+  int tile_x, tile_y;
+
+  for (tile_y = 0; tile_y < N_TILES_Y; tile_y++)
+    for (tile_x = first_column; tile_x < first_column + n_columns; tile_x++)
+      test_utils_check_pixel (tile_x * TILE_SIZE + TILE_SIZE / 2,
+                              tile_y * TILE_SIZE + TILE_SIZE / 2,
+                              get_tile_color (tile_x, tile_y));
+}
+
+void
+test_cogl_tiled_texture (TestUtilsGTestFixture *fixture,
+                         void *data)
+{
+  TestUtilsSharedState *shared_state = data;
+  TestState state;
+  GError *error = NULL;
+
+  state.context = shared_state->ctx;
+  state.n_source_calls = 0;
+  state.n_load_callbacks = 0;
+
+  cogl_ortho (0, cogl_framebuffer_get_width (shared_state->fb), /* left, right */
+              cogl_framebuffer_get_height (shared_state->fb), 0, /* bottom, top */
+              -1, 100 /* z near, far */);
+
+  state.tex = cogl_tiled_texture_new (state.context,
+                                      N_TILES_X * TILE_SIZE,
+                                      N_TILES_Y * TILE_SIZE,
+                                      TILE_SIZE,
+                                      MAX_TILES,
+                                      COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                      tile_source_cb,
+                                      &state,
+                                      &error);
+  g_assert_no_error (error);
+  g_assert (cogl_is_tiled_texture (state.tex));
+
+  cogl_tiled_texture_set_load_callback (state.tex, load_cb, &state);
+
+  /* Nothing should be loaded until the tiles are drawn */
+  g_assert_cmpint (cogl_tiled_texture_get_n_loaded_tiles (state.tex), ==, 0);
+  g_assert_cmpint (cogl_tiled_texture_get_n_pending_tiles (state.tex), ==, 0);
+
+  /* Drawing the left half should only request those tiles */
+  draw_columns (&state, 0, N_TILES_X / 2);
+  g_assert_cmpint (cogl_tiled_texture_get_n_pending_tiles (state.tex),
+                   ==,
+                   MAX_TILES);
+
+  wait_for_tiles (&state);
+
+  g_assert_cmpint (g_atomic_int_get (&state.n_source_calls), ==, MAX_TILES);
+  g_assert_cmpint (state.n_load_callbacks, ==, MAX_TILES);
+  g_assert_cmpint (cogl_tiled_texture_get_n_loaded_tiles (state.tex),
+                   ==,
+                   MAX_TILES);
+
+  draw_columns (&state, 0, N_TILES_X / 2);
+  check_columns (0, N_TILES_X / 2);
+
+  /* Drawing the loaded tiles again shouldn't request anything */
+  g_assert_cmpint (cogl_tiled_texture_get_n_pending_tiles (state.tex), ==, 0);
+
+  /* The right half should evict the left half because the pool is
+     full */
+  draw_columns (&state, N_TILES_X / 2, N_TILES_X / 2);
+  wait_for_tiles (&state);
+
+  g_assert_cmpint (g_atomic_int_get (&state.n_source_calls),
+                   ==,
+                   MAX_TILES * 2);
+  g_assert_cmpint (cogl_tiled_texture_get_n_loaded_tiles (state.tex),
+                   ==,
+                   MAX_TILES);
+
+  draw_columns (&state, N_TILES_X / 2, N_TILES_X / 2);
+  check_columns (N_TILES_X / 2, N_TILES_X / 2);
+
+  /* cogl_polygon() can't resolve the tiles so it draws with the first
+     tile. The texture coordinates covering that tile should map onto
+     the whole of it */
+  draw_columns (&state, 0, 1);
+  wait_for_tiles (&state);
+  draw_first_tile_polygon (&state);
+  test_utils_check_pixel (TILE_SIZE / 2, TILE_SIZE / 2,
+                          get_tile_color (0, 0));
+
+  cogl_object_unref (state.tex);
+
+  if (g_test_verbose ())
+    g_print ("OK\n");
+}
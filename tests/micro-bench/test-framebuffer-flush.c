@@ -0,0 +1,166 @@
+#include <cogl/cogl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* This benchmark measures the CPU cost of drawing a frame made of
+ * lots of small draws with very few state changes between them. Each
+ * draw is a single line so that it bypasses the journal and goes
+ * straight through _cogl_framebuffer_flush_state(). The modelview
+ * matrix is changed before every draw and optionally the draws can
+ * alternate between two framebuffers, which is what happens when an
+ * application renders an effect into an offscreen buffer while
+ * painting.
+ *
+ * The reported time is the CPU time per frame; the GPU work is kept
+ * small so that the overhead of flushing state dominates. */
+
+#define FRAMEBUFFER_WIDTH 256
+#define FRAMEBUFFER_HEIGHT 256
+
+static int n_draws = 20000;
+static int n_frames = 100;
+static int switch_interval = 0;
+
+static GOptionEntry entries[] =
+{
+  { "draws", 'd', 0, G_OPTION_ARG_INT, &n_draws,
+    "Number of draws per frame", "N" },
+  { "frames", 'f', 0, G_OPTION_ARG_INT, &n_frames,
+    "Number of frames to draw", "N" },
+  { "switch", 's', 0, G_OPTION_ARG_INT, &switch_interval,
+    "Switch framebuffers every N draws (0 to never switch)", "N" },
+  { NULL }
+};
+
+static CoglFramebuffer *
+create_framebuffer (CoglContext *ctx)
+{
+  CoglTexture *texture;
+  CoglFramebuffer *fb;
+  GError *error = NULL;
+
+  texture =
+    COGL_TEXTURE (cogl_texture_2d_new_with_size (ctx,
+                                                 FRAMEBUFFER_WIDTH,
+                                                 FRAMEBUFFER_HEIGHT,
+                                                 COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                 &error));
+  if (!texture)
+    g_error ("Failed to create texture: %s", error->message);
+
+  fb = COGL_FRAMEBUFFER (cogl_offscreen_new_to_texture (texture));
+  cogl_object_unref (texture);
+
+  if (!cogl_framebuffer_allocate (fb, &error))
+    g_error ("Failed to allocate framebuffer: %s", error->message);
+
+  cogl_framebuffer_orthographic (fb,
+                                 0, 0,
+                                 FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT,
+                                 -1, 100);
+
+  return fb;
+}
+
+static void
+paint (CoglFramebuffer **fbs,
+       CoglPipeline *pipeline,
+       CoglPrimitive *line)
+{
+  int fb_num = 0;
+  int i;
+
+  cogl_framebuffer_clear4f (fbs[0], COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+  cogl_framebuffer_clear4f (fbs[1], COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+
+  for (i = 0; i < n_draws; i++)
+    {
+      CoglFramebuffer *fb;
+
+      if (switch_interval && i % switch_interval == 0)
+        fb_num = !fb_num;
+
+      fb = fbs[fb_num];
+
+      cogl_framebuffer_push_matrix (fb);
+      cogl_framebuffer_translate (fb,
+                                  i % FRAMEBUFFER_WIDTH,
+                                  (i / FRAMEBUFFER_WIDTH) % FRAMEBUFFER_HEIGHT,
+                                  0);
+      cogl_framebuffer_draw_primitive (fb, pipeline, line);
+      cogl_framebuffer_pop_matrix (fb);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  CoglContext *ctx;
+  CoglFramebuffer *fbs[2];
+  CoglPipeline *pipeline;
+  CoglPrimitive *line;
+  CoglVertexP2 line_vertices[] = { { 0, 0 }, { 1, 1 } };
+  GError *error = NULL;
+  gint64 start_time, total_time;
+  int frame;
+
+  context = g_option_context_new ("- benchmark flushing framebuffer state");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  ctx = cogl_context_new (NULL, &error);
+  if (!ctx)
+    {
+      fprintf (stderr, "Failed to create context: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  fbs[0] = create_framebuffer (ctx);
+  fbs[1] = create_framebuffer (ctx);
+
+  pipeline = cogl_pipeline_new ();
+  cogl_pipeline_set_color4ub (pipeline, 0xff, 0xff, 0xff, 0xff);
+
+  line = cogl_primitive_new_p2 (ctx, COGL_VERTICES_MODE_LINES,
+                                G_N_ELEMENTS (line_vertices),
+                                line_vertices);
+
+  /* Draw one frame first so that everything is initialized */
+  paint (fbs, pipeline, line);
+  cogl_framebuffer_finish (fbs[0]);
+  cogl_framebuffer_finish (fbs[1]);
+
+  start_time = g_get_monotonic_time ();
+
+  for (frame = 0; frame < n_frames; frame++)
+    paint (fbs, pipeline, line);
+
+  total_time = g_get_monotonic_time () - start_time;
+
+  cogl_framebuffer_finish (fbs[0]);
+  cogl_framebuffer_finish (fbs[1]);
+
+  printf ("%i draws per frame, %i frames, ", n_draws, n_frames);
+  if (switch_interval)
+    printf ("switching framebuffers every %i draws\n", switch_interval);
+  else
+    printf ("not switching framebuffers\n");
+  printf ("CPU time per frame: %.1f us\n", total_time / (double) n_frames);
+  printf ("CPU time per draw: %.3f us\n",
+          total_time / ((double) n_frames * n_draws));
+
+  cogl_object_unref (line);
+  cogl_object_unref (pipeline);
+  cogl_object_unref (fbs[0]);
+  cogl_object_unref (fbs[1]);
+  cogl_object_unref (ctx);
+
+  return EXIT_SUCCESS;
+}
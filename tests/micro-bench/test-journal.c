@@ -0,0 +1,274 @@
+#include <cogl/cogl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* This benchmark measures how long it takes the journal to prepare
+ * the vertices of a big scene for drawing. That includes software
+ * clipping and expanding and transforming the vertices of each
+ * rectangle. The scene is drawn with a different number of journal
+ * threads in separate processes, because the number of threads is
+ * read when the context is created, and the speedup is reported. */
+
+#define FRAMEBUFFER_WIDTH 640
+#define FRAMEBUFFER_HEIGHT 480
+
+#define DEFAULT_N_RECTANGLES 20000
+#define DEFAULT_N_FRAMES 100
+#define DEFAULT_N_THREADS 4
+
+/* Every few rectangles are drawn with a clip so that the software
+ * clipping gets exercised */
+#define RECTANGLES_PER_CLIP 4
+
+static int n_rectangles = DEFAULT_N_RECTANGLES;
+static int n_frames = DEFAULT_N_FRAMES;
+static int n_threads = DEFAULT_N_THREADS;
+static gboolean run_child = FALSE;
+
+static GOptionEntry entries[] =
+{
+  { "rectangles", 'r', 0, G_OPTION_ARG_INT, &n_rectangles,
+    "Number of rectangles to draw per frame", "N" },
+  { "frames", 'f', 0, G_OPTION_ARG_INT, &n_frames,
+    "Number of frames to draw", "N" },
+  { "threads", 't', 0, G_OPTION_ARG_INT, &n_threads,
+    "Number of journal threads to compare against no threads", "N" },
+  { "child", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &run_child,
+    NULL, NULL },
+  { NULL }
+};
+
+static void
+paint (CoglFramebuffer *fb, CoglPipeline *pipeline, int frame)
+{
+  float size = 8;
+  int n_columns = FRAMEBUFFER_WIDTH / size;
+  int i;
+
+  cogl_framebuffer_clear4f (fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+
+  cogl_framebuffer_push_matrix (fb);
+
+  /* Rotate the scene slightly so that the vertices have to go
+   * through a real transform */
+  cogl_framebuffer_translate (fb,
+                              FRAMEBUFFER_WIDTH / 2,
+                              FRAMEBUFFER_HEIGHT / 2,
+                              0);
+  cogl_framebuffer_rotate (fb, frame % 360, 0, 0, 1);
+  cogl_framebuffer_translate (fb,
+                              -FRAMEBUFFER_WIDTH / 2,
+                              -FRAMEBUFFER_HEIGHT / 2,
+                              0);
+
+  cogl_push_source (pipeline);
+
+  for (i = 0; i < n_rectangles; i++)
+    {
+      float x = (i % n_columns) * size;
+      float y = ((i / n_columns) % (FRAMEBUFFER_HEIGHT / (int) size)) * size;
+
+      if (i % RECTANGLES_PER_CLIP == 0)
+        cogl_framebuffer_push_rectangle_clip (fb,
+                                              x, y,
+                                              x + size * 2, y + size / 2);
+
+      cogl_rectangle_with_texture_coords (x, y, x + size, y + size,
+                                          0, 0, 1, 1);
+
+      if (i % RECTANGLES_PER_CLIP == RECTANGLES_PER_CLIP - 1 ||
+          i == n_rectangles - 1)
+        cogl_framebuffer_pop_clip (fb);
+    }
+
+  cogl_pop_source ();
+
+  cogl_framebuffer_pop_matrix (fb);
+}
+
+/* Draws the scene and prints the average time in microseconds that
+ * the journal spent preparing the vertices of each frame */
+static int
+run_benchmark (void)
+{
+  CoglContext *ctx;
+  CoglTexture *render_texture;
+  CoglTexture *texture;
+  CoglFramebuffer *fb;
+  CoglPipeline *pipeline;
+  CoglJournalStats stats;
+  guint8 tex_data[] = { 0xff, 0x00, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff,
+                        0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+  GError *error = NULL;
+  gint64 start_time;
+  gint64 frame_time = 0;
+  int frame;
+
+  ctx = cogl_context_new (NULL, &error);
+  if (!ctx)
+    {
+      fprintf (stderr, "Failed to create context: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  render_texture =
+    COGL_TEXTURE (cogl_texture_2d_new_with_size (ctx,
+                                                 FRAMEBUFFER_WIDTH,
+                                                 FRAMEBUFFER_HEIGHT,
+                                                 COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                 &error));
+  if (!render_texture)
+    {
+      fprintf (stderr, "Failed to create texture: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  fb = COGL_FRAMEBUFFER (cogl_offscreen_new_to_texture (render_texture));
+  if (!cogl_framebuffer_allocate (fb, &error))
+    {
+      fprintf (stderr, "Failed to allocate framebuffer: %s\n",
+               error->message);
+      return EXIT_FAILURE;
+    }
+
+  cogl_framebuffer_orthographic (fb,
+                                 0, 0,
+                                 FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT,
+                                 -1, 100);
+
+  texture = COGL_TEXTURE (cogl_texture_2d_new_from_data (ctx,
+                                                         2, 2,
+                                                         COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                         COGL_PIXEL_FORMAT_ANY,
+                                                         8,
+                                                         tex_data,
+                                                         &error));
+  if (!texture)
+    {
+      fprintf (stderr, "Failed to create texture: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  pipeline = cogl_pipeline_new ();
+  cogl_pipeline_set_layer_texture (pipeline, 0, texture);
+
+  cogl_push_framebuffer (fb);
+
+  /* Draw one frame first so that everything is initialized */
+  paint (fb, pipeline, 0);
+  cogl_framebuffer_finish (fb);
+
+  cogl_framebuffer_reset_journal_stats (fb);
+
+  for (frame = 0; frame < n_frames; frame++)
+    {
+      start_time = g_get_monotonic_time ();
+
+      paint (fb, pipeline, frame);
+      cogl_framebuffer_finish (fb);
+
+      frame_time += g_get_monotonic_time () - start_time;
+    }
+
+  cogl_framebuffer_get_journal_stats (fb, &stats);
+
+  cogl_pop_framebuffer ();
+
+  printf ("%f %f\n",
+          stats.upload_time / (double) n_frames,
+          frame_time / (double) n_frames);
+
+  cogl_object_unref (pipeline);
+  cogl_object_unref (texture);
+  cogl_object_unref (fb);
+  cogl_object_unref (render_texture);
+  cogl_object_unref (ctx);
+
+  return EXIT_SUCCESS;
+}
+
+static gboolean
+run_child_benchmark (const char *program,
+                     int threads,
+                     double *prepare_time,
+                     double *frame_time)
+{
+  char *n_rectangles_str = g_strdup_printf ("%i", n_rectangles);
+  char *n_frames_str = g_strdup_printf ("%i", n_frames);
+  char *threads_str = g_strdup_printf ("%i", threads);
+  char *argv[] = { (char *) program,
+                   "--child",
+                   "--rectangles", n_rectangles_str,
+                   "--frames", n_frames_str,
+                   NULL };
+  char *standard_output = NULL;
+  int exit_status;
+  GError *error = NULL;
+  gboolean ret = FALSE;
+
+  g_setenv ("COGL_JOURNAL_THREADS", threads_str, TRUE);
+
+  if (!g_spawn_sync (NULL, /* working directory */
+                     argv,
+                     NULL, /* inherit the environment */
+                     0, /* flags */
+                     NULL, NULL, /* child setup */
+                     &standard_output,
+                     NULL, /* inherit stderr */
+                     &exit_status,
+                     &error))
+    {
+      fprintf (stderr, "Failed to run the benchmark: %s\n", error->message);
+      g_error_free (error);
+    }
+  else if (exit_status != 0 ||
+           sscanf (standard_output, "%lf %lf", prepare_time, frame_time) != 2)
+    fprintf (stderr, "The benchmark failed with %i threads\n", threads);
+  else
+    ret = TRUE;
+
+  g_free (standard_output);
+  g_free (threads_str);
+  g_free (n_frames_str);
+  g_free (n_rectangles_str);
+
+  return ret;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  double serial_prepare, serial_frame;
+  double threaded_prepare, threaded_frame;
+
+  context = g_option_context_new ("- benchmark preparing journal flushes");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  if (run_child)
+    return run_benchmark ();
+
+  if (!run_child_benchmark (argv[0], 0, &serial_prepare, &serial_frame) ||
+      !run_child_benchmark (argv[0], n_threads,
+                            &threaded_prepare, &threaded_frame))
+    return EXIT_FAILURE;
+
+  printf ("%i rectangles, %i frames\n", n_rectangles, n_frames);
+  printf ("%-12s %14s %14s\n", "threads", "prepare (us)", "frame (us)");
+  printf ("%-12i %14.1f %14.1f\n", 0, serial_prepare, serial_frame);
+  printf ("%-12i %14.1f %14.1f\n", n_threads,
+          threaded_prepare, threaded_frame);
+  printf ("prepare speedup: %.2fx\n", serial_prepare / threaded_prepare);
+  printf ("frame speedup: %.2fx\n", serial_frame / threaded_frame);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+#include <cogl/cogl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* This benchmark measures the CPU cost of switching between pipelines
+ * that have several layers. Every layer of every pipeline uses a
+ * different texture and the pipelines use a mixture of filters and
+ * wrap modes so each draw has to rebind all of the texture units. If
+ * GL_ARB_sampler_objects and GL_ARB_multi_bind are available Cogl can
+ * do that with a couple of GL calls per draw. Otherwise it has to bind
+ * each unit separately and set the filters and wrap modes as texture
+ * parameters. The counters in COGL_DEBUG=uprof show which path was
+ * taken. */
+
+#define FRAMEBUFFER_WIDTH 256
+#define FRAMEBUFFER_HEIGHT 256
+
+#define TEXTURE_SIZE 16
+#define N_PIPELINES 16
+
+static int n_draws = 10000;
+static int n_frames = 100;
+static int n_layers = 4;
+
+static GOptionEntry entries[] =
+{
+  { "draws", 'd', 0, G_OPTION_ARG_INT, &n_draws,
+    "Number of draws per frame", "N" },
+  { "frames", 'f', 0, G_OPTION_ARG_INT, &n_frames,
+    "Number of frames to draw", "N" },
+  { "layers", 'l', 0, G_OPTION_ARG_INT, &n_layers,
+    "Number of layers in each pipeline", "N" },
+  { NULL }
+};
+
+static CoglPipeline *
+create_pipeline (CoglContext *ctx, int pipeline_num)
+{
+  CoglPipeline *pipeline = cogl_pipeline_new ();
+  GError *error = NULL;
+  int i;
+
+  for (i = 0; i < n_layers; i++)
+    {
+      CoglTexture2D *texture =
+        cogl_texture_2d_new_with_size (ctx,
+                                       TEXTURE_SIZE, TEXTURE_SIZE,
+                                       COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                       &error);
+      if (!texture)
+        g_error ("Failed to create texture: %s", error->message);
+
+      cogl_pipeline_set_layer_texture (pipeline, i, COGL_TEXTURE (texture));
+      cogl_object_unref (texture);
+
+      if ((pipeline_num + i) & 1)
+        cogl_pipeline_set_layer_filters (pipeline, i,
+                                         COGL_PIPELINE_FILTER_NEAREST,
+                                         COGL_PIPELINE_FILTER_NEAREST);
+      if ((pipeline_num + i) & 2)
+        cogl_pipeline_set_layer_wrap_mode (pipeline, i,
+                                           COGL_PIPELINE_WRAP_MODE_REPEAT);
+      else
+        cogl_pipeline_set_layer_wrap_mode (pipeline, i,
+                                           COGL_PIPELINE_WRAP_MODE_CLAMP_TO_EDGE);
+    }
+
+  return pipeline;
+}
+
+static void
+paint (CoglFramebuffer *fb,
+       CoglPipeline **pipelines,
+       CoglPrimitive *line)
+{
+  int i;
+
+  cogl_framebuffer_clear4f (fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+
+  for (i = 0; i < n_draws; i++)
+    cogl_framebuffer_draw_primitive (fb, pipelines[i % N_PIPELINES], line);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  CoglContext *ctx;
+  CoglTexture *texture;
+  CoglFramebuffer *fb;
+  CoglPipeline *pipelines[N_PIPELINES];
+  CoglPrimitive *line;
+  CoglVertexP2 line_vertices[] = { { 0, 0 }, { 1, 1 } };
+  GError *error = NULL;
+  gint64 start_time, total_time;
+  int frame;
+  int i;
+
+  context = g_option_context_new ("- benchmark switching layered pipelines");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  ctx = cogl_context_new (NULL, &error);
+  if (!ctx)
+    {
+      fprintf (stderr, "Failed to create context: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  texture =
+    COGL_TEXTURE (cogl_texture_2d_new_with_size (ctx,
+                                                 FRAMEBUFFER_WIDTH,
+                                                 FRAMEBUFFER_HEIGHT,
+                                                 COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                 &error));
+  if (!texture)
+    {
+      fprintf (stderr, "Failed to create texture: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  fb = COGL_FRAMEBUFFER (cogl_offscreen_new_to_texture (texture));
+  if (!cogl_framebuffer_allocate (fb, &error))
+    {
+      fprintf (stderr, "Failed to allocate framebuffer: %s\n",
+               error->message);
+      return EXIT_FAILURE;
+    }
+
+  cogl_framebuffer_orthographic (fb,
+                                 0, 0,
+                                 FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT,
+                                 -1, 100);
+
+  for (i = 0; i < N_PIPELINES; i++)
+    pipelines[i] = create_pipeline (ctx, i);
+
+  line = cogl_primitive_new_p2 (ctx, COGL_VERTICES_MODE_LINES,
+                                G_N_ELEMENTS (line_vertices),
+                                line_vertices);
+
+  /* Draw one frame first so that everything is initialized */
+  paint (fb, pipelines, line);
+  cogl_framebuffer_finish (fb);
+
+  start_time = g_get_monotonic_time ();
+
+  for (frame = 0; frame < n_frames; frame++)
+    paint (fb, pipelines, line);
+
+  total_time = g_get_monotonic_time () - start_time;
+
+  cogl_framebuffer_finish (fb);
+
+  printf ("%i draws per frame, %i frames, %i layers per pipeline\n",
+          n_draws, n_frames, n_layers);
+  printf ("CPU time per frame: %.1f us\n", total_time / (double) n_frames);
+  printf ("CPU time per draw: %.3f us\n",
+          total_time / ((double) n_frames * n_draws));
+
+  cogl_object_unref (line);
+  for (i = 0; i < N_PIPELINES; i++)
+    cogl_object_unref (pipelines[i]);
+  cogl_object_unref (fb);
+  cogl_object_unref (texture);
+  cogl_object_unref (ctx);
+
+  return EXIT_SUCCESS;
+}
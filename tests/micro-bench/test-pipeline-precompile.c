@@ -0,0 +1,166 @@
+#include <cogl/cogl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* This benchmark measures how long it takes to draw the first frame
+ * of a scene that uses lots of pipelines that haven't been drawn
+ * before. Each pipeline has a different fragment snippet so they all
+ * need their own program. Normally the programs are generated and
+ * linked in the middle of the frame. With --precompile they are
+ * compiled with cogl_pipeline_precompile_many() before the frame
+ * starts so the frame only has to bind them. The time taken to
+ * precompile is reported separately.
+ *
+ * With --async=ancestor or --async=skip the programs are linked
+ * asynchronously using the given policy by setting
+ * COGL_ASYNC_SHADERS. The pipelines here have no ancestors with a
+ * program so with the ancestor policy the frame still waits for the
+ * links but the precompile doesn't. With the skip policy neither
+ * of them waits. */
+
+#define FRAMEBUFFER_WIDTH 256
+#define FRAMEBUFFER_HEIGHT 256
+
+static int n_pipelines = 100;
+static gboolean precompile = FALSE;
+static char *async_policy = NULL;
+
+static GOptionEntry entries[] =
+{
+  { "pipelines", 'p', 0, G_OPTION_ARG_INT, &n_pipelines,
+    "Number of different pipelines to draw", "N" },
+  { "precompile", 'c', 0, G_OPTION_ARG_NONE, &precompile,
+    "Precompile the pipelines before drawing", NULL },
+  { "async", 'a', 0, G_OPTION_ARG_STRING, &async_policy,
+    "Link programs asynchronously with the given policy", "POLICY" },
+  { NULL }
+};
+
+static CoglPipeline *
+create_pipeline (int pipeline_num)
+{
+  CoglPipeline *pipeline;
+  CoglSnippet *snippet;
+  char *source;
+
+  pipeline = cogl_pipeline_new ();
+
+  source = g_strdup_printf ("cogl_color_out.r *= %f;\n",
+                            pipeline_num / (float) n_pipelines);
+  snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_FRAGMENT,
+                              NULL, /* declarations */
+                              source);
+  cogl_pipeline_add_snippet (pipeline, snippet);
+  cogl_object_unref (snippet);
+  g_free (source);
+
+  return pipeline;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  CoglContext *ctx;
+  CoglTexture *texture;
+  CoglFramebuffer *fb;
+  CoglPipeline **pipelines;
+  CoglPrimitive *line;
+  CoglVertexP2 line_vertices[] = { { 0, 0 }, { 1, 1 } };
+  GError *error = NULL;
+  gint64 start_time, precompile_time = 0, frame_time;
+  int i;
+
+  context = g_option_context_new ("- benchmark drawing new pipelines");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  if (async_policy)
+    g_setenv ("COGL_ASYNC_SHADERS", async_policy, TRUE);
+
+  ctx = cogl_context_new (NULL, &error);
+  if (!ctx)
+    {
+      fprintf (stderr, "Failed to create context: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  texture =
+    COGL_TEXTURE (cogl_texture_2d_new_with_size (ctx,
+                                                 FRAMEBUFFER_WIDTH,
+                                                 FRAMEBUFFER_HEIGHT,
+                                                 COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                 &error));
+  if (!texture)
+    {
+      fprintf (stderr, "Failed to create texture: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  fb = COGL_FRAMEBUFFER (cogl_offscreen_new_to_texture (texture));
+  if (!cogl_framebuffer_allocate (fb, &error))
+    {
+      fprintf (stderr, "Failed to allocate framebuffer: %s\n",
+               error->message);
+      return EXIT_FAILURE;
+    }
+
+  cogl_framebuffer_orthographic (fb,
+                                 0, 0,
+                                 FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT,
+                                 -1, 100);
+
+  line = cogl_primitive_new_p2 (ctx, COGL_VERTICES_MODE_LINES,
+                                G_N_ELEMENTS (line_vertices),
+                                line_vertices);
+
+  pipelines = g_new (CoglPipeline *, n_pipelines);
+  for (i = 0; i < n_pipelines; i++)
+    pipelines[i] = create_pipeline (i);
+
+  /* Make sure the framebuffer itself is ready before timing */
+  cogl_framebuffer_clear4f (fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+  cogl_framebuffer_finish (fb);
+
+  if (precompile)
+    {
+      start_time = g_get_monotonic_time ();
+      cogl_pipeline_precompile_many (ctx, pipelines, n_pipelines,
+                                     COGL_PIPELINE_PRECOMPILE_FLAG_NONE);
+      cogl_framebuffer_finish (fb);
+      precompile_time = g_get_monotonic_time () - start_time;
+    }
+
+  start_time = g_get_monotonic_time ();
+
+  cogl_framebuffer_clear4f (fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+  for (i = 0; i < n_pipelines; i++)
+    cogl_framebuffer_draw_primitive (fb, pipelines[i], line);
+  cogl_framebuffer_finish (fb);
+
+  frame_time = g_get_monotonic_time () - start_time;
+
+  printf ("%i pipelines, %s, %s linking\n",
+          n_pipelines,
+          precompile ? "precompiled" : "compiled during the frame",
+          async_policy ? async_policy : "synchronous");
+  if (precompile)
+    printf ("Precompile time: %.1f ms\n", precompile_time / 1000.0);
+  printf ("First frame time: %.1f ms\n", frame_time / 1000.0);
+
+  for (i = 0; i < n_pipelines; i++)
+    cogl_object_unref (pipelines[i]);
+  g_free (pipelines);
+  cogl_object_unref (line);
+  cogl_object_unref (fb);
+  cogl_object_unref (texture);
+  cogl_object_unref (ctx);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+#include <cogl/cogl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* This benchmark measures the CPU cost of switching between lots of
+ * pipelines that share a program but have different values for a
+ * large number of custom uniforms. This is based on the
+ * test-pipeline-uniforms conformance test. Every draw uses a
+ * different pipeline so all of the uniforms have to be flushed each
+ * time.
+ *
+ * With --blocks the shader declares the uniforms in a uniform block
+ * so that Cogl can upload them with a single buffer write per
+ * pipeline change. This needs GL_ARB_uniform_buffer_object. Without
+ * it each uniform is set with a separate glUniform call. Running with
+ * COGL_DEBUG=disable-ubos shows the cost when the driver doesn't
+ * support uniform buffers, although the block uniforms won't be set
+ * in that case. */
+
+#define FRAMEBUFFER_WIDTH 256
+#define FRAMEBUFFER_HEIGHT 256
+
+#define N_VECTORS 16
+#define N_PIPELINES 64
+
+static int n_draws = 10000;
+static int n_frames = 100;
+static gboolean use_blocks = FALSE;
+
+static GOptionEntry entries[] =
+{
+  { "draws", 'd', 0, G_OPTION_ARG_INT, &n_draws,
+    "Number of draws per frame", "N" },
+  { "frames", 'f', 0, G_OPTION_ARG_INT, &n_frames,
+    "Number of frames to draw", "N" },
+  { "blocks", 'b', 0, G_OPTION_ARG_NONE, &use_blocks,
+    "Declare the uniforms in a uniform block", NULL },
+  { NULL }
+};
+
+static const char
+plain_source[] =
+  "uniform vec4 colors[" G_STRINGIFY (N_VECTORS) "];\n"
+  "uniform mat4 transform;\n"
+  "uniform float scale;\n";
+
+static const char
+block_source[] =
+  "#extension GL_ARB_uniform_buffer_object : enable\n"
+  "layout(std140) uniform Values\n"
+  "{\n"
+  "  vec4 colors[" G_STRINGIFY (N_VECTORS) "];\n"
+  "  mat4 transform;\n"
+  "  float scale;\n"
+  "};\n";
+
+static const char
+main_source[] =
+  "\n"
+  "void\n"
+  "main ()\n"
+  "{\n"
+  "  vec4 color = vec4 (0.0);\n"
+  "  int i;\n"
+  "\n"
+  "  for (i = 0; i < " G_STRINGIFY (N_VECTORS) "; i++)\n"
+  "    color += colors[i];\n"
+  "\n"
+  "  cogl_color_out = transform * color * scale;\n"
+  "}\n";
+
+static CoglPipeline *
+create_pipeline (void)
+{
+  CoglPipeline *pipeline;
+  CoglHandle shader;
+  CoglHandle program;
+  char *source;
+
+  source = g_strconcat (use_blocks ? block_source : plain_source,
+                        main_source,
+                        NULL);
+
+  pipeline = cogl_pipeline_new ();
+
+  shader = cogl_create_shader (COGL_SHADER_TYPE_FRAGMENT);
+  cogl_shader_source (shader, source);
+
+  program = cogl_create_program ();
+  cogl_program_attach_shader (program, shader);
+
+  cogl_pipeline_set_user_program (pipeline, program);
+
+  cogl_handle_unref (shader);
+  cogl_handle_unref (program);
+  g_free (source);
+
+  return pipeline;
+}
+
+static void
+set_uniforms (CoglPipeline *pipeline, int pipeline_num)
+{
+  float colors[N_VECTORS * 4];
+  CoglMatrix transform;
+  int i;
+
+  for (i = 0; i < N_VECTORS * 4; i++)
+    colors[i] = (i + pipeline_num) / (float) (N_VECTORS * 4 + N_PIPELINES);
+
+  cogl_matrix_init_identity (&transform);
+  cogl_matrix_scale (&transform, 1.0f, 0.5f, 0.25f);
+  cogl_matrix_rotate (&transform, pipeline_num * 5.0f, 0.0f, 0.0f, 1.0f);
+
+  cogl_pipeline_set_uniform_float (pipeline,
+                                   cogl_pipeline_get_uniform_location (pipeline,
+                                                                       "colors"),
+                                   4, /* n_components */
+                                   N_VECTORS, /* count */
+                                   colors);
+  cogl_pipeline_set_uniform_matrix (pipeline,
+                                    cogl_pipeline_get_uniform_location
+                                    (pipeline, "transform"),
+                                    4, /* dimensions */
+                                    1, /* count */
+                                    FALSE, /* transpose */
+                                    cogl_matrix_get_array (&transform));
+  cogl_pipeline_set_uniform_1f (pipeline,
+                                cogl_pipeline_get_uniform_location (pipeline,
+                                                                    "scale"),
+                                1.0f / N_VECTORS);
+}
+
+static void
+paint (CoglFramebuffer *fb,
+       CoglPipeline **pipelines,
+       CoglPrimitive *line)
+{
+  int i;
+
+  cogl_framebuffer_clear4f (fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+
+  for (i = 0; i < n_draws; i++)
+    cogl_framebuffer_draw_primitive (fb, pipelines[i % N_PIPELINES], line);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  CoglContext *ctx;
+  CoglTexture *texture;
+  CoglFramebuffer *fb;
+  CoglPipeline *parent;
+  CoglPipeline *pipelines[N_PIPELINES];
+  CoglPrimitive *line;
+  CoglVertexP2 line_vertices[] = { { 0, 0 }, { 1, 1 } };
+  GError *error = NULL;
+  gint64 start_time, total_time;
+  int frame;
+  int i;
+
+  context = g_option_context_new ("- benchmark flushing pipeline uniforms");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  ctx = cogl_context_new (NULL, &error);
+  if (!ctx)
+    {
+      fprintf (stderr, "Failed to create context: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  texture =
+    COGL_TEXTURE (cogl_texture_2d_new_with_size (ctx,
+                                                 FRAMEBUFFER_WIDTH,
+                                                 FRAMEBUFFER_HEIGHT,
+                                                 COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                 &error));
+  if (!texture)
+    {
+      fprintf (stderr, "Failed to create texture: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  fb = COGL_FRAMEBUFFER (cogl_offscreen_new_to_texture (texture));
+  if (!cogl_framebuffer_allocate (fb, &error))
+    {
+      fprintf (stderr, "Failed to allocate framebuffer: %s\n",
+               error->message);
+      return EXIT_FAILURE;
+    }
+
+  cogl_framebuffer_orthographic (fb,
+                                 0, 0,
+                                 FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT,
+                                 -1, 100);
+
+  /* All of the pipelines are copies of the same parent so that they
+   * share a single GL program */
+  parent = create_pipeline ();
+
+  for (i = 0; i < N_PIPELINES; i++)
+    {
+      pipelines[i] = cogl_pipeline_copy (parent);
+      set_uniforms (pipelines[i], i);
+    }
+
+  line = cogl_primitive_new_p2 (ctx, COGL_VERTICES_MODE_LINES,
+                                G_N_ELEMENTS (line_vertices),
+                                line_vertices);
+
+  /* Draw one frame first so that everything is initialized */
+  paint (fb, pipelines, line);
+  cogl_framebuffer_finish (fb);
+
+  start_time = g_get_monotonic_time ();
+
+  for (frame = 0; frame < n_frames; frame++)
+    paint (fb, pipelines, line);
+
+  total_time = g_get_monotonic_time () - start_time;
+
+  cogl_framebuffer_finish (fb);
+
+  printf ("%i draws per frame, %i frames, uniforms %s\n",
+          n_draws, n_frames,
+          use_blocks ? "in a uniform block" : "set individually");
+  printf ("CPU time per frame: %.1f us\n", total_time / (double) n_frames);
+  printf ("CPU time per draw: %.3f us\n",
+          total_time / ((double) n_frames * n_draws));
+
+  cogl_object_unref (line);
+  for (i = 0; i < N_PIPELINES; i++)
+    cogl_object_unref (pipelines[i]);
+  cogl_object_unref (parent);
+  cogl_object_unref (fb);
+  cogl_object_unref (texture);
+  cogl_object_unref (ctx);
+
+  return EXIT_SUCCESS;
+}
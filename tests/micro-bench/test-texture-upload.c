@@ -0,0 +1,191 @@
+#include <cogl/cogl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* This benchmark measures the CPU time spent updating a large texture
+ * every frame, as a video player would. Each frame the whole texture
+ * is replaced with new data and then drawn.
+ *
+ * With --async the data is uploaded with
+ * cogl_texture_set_region_async() so that the upload is staged in a
+ * pixel buffer and the application doesn't have to wait for the
+ * driver to copy it. Without it cogl_texture_set_region() is used. */
+
+#define FRAMEBUFFER_WIDTH 256
+#define FRAMEBUFFER_HEIGHT 256
+
+static int texture_width = 1920;
+static int texture_height = 1080;
+static int n_frames = 100;
+static gboolean use_async = FALSE;
+
+static GOptionEntry entries[] =
+{
+  { "width", 'W', 0, G_OPTION_ARG_INT, &texture_width,
+    "Width of the texture", "N" },
+  { "height", 'H', 0, G_OPTION_ARG_INT, &texture_height,
+    "Height of the texture", "N" },
+  { "frames", 'f', 0, G_OPTION_ARG_INT, &n_frames,
+    "Number of frames to draw", "N" },
+  { "async", 'a', 0, G_OPTION_ARG_NONE, &use_async,
+    "Upload with cogl_texture_set_region_async()", NULL },
+  { NULL }
+};
+
+static void
+fill_data (guint8 *data, int frame)
+{
+  int i;
+
+  for (i = 0; i < texture_width * texture_height * 4; i++)
+    data[i] = i + frame;
+}
+
+static void
+paint (CoglFramebuffer *fb,
+       CoglPipeline *pipeline,
+       CoglTexture *texture,
+       const guint8 *data,
+       unsigned int *upload_id)
+{
+  if (use_async)
+    cogl_texture_set_region_async (texture,
+                                   0, 0, /* src_x/y */
+                                   0, 0, /* dst_x/y */
+                                   texture_width, texture_height,
+                                   texture_width, texture_height,
+                                   COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                   0, /* rowstride */
+                                   data,
+                                   upload_id);
+  else
+    cogl_texture_set_region (texture,
+                             0, 0, /* src_x/y */
+                             0, 0, /* dst_x/y */
+                             texture_width, texture_height,
+                             texture_width, texture_height,
+                             COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                             0, /* rowstride */
+                             data);
+
+  cogl_framebuffer_clear4f (fb, COGL_BUFFER_BIT_COLOR, 0, 0, 0, 1);
+  cogl_framebuffer_draw_rectangle (fb, pipeline,
+                                   0, 0,
+                                   FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  CoglContext *ctx;
+  CoglTexture *fb_texture;
+  CoglTexture *texture;
+  CoglFramebuffer *fb;
+  CoglPipeline *pipeline;
+  GError *error = NULL;
+  guint8 *frames[2];
+  unsigned int upload_id = 0;
+  gint64 start_time, total_time;
+  int n_pending = 0;
+  int frame;
+
+  context = g_option_context_new ("- benchmark streaming texture uploads");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  ctx = cogl_context_new (NULL, &error);
+  if (!ctx)
+    {
+      fprintf (stderr, "Failed to create context: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  fb_texture =
+    COGL_TEXTURE (cogl_texture_2d_new_with_size (ctx,
+                                                 FRAMEBUFFER_WIDTH,
+                                                 FRAMEBUFFER_HEIGHT,
+                                                 COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                 &error));
+  if (!fb_texture)
+    {
+      fprintf (stderr, "Failed to create texture: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  fb = COGL_FRAMEBUFFER (cogl_offscreen_new_to_texture (fb_texture));
+  if (!cogl_framebuffer_allocate (fb, &error))
+    {
+      fprintf (stderr, "Failed to allocate framebuffer: %s\n",
+               error->message);
+      return EXIT_FAILURE;
+    }
+
+  cogl_framebuffer_orthographic (fb,
+                                 0, 0,
+                                 FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT,
+                                 -1, 100);
+
+  texture =
+    COGL_TEXTURE (cogl_texture_2d_new_with_size (ctx,
+                                                 texture_width,
+                                                 texture_height,
+                                                 COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                 &error));
+  if (!texture)
+    {
+      fprintf (stderr, "Failed to create texture: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  pipeline = cogl_pipeline_new ();
+  cogl_pipeline_set_layer_texture (pipeline, 0, texture);
+
+  /* Alternate between two frames of data so that the driver can't
+     skip any of the uploads */
+  frames[0] = g_malloc (texture_width * texture_height * 4);
+  frames[1] = g_malloc (texture_width * texture_height * 4);
+  fill_data (frames[0], 0);
+  fill_data (frames[1], 1);
+
+  /* Draw one frame first so that everything is initialized */
+  paint (fb, pipeline, texture, frames[0], &upload_id);
+  cogl_framebuffer_finish (fb);
+
+  start_time = g_get_monotonic_time ();
+
+  for (frame = 0; frame < n_frames; frame++)
+    {
+      paint (fb, pipeline, texture, frames[frame & 1], &upload_id);
+
+      if (use_async && !cogl_texture_is_upload_complete (texture, upload_id))
+        n_pending++;
+    }
+
+  total_time = g_get_monotonic_time () - start_time;
+
+  cogl_framebuffer_finish (fb);
+
+  printf ("%ix%i texture, %i frames, %s uploads\n",
+          texture_width, texture_height, n_frames,
+          use_async ? "asynchronous" : "synchronous");
+  printf ("CPU time per frame: %.1f us\n", total_time / (double) n_frames);
+  if (use_async)
+    printf ("Frames with the upload still pending: %i\n", n_pending);
+
+  g_free (frames[0]);
+  g_free (frames[1]);
+  cogl_object_unref (pipeline);
+  cogl_object_unref (texture);
+  cogl_object_unref (fb);
+  cogl_object_unref (fb_texture);
+  cogl_object_unref (ctx);
+
+  return EXIT_SUCCESS;
+}